@@ -0,0 +1,24 @@
+/*
+ * bench.h
+ * Kevin Coltin 
+ *
+ * Contains microbenchmarks of the program's inner loops, which are run with 
+ * ./blackjack_strategy bench [name], and a wall-clock timer. 
+ */
+
+#ifndef BENCH_H 
+#define BENCH_H 
+
+double wall_time (); 
+void runBenchmarks (const char *name); 
+void benchRng (); 
+void benchSampler (); 
+void benchAllocs (); 
+void benchDealer (); 
+void benchChain (); 
+void benchStand (); 
+void benchChart (); 
+void benchSplits (); 
+void benchLinal (); 
+
+#endif 
@@ -8,26 +8,143 @@
 #ifndef BJ_SIMS_H 
 #define BJ_SIMS_H 
 
+#include <stdint.h>
+#include "stp.h"
 #include "bj_strat.h" 
 #include "hands.h"
+#include "shoe.h"
+
+//Variance-reduction methods for the simulations, which may be combined (see 
+//runSims) 
+#define VR_CONTROL (1) //the dealer's final total, as control variates 
+#define VR_ANTITHETIC (2) //antithetic pairs of hands 
+#define VR_STRATIFY (4) //stratified choice of the starting cards 
+
+//Maximum number of combinations of two cards that can make a given hard hand 
+//in chooseCardsInStartingHand 
+#define MAX_COMBOS (4) 
+
+//Number of the dealer's final totals used as control variates: 18 to 21 and 
+//bust (17 is left out, since the six add up to one) 
+#define NUM_DEALER_CONTROLS (5) 
+
+//Positions of the quantities in a unit of simulations whose sums of products 
+//are kept in a HandSim: a constant 1, the numbers of times the dealer ends on
+//each of the totals 18 to 21 and bust, the numbers of hands dealt from each 
+//of the first MAX_COMBOS-1 combinations of starting cards, and the numbers of
+//wins and losses. 
+#define MOMENT_ONE (0) 
+#define MOMENT_DEALER (1) 
+#define MOMENT_STRATA (MOMENT_DEALER + NUM_DEALER_CONTROLS) 
+#define MOMENT_WIN (MOMENT_STRATA + MAX_COMBOS - 1) 
+#define MOMENT_LOSS (MOMENT_WIN + 1) 
+#define NUM_MOMENTS (MOMENT_LOSS + 1) 
 
 //Structure representing the results of simulations for a single combination of
 //player's hand and dealer's up card 
 typedef struct {
   int nwins; 
   int nlosses; 
+  int nsims; //number of simulations run 
+  double moments[NUM_MOMENTS][NUM_MOMENTS]; //sums over units of the products
+                              //of the quantities above (upper 
+                              //triangle only); kept only with 
+                              //variance reduction 
 } HandSim; 
 
+//Estimates of the probabilities of winning and losing in one cell, from its 
+//HandSim 
+typedef struct {
+  double winPct; 
+  double lossPct; 
+  double winVar; //variance of the estimate winPct 
+  double lossVar; 
+  double winGain; //effective sample size of winPct per simulated hand, i.e. 
+              //the factor by which variance reduction cut its variance 
+  double lossGain; 
+} SimEstimate; 
+
+//Settings for runAdaptiveSims 
+typedef struct {
+  double halfWidth; //target half-width of the confidence intervals for the 
+               //probabilities of winning and of losing, in every cell 
+  double confidence; //confidence level of the intervals, e.g. .95 
+  double alpha; //if positive, a cell is also finished once it disagrees with 
+            //the chart at this significance level (Bonferroni-corrected 
+            //over the cells), since more simulations cannot change that 
+  int vr; //variance-reduction methods, as in runSims 
+  int pilot; //number of simulations of every cell in the first round 
+  int maxPerCell; //most simulations to run of any one cell 
+} AdaptiveSpec; 
+
+//Summary of a run of runAdaptiveSims 
+typedef struct {
+  int nrounds; 
+  int ncells; //number of cells simulated 
+  int nmet; //number of cells whose intervals reached the target half-width 
+  int ndisagree; //number of cells that disagree with the chart 
+  long nhands; //total number of hands simulated 
+  long uniformHands; //number that would have been needed by giving every 
+                //cell as many simulations as the one that needed most 
+  double maxHalfWidth; //widest interval at the end 
+} AdaptiveResult; 
+
+//Structure representing the results of playing rounds from a shoe until its 
+//cut card, over a number of shoes. Winnings are in units of the initial bet. 
+//Rounds from the same shoe are not independent, so the sums over shoes are 
+//kept in order to estimate the standard error with each shoe as a batch. 
+typedef struct {
+  long nshoes; 
+  long nrounds; 
+  double won; //net amount won by the player over all rounds 
+  double wonSq; //sum over shoes of the square of the amount won in the shoe 
+  double roundsSq; //sum over shoes of the square of the number of rounds 
+  double wonRounds; //sum over shoes of amount won times number of rounds 
+} ShoeSim; 
+
 
 //Function prototypes 
-void runSims(HandSim **simsChart, Strategy **chart, int i, int upCard, int N);
+void runSimsParallel (HandSim **simsChart, const StrategyTable *chart, 
+              const Rules *rules, int N, int vr, int nthreads, 
+              uint64_t seed, int pass); 
+void runSimsCells (HandSim **simsChart, const StrategyTable *chart, 
+              const Rules *rules, int **nsims, int vr, int nthreads, 
+              uint64_t seed, int pass); 
+void runSims(HandSim **simsChart, const StrategyTable *chart, 
+        const Rules *rules, int i, int upCard, int N, int vr, RandStream *rs);
+SimEstimate getSimEstimate (HandSim hs, const Rules *rules, int i, int upCard,
+                     int vr); 
+AdaptiveResult runAdaptiveSims (HandSim **simsChart, 
+                      const StrategyTable *chart, 
+                      const Rules *rules, AdaptiveSpec spec, int nthreads, 
+                      uint64_t seed); 
+double getSimHalfWidth (SimEstimate est, double z); 
+double getSimPValue (SimEstimate est, Strategy strat); 
+int doesSimDisagree (SimEstimate est, Strategy strat, double alpha, 
+               int ncells); 
+ShoeSim runShoeSims (const StrategyTable *chart, const Rules *rules, 
+              double penetration, int nshoes, int nthreads, uint64_t seed); 
+void playShoe (ShoeSim *sim, Shoe *shoe, const StrategyTable *chart, 
+          const Rules *rules, RandStream *rs); 
+double playRound (Shoe *shoe, const StrategyTable *chart, const Rules *rules, 
+            RandStream *rs); 
+ShoeSim newShoeSim (); 
+void addShoeSim (ShoeSim *total, ShoeSim sim); 
+double getShoeSimEV (ShoeSim sim); 
+double getShoeSimStdErr (ShoeSim sim); 
 int doesPlayerWin (int playerTotal, int dealerTotal);
 int doesPlayerLose (int playerTotal, int dealerTotal);
 HandSim ** initializeSimsChart (); 
 HandSim newHandSim (); 
-double getMaxWinErr(Strategy **chart, HandSim **simsChart, int nsims); 
-double getMaxLossErr(Strategy **chart, HandSim **simsChart, int nsims); 
-void removeCardsInStartingHand (int *deck, Hand hand, int cardsInDeck); 
-int * chooseCardsInStartingHand (int *deck, int value, int cardsInDeck); 
+double getMaxWinErr(const StrategyTable *chart, HandSim **simsChart, 
+             int nsims); 
+double getMaxLossErr(const StrategyTable *chart, HandSim **simsChart, 
+              int nsims); 
+int removeCardsInStartingHand (CardSampler *shoe, Hand hand, double u, 
+                       RandStream *rs); 
+int chooseCardsInStartingHand (CardSampler *shoe, int value, int *cards, 
+                       double u, RandStream *rs); 
+int getStartingCombos (const CardSampler *shoe, int value, int *lesserCards, 
+                 int *greaterCards, int *weights); 
 
 #endif
@@ -9,8 +9,7 @@
 #define BJ_STRAT_H 
 
 #include "hands.h" 
-
-#define NUM_CARDS (10) //number of distinct card types: A, 2-10 
+#include "rules.h" 
 
 //Possible actions to take 
 extern const int STAND;
@@ -20,7 +19,18 @@ extern const int DOUBLE_DOWN;
 
 //Probabilities that the dealer ends up with each possible total 0-22, given 
 //his up card, ignoring the possibility of blackjack. 
-extern double **dealersProbabilities;
+//Each thread has its own, which it sets before solving a chart. 
+extern __thread double **dealersProbabilities;
+
+//Layout of a row of dealersProbabilities, for one up card: the probability 
+//of each total 0-22 (22 for bust), then the player's probability of winning 
+//by standing on each total 0-22, then of losing. The last two are running 
+//sums of the first, made once by makeDealersProbabilities so that a stand is 
+//looked up rather than summed (see probOfWinGivenTotal). 
+#define DEALER_TOTALS (23)
+#define DEALER_WIN_TABLE (DEALER_TOTALS)
+#define DEALER_LOSS_TABLE (2 * DEALER_TOTALS)
+#define DEALER_ROW_SIZE (3 * DEALER_TOTALS)
 
 //Represents the strategy a player should take given a certain hand and 
 //dealer's up card 
@@ -29,39 +39,109 @@ typedef struct {
   double winPct; //probability of winning the hand, Note 1 
   double lossPct; //prob of losing it 
   double splitEV; //expected value of hand if split 
+  int surrender; //true if the player should surrender, when he may (on his 
+             //first two cards); action is then what to do otherwise 
 } Strategy; 
 
-void calculateStrategyChart (Strategy **chart, int MAKE_SIMPLE_CHART); 
-int calculateSimpleChart (Strategy **chart); 
+//Plays whose expected values the chart keeps for every cell, whether or not 
+//they are the best play (see PLAY_EV) 
+enum { 
+  PLAY_EV_STAND, 
+  PLAY_EV_HIT, 
+  PLAY_EV_DOUBLE, 
+  PLAY_EV_SPLIT, 
+  PLAY_EV_SURRENDER, 
+  NUM_PLAY_EVS 
+}; 
+
+//A strategy chart: the Strategy for each hand against each up card, stored 
+//as a structure of arrays in one block of memory, so that the solver reads 
+//the win or loss probabilities of the hands in place. The cell for hands[i] 
+//against upCard is STRAT_CELL(i, upCard); the up cards 0-10 of a hand are 
+//next to each other, and 0 is unused. 
+typedef struct { 
+  int nhands; //number of hands: NUM_HANDS, or NUM_HANDS_SIMPLE 
+  int *action; 
+  int *surrender; 
+  double *winPct; 
+  double *lossPct; 
+  double *splitEV; 
+  double *playEV; //expected value of every play of each cell: see PLAY_EV 
+} StrategyTable; 
+
+#define STRAT_CELL(hand, upCard) ((hand) * (NUM_CARDS+1) + (upCard))
+
+//The expected value of play (a PLAY_EV_ constant) in a cell of the chart, 
+//as getStratEV would give it if that were the play: per unit bet, given that 
+//the dealer doesn't have blackjack. It is NAN where the play may not be made 
+//(doubling or splitting where the rules don't allow it, surrendering without 
+//surrender, and all but standing on a bust or A,10), and for doubling, 
+//splitting and surrendering in a chart of the simple hands only. The solver 
+//finds each of them on the way to the best play. Standing on A,10, which is 
+//a blackjack, is worth what a blackjack pays, as in getEVOfHand. 
+#define PLAY_EV(chart, cell, play) \
+  ((chart)->playEV[(cell) * NUM_PLAY_EVS + (play)])
+
+//The tables, kept per thread, that a solved chart is played by: see 
+//getStratTables 
+typedef struct { 
+  double **dealersProbabilities; 
+  double **hitTransitionMatrix; 
+  int (*hitStandActions)[NUM_CARDS+1]; 
+  int numHitStandLevels; 
+} StratTables; 
+
+StrategyTable * newStrategyTable (int nhands); 
+void freeStrategyTable (StrategyTable *chart); 
+Strategy getStrat (const StrategyTable *chart, int handIndex, int upCard); 
+void setStrat (StrategyTable *chart, int handIndex, int upCard, 
+          Strategy strat); 
+void calculateStrategyChart (StrategyTable *chart, int MAKE_SIMPLE_CHART, 
+                   const Rules *rules); 
+void calculateStrategyChartParallel (StrategyTable *chart, 
+                          int MAKE_SIMPLE_CHART, const Rules *rules, 
+                          int nthreads); 
+int calculateSimpleChart (StrategyTable *chart, const Rules *rules); 
+int calculateSimpleChartScalar (StrategyTable *chart, const Rules *rules); 
+int getHitStandAction (int handIndex, int ncards, int upCard); 
+StratTables getStratTables (); 
+void useStratTables (StratTables tables); 
+void freeStratTables (); 
 int shouldHit (double, double, double, double); 
 double probOfWinIgnorePushes (int yourValue, int upCard);
 double probOfWinGivenTotal (int, int); 
 double probOfLossGivenTotal (int, int); 
 double probOfPushGivenTotal (int, int);
-double getHitWinProb (Strategy **, int **, int, int);
-double getHitLossProb (Strategy **, int **, int, int); 
-double getSplitEV (Strategy **, int, int);
-double getSplitWinProb (Strategy **, int, int, int **);
-double getSplitLossProb (Strategy **, int, int, int **);
-double getDDWinProb (Strategy **, Hand, int);
-double getDDLossProb (Strategy **, Hand, int);
-double * getWinProbsByHand (Strategy **, int, int **);
-double * getLossProbsByHand (Strategy **, int, int **);
-int doesDealerStand (Hand hand); 
-double ** makeDealersProbabilities (); 
-double ** makeDealersTransitionMat (); 
-double ** makeHitTransitionMat (); 
+const double * getStandWinProbs (int upCard); 
+const double * getStandLossProbs (int upCard); 
+void getStandEVs (int upCard, double *ev); 
+double getHitWinProb (const StrategyTable *, int, int);
+double getHitLossProb (const StrategyTable *, int, int); 
+double getSplitEV (const StrategyTable *, int, int, const Rules *);
+double getSplitWinProb (const StrategyTable *, int, int, const Rules *);
+double getSplitLossProb (const StrategyTable *, int, int, const Rules *);
+int getUnsplitIndex (int splitCard); 
+double getDDWinProb (Hand, int);
+double getDDLossProb (Hand, int);
+int doesDealerStand (Hand hand, const Rules *rules); 
+double ** makeDealersProbabilities (const Rules *rules); 
+double ** makeDealersTransitionMat (const Rules *rules); 
+double ** makeHitTransitionMat (const Rules *rules); 
 Hand calculateNewHand (Hand, int); 
-double * distribOfHands (int, int); 
-double cardProbsAceUpAssumingNoBJ(int);
-double cardProbsTenUpAssumingNoBJ(int);
-Strategy splitOrDoubleStrat (Strategy **, int, int); 
-void computeExpectedValue (Strategy **, double); 
-double * getStartingHandProbs (); 
-double * getHandExpVals (Strategy **, double); 
-double getEVOfHand (Strategy **, int, double); 
-double probOfUpCardGivenNoBJ (int); 
-double dot_ignore_undef (double *, double *, int);
+double * distribOfHands (int, int, const Rules *); 
+double cardProbsAceUpAssumingNoBJ(int, const Rules *);
+double cardProbsTenUpAssumingNoBJ(int, const Rules *);
+double computeExpectedValue (const StrategyTable *, const Rules *); 
+double getExpectedValue (const StrategyTable *, const Rules *); 
+double * getStartingHandProbs (const Rules *); 
+double * getHandExpVals (const StrategyTable *, const Rules *); 
+double getHandEV (const StrategyTable *, int, const Rules *); 
+double getEVOfHand (const StrategyTable *, int, const Rules *); 
+double getStratEV (Strategy strat); 
+double getEVDealerBJ (Strategy strat, int handIndex, const Rules *rules); 
+double getEVBeforePeek (Strategy strat, int handIndex, double q, 
+                const Rules *rules); 
+double probOfUpCardGivenNoBJ (int, const Rules *); 
 
 #endif 
 
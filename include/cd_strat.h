@@ -0,0 +1,59 @@
+/* 
+ *  cd_strat.h 
+ *  Kevin Coltin 
+ * 
+ *  Contains a composition-dependent strategy solver, which finds the best play 
+ *  for each pair of cards the player can be dealt against each up card, 
+ *  taking into account exactly which cards have been removed from a finite 
+ *  shoe, rather than only the total of the player's hand. 
+ */ 
+
+#ifndef CD_STRAT_H 
+#define CD_STRAT_H 
+
+#include <stdint.h> 
+#include "bj_strat.h" 
+#include "dealer.h" 
+
+//The best play of one holding (the cards in one player hand) against one up 
+//card, when the only choices left are to hit or stand 
+typedef struct { 
+  uint64_t key; //number of each card held and any other card removed; 0 if 
+             //the entry is empty 
+  double standWin, standLoss; //probabilities of winning/losing by standing 
+  double winPct, lossPct; //probabilities of winning/losing playing optimally 
+  int action; //STAND or HIT 
+} CDHolding; 
+
+//Memoized CDHoldings for one up card: a hash table that grows as needed 
+typedef struct { 
+  CDHolding *entry; 
+  int size; //number of entries; a power of two 
+  int nused; 
+} CDHoldingTable; 
+
+//Composition-dependent strategy for the shoe and rules given by rules. 
+//strat[c1][c2][u] is the strategy for a player dealt cards c1 and c2 (1-10, 
+//in either order) against up card u, in the same form as an entry of the 
+//total-dependent chart: winPct and lossPct are for the chosen action (for one 
+//of the hands after a split), splitEV is set if the action is to split, and 
+//surrender if the player should surrender. As in the chart, everything is 
+//conditioned on the dealer not having blackjack. 
+typedef struct { 
+  const Rules *rules; 
+  int numDecks; 
+  int counts[NUM_CARDS+1]; //number of each card in the full shoe 
+  Strategy strat[NUM_CARDS+1][NUM_CARDS+1][NUM_CARDS+1]; 
+  double ev; //player's expected value per hand, including blackjacks 
+  CDHoldingTable holdings[NUM_CARDS+1]; //solved holdings for each up card 
+  DealerCache *cache; //for getCDHoldingStrat 
+} CDChart; 
+
+CDChart * newCDChart (const Rules *rules); 
+void freeCDChart (CDChart *chart); 
+void calculateCDChart (CDChart *chart, int nthreads); 
+Strategy getCDHoldingStrat (CDChart *chart, const int *cards, int ncards, 
+                   int upCard); 
+double getCDPairSplitEV (CDChart *chart, int card, int upCard); 
+
+#endif 
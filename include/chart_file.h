@@ -0,0 +1,88 @@
+/* 
+ *  chart_file.h 
+ *  Kevin Coltin 
+ * 
+ *  Contains a binary file format for a solved strategy chart: the rules it was 
+ *  solved for, the hands, the dealer's table and the tables that the chart is 
+ *  played by, and the chart with the expected value of each play. The file 
+ *  is mapped into memory read-only and used where it lies, so that loading a 
+ *  chart takes no solving and no copying, and processes that map the same 
+ *  file share one copy of it. 
+ */ 
+
+#ifndef CHART_FILE_H 
+#define CHART_FILE_H 
+
+#include <stddef.h> 
+#include <stdint.h> 
+#include "bj_strat.h" 
+#include "rules.h" 
+
+//Version of the format, which changes whenever the layout does 
+#define CHART_FILE_VERSION (3)
+
+//Sections of the file, each of which starts on a CHART_FILE_ALIGN boundary 
+enum { 
+  CHART_SECTION_RULES, //the Rules 
+  CHART_SECTION_HANDS, //hands, NUM_HANDS of them 
+  CHART_SECTION_DEALER, //dealersProbabilities, by up card 0-10, with rows of 
+                   //DEALER_ROW_SIZE (see bj_strat.h) 
+  CHART_SECTION_HIT_TRANSITION, //hit transition matrix of the simple hands 
+  CHART_SECTION_HIT_STAND, //hit/stand actions of every Charlie level 
+  CHART_SECTION_WIN, //the chart's arrays, by STRAT_CELL 
+  CHART_SECTION_LOSS, 
+  CHART_SECTION_SPLIT_EV, 
+  CHART_SECTION_EV, //expected value of each cell's play (see getStratEV)
+  CHART_SECTION_ACTION, 
+  CHART_SECTION_SURRENDER, 
+  CHART_SECTION_PLAY_EV, //expected value of every play of each cell, 
+                   //NUM_PLAY_EVS per cell (see PLAY_EV) 
+  NUM_CHART_SECTIONS 
+}; 
+
+#define CHART_FILE_ALIGN (64)
+
+//Start of the file. The sizes of the types, the byte order and the numbers of 
+//hands and cards are those of the program that wrote it, which must match 
+//those of the program that reads it, since the sections are read in place. 
+typedef struct { 
+  char magic[8]; //"BJCHART" 
+  int32_t version; //CHART_FILE_VERSION 
+  uint32_t byteOrder; //0x01020304, as written 
+  int32_t headerSize, intSize, handSize, rulesSize; 
+  int32_t numHands, numHandsSimple, numCards; 
+  int32_t numOutcomes; //length of a row of the dealer's table 
+  int32_t numHitStandLevels; 
+  int32_t numPlayEVs; 
+  uint64_t fileSize; 
+  uint64_t offset[NUM_CHART_SECTIONS]; //of each section, in bytes 
+  double ev; //player's expected value per hand, by getExpectedValue 
+} ChartFileHeader; 
+
+//A chart file mapped into memory by loadChartFile. Every array points into 
+//the mapping, which is read-only: the chart and tables must not be written 
+//to. 
+typedef struct { 
+  const ChartFileHeader *header; 
+  Rules rules; 
+  StrategyTable chart; 
+  const double *ev; //expected value of each cell's play, by STRAT_CELL 
+  StratTables tables; //to be played by with useStratTables; the rows of 
+                 //the matrices are pointers into the mapping 
+  void *map; 
+  size_t size; 
+} ChartFile; 
+
+//The --save and --load options (see parseChartFileArgs)
+typedef struct { 
+  const char *save; //file to save the chart to, or NULL 
+  const char *load; //file to load the chart from, or NULL 
+} ChartFileArgs; 
+
+void saveChartFile (const char *filename, const StrategyTable *chart, 
+              const Rules *rules); 
+ChartFile * loadChartFile (const char *filename); 
+void closeChartFile (ChartFile *file); 
+int parseChartFileArgs (ChartFileArgs *args, int argc, char **argv); 
+
+#endif 
@@ -0,0 +1,48 @@
+/* 
+ *  dealer.h 
+ *  Kevin Coltin 
+ * 
+ *  Contains an exact calculator of the distribution of the dealer's final 
+ *  total when he draws from a finite shoe of known composition, rather than 
+ *  from the infinite deck assumed by makeDealersProbabilities. 
+ */ 
+
+#ifndef DEALER_H 
+#define DEALER_H 
+
+#include <stdint.h> 
+#include "bj_strat.h" 
+
+//Number of final totals the dealer can end up with: 17-21 and bust 
+#define NUM_DEALER_TOTALS (6)
+
+//Number of entries in a DealerCache; a power of two 
+#define DEALER_CACHE_SIZE (1 << 14)
+
+//The distribution of the dealer's final total from one partial dealer hand, 
+//identified by the cards that have been dealt to it 
+typedef struct { 
+  uint64_t key; //up card and number of each card drawn; see dealer.c 
+  unsigned gen; //generation of the cache in which the entry was made 
+  double prob[NUM_DEALER_TOTALS]; //probability of ending on 17-21, bust 
+} DealerCacheEntry; 
+
+//Memoized results of dealerOutcomeProbs for one shoe composition. A cache is 
+//owned by the caller, one per thread, and is reused from call to call: 
+//entries are kept as long as the composition is the same, and are discarded 
+//(in constant time) when it changes. 
+typedef struct { 
+  DealerCacheEntry *entry; //hash table of DEALER_CACHE_SIZE entries 
+  unsigned gen; //current generation; entries from older ones are empty 
+  int nused; //number of entries in the current generation 
+  int counts[NUM_CARDS+1]; //composition the entries were computed for 
+  int ncards; //total of counts 
+  const Rules *rules; //how the dealer plays 
+} DealerCache; 
+
+DealerCache * newDealerCache (const Rules *rules); 
+void freeDealerCache (DealerCache *cache); 
+void dealerOutcomeProbs (DealerCache *cache, const int *counts, int upCard, 
+               int noBlackjack, double *probs); 
+
+#endif 
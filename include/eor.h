@@ -0,0 +1,46 @@
+/* 
+ *  eor.h 
+ *  Kevin Coltin 
+ * 
+ *  Contains a calculator of effects of removal: the change in the player's 
+ *  expected value, and in the value of some key decisions, when one card of 
+ *  each rank is taken out of the shoe. These are what card-counting systems 
+ *  are designed from. 
+ */ 
+
+#ifndef EOR_H 
+#define EOR_H 
+
+#include "bj_strat.h" 
+#include "rules.h" 
+
+//A key decision: a hard total against an up card, on which the player 
+//chooses between hitting and standing, or if isDouble is set, between 
+//hitting and doubling 
+typedef struct { 
+  int total; 
+  int upCard; 
+  int isDouble; //1 for hitting and doubling, 0 for hitting and standing 
+} KeyPlay; 
+
+extern const KeyPlay KEY_PLAYS[]; 
+extern const int NUM_KEY_PLAYS; 
+
+//Effects of removal for one set of rules. Every value is per unit bet, and 
+//every effect is the change in it from taking one card of the rank out of 
+//the rules' shoe, to first order, with the plays of the full shoe (0 for a 
+//rank the shoe has none of). 
+typedef struct { 
+  double ev; //player's expected value with the full shoe 
+  double eor[NUM_CARDS+1]; //effect on ev of each rank 1-10 
+  double *keyGain; //for each key play, EV of standing (or doubling) less EV 
+               //of hitting, given that the dealer doesn't have blackjack 
+  double (*keyEoR)[NUM_CARDS+1]; //effect on each keyGain of each rank 
+  double insurance; //expected value of an insurance bet 
+  double insuranceEoR[NUM_CARDS+1]; //effect on it of each rank 
+} EoRSet; 
+
+EoRSet * computeEoR (const Rules *rules, int nthreads); 
+void freeEoRSet (EoRSet *set); 
+
+#endif 
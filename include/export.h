@@ -0,0 +1,84 @@
+/* 
+ *  export.h 
+ *  Kevin Coltin 
+ * 
+ *  Contains writers of tables in machine-readable formats - CSV, 
+ *  newline-delimited JSON and a columnar binary format - for the strategy 
+ *  chart, the results of the simulations and sweeps. Rows are written as they 
+ *  come, through a buffer, so that a table of any length can be written 
+ *  without being held in memory. 
+ */ 
+
+#ifndef EXPORT_H 
+#define EXPORT_H 
+
+#include <stdint.h> 
+#include <stdio.h> 
+#include "bj_sims.h" 
+#include "bj_strat.h" 
+#include "rules.h" 
+#include "sweep.h" 
+
+//Formats of an exported table 
+#define EXPORT_CSV (1) //a header line of column names, then one line per row
+#define EXPORT_NDJSON (2) //one JSON object per line, keyed by column name
+#define EXPORT_COLUMNAR (3) //see below
+
+//Types of the columns of a table 
+#define EXPORT_INT (1) //stored as int64 in the columnar format
+#define EXPORT_DOUBLE (2)
+#define EXPORT_STRING (3)
+
+//Rows of the columnar format are kept in blocks of this many at a time 
+#define EXPORT_BLOCK_ROWS (4096)
+
+//The columnar format, in the byte order of the machine that wrote it: the 
+//magic "BJCOLS" padded with nulls to 8 bytes, uint32 0x01020304 (the byte 
+//order), uint32 version 1 and uint32 number of columns; for each column, 
+//uint32 type and uint32 length of its name, then the name. Then come blocks 
+//of rows, each starting with uint32 number of rows, n, and a block of no rows 
+//ends the file. In a block, each column in turn: n int64 or n doubles, or for 
+//a string column n uint32 lengths followed by the strings, without nulls. 
+
+//One column of a table 
+typedef struct { 
+  const char *name; 
+  int type; //one of the EXPORT_ types 
+} ExportColumn; 
+
+//Buffer of one column of the current block, for the columnar format 
+typedef struct { 
+  char *data; //the values, or for a string column, the strings 
+  size_t size, capacity; //bytes used and allocated in data 
+  uint32_t *lengths; //for a string column, the length of each string 
+} ExportBlockColumn; 
+
+//A table being written: see openExporter 
+typedef struct { 
+  FILE *file; 
+  char *buffer; //the file's buffer 
+  int format; 
+  int ncolumns; 
+  const ExportColumn *columns; 
+  int column; //column of the next value in the current row 
+  long nrows; //rows written so far 
+  int blockRows; //rows in the current block, for the columnar format 
+  ExportBlockColumn *block; 
+} Exporter; 
+
+int getExportFormat (const char *filename); 
+Exporter * openExporter (const char *filename, int format, 
+                 const ExportColumn *columns, int ncolumns); 
+void exportInt (Exporter *e, int64_t value); 
+void exportDouble (Exporter *e, double value); 
+void exportString (Exporter *e, const char *value); 
+void endExportRow (Exporter *e); 
+void closeExporter (Exporter *e); 
+void exportChart (const char *filename, const StrategyTable *chart, 
+              const Rules *rules); 
+void exportSims (const char *filename, HandSim **simsChart, 
+             const StrategyTable *chart, const Rules *rules, int vr); 
+void exportSweep (const char *filename, const Sweep *sweep); 
+int parseExportArgs (const char **filename, int argc, char **argv); 
+
+#endif 
@@ -10,6 +10,8 @@
 #ifndef HANDS_H 
 #define HANDS_H 
 
+#define NUM_CARDS (10) //number of distinct card types: A, 2-10 
+
 //Represents a hand, in terms of the cards held 
 typedef struct {
   int value; //point value of cards (if possible, ace is counted as 11)
@@ -30,6 +32,14 @@ extern const int BUST_VALUE; //indicates any value over 21
 //Vector of all possible hands. 
 extern Hand *hands; 
 
+//Tables of hand indices built by makeHands. handAfterCard[i][card] is the 
+//index of the hand that results from drawing card (1-10) to hands[i]. 
+//handByCards[card1][card2] and dealerHandByCards[card1][card2] are the indices
+//of getHandByCards(card1, card2, FALSE) and getHandByCards(card1, card2, TRUE).
+extern int **handAfterCard; 
+extern int **handByCards; 
+extern int **dealerHandByCards; 
+
 //Constants to use to refer to each hand 
 extern const int FOUR; //splittable; equals 22
 extern const int FIVE; 
@@ -73,11 +83,12 @@ extern const int TENS;
 
 
 void makeHands (); 
+void freeHands (); 
 Hand makeHand (int, int, int, int); 
 int getHandIndex (Hand); 
 Hand getHand (Hand);
 int areHandsEqual (Hand, Hand); 
-char * getHandName (Hand); 
+const char * getHandName (Hand); 
 Hand getHandByCards (int, int, int);  
 
 #endif
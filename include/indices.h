@@ -0,0 +1,67 @@
+/* 
+ *  indices.h 
+ *  Kevin Coltin 
+ * 
+ *  Contains a generator of index plays for card counters: the true counts at 
+ *  which the best play of each starting hand against each up card changes 
+ *  from basic strategy, found by solving the strategy chart for thousands of 
+ *  depleted shoes at each true count. 
+ */ 
+
+#ifndef INDICES_H 
+#define INDICES_H 
+
+#include <stdint.h> 
+#include "bj_strat.h" 
+#include "rules.h" 
+
+//A balanced card-counting system: the running count adds tag[k] for each 
+//card of rank k (1-10) that has been seen 
+typedef struct { 
+  const char *name; 
+  int tag[NUM_CARDS+1]; 
+} CountSystem; 
+
+extern const CountSystem COUNT_SYSTEMS[]; 
+extern const int NUM_COUNT_SYSTEMS; 
+
+//What to generate indices for. Shoes are depleted by dealing a random number 
+//of cards, up to the fraction "penetration" of the shoe, and binned by their 
+//true count (the running count per deck left), rounded to the nearest whole 
+//number from minTC to maxTC. 
+typedef struct { 
+  const Rules *rules; 
+  const CountSystem *count; 
+  int minTC, maxTC; 
+  int perBin; //number of shoes to solve at each true count 
+  double penetration; 
+  uint64_t seed; 
+} IndexSpec; 
+
+//A play that departs from basic strategy beyond some true count 
+typedef struct { 
+  int hand; //index into hands 
+  int upCard; 
+  int basicAction, basicSurrender; //basic strategy, as in a Strategy 
+  int action, surrender; //the play at counts beyond the index 
+  double index; //true count at which the play changes 
+  int above; //true if the play is made at or above the index, false if at or 
+          //below it 
+} IndexPlay; 
+
+//The index plays of one counting system, in the order of the chart 
+typedef struct { 
+  IndexSpec spec; 
+  int nbins; //maxTC - minTC + 1 
+  int *nshoes; //number of shoes solved at each true count 
+  int nplays; 
+  IndexPlay *play; 
+  double insurance; //true count at or above which to take insurance, or 
+               //HUGE_VAL if never within the bins 
+} IndexSet; 
+
+const CountSystem * findCountSystem (const char *name); 
+IndexSet * computeIndexSet (const IndexSpec *spec, int nthreads); 
+void freeIndexSet (IndexSet *set); 
+
+#endif 
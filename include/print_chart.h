@@ -12,13 +12,14 @@
 #include "bj_sims.h" 
 #include "bj_strat.h" 
 
-void printChart (Strategy **chart, const char *filename, int showWinPct, 
-            int MAKE_SIMPLE_CHART); 
-void printHand (int i, Strategy **chart, int showWinPct,  FILE *file);
+void printChart (const StrategyTable *chart, const char *filename, 
+            int showWinPct, int MAKE_SIMPLE_CHART, const Rules *rules); 
+void printHand (int i, const StrategyTable *chart, int showWinPct, 
+            FILE *file);
 char * actionSymbol (int); 
-void printSimsChart (HandSim **simsChart, Strategy **chart, 
+void printSimsChart (HandSim **simsChart, const StrategyTable *chart, 
               const char *filename, int nsims); 
-void printHandSims (int i, HandSim **simsChart, Strategy **chart, FILE *file,
-              int nsims);
+void printHandSims (int i, HandSim **simsChart, const StrategyTable *chart, 
+              FILE *file, int nsims);
 
 #endif 
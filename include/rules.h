@@ -0,0 +1,59 @@
+/* 
+ *  rules.h 
+ *  Kevin Coltin 
+ * 
+ *  Contains the rules of the game - how the dealer plays, what the player may 
+ *  do, what blackjack pays and what is in the shoe - which are passed to the 
+ *  strategy calculator, the simulations and the chart printer. 
+ */ 
+
+#ifndef RULES_H 
+#define RULES_H 
+
+#include <stddef.h> 
+#include "hands.h" 
+
+//Hands the player may double down on 
+extern const int DOUBLE_ANY_TWO; //any first two cards 
+extern const int DOUBLE_NINE_TO_ELEVEN; //hard 9, 10 or 11 
+extern const int DOUBLE_TEN_ELEVEN; //hard 10 or 11 
+
+//When the player may surrender half of his bet on his first two cards 
+extern const int SURRENDER_NONE; 
+extern const int SURRENDER_LATE; //only once the dealer doesn't have blackjack 
+extern const int SURRENDER_EARLY; //before the dealer checks for blackjack 
+
+//Rules of the game 
+typedef struct { 
+  int numDecks; //number of decks in the shoe 
+  int rankCounts[NUM_CARDS+1]; //number of cards of each rank 1-10 in a deck 
+  double cardProbs[NUM_CARDS+1]; //probability of drawing each rank 1-10, 
+                          //from rankCounts; set by setRankCounts 
+  int hitSoft17; //true if the dealer hits soft 17 (H17), false if he stands 
+  int holeCard; //true if the dealer takes a hole card and checks it for 
+            //blackjack; false for no hole card (ENHC), in which case his 
+            //blackjack takes every bet the player has made 
+  int doubleRule; //hands that may be doubled: one of the DOUBLE_ constants 
+  int doubleAfterSplit; //true if the hands after a split may be doubled 
+  int maxSplitHands; //most hands a pair may be split into, by resplitting; 
+                //2 allows no resplits, 0 allows any number 
+  int resplitAces; //true if aces may be resplit (up to maxSplitHands)
+  int hitSplitAces; //true if the hands after splitting aces are played like 
+               //any others; false if each gets one card only 
+  int surrender; //one of the SURRENDER_ constants 
+  int charlie; //number of cards with which a hand that has not busted wins 
+           //outright, e.g. 5 for five-card Charlie; 0 for none 
+  double blackjackPays; //ratio of the bet that the player wins with blackjack 
+} Rules; 
+
+void defaultRules (Rules *rules); 
+void setRankCounts (Rules *rules, const int *rankCounts); 
+void checkRules (const Rules *rules); 
+void getShoeCounts (const Rules *rules, int *counts); 
+int isDoubleAllowed (Hand hand, const Rules *rules); 
+int getMaxSplitHands (int splitCard, const Rules *rules); 
+double probOfDealerBJ (int upCard, const Rules *rules); 
+void describeRules (const Rules *rules, char *buf, size_t size); 
+int parseRulesArgs (Rules *rules, int argc, char **argv); 
+
+#endif 
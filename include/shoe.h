@@ -0,0 +1,55 @@
+/*
+ *  shoe.h
+ *  Kevin Coltin 
+ *
+ *  Contains a sampler for drawing cards at random from a shoe of one or more
+ *  decks, and a physical shoe that is shuffled and dealt from in order, used 
+ *  by the simulations. 
+ */
+
+#ifndef SHOE_H 
+#define SHOE_H 
+
+#include "bj_strat.h" 
+#include "stp.h" 
+
+#define CARDS_PER_DECK (52) 
+#define MAX_DECKS (8) //largest shoe that can be represented 
+#define MAX_SHOE_CARDS (MAX_DECKS * CARDS_PER_DECK) 
+
+//The cards remaining in a shoe, arranged so that a card can be drawn at random
+//in constant time using integer arithmetic only. There is one slot per card, 
+//holding its rank, and the cards of each rank fill a contiguous run of slots 
+//(aces first, then twos, and so on, with ten-valued cards last). A uniformly 
+//chosen slot therefore gives each rank with probability proportional to the 
+//number of cards of that rank remaining. 
+typedef struct {
+  unsigned char slot[MAX_SHOE_CARDS]; //rank of the card in each slot 
+  int start[NUM_CARDS+2]; //first slot of the run of each rank 1-10; 
+                     //start[NUM_CARDS+1] is the number of cards left 
+} CardSampler; 
+
+//A physical shoe: every card of one or more decks in the order in which they 
+//will be dealt, and a cut card. Cards are dealt in order until the round in 
+//which the cut card comes out, after which the shoe is reshuffled. 
+typedef struct {
+  unsigned char card[MAX_SHOE_CARDS]; //rank of each card, in dealing order 
+  int ncards; //number of cards in the full shoe 
+  int next; //position of the next card to be dealt 
+  int cutCard; //position of the cut card 
+} Shoe; 
+
+void initShoe (Shoe *shoe, int numDecks, double penetration); 
+void initShoeFromCounts (Shoe *shoe, const int *counts, double penetration); 
+void shuffleShoe (Shoe *shoe, RandStream *rs); 
+int dealCard (Shoe *shoe, RandStream *rs); 
+int isCutCardReached (const Shoe *shoe); 
+void initCardSampler (CardSampler *shoe, int numDecks); 
+void initCardSamplerFromCounts (CardSampler *shoe, const int *counts); 
+int cardsLeft (const CardSampler *shoe); 
+int countOfRank (const CardSampler *shoe, int rank); 
+void removeCard (CardSampler *shoe, int rank); 
+int drawCard (CardSampler *shoe, RandStream *rs); 
+int drawCardExcluding (CardSampler *shoe, int excludedRank, RandStream *rs); 
+
+#endif 
@@ -0,0 +1,43 @@
+/* 
+ *  splits.h 
+ *  Kevin Coltin 
+ * 
+ *  Contains the evaluator of splitting a pair, resplitting as often as the 
+ *  rules allow, which is shared by the strategy chart (an infinite shoe) and 
+ *  the composition-dependent solver (a finite shoe). 
+ */ 
+
+#ifndef SPLITS_H 
+#define SPLITS_H 
+
+//What one hand after a split is worth when "removed" cards of the split rank 
+//are out of the shoe, counting those in the player's hands. The values of a 
+//hand whose second card is not of the split rank are weighted by the 
+//probability of that card; those of a pair that may not be split again are 
+//not. 
+typedef struct { 
+  double pairProb; //probability that the hand's second card is of the split 
+               //rank 
+  double ev, win, loss; //expected value and probabilities of winning and 
+                   //losing, times the probability of the second card 
+  double pairEV, pairWin, pairLoss; //the same for a pair that may not be 
+                             //split again, which holds two of the cards 
+} SplitHandValue; 
+
+//Fills in the value of a hand after a split with removed cards of the split 
+//rank out of the shoe: pairEV, pairWin and pairLoss if isPair is true, or 
+//else the rest 
+typedef void (*SplitHandFn) (int removed, int isPair, SplitHandValue *value, 
+                    void *arg); 
+
+//Totals over all the hands that a split ends up with 
+typedef struct { 
+  double ev; //expected value of the split, in units of the original bet 
+  double win, loss; //expected numbers of the hands won and lost 
+  double nhands; //expected number of hands 
+} SplitResult; 
+
+SplitResult evaluateSplit (int maxHands, int maxRemoved, SplitHandFn fn, 
+                  void *arg); 
+
+#endif 
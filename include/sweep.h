@@ -0,0 +1,67 @@
+/* 
+ *  sweep.h 
+ *  Kevin Coltin 
+ * 
+ *  Contains a runner that solves the strategy chart, and finds the player's 
+ *  expected value, for every combination of a grid of rule variations, 
+ *  spreading the variants over a pool of threads and solving each dealer 
+ *  table only once for all of the variants that share it. 
+ */ 
+
+#ifndef SWEEP_H 
+#define SWEEP_H 
+
+#include "bj_strat.h" 
+#include "rules.h" 
+
+//Most axes a sweep can have, and most values an axis can take 
+#define MAX_SWEEP_AXES (10)
+#define MAX_SWEEP_VALUES (16)
+
+//Longest name or value of an axis, including the terminating null 
+#define SWEEP_NAME_LENGTH (16)
+
+//One rule that a sweep varies, e.g. "decks" over 1, 2, 6 and 8: see 
+//addSweepAxis 
+typedef struct { 
+  char name[SWEEP_NAME_LENGTH]; 
+  int nvalues; 
+  char values[MAX_SWEEP_VALUES][SWEEP_NAME_LENGTH]; 
+} SweepAxis; 
+
+//A grid of rule variations: every combination of one value of each axis, 
+//applied on top of the base rules 
+typedef struct { 
+  Rules base; 
+  int naxes; 
+  SweepAxis axis[MAX_SWEEP_AXES]; 
+  int cd; //true to also solve composition-dependent strategy for each variant 
+} SweepSpec; 
+
+//One combination of the grid, and its results 
+typedef struct { 
+  Rules rules; 
+  int value[MAX_SWEEP_AXES]; //which value of each axis it takes 
+  int dealer; //which of the sweep's dealer tables it plays against 
+  double ev; //player's expected value with the chart (an infinite shoe)
+  double cdEV; //same with composition-dependent strategy, if spec.cd is set 
+  int nchanges; //number of cells of the chart in which the play differs from 
+             //that of the first variant 
+} SweepVariant; 
+
+//A sweep: the variants of a grid, in order with the last axis varying 
+//fastest 
+typedef struct { 
+  SweepSpec spec; 
+  int nvariants; 
+  SweepVariant *variant; 
+  int ndealers; //number of distinct dealer tables among the variants 
+} Sweep; 
+
+void initSweepSpec (SweepSpec *spec, const Rules *base); 
+void addSweepAxis (SweepSpec *spec, const char *arg); 
+Sweep * newSweep (const SweepSpec *spec); 
+void freeSweep (Sweep *sweep); 
+void runSweep (Sweep *sweep, int nthreads); 
+
+#endif 
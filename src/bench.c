@@ -0,0 +1,862 @@
+#include "bench.h" 
+#include <stdio.h> 
+#include <stdlib.h> 
+#include <string.h> 
+#include <stdint.h> 
+#include <time.h> 
+#include <math.h> 
+#include <complex.h> 
+#include "alloccount.h" 
+#include "boolean.h" 
+#include "error.h" 
+#include "linal.h" 
+#include "moremath.h" 
+#include "parallel.h" 
+#include "bj_sims.h" 
+#include "bj_strat.h" 
+#include "cd_strat.h" 
+#include "dealer.h" 
+#include "hands.h" 
+#include "rules.h" 
+#include "shoe.h" 
+#include "stp.h" 
+
+//A benchmark, and the name by which it is selected on the command line 
+typedef struct {
+  const char *name; 
+  void (*run) (); 
+} Benchmark; 
+
+static const Benchmark BENCHMARKS[] = {
+  {"rng", benchRng}, 
+  {"sampler", benchSampler}, 
+  {"allocs", benchAllocs}, 
+  {"dealer", benchDealer}, 
+  {"chain", benchChain}, 
+  {"stand", benchStand}, 
+  {"chart", benchChart}, 
+  {"splits", benchSplits}, 
+  {"linal", benchLinal}, 
+}; 
+static const int NUM_BENCHMARKS = sizeof(BENCHMARKS) / sizeof(Benchmark); 
+
+static void printRate (const char *label, double count, double seconds, 
+              const char *unit); 
+static void benchVtimesm (int n); 
+static void benchMtimesm (int n, int timeNaive); 
+static void benchMsolve (int n, int nrhs, int timeNaive); 
+static double ** makeBenchMatrix (int M, int N, int seed); 
+static double sumStandWinProb (int yourValue, int upCard); 
+static double sumStandLossProb (int yourValue, int upCard); 
+static double complex ** makeBenchCMatrix (int M, int N, int seed); 
+static void printLinalLine (const char *label, int n, double naive, 
+                   double blas, double diff); 
+
+//Least time for which each linear algebra function is timed, in seconds 
+static const double MIN_LINAL_SECONDS = 0.2; 
+
+
+//------------------------------------------------------------------------------
+// Returns the current wall-clock time in seconds, for timing. 
+//------------------------------------------------------------------------------
+double wall_time ()
+{
+  struct timespec ts; 
+  
+  clock_gettime(CLOCK_MONOTONIC, &ts); 
+  return ts.tv_sec + 1e-9 * ts.tv_nsec; 
+}
+
+
+//------------------------------------------------------------------------------
+// Runs the benchmark with the given name, or all of them if name is NULL or 
+// "all". 
+//------------------------------------------------------------------------------
+void runBenchmarks (const char *name)
+{
+  int i, found = 0; 
+  
+  for (i = 0; i < NUM_BENCHMARKS; i++)
+  {
+    if (name == NULL || !strcmp(name, "all") 
+      || !strcmp(name, BENCHMARKS[i].name))
+    {
+      printf("--- %s ---\n", BENCHMARKS[i].name); 
+      BENCHMARKS[i].run(); 
+      found = 1; 
+    }
+  }
+  
+  if (!(found))
+    throwErr("Unknown benchmark.", "runBenchmarks"); 
+}
+
+
+//------------------------------------------------------------------------------
+// Compares the speed of drawing a card position (an integer between 1 and the
+// number of cards in a six-deck shoe) with the global GSL generator through 
+// runif and rdiscunif, against the counter-based stream one draw at a time and
+// in bulk. 
+//------------------------------------------------------------------------------
+void benchRng ()
+{
+  const int N = 20000000; //draws per method 
+  const int CHUNK = 4096; //draws per call for the bulk methods 
+  const int CARDS = 312; //cards in six decks 
+  RandStream rs; 
+  uint32_t *buf = NULL; 
+  unsigned long sink = 0; //keeps the draws from being optimized away 
+  double start; 
+  int i, j; 
+  
+  buf = (uint32_t *) malloc(CHUNK * sizeof(uint32_t)); 
+  if (buf == NULL) throwMemErr("buf", "benchRng"); 
+  rng_seed(&rs, 12345); 
+  
+  start = wall_time(); 
+  for (i = 0; i < N; i++)
+    sink += rdiscunif(1, CARDS); 
+  printRate("runif + rdiscunif (GSL)", N, wall_time() - start, "draws"); 
+  
+  start = wall_time(); 
+  for (i = 0; i < N; i++)
+    sink += rdiscunif_r(&rs, 1, CARDS); 
+  printRate("rdiscunif_r (Philox)", N, wall_time() - start, "draws"); 
+  
+  start = wall_time(); 
+  for (i = 0; i < N; i++)
+    sink += rng_u32(&rs); 
+  printRate("rng_u32 (Philox)", N, wall_time() - start, "draws"); 
+  
+  start = wall_time(); 
+  for (i = 0; i < N; i += CHUNK)
+  {
+    rng_fill_bounded(&rs, buf, CHUNK, CARDS); 
+    for (j = 0; j < CHUNK; j++)
+      sink += buf[j]; 
+  }
+  printRate("rng_fill_bounded (Philox)", N, wall_time() - start, "draws"); 
+  
+  start = wall_time(); 
+  for (i = 0; i < N; i += CHUNK)
+  {
+    rng_fill_u32(&rs, buf, CHUNK); 
+    for (j = 0; j < CHUNK; j++)
+      sink += buf[j]; 
+  }
+  printRate("rng_fill_u32 (Philox)", N, wall_time() - start, "draws"); 
+  
+  //Jumping to an arbitrary stream and position is constant time 
+  start = wall_time(); 
+  for (i = 0; i < N; i++)
+  {
+    rng_set_stream(&rs, (uint32_t) i, (uint32_t) (i >> 3)); 
+    rng_skip(&rs, (uint64_t) i * 1000003); 
+    sink += rng_u32(&rs); 
+  }
+  printRate("rng_set_stream + rng_skip", N, wall_time() - start, "jumps"); 
+  
+  if (sink == 42) //practically never; only so that sink is used 
+    printf("\n"); 
+  free(buf); 
+}
+
+
+//------------------------------------------------------------------------------
+// Compares the speed of drawing cards from a six-deck shoe with the linear 
+// prefix-count scan of randdraw_count2 against the CardSampler, both drawing 
+// freely and drawing with one rank excluded (by rejection for the former). 
+// The shoe is refilled after every 10 draws, about the number in a hand. 
+//------------------------------------------------------------------------------
+void benchSampler ()
+{
+  const int N = 20000000; //draws per method 
+  const int DRAWS_PER_HAND = 10; 
+  const int NUM_DECKS = 6; 
+  int fullCounts[NUM_CARDS+1], counts[NUM_CARDS+1]; 
+  int total, card; 
+  CardSampler fullShoe, shoe; 
+  RandStream rs; 
+  unsigned long sink = 0; 
+  double start; 
+  int i, k; 
+  
+  rng_seed(&rs, 12345); 
+  initCardSampler(&fullShoe, NUM_DECKS); 
+  for (k = 1; k <= NUM_CARDS; k++)
+    fullCounts[k] = countOfRank(&fullShoe, k); 
+  
+  start = wall_time(); 
+  for (i = 0; i < N; i += DRAWS_PER_HAND)
+  {
+    for (k = 1; k <= NUM_CARDS; k++)
+      counts[k] = fullCounts[k]; 
+    total = cardsLeft(&fullShoe); 
+    for (k = 0; k < DRAWS_PER_HAND; k++)
+    {
+      card = randdraw_count2_r(&rs, counts + 1, NUM_CARDS, total); 
+      counts[card]--; 
+      total--; 
+      sink += card; 
+    }
+  }
+  printRate("randdraw_count2_r", N, wall_time() - start, "cards"); 
+  
+  start = wall_time(); 
+  for (i = 0; i < N; i += DRAWS_PER_HAND)
+  {
+    shoe = fullShoe; 
+    for (k = 0; k < DRAWS_PER_HAND; k++)
+      sink += drawCard(&shoe, &rs); 
+  }
+  printRate("drawCard", N, wall_time() - start, "cards"); 
+  
+  start = wall_time(); 
+  for (i = 0; i < N; i += DRAWS_PER_HAND)
+  {
+    for (k = 1; k <= NUM_CARDS; k++)
+      counts[k] = fullCounts[k]; 
+    total = cardsLeft(&fullShoe); 
+    for (k = 0; k < DRAWS_PER_HAND; k++)
+    {
+      do
+      {
+        card = randdraw_count2_r(&rs, counts + 1, NUM_CARDS, total); 
+      }
+      while (card == 10); 
+      counts[card]--; 
+      total--; 
+      sink += card; 
+    }
+  }
+  printRate("randdraw_count2_r, rejecting 10s", N, wall_time() - start, 
+         "cards"); 
+  
+  start = wall_time(); 
+  for (i = 0; i < N; i += DRAWS_PER_HAND)
+  {
+    shoe = fullShoe; 
+    for (k = 0; k < DRAWS_PER_HAND; k++)
+      sink += drawCardExcluding(&shoe, 10, &rs); 
+  }
+  printRate("drawCardExcluding 10s", N, wall_time() - start, "cards"); 
+  
+  if (sink == 42) 
+    printf("\n"); 
+}
+
+
+//------------------------------------------------------------------------------
+// Counts the heap allocations made while simulating, once the chart and the 
+// simulation state have been set up: in runSims for every simulated cell, and
+// in playing whole shoes. Both should be zero, as should those made in solving
+// the chart again once the thread has solved one. Allocations are only counted
+// in a build with COUNT_ALLOCS. 
+//------------------------------------------------------------------------------
+void benchAllocs ()
+{
+  const int N = 2000; //simulations per cell 
+  const int NUM_SHOES = 500; 
+  const int NUM_CHARTS = 200; 
+  const int NUM_DECKS = 6; 
+  const double PENETRATION = 0.75; 
+  Rules rules; 
+  StrategyTable *chart = NULL; 
+  HandSim **simsChart; 
+  ShoeSim sim; 
+  Shoe shoe; 
+  RandStream rs; 
+  long before, nallocs, nhands; 
+  double start; 
+  int i, j; 
+  
+  if (alloc_count() < 0)
+  {
+    printf("Allocations are not counted in this build; configure with "
+      "-DCOUNT_ALLOCS=ON.\n"); 
+    return; 
+  }
+  
+  chart = newStrategyTable(NUM_HANDS); 
+  makeHands(); 
+  defaultRules(&rules); 
+  rules.numDecks = NUM_DECKS; 
+  dealersProbabilities = makeDealersProbabilities(&rules); 
+  calculateStrategyChart(chart, FALSE, &rules); 
+  
+  start = wall_time(); 
+  before = alloc_count(); 
+  for (i = 0; i < NUM_CHARTS; i++)
+    calculateStrategyChart(chart, FALSE, &rules); 
+  nallocs = alloc_count() - before; 
+  printf("%-32s %10.0f charts/sec\n", "calculateStrategyChart", 
+    NUM_CHARTS / (wall_time() - start)); 
+  printf("%-32s %10ld in %d charts\n", "  allocations", nallocs, NUM_CHARTS); 
+  
+  simsChart = initializeSimsChart(); 
+  rng_seed(&rs, 12345); 
+  initShoe(&shoe, NUM_DECKS, PENETRATION); 
+  sim = newShoeSim(); 
+  
+  nhands = 0; 
+  start = wall_time(); 
+  before = alloc_count(); 
+  for (i = 0; i < NUM_HANDS; i++)
+  {
+    if (hands[i].isObvious)
+      continue; 
+    for (j = 1; j <= NUM_CARDS; j++)
+    {
+      runSims(simsChart, chart, &rules, i, j, N, 0, &rs); 
+      nhands += N; 
+    }
+  }
+  nallocs = alloc_count() - before; 
+  printRate("runSims", nhands, wall_time() - start, "hands"); 
+  printf("%-32s %10ld in %ld hands\n", "  allocations", nallocs, nhands); 
+  
+  start = wall_time(); 
+  before = alloc_count(); 
+  for (i = 0; i < NUM_SHOES; i++)
+    playShoe(&sim, &shoe, chart, &rules, &rs); 
+  nallocs = alloc_count() - before; 
+  printRate("playShoe", sim.nrounds, wall_time() - start, "rounds"); 
+  printf("%-32s %10ld in %ld rounds\n", "  allocations", nallocs, 
+    sim.nrounds); 
+  
+  freematrix(dealersProbabilities, NUM_CARDS+1); 
+  freeStrategyTable(chart); 
+  for (i = 0; i < NUM_HANDS; i++)
+    free(simsChart[i]); 
+  free(simsChart); 
+}
+
+
+//------------------------------------------------------------------------------
+// Times dealerOutcomeProbs with one, two, six and eight decks. Each new 
+// composition is a full shoe less three cards dealt at random (the player's 
+// two and the up card), so nothing is reused from the previous call but the 
+// memory of the cache; a repeated composition is answered from the cache. 
+//------------------------------------------------------------------------------
+void benchDealer ()
+{
+  const int DECKS[] = {1, 2, 6, 8}; 
+  const int NUM_SIZES = sizeof(DECKS) / sizeof(int); 
+  const int N = 20000; //compositions per shoe size 
+  const int REPEATS = 1000000; //calls with a repeated composition 
+  DealerCache *cache = NULL; 
+  Rules rules; 
+  CardSampler fullShoe, shoe; 
+  RandStream rs; 
+  double probs[BUST_VALUE+1]; 
+  int counts[NUM_CARDS+1]; 
+  double sink = 0.; 
+  double start; 
+  char label[64]; 
+  int d, i, k, upCard; 
+  
+  makeHands(); 
+  defaultRules(&rules); 
+  cache = newDealerCache(&rules); 
+  rng_seed(&rs, 12345); 
+  
+  for (d = 0; d < NUM_SIZES; d++)
+  {
+    initCardSampler(&fullShoe, DECKS[d]); 
+    
+    start = wall_time(); 
+    for (i = 0; i < N; i++)
+    {
+      shoe = fullShoe; 
+      drawCard(&shoe, &rs); 
+      drawCard(&shoe, &rs); 
+      upCard = drawCard(&shoe, &rs); 
+      for (k = 1; k <= NUM_CARDS; k++)
+        counts[k] = countOfRank(&shoe, k); 
+      dealerOutcomeProbs(cache, counts, upCard, TRUE, probs); 
+      sink += probs[BUST_VALUE]; 
+    }
+    sprintf(label, "%d deck(s), new composition", DECKS[d]); 
+    printRate(label, N, wall_time() - start, "calls"); 
+    
+    start = wall_time(); 
+    for (i = 0; i < REPEATS; i++)
+    {
+      dealerOutcomeProbs(cache, counts, upCard, TRUE, probs); 
+      sink += probs[BUST_VALUE]; 
+    }
+    sprintf(label, "%d deck(s), repeated", DECKS[d]); 
+    printRate(label, REPEATS, wall_time() - start, "calls"); 
+  }
+  
+  if (sink == 42.) 
+    printf("\n"); 
+  freeDealerCache(cache); 
+}
+
+
+//------------------------------------------------------------------------------
+// Times makeDealersProbabilities, which solves the dealer's absorbing chain 
+// once by back-substitution, against raising the same transition matrix to the
+// 22nd power with matrixpow as it used to, once per up card. 
+//------------------------------------------------------------------------------
+void benchChain ()
+{
+  const int N = 2000; //repetitions 
+  const int NUM_POWERS = 200; //repetitions of the much slower matrixpow 
+  const int MAX_POSSIBLE_HITS = 22; 
+  double **P, **PP; 
+  Rules rules; 
+  double start; 
+  int i; 
+  
+  makeHands(); 
+  defaultRules(&rules); 
+  
+  start = wall_time(); 
+  for (i = 0; i < N; i++)
+  {
+    dealersProbabilities = makeDealersProbabilities(&rules); 
+    freematrix(dealersProbabilities, NUM_CARDS+1); 
+  }
+  printf("%-32s %10.0f tables/sec\n", "makeDealersProbabilities", 
+    N / (wall_time() - start)); 
+  
+  P = makeDealersTransitionMat(&rules); 
+  start = wall_time(); 
+  for (i = 0; i < NUM_POWERS; i++)
+  {
+    PP = matrixpow(P, NUM_HANDS_SIMPLE, MAX_POSSIBLE_HITS); 
+    freematrix(PP, NUM_HANDS_SIMPLE); 
+  }
+  printf("%-32s %10.0f tables/sec\n", "matrixpow x 10 up cards", 
+    NUM_POWERS / (double) NUM_CARDS / (wall_time() - start)); 
+  freematrix(P, NUM_HANDS_SIMPLE); 
+}
+
+
+//------------------------------------------------------------------------------
+// Times the probabilities of winning and losing by standing on each total 
+// against each up card: looked up one at a time in the stand tables 
+// (probOfWinGivenTotal and probOfLossGivenTotal), a whole up card at a time 
+// (getStandEVs), and summed from the dealer's distribution as they used to be. 
+//------------------------------------------------------------------------------
+void benchStand ()
+{
+  const int N = 200000; //repetitions, each of every total and up card 
+  const int NUM_SUMS = 20000; //repetitions of the slower sums 
+  const double PER_REP = (double) NUM_CARDS * DEALER_TOTALS; 
+  double ev[DEALER_TOTALS]; 
+  Rules rules; 
+  double start, sink = 0.; 
+  int i, upCard, v; 
+  
+  makeHands(); 
+  defaultRules(&rules); 
+  dealersProbabilities = makeDealersProbabilities(&rules); 
+  
+  start = wall_time(); 
+  for (i = 0; i < N; i++)
+    for (upCard = 1; upCard <= NUM_CARDS; upCard++)
+      for (v = 0; v < DEALER_TOTALS; v++)
+        sink += probOfWinGivenTotal(v, upCard) 
+          - probOfLossGivenTotal(v, upCard); 
+  printRate("probOf{Win,Loss}GivenTotal", N * PER_REP, wall_time() - start, 
+    "totals"); 
+  
+  start = wall_time(); 
+  for (i = 0; i < N; i++)
+    for (upCard = 1; upCard <= NUM_CARDS; upCard++)
+    {
+      getStandEVs(upCard, ev); 
+      sink += ev[i % DEALER_TOTALS]; 
+    }
+  printRate("getStandEVs", N * PER_REP, wall_time() - start, "totals"); 
+  
+  start = wall_time(); 
+  for (i = 0; i < NUM_SUMS; i++)
+    for (upCard = 1; upCard <= NUM_CARDS; upCard++)
+      for (v = 0; v < DEALER_TOTALS; v++)
+        sink += sumStandWinProb(v, upCard) - sumStandLossProb(v, upCard); 
+  printRate("summed from the distribution", NUM_SUMS * PER_REP, 
+    wall_time() - start, "totals"); 
+  
+  if (sink == 42.) 
+    printf("\n"); 
+  freematrix(dealersProbabilities, NUM_CARDS+1); 
+}
+
+
+//------------------------------------------------------------------------------
+// Times solving the chart: the hit/stand chart alone, for every up card at 
+// once (calculateSimpleChart) and one at a time (calculateSimpleChartScalar), 
+// which must make the same chart, and the full chart with doubles and splits,
+// on one thread and with the up cards solved on all the processors. 
+//------------------------------------------------------------------------------
+void benchChart ()
+{
+  const int N = 2000; //repetitions 
+  StrategyTable *chart = NULL, *scalar = NULL; 
+  Rules rules; 
+  double start; 
+  char label[64]; 
+  int nthreads = num_cpus(); 
+  int i, upCard, c, same = TRUE; 
+  
+  chart = newStrategyTable(NUM_HANDS); 
+  scalar = newStrategyTable(NUM_HANDS); 
+  makeHands(); 
+  defaultRules(&rules); 
+  dealersProbabilities = makeDealersProbabilities(&rules); 
+  
+  start = wall_time(); 
+  for (i = 0; i < N; i++)
+    calculateSimpleChart(chart, &rules); 
+  printf("%-32s %10.0f charts/sec\n", "calculateSimpleChart", 
+    N / (wall_time() - start)); 
+  
+  start = wall_time(); 
+  for (i = 0; i < N; i++)
+    calculateSimpleChartScalar(scalar, &rules); 
+  printf("%-32s %10.0f charts/sec\n", "calculateSimpleChartScalar", 
+    N / (wall_time() - start)); 
+  
+  for (i = 0; i < NUM_HANDS_SIMPLE; i++)
+    for (upCard = 1; upCard <= NUM_CARDS; upCard++)
+    {
+      c = STRAT_CELL(i, upCard); 
+      same = same && chart->action[c] == scalar->action[c] 
+        && chart->winPct[c] == scalar->winPct[c] 
+        && chart->lossPct[c] == scalar->lossPct[c]; 
+    }
+  if (!same)
+    printf("calculateSimpleChart and calculateSimpleChartScalar differ!\n"); 
+  
+  start = wall_time(); 
+  for (i = 0; i < N; i++)
+    calculateStrategyChart(chart, FALSE, &rules); 
+  printf("%-32s %10.0f charts/sec\n", "calculateStrategyChart", 
+    N / (wall_time() - start)); 
+  
+  start = wall_time(); 
+  for (i = 0; i < N; i++)
+    calculateStrategyChartParallel(chart, FALSE, &rules, nthreads); 
+  sprintf(label, "calculateStrategyChartParallel/%d", nthreads); 
+  printf("%-32s %10.0f charts/sec\n", label, N / (wall_time() - start)); 
+  
+  freematrix(dealersProbabilities, NUM_CARDS+1); 
+  freeStrategyTable(chart); 
+  freeStrategyTable(scalar); 
+}
+
+
+//------------------------------------------------------------------------------
+// Times splitting every pair against every up card, with no resplits and 
+// resplitting to four hands, in one, two and six decks: in the finite shoe 
+// (getCDPairSplitEV, starting each time from a chart with nothing solved, so 
+// that every holding the splits lead to is solved) and in the infinite shoe 
+// of the chart (getSplitEV, once the hit/stand chart is solved). Also prints 
+// the expected value of splitting 8s against a 10 with each. 
+//------------------------------------------------------------------------------
+void benchSplits ()
+{
+  const int DECKS[] = {1, 2, 6}; 
+  const int NUM_SIZES = sizeof(DECKS) / sizeof(int); 
+  const int MAX_HANDS[] = {2, 4}; 
+  const int NUM_RULES = sizeof(MAX_HANDS) / sizeof(int); 
+  const int N = 200; //repetitions of the much faster infinite shoe 
+  StrategyTable *chart = NULL; 
+  CDChart *cd = NULL; 
+  Rules rules; 
+  double start, cdTime, infTime, cdEV, infEV; 
+  char label[64]; 
+  int d, r, i, card, upCard; 
+  
+  chart = newStrategyTable(NUM_HANDS); 
+  makeHands(); 
+  defaultRules(&rules); 
+  rules.resplitAces = TRUE; 
+  dealersProbabilities = makeDealersProbabilities(&rules); 
+  calculateSimpleChart(chart, &rules); 
+  
+  for (d = 0; d < NUM_SIZES; d++)
+  {
+    for (r = 0; r < NUM_RULES; r++)
+    {
+      rules.numDecks = DECKS[d]; 
+      rules.maxSplitHands = MAX_HANDS[r]; 
+      
+      cd = newCDChart(&rules); 
+      start = wall_time(); 
+      for (card = 1; card <= NUM_CARDS; card++)
+        for (upCard = 1; upCard <= NUM_CARDS; upCard++)
+          getCDPairSplitEV(cd, card, upCard); 
+      cdTime = wall_time() - start; 
+      cdEV = getCDPairSplitEV(cd, 8, 10); 
+      freeCDChart(cd); 
+      
+      start = wall_time(); 
+      for (i = 0; i < N; i++)
+        for (card = 1; card <= NUM_CARDS; card++)
+          for (upCard = 1; upCard <= NUM_CARDS; upCard++)
+            getSplitEV(chart, card, upCard, &rules); 
+      infTime = (wall_time() - start) / N; 
+      infEV = getSplitEV(chart, 8, 10, &rules); 
+      
+      sprintf(label, "%d deck(s), %d hands", DECKS[d], MAX_HANDS[r]); 
+      printf("%-24s %8.2f ms finite %8.4f ms infinite   8,8 v 10 %+.4f "
+        "%+.4f\n", label, 1000. * cdTime, 1000. * infTime, cdEV, infEV); 
+    }
+  }
+  
+  freematrix(dealersProbabilities, NUM_CARDS+1); 
+  freeStrategyTable(chart); 
+}
+
+
+//------------------------------------------------------------------------------
+// Compares vtimesm, mtimesm and c_msolve, which use BLAS and LAPACK, against 
+// the versions they replaced (vtimesm_naive and so on), for square matrices 
+// the size of the transition matrices of the hands (NUM_HANDS_SIMPLE), and 10 
+// and 100 times that, the size of state spaces that are expanded by the 
+// composition of the shoe. Prints the time per call of each, and the largest 
+// difference between their results. The naive product and solve are too slow 
+// to time at the largest size, as is a solve with either; the solves are for 
+// NUM_HANDS_SIMPLE right-hand sides. 
+//------------------------------------------------------------------------------
+void benchLinal ()
+{
+  const int SCALES[] = {1, 10, 100}; 
+  const int NUM_SCALES = sizeof(SCALES) / sizeof(int); 
+  int s, n; 
+  
+  printf("%-12s %6s %12s %12s %8s %10s\n", "", "n", "naive us", "BLAS us", 
+    "speedup", "max diff"); 
+  for (s = 0; s < NUM_SCALES; s++)
+  {
+    n = SCALES[s] * NUM_HANDS_SIMPLE; 
+    benchVtimesm(n); 
+    benchMtimesm(n, SCALES[s] <= 10); 
+    if (SCALES[s] <= 10)
+      benchMsolve(n, NUM_HANDS_SIMPLE, TRUE); 
+  }
+}
+
+
+//------------------------------------------------------------------------------
+// Times vtimesm and vtimesm_naive for an n x n matrix, for benchLinal. 
+//------------------------------------------------------------------------------
+static void benchVtimesm (int n)
+{
+  double **A = makeBenchMatrix(n, n, 1); 
+  double **X = makeBenchMatrix(1, n, 2); 
+  double *y, *z; 
+  double start, naive, blas, diff = 0.; 
+  int reps, j; 
+  
+  start = wall_time(); 
+  for (reps = 0; reps == 0 || wall_time() - start < MIN_LINAL_SECONDS; reps++)
+    free(vtimesm_naive(X[0], A, n, n)); 
+  naive = (wall_time() - start) / reps; 
+  
+  start = wall_time(); 
+  for (reps = 0; reps == 0 || wall_time() - start < MIN_LINAL_SECONDS; reps++)
+    free(vtimesm(X[0], A, n, n)); 
+  blas = (wall_time() - start) / reps; 
+  
+  y = vtimesm_naive(X[0], A, n, n); 
+  z = vtimesm(X[0], A, n, n); 
+  for (j = 0; j < n; j++)
+    diff = fmax(diff, fabs(y[j] - z[j])); 
+  printLinalLine("vtimesm", n, naive, blas, diff); 
+  
+  free(y); 
+  free(z); 
+  freematrix(A, n); 
+  freematrix(X, 1); 
+}
+
+
+//------------------------------------------------------------------------------
+// Times mtimesm, and mtimesm_naive if timeNaive is true, for n x n matrices, 
+// for benchLinal. 
+//------------------------------------------------------------------------------
+static void benchMtimesm (int n, int timeNaive)
+{
+  double **A = makeBenchMatrix(n, n, 1); 
+  double **B = makeBenchMatrix(n, n, 2); 
+  double **C, **D; 
+  double start, naive = -1., blas, diff = -1.; 
+  int reps, i, j; 
+  
+  start = wall_time(); 
+  for (reps = 0; reps == 0 || wall_time() - start < MIN_LINAL_SECONDS; reps++)
+    freematrix(mtimesm(A, B, n, n, n), n); 
+  blas = (wall_time() - start) / reps; 
+  
+  if (timeNaive)
+  {
+    start = wall_time(); 
+    for (reps = 0; reps == 0 || wall_time() - start < MIN_LINAL_SECONDS; 
+        reps++)
+      freematrix(mtimesm_naive(A, B, n, n, n), n); 
+    naive = (wall_time() - start) / reps; 
+    
+    C = mtimesm_naive(A, B, n, n, n); 
+    D = mtimesm(A, B, n, n, n); 
+    diff = 0.; 
+    for (i = 0; i < n; i++)
+      for (j = 0; j < n; j++)
+        diff = fmax(diff, fabs(C[i][j] - D[i][j])); 
+    freematrix(C, n); 
+    freematrix(D, n); 
+  }
+  printLinalLine("mtimesm", n, naive, blas, diff); 
+  
+  freematrix(A, n); 
+  freematrix(B, n); 
+}
+
+
+//------------------------------------------------------------------------------
+// Times c_msolve, and c_msolve_naive if timeNaive is true, for an n x n matrix
+// and nrhs right-hand sides, for benchLinal. 
+//------------------------------------------------------------------------------
+static void benchMsolve (int n, int nrhs, int timeNaive)
+{
+  double complex **A = makeBenchCMatrix(n, n, 1); 
+  double complex **B = makeBenchCMatrix(n, nrhs, 2); 
+  double complex **X, **Y; 
+  double start, naive = -1., blas, diff = -1.; 
+  int reps, i, j; 
+  
+  //Make A diagonally dominant, so that it is well conditioned 
+  for (i = 0; i < n; i++)
+    A[i][i] += n; 
+  
+  start = wall_time(); 
+  for (reps = 0; reps == 0 || wall_time() - start < MIN_LINAL_SECONDS; reps++)
+    freecmatrix(c_msolve(A, B, n, nrhs), n); 
+  blas = (wall_time() - start) / reps; 
+  
+  if (timeNaive)
+  {
+    start = wall_time(); 
+    for (reps = 0; reps == 0 || wall_time() - start < MIN_LINAL_SECONDS; 
+        reps++)
+      freecmatrix(c_msolve_naive(A, B, n, nrhs), n); 
+    naive = (wall_time() - start) / reps; 
+    
+    X = c_msolve_naive(A, B, n, nrhs); 
+    Y = c_msolve(A, B, n, nrhs); 
+    diff = 0.; 
+    for (i = 0; i < n; i++)
+      for (j = 0; j < nrhs; j++)
+        diff = fmax(diff, cabs(X[i][j] - Y[i][j])); 
+    freecmatrix(X, n); 
+    freecmatrix(Y, n); 
+  }
+  printLinalLine("c_msolve", n, naive, blas, diff); 
+  
+  freecmatrix(A, n); 
+  freecmatrix(B, n); 
+}
+
+
+//------------------------------------------------------------------------------
+// Returns an M x N matrix of made-up entries between -.5 and .5, which differ
+// with the seed. 
+//------------------------------------------------------------------------------
+static double ** makeBenchMatrix (int M, int N, int seed)
+{
+  double **A = allocmatrix(M, N); 
+  int i, j; 
+  
+  if (A == NULL) throwMemErr("A", "makeBenchMatrix"); 
+  for (i = 0; i < M; i++)
+    for (j = 0; j < N; j++)
+      A[i][j] = ((i * 31 + j * 17 + seed * 7) % 101) / 101. - .5; 
+  return A; 
+}
+
+
+//------------------------------------------------------------------------------
+// Returns a complex M x N matrix of made-up entries, like makeBenchMatrix. 
+//------------------------------------------------------------------------------
+static double complex ** makeBenchCMatrix (int M, int N, int seed)
+{
+  double complex **A = c_allocmatrix(M, N); 
+  int i, j; 
+  
+  if (A == NULL) throwMemErr("A", "makeBenchCMatrix"); 
+  for (i = 0; i < M; i++)
+    for (j = 0; j < N; j++)
+      A[i][j] = ((i * 31 + j * 17 + seed * 7) % 101) / 101. - .5 
+        + (((i * 13 + j * 29 + seed * 3) % 97) / 97. - .5) * I; 
+  return A; 
+}
+
+
+//------------------------------------------------------------------------------
+// Prints a line of benchLinal's table: the times per call in seconds, which 
+// are printed in microseconds, and the largest difference between the 
+// results. A negative naive time or difference was not measured. 
+//------------------------------------------------------------------------------
+static void printLinalLine (const char *label, int n, double naive, 
+                   double blas, double diff)
+{
+  if (naive < 0.)
+    printf("%-12s %6d %12s %12.1f %8s %10s\n", label, n, "-", 1e6 * blas, 
+      "-", "-"); 
+  else 
+    printf("%-12s %6d %12.1f %12.1f %7.1fx %10.1e\n", label, n, 1e6 * naive, 
+      1e6 * blas, naive / blas, diff); 
+}
+
+
+//------------------------------------------------------------------------------
+// The probability of winning by standing on yourValue against upCard, summed 
+// from the dealer's distribution as probOfWinGivenTotal did before the stand 
+// tables, for benchStand. 
+//------------------------------------------------------------------------------
+static double sumStandWinProb (int yourValue, int upCard)
+{
+  const int DEALERS_MIN = 17; 
+  double prob; 
+  int i; 
+
+  if (yourValue > 21)
+    return 0.; 
+  prob = dealersProbabilities[upCard][BUST_VALUE]; 
+  for (i = DEALERS_MIN; i < yourValue; i++)
+    prob += dealersProbabilities[upCard][i]; 
+  return prob; 
+}
+
+
+//------------------------------------------------------------------------------
+// Like sumStandWinProb but for a loss. 
+//------------------------------------------------------------------------------
+static double sumStandLossProb (int yourValue, int upCard)
+{
+  const int DEALERS_MIN = 17; 
+  double prob = 0.; 
+  int i; 
+
+  if (yourValue > 21)
+    return 1.; 
+  for (i = maxi(yourValue + 1, DEALERS_MIN); i <= 21; i++)
+    prob += dealersProbabilities[upCard][i]; 
+  return prob; 
+}
+
+
+//------------------------------------------------------------------------------
+// Prints a line giving the rate (in millions of units per second) at which 
+// count units were processed in the given time. 
+//------------------------------------------------------------------------------
+static void printRate (const char *label, double count, double seconds, 
+              const char *unit)
+{
+  printf("%-32s %10.2f M %s/sec\n", label, count / seconds / 1e6, unit); 
+}
@@ -5,158 +5,1330 @@
 #include "error.h"
 #include "linal.h" 
 #include "moremath.h"
+#include "parallel.h"
 #include "stp.h"
 #include "bj_strat.h" 
+#include "dealer.h" 
 #include "hands.h" 
+#include "shoe.h" 
+
+//Number of simulations of a single hand and up card that make up one task for
+//the thread pool in runSimsParallel. Small enough that the work is balanced 
+//across threads, large enough that handing out tasks costs next to nothing. 
+static const int SIMS_BLOCK_SIZE = 5000; 
+
+//Size in bytes of a cache line. Each thread's accumulators are aligned to, and
+//padded out to, a multiple of this so that no two threads write to the same 
+//line. 
+#define CACHE_LINE (64) 
+
+//Number of bits of the substream number that identify a block within a pass 
+//of runSimsParallel; the rest identify the pass. 
+static const int BLOCK_BITS = 20; 
+
+//Most hands that playRound splits a pair into, when the rules set no limit 
+#define MAX_SPLIT_HANDS (16) 
+
+//Private state of one thread in runSimsParallel 
+typedef struct {
+  HandSim **simsChart; //the thread's own counts, indexed like simsChart 
+  HandSim *counts; //contiguous, cache-aligned storage behind simsChart 
+  RandStream rs; //the thread's random number stream 
+} SimsWorker; 
+
+//Work shared by all threads in runSimsParallel and runSimsCells 
+typedef struct {
+  const StrategyTable *chart; 
+  const Rules *rules; 
+  int ncells; 
+  int *cells; //cells to simulate, each encoded as i * (NUM_CARDS+1) + upCard
+  int *cellN; //number of simulations of each of the cells 
+  int *firstTask; //number of the first task (block) of each cell; 
+              //firstTask[ncells] is the total number of tasks 
+  int vr; //variance-reduction methods 
+  uint32_t pass; 
+  SimsWorker *workers; 
+  StratTables tables; //those the chart was solved with 
+} SimsJob; 
+
+//Number of shoes played in one task for the thread pool in runShoeSims 
+static const int SHOES_PER_TASK = 50; 
+
+//Stream of the counter-based generator used by runShoeSims; the substream is
+//the task number. Chosen so as not to collide with the streams of the cells in
+//runSimsParallel. 
+static const uint32_t SHOE_STREAM = 0x53484f45; 
+
+//Work shared by all threads in runShoeSims 
+typedef struct {
+  const StrategyTable *chart; 
+  Shoe shoe; //unshuffled shoe that each task starts from 
+  int nshoes; 
+  const Rules *rules; 
+  uint64_t seed; 
+  ShoeSim *results; //results of each task 
+  StratTables tables; //those the chart was solved with 
+} ShoeJob; 
+
+static void runSimsJob (HandSim **simsChart, SimsJob *job, int nthreads, 
+              uint64_t seed); 
+static void runSimsTask (int task, int thread, void *arg); 
+static int simulateHand (const StrategyTable *chart, const Rules *rules, 
+                  const CardSampler *fullShoe, int i, int upCard, double u, 
+                  int playDealer, RandStream *rs, int *stratum, 
+                  int *dealerFinal); 
+static void getDealerControlMeans (const Rules *rules, int i, int upCard, 
+                          double *mu); 
+static int solveSymmetric (double a[][NUM_MOMENTS], double *b, int n); 
+static double pValueZ (double diff, double var); 
+static void runShoeTask (int task, int thread, void *arg); 
+static int playHand (Shoe *shoe, const StrategyTable *chart, 
+              const Rules *rules, int index, int upCard, int isSplit, 
+              double *bet, int *ncards, RandStream *rs); 
+static int isCharlie (int index, int ncards, const Rules *rules); 
+static void initSimsWorker (SimsWorker *worker, uint64_t seed); 
+static void freeSimsWorker (SimsWorker *worker); 
+
+
+//------------------------------------------------------------------------------
+// Runs N simulations of every non-obvious combination of player's hand and 
+// dealer's up card, spread over nthreads threads, and adds the results to 
+// simsChart. 
+// The simulations for each cell are broken into blocks that are handed out to
+// the threads as they become free. Each thread keeps its own counts, which are
+// added into simsChart once all of the threads have finished. 
+// 
+// Every block draws from its own substream of the counter-based generator, 
+// determined by the seed, the cell, the block number and "pass" (which should 
+// be different for each call that adds to the same simsChart). The results 
+// therefore depend only on the seed, never on nthreads or on which thread ran
+// which block. 
+//------------------------------------------------------------------------------
+void runSimsParallel (HandSim **simsChart, const StrategyTable *chart, 
+              const Rules *rules, int N, int vr, int nthreads, 
+              uint64_t seed, int pass)
+{
+  SimsJob job; 
+  int i, j; 
+  
+  job.chart = chart; 
+  job.rules = rules; 
+  job.vr = vr; 
+  job.pass = (uint32_t) pass; 
+  job.cells = (int *) malloc(NUM_HANDS * NUM_CARDS * sizeof(int)); 
+  if (job.cells == NULL) throwMemErr("job.cells", "runSimsParallel"); 
+  job.cellN = (int *) malloc(NUM_HANDS * NUM_CARDS * sizeof(int)); 
+  if (job.cellN == NULL) throwMemErr("job.cellN", "runSimsParallel"); 
+  
+  job.ncells = 0; 
+  for (i = 0; i < NUM_HANDS; i++)
+  {
+    if (hands[i].isObvious)
+      continue; 
+    for (j = 1; j <= NUM_CARDS; j++)
+    {
+      job.cells[job.ncells] = i * (NUM_CARDS+1) + j; 
+      job.cellN[job.ncells] = N; 
+      job.ncells++; 
+    }
+  }
+  
+  runSimsJob(simsChart, &job, nthreads, seed); 
+  
+  free(job.cells); 
+  free(job.cellN); 
+}
+
+
+//------------------------------------------------------------------------------
+// Same as runSimsParallel, but runs nsims[i][upCard] simulations of each 
+// combination of hand i and up card (none where it is zero), so that the 
+// simulations can be concentrated on the cells that need them most. 
+//------------------------------------------------------------------------------
+void runSimsCells (HandSim **simsChart, const StrategyTable *chart, 
+              const Rules *rules, int **nsims, int vr, int nthreads, 
+              uint64_t seed, int pass)
+{
+  SimsJob job; 
+  int i, j; 
+  
+  job.chart = chart; 
+  job.rules = rules; 
+  job.vr = vr; 
+  job.pass = (uint32_t) pass; 
+  job.cells = (int *) malloc(NUM_HANDS * NUM_CARDS * sizeof(int)); 
+  if (job.cells == NULL) throwMemErr("job.cells", "runSimsCells"); 
+  job.cellN = (int *) malloc(NUM_HANDS * NUM_CARDS * sizeof(int)); 
+  if (job.cellN == NULL) throwMemErr("job.cellN", "runSimsCells"); 
+  
+  job.ncells = 0; 
+  for (i = 0; i < NUM_HANDS; i++)
+  {
+    for (j = 1; j <= NUM_CARDS; j++)
+    {
+      if (nsims[i][j] <= 0)
+        continue; 
+      job.cells[job.ncells] = i * (NUM_CARDS+1) + j; 
+      job.cellN[job.ncells] = nsims[i][j]; 
+      job.ncells++; 
+    }
+  }
+  
+  runSimsJob(simsChart, &job, nthreads, seed); 
+  
+  free(job.cells); 
+  free(job.cellN); 
+}
+
+
+//------------------------------------------------------------------------------
+// Breaks the cells of a job into blocks, runs them on the thread pool and adds
+// the threads' counts to simsChart. 
+//------------------------------------------------------------------------------
+static void runSimsJob (HandSim **simsChart, SimsJob *job, int nthreads, 
+              uint64_t seed)
+{
+  int i, j, k, t, a, b, nblocks; 
+  
+  if (nthreads < 1) 
+    nthreads = 1; 
+  
+  job->firstTask = (int *) malloc((job->ncells + 1) * sizeof(int)); 
+  if (job->firstTask == NULL) throwMemErr("job->firstTask", "runSimsJob"); 
+  job->firstTask[0] = 0; 
+  for (k = 0; k < job->ncells; k++)
+  {
+    nblocks = (job->cellN[k] + SIMS_BLOCK_SIZE - 1) / SIMS_BLOCK_SIZE; 
+    if (nblocks >= (1 << BLOCK_BITS)) 
+      throwErr("Too many simulations in one pass.", "runSimsJob"); 
+    job->firstTask[k+1] = job->firstTask[k] + nblocks; 
+  }
+  
+  job->tables = getStratTables(); 
+  job->workers = (SimsWorker *) malloc(nthreads * sizeof(SimsWorker)); 
+  if (job->workers == NULL) throwMemErr("job->workers", "runSimsJob"); 
+  for (t = 0; t < nthreads; t++)
+    initSimsWorker(&job->workers[t], seed); 
+  
+  parallel_for(job->firstTask[job->ncells], nthreads, runSimsTask, job); 
+  
+  //Reduce the threads' counts into the chart 
+  for (t = 0; t < nthreads; t++)
+  {
+    for (i = 0; i < NUM_HANDS; i++)
+    {
+      for (j = 1; j <= NUM_CARDS; j++)
+      {
+        simsChart[i][j].nwins += job->workers[t].simsChart[i][j].nwins; 
+        simsChart[i][j].nlosses += job->workers[t].simsChart[i][j].nlosses; 
+        simsChart[i][j].nsims += job->workers[t].simsChart[i][j].nsims; 
+        if (job->vr)
+          for (a = 0; a < NUM_MOMENTS; a++)
+            for (b = a; b < NUM_MOMENTS; b++)
+              simsChart[i][j].moments[a][b] 
+                += job->workers[t].simsChart[i][j].moments[a][b]; 
+      }
+    }
+    freeSimsWorker(&job->workers[t]); 
+  }
+  
+  free(job->workers); 
+  free(job->firstTask); 
+}
 
 
 //------------------------------------------------------------------------------
-// Runs N simulations of the player's hand i and dealer's up card. 
+// Runs one block of simulations for runSimsJob. 
 //------------------------------------------------------------------------------
-void runSims(HandSim **simsChart, Strategy **chart, int i, int upCard, int N)
+static void runSimsTask (int task, int thread, void *arg)
+{
+  SimsJob *job = (SimsJob *) arg; 
+  SimsWorker *worker = &job->workers[thread]; 
+  int lo = 0, hi = job->ncells - 1, mid; 
+  int cell, block, n; 
+  
+  useStratTables(job->tables); 
+  
+  //Find the cell that the task belongs to 
+  while (lo < hi)
+  {
+    mid = (lo + hi + 1) / 2; 
+    if (job->firstTask[mid] <= task)
+      lo = mid; 
+    else
+      hi = mid - 1; 
+  }
+  
+  cell = job->cells[lo]; 
+  block = task - job->firstTask[lo]; 
+  n = job->cellN[lo] - block * SIMS_BLOCK_SIZE; 
+  if (n > SIMS_BLOCK_SIZE)
+    n = SIMS_BLOCK_SIZE; 
+  
+  rng_set_stream(&worker->rs, (uint32_t) cell, 
+            (job->pass << BLOCK_BITS) | (uint32_t) block); 
+  runSims(worker->simsChart, job->chart, job->rules, cell / (NUM_CARDS+1), 
+       cell % (NUM_CARDS+1), n, job->vr, &worker->rs); 
+}
+
+
+//------------------------------------------------------------------------------
+// Allocates a thread's accumulators and seeds its random number stream. 
+//------------------------------------------------------------------------------
+static void initSimsWorker (SimsWorker *worker, uint64_t seed)
+{
+  size_t rowSize = (NUM_CARDS+1) * sizeof(HandSim); 
+  size_t size = NUM_HANDS * rowSize; 
+  int i, j; 
+  
+  size = (size + CACHE_LINE - 1) / CACHE_LINE * CACHE_LINE; 
+  if (posix_memalign((void **) &worker->counts, CACHE_LINE, size) != 0)
+    throwMemErr("worker->counts", "initSimsWorker"); 
+  worker->simsChart = (HandSim **) malloc(NUM_HANDS * sizeof(HandSim *)); 
+  if (worker->simsChart == NULL) 
+    throwMemErr("worker->simsChart", "initSimsWorker"); 
+  
+  for (i = 0; i < NUM_HANDS; i++)
+  {
+    worker->simsChart[i] = worker->counts + i * (NUM_CARDS+1); 
+    for (j = 0; j <= NUM_CARDS; j++)
+      worker->simsChart[i][j] = newHandSim(); 
+  }
+  
+  rng_seed(&worker->rs, seed); 
+}
+
+
+//------------------------------------------------------------------------------
+// Frees everything allocated by initSimsWorker. 
+//------------------------------------------------------------------------------
+static void freeSimsWorker (SimsWorker *worker)
+{
+  free(worker->simsChart); 
+  free(worker->counts); 
+}
+
+
+//------------------------------------------------------------------------------
+// Runs N simulations of the player's hand i and dealer's up card, dealt from 
+// the shoe given by rules and played by them, drawing random numbers from the 
+// stream rs. vr is a combination of the VR_ flags, 
+// giving the variance-reduction methods to use (0 for none): 
+// 
+// VR_CONTROL: Records the dealer's final total, whose distribution is known 
+//   (see getDealerControlMeans), for control variates. The dealer's hand is 
+//   then played out even if the player has busted. 
+// VR_ANTITHETIC: Simulates hands in pairs, the second replaying the first's 
+//   random numbers from the antithetic stream (so that low cards become high 
+//   ones and vice versa). N is rounded up to an even number. 
+// VR_STRATIFY: For hard totals, chooses the starting two cards by systematic 
+//   sampling over the N hands, so that each combination of cards is dealt in
+//   almost exactly its expected proportion. 
+// 
+// With any of these, the sums needed by getSimEstimate are accumulated in the
+// cell's moments, over "units" of one hand (or one antithetic pair). 
+//------------------------------------------------------------------------------
+void runSims(HandSim **simsChart, const StrategyTable *chart, 
+        const Rules *rules, int i, int upCard, int N, int vr, RandStream *rs)
+{
+  HandSim *hs = &simsChart[i][upCard]; 
+  CardSampler fullShoe; //shoe before any cards are dealt 
+  RandStream start, after; //stream at the start and end of a unit's first hand
+  double z[NUM_MOMENTS]; //quantities summed over the hands in a unit 
+  double u, u0; 
+  int n, k, m, a, b; 
+  int nunits, perUnit; 
+  int outcome, stratum, dealerTotal; 
+  int counts[NUM_CARDS+1]; 
+  
+  getShoeCounts(rules, counts); 
+  initCardSamplerFromCounts(&fullShoe, counts); 
+  
+  if (!(vr))
+  {
+    for (n = 0; n < N; n++)
+    {
+      outcome = simulateHand(chart, rules, &fullShoe, i, upCard, -1., FALSE, 
+                      rs, &stratum, &dealerTotal); 
+      if (outcome > 0)
+        hs->nwins++; 
+      else if (outcome < 0)
+        hs->nlosses++; 
+      hs->nsims++; 
+    }
+    return; 
+  }
+  
+  perUnit = (vr & VR_ANTITHETIC) ? 2 : 1; 
+  nunits = (N + perUnit - 1) / perUnit; 
+  u0 = runif_r(rs); //offset of the systematic sample 
+  
+  for (k = 0; k < nunits; k++)
+  {
+    for (a = 0; a < NUM_MOMENTS; a++)
+      z[a] = 0.; 
+    z[MOMENT_ONE] = 1.; 
+    start = *rs; 
+    
+    for (m = 0; m < perUnit; m++)
+    {
+      u = -1.; 
+      if (vr & VR_STRATIFY)
+        u = (k + u0) / nunits; 
+      
+      if (m == 1) //replay the first hand's numbers, antithetically 
+      {
+        after = *rs; 
+        *rs = start; 
+        rng_set_antithetic(rs, TRUE); 
+        if (u >= 0.)
+          u = 1. - u; 
+      }
+      
+      outcome = simulateHand(chart, rules, &fullShoe, i, upCard, u, 
+                      vr & VR_CONTROL, rs, &stratum, &dealerTotal); 
+      
+      if (outcome > 0)
+      {
+        hs->nwins++; 
+        z[MOMENT_WIN] += 1.; 
+      }
+      else if (outcome < 0)
+      {
+        hs->nlosses++; 
+        z[MOMENT_LOSS] += 1.; 
+      }
+      hs->nsims++; 
+      if (dealerTotal >= 18)
+        z[MOMENT_DEALER + dealerTotal - 18] += 1.; 
+      if (stratum > 0)
+        z[MOMENT_STRATA + stratum - 1] += 1.; 
+    }
+    
+    //Carry on from wherever the further of the two hands got to, so that no 
+    //numbers are shared between units 
+    if (perUnit == 2)
+    {
+      rng_set_antithetic(rs, FALSE); 
+      if (after.pos > rs->pos)
+        *rs = after; 
+    }
+    
+    for (a = 0; a < NUM_MOMENTS; a++)
+      for (b = a; b < NUM_MOMENTS; b++)
+        hs->moments[a][b] += z[a] * z[b]; 
+  }
+}
+
+
+//------------------------------------------------------------------------------
+// Simulates a single hand: the player's hand i against the dealer's up card, 
+// dealt from a copy of fullShoe. Returns 1 if the player wins, -1 if he loses
+// and 0 for a push. As in the chart, the dealer is assumed not to have 
+// blackjack and the player not to surrender. After a split, the first of the 
+// hands is followed, resplitting as the rules allow (see getSplitWinProb). 
+// If u is not negative, it is used in place of a random number to choose the 
+// starting cards of a hard total (see chooseCardsInStartingHand). stratum is 
+// set to the index of the combination of starting cards that was dealt (0 if
+// there is only one). If playDealer is true, the dealer's hand is played out 
+// even when the player busts. dealerFinal is set to the dealer's final total 
+// (BUST_VALUE if he busts), or 0 if his hand was not played out. 
+//------------------------------------------------------------------------------
+static int simulateHand (const StrategyTable *chart, const Rules *rules, 
+                  const CardSampler *fullShoe, int i, int upCard, double u, 
+                  int playDealer, RandStream *rs, int *stratum, 
+                  int *dealerFinal)
 {
-  int n; 
-  int j; 
   int playerTotal, dealerTotal; 
-  int index, splitCard, newCard; 
+  int index, dIndex, splitCard, newCard; 
+  int maxHands, nhands; //most hands a split may make, and hands so far 
   int action; 
-  Hand hand, dHand; 
+  int ncards; //number of cards in the player's hand 
   int isInitialHand; //true if it's the two cards first dealt - i.e. if 
                    //the player can split or double 
-  
-  int *deck; 
-  int numDecks; 
-  const int CARDS_PER_DECK = 52; //cards per deck 
-  const int NUM_EACH_CARD = 4; //number of each card in a deck 
-  int cardsInDeck; 
+  int isSplit; //true once the player has split 
+  CardSampler shoe = *fullShoe; //cards remaining in the shoe during the hand 
   int downCard; 
   
-  n = 0; 
-  while (n < N)
-  {
-    numDecks = 6;  
-    cardsInDeck = numDecks * CARDS_PER_DECK; //number of cards remaining 
-                                           //in the stack of decks 
-
-    deck = NULL; 
-    deck = (int *) malloc ((NUM_CARDS+1) * sizeof(int)); 
-    if (deck == NULL) throwMemErr("deck", "runSims"); 
-    for (j = 1; j <= NUM_CARDS - 1; j++)
-      deck[j] = NUM_EACH_CARD * numDecks; 
-    deck[10] = 4 * NUM_EACH_CARD * numDecks; //10 plus three face cards 
-    removeCardsInStartingHand(deck, hands[i], cardsInDeck); 
-    cardsInDeck -= 2; 
+  *stratum = removeCardsInStartingHand(&shoe, hands[i], u, rs); 
+  *dealerFinal = 0; 
+  
+  //remove dealer's up card 
+  removeCard(&shoe, upCard); 
+  //Draw dealer's down card. We're assuming it's not blackjack, so it is 
+  //drawn from the cards that would not make blackjack. 
+  if (upCard == 1)
+    downCard = drawCardExcluding(&shoe, 10, rs); 
+  else if (upCard == 10)
+    downCard = drawCardExcluding(&shoe, 1, rs); 
+  else 
+    downCard = drawCard(&shoe, rs); 
+  
+  //keep hitting to get final hand 
+  index = i; //index of current hand
+  ncards = 2; 
+  isInitialHand = TRUE; 
+  isSplit = FALSE; 
+
+  while (index != BUST && !(isCharlie(index, ncards, rules)))
+  {
+    //Once the player has hit, or may not double after a split, he can only 
+    //hit or stand 
+    action = chart->action[STRAT_CELL(index, upCard)]; 
+    if (!(isInitialHand) || (isSplit && (action == SPLIT 
+        || (action == DOUBLE_DOWN && !(rules->doubleAfterSplit)))))
+      action = getHitStandAction(index, ncards, upCard); 
     
-    //remove dealer's up card 
-    deck[upCard]--; 
-    //Draw dealer's down card. We're assuming it's not blackjack, so keep 
-    //drawing until it's not.  
-    do
-    {
-      downCard = randdraw_count2 (deck + 1, NUM_CARDS, cardsInDeck);
-    } 
-    while ((upCard == 1 && downCard == 10) || (upCard == 10 && downCard == 1)); 
-    deck[downCard]--; 
-    cardsInDeck -= 2; 
+    if (action == STAND)
+      break; 
     
-    //keep hitting to get final hand 
-    index = i; //index of current hand
-    hand = hands[i]; 
-    isInitialHand = TRUE; 
-
-    while (chart[index][upCard].action != STAND)
+    if (action == HIT || action == DOUBLE_DOWN)
+    {
+      //Draw a card. (A double 3 through 10 needs no conversion to its 
+      //non-splittable form first, since the table gives the same result.)
+      newCard = drawCard(&shoe, rs); 
+      index = handAfterCard[index][newCard]; 
+      ncards++; 
+      
+      isInitialHand = FALSE; //after the first time through, it's not the
+                      //initial hand anymore 
+  
+      if (action == DOUBLE_DOWN) //cannot hit further 
+        break; 
+    }
+    else //if action = split. If "stand", we wouldn't be in the while loop.
     {
-      action = chart[index][upCard].action; 
+      //Another card of the split rank starts a new hand, as long as there 
+      //may be more hands, and this one is dealt another card; once there 
+      //may not, it leaves a pair, which is played like its total 
+      splitCard = hands[index].isSoft ? 1 : hands[index].value / 2; 
+      maxHands = getMaxSplitHands(splitCard, rules); 
+      nhands = 2; 
+      while ((newCard = drawCard(&shoe, rs)) == splitCard 
+          && (maxHands == 0 || nhands < maxHands))
+        nhands++; 
+      
+      if (newCard == splitCard)
+        index = getUnsplitIndex(splitCard); 
+      else 
+        index = dealerHandByCards[splitCard][newCard]; //Note 1
+      
+      isInitialHand = TRUE; //should already be true at this point; just 
+                    //making sure. 
+      isSplit = TRUE; 
+      
+      //Split aces that may not be hit get one card only 
+      if (splitCard == 1 && !(rules->hitSplitAces))
+        break; 
+    }
+  }
+
+  playerTotal = hands[index].value; 
+  
+  //If the player has busted he loses whatever the dealer has, and with a 
+  //Charlie he wins, so there is no need to play out the dealer's hand 
+  //(unless its outcome is wanted as a control variate). 
+  if ((index == BUST || isCharlie(index, ncards, rules)) && !(playDealer))
+    return index == BUST ? -1 : 1; 
+  
+  //have dealer hit until standing 
+  dIndex = dealerHandByCards[upCard][downCard]; 
+  while (!(doesDealerStand(hands[dIndex], rules)))
+  {
+    newCard = drawCard(&shoe, rs); 
+    dIndex = handAfterCard[dIndex][newCard]; 
+  }    
+  dealerTotal = hands[dIndex].value; 
+  *dealerFinal = dealerTotal; 
 
-      //If it's not the initial hand, convert to a non-splittable hand and/or
-      //hit or stand instead of splitting or doubling down. 
-      if (!(isInitialHand))
+  if (isCharlie(index, ncards, rules))
+    return 1; 
+  else if (doesPlayerWin(playerTotal, dealerTotal))
+    return 1; 
+  else if (doesPlayerLose(playerTotal, dealerTotal))
+    return -1; 
+  else 
+    return 0; 
+}
+
+
+//------------------------------------------------------------------------------
+// Indicates whether a hand of ncards cards, hands[index], is a Charlie, which 
+// wins outright. 
+//------------------------------------------------------------------------------
+static int isCharlie (int index, int ncards, const Rules *rules)
+{
+  return rules->charlie && ncards >= rules->charlie && index != BUST; 
+}
+
+
+//------------------------------------------------------------------------------
+// Runs simulations of every non-obvious combination of hand and up card until
+// the confidence interval for both the probability of winning and that of 
+// losing is no wider than spec.halfWidth on either side, in every cell; or 
+// until the cell disagrees with the chart (if spec.alpha > 0) or has had 
+// spec.maxPerCell simulations. 
+// After a pilot round, each round gives every unfinished cell the number of 
+// simulations that its estimated variance says it still needs. For a common 
+// target half-width h this is n = z^2 p(1-p) / h^2, i.e. simulations are 
+// allocated in proportion to each cell's variance (the Neyman allocation for 
+// equal target precision), so that cells near 0 or 1 stop early and the 
+// effort goes to the cells whose intervals are widest. Since the variances are
+// only estimates, a cell's count at most doubles in each round. 
+//------------------------------------------------------------------------------
+AdaptiveResult runAdaptiveSims (HandSim **simsChart, 
+                      const StrategyTable *chart, 
+                      const Rules *rules, AdaptiveSpec spec, int nthreads, 
+                      uint64_t seed)
+{
+  const int MIN_SIMS_PER_ROUND = 100; 
+  AdaptiveResult result = {0, 0, 0, 0, 0, 0, 0.}; 
+  double z = qnorm(1. - (1. - spec.confidence) / 2.); 
+  double halfWidth, v; 
+  int **nsims = NULL; 
+  int i, j, add, need, maxn; 
+  int anyLeft; 
+  HandSim hs; 
+  SimEstimate est; 
+  
+  nsims = (int **) malloc(NUM_HANDS * sizeof(int *)); 
+  if (nsims == NULL) throwMemErr("nsims", "runAdaptiveSims"); 
+  for (i = 0; i < NUM_HANDS; i++)
+  {
+    nsims[i] = (int *) malloc((NUM_CARDS+1) * sizeof(int)); 
+    if (nsims[i] == NULL) throwMemErr("nsims[i]", "runAdaptiveSims"); 
+    if (!(hands[i].isObvious))
+      result.ncells += NUM_CARDS; 
+  }
+  
+  do
+  {
+    anyLeft = FALSE; 
+    for (i = 0; i < NUM_HANDS; i++)
+    {
+      for (j = 1; j <= NUM_CARDS; j++)
       {
-        //if it's a double 3 through 10, convert to non-splittable form 
-        if (hand.isSplittable && index >= THREES) 
-        {
-          hand.isSplittable = FALSE; 
-          index = getHandIndex(hand);
-          action = chart[index][upCard].action; 
-        }
+        hs = simsChart[i][j]; 
+        nsims[i][j] = 0; 
         
-        if (action == DOUBLE_DOWN)
-        {
-          action = hand.value >= 18 ? STAND : HIT; 
-          if (action == STAND)
-            break; 
-        }
-      }
-      
-      if (action == HIT || action == DOUBLE_DOWN)
-      {
-        //if it's a double 3 through 10, convert to non-splittable form 
-        if (hand.isSplittable && index >= THREES) 
+        if (hands[i].isObvious || hs.nsims >= spec.maxPerCell)
+          continue; 
+        if (hs.nsims == 0)
         {
-          hand.isSplittable = FALSE; 
-          index = getHandIndex(hand);
+          nsims[i][j] = spec.pilot; 
+          anyLeft = TRUE; 
+          continue; 
         }
+        est = getSimEstimate(hs, rules, i, j, spec.vr); 
+        if (getSimHalfWidth(est, z) <= spec.halfWidth)
+          continue; 
+        if (spec.alpha > 0. 
+          && doesSimDisagree(est, getStrat(chart, i, j), spec.alpha, 
+                      result.ncells))
+          continue; 
         
-        //Draw a card  
-        newCard = randdraw_count2 (deck + 1, NUM_CARDS, cardsInDeck); 
-        deck[newCard]--;
-        cardsInDeck--; 
-        hand = calculateNewHand(hand, newCard); 
-        index = getHandIndex(hand); 
+        //Number of simulations needed for the larger of the two variances 
+        //(per simulated hand) 
+        v = fmax(est.winVar, est.lossVar) * hs.nsims; 
+        need = (int) ceil(z * z * v / (spec.halfWidth * spec.halfWidth)); 
         
-        isInitialHand = FALSE; //after the first time through, it's not the
-                        //initial hand anymore 
-    
-        if (action == DOUBLE_DOWN) //cannot hit further 
-          break; 
-      }
-      else //if action = split. If "stand", we wouldn't be in the while loop.
-      {
-        //Compute the probability of winning each of the newly split hands;
-        //ignores the case where the same card is dealt a third time causing
-        //the hand to be resplit. 
-        splitCard = hand.isSoft ? 1 : hand.value / 2; 
-        do
-        {
-          newCard = randdraw_count2 (deck + 1, NUM_CARDS, cardsInDeck); 
-        }
-        while (newCard == splitCard); 
-        deck[newCard]--; 
-        cardsInDeck--; 
-        
-        hand = getHandByCards(splitCard, newCard, TRUE); //Note 1
-        index = getHandIndex(hand); 
+        add = need - hs.nsims; 
+        if (add > hs.nsims)
+          add = hs.nsims; 
+        if (add < MIN_SIMS_PER_ROUND)
+          add = MIN_SIMS_PER_ROUND; 
+        if (add > spec.maxPerCell - hs.nsims)
+          add = spec.maxPerCell - hs.nsims; 
         
-        isInitialHand = TRUE; //should already be true at this point; just 
-                      //making sure. 
+        nsims[i][j] = add; 
+        anyLeft = TRUE; 
       }
     }
+    
+    if (anyLeft)
+    {
+      runSimsCells(simsChart, chart, rules, nsims, spec.vr, nthreads, seed, 
+               result.nrounds); 
+      result.nrounds++; 
+    }
+  } while (anyLeft); 
+  
+  //Summarize 
+  maxn = 0; 
+  for (i = 0; i < NUM_HANDS; i++)
+  {
+    if (hands[i].isObvious)
+      continue; 
+    for (j = 1; j <= NUM_CARDS; j++)
+    {
+      hs = simsChart[i][j]; 
+      est = getSimEstimate(hs, rules, i, j, spec.vr); 
+      halfWidth = getSimHalfWidth(est, z); 
+      result.nhands += hs.nsims; 
+      if (hs.nsims > maxn)
+        maxn = hs.nsims; 
+      if (halfWidth <= spec.halfWidth)
+        result.nmet++; 
+      if (halfWidth > result.maxHalfWidth)
+        result.maxHalfWidth = halfWidth; 
+      if (doesSimDisagree(est, getStrat(chart, i, j), 
+                  spec.alpha > 0. ? spec.alpha : 1. - spec.confidence, 
+                  result.ncells))
+        result.ndisagree++; 
+    }
+  }
+  result.uniformHands = (long) maxn * result.ncells; 
+  
+  for (i = 0; i < NUM_HANDS; i++)
+    free(nsims[i]); 
+  free(nsims); 
+  
+  return result; 
+}
+
 
-    playerTotal = hand.value; 
+//------------------------------------------------------------------------------
+// Estimates the probabilities of winning and losing in the cell of hand i and
+// the up card, and the variances of the estimates, from the cell's results. 
+// Without variance reduction (vr = 0) these are the plain proportions; the 
+// variances use proportions shrunk slightly toward 1/2 (by adding one win and
+// one loss), so that a cell with no wins or losses yet does not look exact. 
+// 
+// With variance reduction, each probability is estimated by regressing the 
+// numbers of wins (or losses) per unit on the control quantities of the 
+// methods in use, whose expected values are known, and correcting the mean by
+// the difference between the controls' sample means and expected values: 
+// - VR_CONTROL: the numbers of times the dealer ends on 18, 19, 20, 21 and 
+//   bust, whose expected values are those of the shoe the hands are dealt 
+//   from (see getDealerControlMeans). Where the controls determine the 
+//   outcome, as when the player stands, the regression would only give back 
+//   those expected values, with no variance; such a probability is left as 
+//   the plain proportion, so that it is still checked against the chart. 
+// - VR_STRATIFY: the numbers of hands from each combination of starting cards,
+//   whose expected values are exact for the rules' shoe. This is 
+//   post-stratification, and the correction is all but zero since the sample 
+//   is systematic; what it does is take the variance within rather than 
+//   across the combinations. 
+// - VR_ANTITHETIC enters through the units: pairs whose outcomes are negatively
+//   correlated have a smaller variance than two independent hands. 
+// The variance of the estimate is the residual variance of the regression 
+// divided by the number of units. The gains compare it with the variance of 
+// the plain proportion over the same number of hands. 
+//------------------------------------------------------------------------------
+SimEstimate getSimEstimate (HandSim hs, const Rules *rules, int i, int upCard,
+                     int vr)
+{
+  const double EXACT_TOL = 1e-9; //relative residual variance below which the
+                         //controls are taken to explain the outcome 
+  SimEstimate est; 
+  CardSampler fullShoe; 
+  int lesserCards[MAX_COMBOS], greaterCards[MAX_COMBOS]; 
+  int weights[MAX_COMBOS]; 
+  int x[NUM_MOMENTS]; //positions of the control quantities in use 
+  double mu[NUM_MOMENTS]; //expected value of each quantity per unit 
+  double dealerMeans[NUM_DEALER_CONTROLS]; 
+  double cov[NUM_MOMENTS][NUM_MOMENTS]; //sample covariances of the quantities
+  double sxx[NUM_MOMENTS][NUM_MOMENTS]; 
+  double beta[NUM_MOMENTS]; 
+  double nunits, perUnit, est1, resid, var, plainVar, p; 
+  int nx, ncombos, total, a, b, k, y; 
+  int counts[NUM_CARDS+1]; 
+  
+  est.winPct = hs.nsims > 0 ? (double) hs.nwins / hs.nsims : 0.; 
+  est.lossPct = hs.nsims > 0 ? (double) hs.nlosses / hs.nsims : 0.; 
+  est.winVar = est.lossVar = HUGE_VAL; 
+  est.winGain = est.lossGain = 1.; 
+  if (hs.nsims == 0)
+    return est; 
+  
+  p = (hs.nwins + 1.) / (hs.nsims + 2.); 
+  est.winVar = p * (1. - p) / hs.nsims; 
+  p = (hs.nlosses + 1.) / (hs.nsims + 2.); 
+  est.lossVar = p * (1. - p) / hs.nsims; 
+  
+  nunits = hs.moments[MOMENT_ONE][MOMENT_ONE]; 
+  if (!(vr) || nunits < 2.)
+    return est; 
+  perUnit = hs.nsims / nunits; 
+  
+  //Controls in use and their expected values per unit 
+  nx = 0; 
+  if (vr & VR_CONTROL)
+  {
+    getDealerControlMeans(rules, i, upCard, dealerMeans); 
+    for (k = 0; k < NUM_DEALER_CONTROLS; k++)
+    {
+      x[nx++] = MOMENT_DEALER + k; 
+      mu[MOMENT_DEALER + k] = perUnit * dealerMeans[k]; 
+    }
+  }
+  if ((vr & VR_STRATIFY) && !(hands[i].isSoft || hands[i].isSplittable))
+  {
+    getShoeCounts(rules, counts); 
+    initCardSamplerFromCounts(&fullShoe, counts); 
+    ncombos = getStartingCombos(&fullShoe, hands[i].value, lesserCards, 
+                         greaterCards, weights); 
+    total = 0; 
+    for (k = 0; k < ncombos; k++)
+      total += weights[k]; 
+    for (k = 1; k < ncombos; k++)
+    {
+      x[nx++] = MOMENT_STRATA + k - 1; 
+      mu[MOMENT_STRATA + k - 1] = perUnit * weights[k] / total; 
+    }
+  }
+  
+  //Sample covariances of all of the quantities, from the upper triangle 
+  for (a = 0; a < NUM_MOMENTS; a++)
+  {
+    for (b = a; b < NUM_MOMENTS; b++)
+    {
+      cov[a][b] = hs.moments[a][b] / nunits - hs.moments[MOMENT_ONE][a] 
+        * hs.moments[MOMENT_ONE][b] / (nunits * nunits); 
+      cov[b][a] = cov[a][b]; 
+    }
+  }
+  
+  for (y = MOMENT_WIN; y <= MOMENT_LOSS; y++)
+  {
+    for (a = 0; a < nx; a++)
+    {
+      for (b = 0; b < nx; b++)
+        sxx[a][b] = cov[x[a]][x[b]]; 
+      beta[a] = cov[x[a]][y]; 
+    }
+    solveSymmetric(sxx, beta, nx); 
+    
+    est1 = hs.moments[MOMENT_ONE][y] / nunits; 
+    resid = cov[y][y]; 
+    for (a = 0; a < nx; a++)
+    {
+      est1 -= beta[a] * (hs.moments[MOMENT_ONE][x[a]] / nunits - mu[x[a]]); 
+      resid -= beta[a] * cov[x[a]][y]; 
+    }
+    
+    //Keep the plain estimate if the outcome never (or always) occurs, or 
+    //if the controls explain all of its variance: then the outcome is a 
+    //function of them - e.g. when the player stands, whether he wins depends
+    //only on the dealer's total - and the regression would give back their 
+    //expected values rather than anything that was simulated. 
+    if (cov[y][y] <= 0. || nunits <= nx + 1 
+        || resid <= EXACT_TOL * cov[y][y])
+      continue; 
+    
+    var = resid * nunits / (nunits - 1 - nx) / nunits / (perUnit * perUnit);
+    p = est1 / perUnit; 
+    if (y == MOMENT_WIN)
+    {
+      plainVar = est.winVar; 
+      est.winPct = p; 
+      est.winVar = var; 
+      est.winGain = plainVar / var; 
+    }
+    else 
+    {
+      plainVar = est.lossVar; 
+      est.lossPct = p; 
+      est.lossVar = var; 
+      est.lossGain = plainVar / var; 
+    }
+  }
+  
+  return est; 
+}
+
+
+//------------------------------------------------------------------------------
+// Finds the expected number of times per hand that the dealer ends on each of 
+// 18, 19, 20, 21 and bust, as runSims deals hand i against upCard, and stores 
+// them in mu: the exact distribution from the rules' shoe with the player's 
+// two cards and the up card removed, and given that the dealer doesn't have 
+// blackjack (see dealerOutcomeProbs), averaged over the combinations of 
+// starting cards in the proportions in which they are dealt. This is exact 
+// when the player draws no cards; those he draws before the dealer plays 
+// only shift it slightly. 
+//------------------------------------------------------------------------------
+static void getDealerControlMeans (const Rules *rules, int i, int upCard, 
+                          double *mu)
+{
+  CardSampler fullShoe; 
+  DealerCache *cache = newDealerCache(rules); 
+  int lesserCards[MAX_COMBOS], greaterCards[MAX_COMBOS]; 
+  int weights[MAX_COMBOS]; 
+  double probs[BUST_VALUE+1]; 
+  int counts[NUM_CARDS+1], left[NUM_CARDS+1]; 
+  int ncombos, total, c, k; 
+  
+  getShoeCounts(rules, counts); 
+  if (hands[i].isSplittable)
+  {
+    ncombos = 1; 
+    lesserCards[0] = greaterCards[0] = hands[i].isSoft ? 1 
+      : hands[i].value / 2; 
+    weights[0] = 1; 
+  }
+  else if (hands[i].isSoft)
+  {
+    ncombos = 1; 
+    lesserCards[0] = 1; 
+    greaterCards[0] = hands[i].value - 11; 
+    weights[0] = 1; 
+  }
+  else 
+  {
+    initCardSamplerFromCounts(&fullShoe, counts); 
+    ncombos = getStartingCombos(&fullShoe, hands[i].value, lesserCards, 
+                         greaterCards, weights); 
+  }
+  
+  for (k = 0; k < NUM_DEALER_CONTROLS; k++)
+    mu[k] = 0.; 
+  total = 0; 
+  for (c = 0; c < ncombos; c++)
+  {
+    if (weights[c] <= 0)
+      continue; 
+    for (k = 0; k <= NUM_CARDS; k++)
+      left[k] = counts[k]; 
+    left[lesserCards[c]]--; 
+    left[greaterCards[c]]--; 
+    left[upCard]--; 
+    dealerOutcomeProbs(cache, left, upCard, TRUE, probs); 
+    for (k = 0; k < NUM_DEALER_CONTROLS; k++)
+      mu[k] += weights[c] * probs[18 + k]; 
+    total += weights[c]; 
+  }
+  for (k = 0; k < NUM_DEALER_CONTROLS; k++)
+    mu[k] /= total; 
+  
+  freeDealerCache(cache); 
+}
+
+
+//------------------------------------------------------------------------------
+// Solves the n by n symmetric system a x = b in place (leaving x in b), by 
+// Gaussian elimination. A variable whose pivot is (numerically) zero - a 
+// control that never varied, or that is a combination of the others - is 
+// dropped by setting it to zero. Returns the number of variables kept. 
+//------------------------------------------------------------------------------
+static int solveSymmetric (double a[][NUM_MOMENTS], double *b, int n)
+{
+  const double TOL = 1e-12; 
+  int keep[NUM_MOMENTS]; 
+  double f; 
+  int i, j, k, nkept = 0; 
+  
+  for (k = 0; k < n; k++)
+  {
+    keep[k] = fabs(a[k][k]) > TOL; 
+    if (!(keep[k]))
+    {
+      b[k] = 0.; 
+      continue; 
+    }
+    nkept++; 
+    for (i = k + 1; i < n; i++)
+    {
+      f = a[i][k] / a[k][k]; 
+      for (j = k; j < n; j++)
+        a[i][j] -= f * a[k][j]; 
+      b[i] -= f * b[k]; 
+    }
+  }
+  
+  for (k = n - 1; k >= 0; k--)
+  {
+    if (!(keep[k]))
+      continue; 
+    for (j = k + 1; j < n; j++)
+      b[k] -= a[k][j] * b[j]; 
+    b[k] /= a[k][k]; 
+  }
+  
+  return nkept; 
+}
+
+
+//------------------------------------------------------------------------------
+// Returns the half-width of the confidence interval, with normal quantile z, 
+// for whichever of the estimated probabilities of winning and of losing has 
+// the larger variance. 
+//------------------------------------------------------------------------------
+double getSimHalfWidth (SimEstimate est, double z)
+{
+  return z * sqrt(fmax(est.winVar, est.lossVar)); 
+}
+
+
+//------------------------------------------------------------------------------
+// Returns the two-sided p-value of the hypothesis that the simulations agree 
+// with the chart's probabilities of winning and of losing: the smaller of the
+// two p-values, doubled to account for testing both. 
+//------------------------------------------------------------------------------
+double getSimPValue (SimEstimate est, Strategy strat)
+{
+  double zw, zl, p; 
+  
+  if (est.winVar == HUGE_VAL)
+    return 1.; 
+  
+  zw = pValueZ(est.winPct - strat.winPct, est.winVar); 
+  zl = pValueZ(est.lossPct - strat.lossPct, est.lossVar); 
+  
+  p = 4. * (1. - pnorm(fmax(zw, zl))); 
+  return p < 1. ? p : 1.; 
+}
+
+
+//------------------------------------------------------------------------------
+// Returns the z statistic of a difference with the given variance, for 
+// getSimPValue. An exact estimate (variance 0) agrees only if the difference 
+// is down to rounding error. 
+//------------------------------------------------------------------------------
+static double pValueZ (double diff, double var)
+{
+  const double ROUNDING = 1e-9; 
+  
+  if (var > 0.)
+    return fabs(diff) / sqrt(var); 
+  return fabs(diff) < ROUNDING ? 0. : HUGE_VAL; 
+}
+
+
+//------------------------------------------------------------------------------
+// Indicates whether the simulations of a cell disagree with the chart at 
+// significance level alpha, Bonferroni-corrected for testing ncells cells. 
+//------------------------------------------------------------------------------
+int doesSimDisagree (SimEstimate est, Strategy strat, double alpha, int ncells)
+{
+  return getSimPValue(est, strat) < alpha / ncells; 
+}
+
+
+//------------------------------------------------------------------------------
+// Plays nshoes shoes of the decks given by rules, spread over nthreads 
+// threads, following the strategy in chart and the rules. Each shoe is 
+// shuffled, dealt from one round at a time until the round in which the cut 
+// card (at the given penetration) comes out, and then reshuffled. 
+// As in runSimsParallel, each block of shoes draws from its own substream, so
+// the results depend only on the seed and not on the number of threads. 
+//------------------------------------------------------------------------------
+ShoeSim runShoeSims (const StrategyTable *chart, const Rules *rules, 
+              double penetration, int nshoes, int nthreads, uint64_t seed)
+{
+  ShoeJob job; 
+  ShoeSim total = newShoeSim(); 
+  int counts[NUM_CARDS+1]; 
+  int ntasks, t; 
+  
+  if (nthreads < 1)
+    nthreads = 1; 
+  
+  job.chart = chart; 
+  job.nshoes = nshoes; 
+  job.rules = rules; 
+  job.seed = seed; 
+  job.tables = getStratTables(); 
+  getShoeCounts(rules, counts); 
+  initShoeFromCounts(&job.shoe, counts, penetration); 
+  
+  ntasks = (nshoes + SHOES_PER_TASK - 1) / SHOES_PER_TASK; 
+  job.results = (ShoeSim *) malloc(ntasks * sizeof(ShoeSim)); 
+  if (job.results == NULL) throwMemErr("job.results", "runShoeSims"); 
+  
+  parallel_for(ntasks, nthreads, runShoeTask, &job); 
+  
+  for (t = 0; t < ntasks; t++)
+    addShoeSim(&total, job.results[t]); 
+  
+  free(job.results); 
+  return total; 
+}
+
+
+//------------------------------------------------------------------------------
+// Plays one block of shoes for runShoeSims. 
+//------------------------------------------------------------------------------
+static void runShoeTask (int task, int thread, void *arg)
+{
+  ShoeJob *job = (ShoeJob *) arg; 
+  Shoe shoe = job->shoe; 
+  ShoeSim sim = newShoeSim(); 
+  RandStream rs; 
+  int n = job->nshoes - task * SHOES_PER_TASK; 
+  int k; 
+  
+  if (n > SHOES_PER_TASK)
+    n = SHOES_PER_TASK; 
+  
+  useStratTables(job->tables); 
+  rng_seed(&rs, job->seed); 
+  rng_set_stream(&rs, SHOE_STREAM, (uint32_t) task); 
+  
+  for (k = 0; k < n; k++)
+    playShoe(&sim, &shoe, job->chart, job->rules, &rs); 
+  
+  job->results[task] = sim; 
+}
+
+
+//------------------------------------------------------------------------------
+// Shuffles the shoe and plays rounds from it until the cut card comes out, 
+// adding the results to sim. 
+//------------------------------------------------------------------------------
+void playShoe (ShoeSim *sim, Shoe *shoe, const StrategyTable *chart, 
+          const Rules *rules, RandStream *rs)
+{
+  long nrounds = 0; 
+  double won = 0.; 
+  
+  shuffleShoe(shoe, rs); 
+  do
+  {
+    won += playRound(shoe, chart, rules, rs); 
+    nrounds++; 
+  } while (!(isCutCardReached(shoe))); 
+  
+  sim->nshoes++; 
+  sim->nrounds += nrounds; 
+  sim->won += won; 
+  sim->wonSq += won * won; 
+  sim->roundsSq += (double) nrounds * nrounds; 
+  sim->wonRounds += won * nrounds; 
+}
+
+
+//------------------------------------------------------------------------------
+// Deals and plays one round from the shoe, and returns the net amount won by 
+// the player in units of the initial bet. 
+// With a hole card, the dealer peeks for blackjack, so if he has it the player
+// loses only his initial bet (or pushes with blackjack of his own); without 
+// one, his second card is dealt after the player has played, and his 
+// blackjack takes every bet the player has made. The player surrenders where 
+// the chart says to, if the rules allow it at that point. A pair is split 
+// again as often as the rules allow (up to MAX_SPLIT_HANDS hands). 
+//------------------------------------------------------------------------------
+double playRound (Shoe *shoe, const StrategyTable *chart, const Rules *rules, 
+            RandStream *rs)
+{
+  int card1, card2, upCard, downCard, splitCard, newCard; 
+  int isPlayerBJ, isDealerBJ; 
+  int nhands, maxHands, k; 
+  int anyLive; //true if any of the player's hands must be played against the
+             //dealer's: it has neither busted nor made a Charlie 
+  double bet[MAX_SPLIT_HANDS]; 
+  int pIndex[MAX_SPLIT_HANDS]; //indices of the player's final hands 
+  int ncards[MAX_SPLIT_HANDS]; //number of cards in each of them 
+  int index, dIndex; 
+  double won, totalBet; 
+  Strategy strat; 
+  
+  //Deal in the usual order: player, dealer, player, dealer 
+  card1 = dealCard(shoe, rs); 
+  upCard = dealCard(shoe, rs); 
+  card2 = dealCard(shoe, rs); 
+  downCard = rules->holeCard ? dealCard(shoe, rs) : 0; 
+  
+  index = handByCards[card1][card2]; 
+  strat = getStrat(chart, index, upCard); 
+  isPlayerBJ = (card1 == 1 && card2 == 10) || (card1 == 10 && card2 == 1); 
+  
+  if (strat.surrender && rules->surrender == SURRENDER_EARLY)
+    return -.5; 
+  if (!(rules->holeCard) && (isPlayerBJ || strat.surrender))
+    downCard = dealCard(shoe, rs); 
+  isDealerBJ = (upCard == 1 && downCard == 10) 
+            || (upCard == 10 && downCard == 1); 
+  
+  if (isDealerBJ && (rules->holeCard || isPlayerBJ || strat.surrender))
+    return isPlayerBJ ? 0. : -1.; 
+  if (isPlayerBJ)
+    return rules->blackjackPays; 
+  if (strat.surrender)
+    return -.5; 
+  
+  if (strat.action == SPLIT)
+  {
+    splitCard = card1; 
+    maxHands = getMaxSplitHands(splitCard, rules); 
+    if (maxHands == 0 || maxHands > MAX_SPLIT_HANDS)
+      maxHands = MAX_SPLIT_HANDS; 
     
-    //have dealer hit until standing 
-    dHand = getHandByCards (upCard, downCard, TRUE); 
-    while (!(doesDealerStand(dHand)))
+    //Each hand is dealt its second card in turn; another card of the same 
+    //rank starts a new hand, as long as there may be more hands 
+    nhands = 2; 
+    for (k = 0; k < nhands; k++)
     {
-      newCard = randdraw_count2 (deck + 1, NUM_CARDS, cardsInDeck); 
-      deck[newCard]--; 
-      cardsInDeck--; 
-      dHand = calculateNewHand (dHand, newCard); 
-    }    
-    dealerTotal = dHand.value; 
-
-    if (doesPlayerWin(playerTotal, dealerTotal))
-      simsChart[i][upCard].nwins++; 
-    else if (doesPlayerLose(playerTotal, dealerTotal))
-      simsChart[i][upCard].nlosses++; 
+      while ((newCard = dealCard(shoe, rs)) == splitCard && nhands < maxHands)
+        nhands++; 
+      bet[k] = 1.; 
+      index = handByCards[splitCard][newCard]; 
+      if (splitCard == 1 && !(rules->hitSplitAces)) //one card only 
+      {
+        pIndex[k] = index == handByCards[1][1] ? SOFT_TWELVE : index; 
+        ncards[k] = 2; 
+      }
+      else 
+        pIndex[k] = playHand(shoe, chart, rules, index, upCard, TRUE, &bet[k],
+                      &ncards[k], rs); 
+    }
+  }
+  else 
+  {
+    nhands = 1; 
+    bet[0] = 1.; 
+    pIndex[0] = playHand(shoe, chart, rules, index, upCard, FALSE, &bet[0], 
+                  &ncards[0], rs); 
+  }
+  
+  anyLive = FALSE; 
+  totalBet = 0.; 
+  for (k = 0; k < nhands; k++)
+  {
+    if (pIndex[k] != BUST && !(isCharlie(pIndex[k], ncards[k], rules)))
+      anyLive = TRUE; 
+    totalBet += bet[k]; 
+  }
+  
+  //Without a hole card, the dealer's blackjack takes everything, unless the 
+  //player has already lost it all 
+  if (!(rules->holeCard))
+  {
+    for (k = 0; k < nhands && pIndex[k] == BUST; k++)
+      ; 
+    if (k == nhands)
+      return -totalBet; 
+    downCard = dealCard(shoe, rs); 
+    if ((upCard == 1 && downCard == 10) || (upCard == 10 && downCard == 1))
+      return -totalBet; 
+  }
+  
+  //The dealer only plays out his hand if the player has a hand left to play 
+  //against it 
+  dIndex = dealerHandByCards[upCard][downCard]; 
+  if (anyLive)
+    while (!(doesDealerStand(hands[dIndex], rules)))
+      dIndex = handAfterCard[dIndex][dealCard(shoe, rs)]; 
+  
+  won = 0.; 
+  for (k = 0; k < nhands; k++)
+  {
+    if (isCharlie(pIndex[k], ncards[k], rules))
+      won += bet[k]; 
+    else if (doesPlayerWin(hands[pIndex[k]].value, hands[dIndex].value))
+      won += bet[k]; 
+    else if (doesPlayerLose(hands[pIndex[k]].value, hands[dIndex].value))
+      won -= bet[k]; 
+  }
+  
+  return won; 
+}
+
+
+//------------------------------------------------------------------------------
+// Plays out one of the player's hands (the whole hand, or one of those after a
+// split, if isSplit is true) starting from the two cards of hands[index], 
+// according to the chart and the rules, and returns the index of the final 
+// hand. bet is doubled if the player doubles down, and ncards is set to the 
+// number of cards in the final hand. 
+//------------------------------------------------------------------------------
+static int playHand (Shoe *shoe, const StrategyTable *chart, 
+              const Rules *rules, int index, int upCard, int isSplit, 
+              double *bet, int *ncards, RandStream *rs)
+{
+  int action; 
+  int isInitialHand = TRUE; //true if the player may still double 
+  
+  //A pair that may not be split again is played like its hard total (A,A 
+  //and 2,2 are already the simple hands soft 12 and 4) 
+  if (isSplit && index >= NUM_HANDS_SIMPLE)
+    index = getHandIndex(makeHand(hands[index].value, FALSE, FALSE, FALSE)); 
+  *ncards = 2; 
+  
+  while (index != BUST && !(isCharlie(index, *ncards, rules)))
+  {
+    action = chart->action[STRAT_CELL(index, upCard)]; 
     
-    n++; 
-    free(deck); 
+    //Once the player has hit, or after a split, he may only hit or stand, 
+    //unless he may double after a split 
+    if (!(isInitialHand) || action == SPLIT 
+        || (isSplit && action == DOUBLE_DOWN && !(rules->doubleAfterSplit)))
+      action = getHitStandAction(index, *ncards, upCard); 
+    
+    if (action == STAND)
+      break; 
+    
+    index = handAfterCard[index][dealCard(shoe, rs)]; 
+    (*ncards)++; 
+    isInitialHand = FALSE; 
+    
+    if (action == DOUBLE_DOWN)
+    {
+      *bet *= 2.; 
+      break; 
+    }
   }
   
+  return index; 
+}
+
+
+//------------------------------------------------------------------------------
+// Initializes a new ShoeSim 
+//------------------------------------------------------------------------------
+ShoeSim newShoeSim ()
+{
+  ShoeSim sim = {0, 0, 0., 0., 0., 0.}; 
+  return sim; 
+}
+
+
+//------------------------------------------------------------------------------
+// Adds the results in sim to total. 
+//------------------------------------------------------------------------------
+void addShoeSim (ShoeSim *total, ShoeSim sim)
+{
+  total->nshoes += sim.nshoes; 
+  total->nrounds += sim.nrounds; 
+  total->won += sim.won; 
+  total->wonSq += sim.wonSq; 
+  total->roundsSq += sim.roundsSq; 
+  total->wonRounds += sim.wonRounds; 
 }
 
 
+//------------------------------------------------------------------------------
+// Returns the player's expected value per round, estimated from sim. 
+//------------------------------------------------------------------------------
+double getShoeSimEV (ShoeSim sim)
+{
+  return sim.nrounds > 0 ? sim.won / sim.nrounds : 0.; 
+}
+
+
+//------------------------------------------------------------------------------
+// Returns the standard error of getShoeSimEV. Since rounds from the same shoe 
+// are correlated (that is the cut-card effect), this treats the EV as a ratio 
+// of the amount won per shoe to the rounds per shoe and uses the variance of 
+// the ratio estimator over shoes. 
+//------------------------------------------------------------------------------
+double getShoeSimStdErr (ShoeSim sim)
+{
+  double ev = getShoeSimEV(sim); 
+  double meanRounds, ss; 
+  
+  if (sim.nshoes < 2)
+    return 0.; 
+  
+  meanRounds = (double) sim.nrounds / sim.nshoes; 
+  //sum over shoes of (won - ev * rounds)^2 
+  ss = sim.wonSq - 2. * ev * sim.wonRounds + ev * ev * sim.roundsSq; 
+  if (ss < 0.)
+    ss = 0.; 
+  
+  return sqrt(ss / (sim.nshoes - 1) / sim.nshoes) / meanRounds; 
+}
+
 
 //------------------------------------------------------------------------------
 // Indicates whether the player wins given the indicated ending totals. 
@@ -209,7 +1381,7 @@ HandSim ** initializeSimsChart ()
 //------------------------------------------------------------------------------
 HandSim newHandSim ()
 {
-  HandSim hs = {0, 0}; 
+  HandSim hs = {0, 0, 0, {{0.}}}; 
   return hs; 
 }
 
@@ -220,7 +1392,8 @@ HandSim newHandSim ()
 // simulations) percent chance of winning, over all hands and up cards. 
 // Note: This ignores obvious hands, since they are not simulated. 
 //------------------------------------------------------------------------------
-double getMaxWinErr(Strategy **chart, HandSim **simsChart, int nsims)
+double getMaxWinErr(const StrategyTable *chart, HandSim **simsChart, 
+             int nsims)
 {
   int i, j; 
   double mx = 0.; 
@@ -234,7 +1407,7 @@ double getMaxWinErr(Strategy **chart, HandSim **simsChart, int nsims)
     for (j = 1; j <= NUM_CARDS; j++)
     {
       winPctActual = ((double) simsChart[i][j].nwins) / nsims; 
-      err = fabs(chart[i][j].winPct - winPctActual); 
+      err = fabs(chart->winPct[STRAT_CELL(i, j)] - winPctActual); 
       if (err > mx)
         mx = err; 
     }
@@ -249,7 +1422,8 @@ double getMaxWinErr(Strategy **chart, HandSim **simsChart, int nsims)
 // simulations) percent chance of losing, over all hands and up cards. 
 // Note: This ignores obvious hands, since they are not simulated. 
 //------------------------------------------------------------------------------
-double getMaxLossErr(Strategy **chart, HandSim **simsChart, int nsims)
+double getMaxLossErr(const StrategyTable *chart, HandSim **simsChart, 
+              int nsims)
 {
   int i, j; 
   double mn = 0.; 
@@ -263,7 +1437,7 @@ double getMaxLossErr(Strategy **chart, HandSim **simsChart, int nsims)
     for (j = 1; j <= NUM_CARDS; j++)
     {
       lossPctActual = ((double) simsChart[i][j].nlosses) / nsims; 
-      err = fabs(chart[i][j].lossPct - lossPctActual); 
+      err = fabs(chart->lossPct[STRAT_CELL(i, j)] - lossPctActual); 
       if (err > mn)
         mn = err; 
     }
@@ -274,45 +1448,55 @@ double getMaxLossErr(Strategy **chart, HandSim **simsChart, int nsims)
 
 
 //------------------------------------------------------------------------------
-// Removes the cards in the player's starting hand from the deck. 
+// Removes the cards in the player's starting hand from the shoe. Returns the 
+// index of the combination of cards that was chosen, for a hard total that can
+// be made in more than one way, and 0 otherwise; u is as in 
+// chooseCardsInStartingHand. 
 //------------------------------------------------------------------------------
-void removeCardsInStartingHand (int *deck, Hand hand, int cardsInDeck)
+int removeCardsInStartingHand (CardSampler *shoe, Hand hand, double u, 
+                       RandStream *rs)
 {
   const int ACE_VALUE = 11; 
-  int *cards; 
+  int cards[2]; 
   int splitCard, otherCard; 
+  int stratum = 0; 
 
   //If it's a pair, remove the two cards. 
   if (hand.isSplittable)
   {
     splitCard = hand.isSoft ? 1 : hand.value / 2; 
-    deck[splitCard] -= 2; 
+    removeCard(shoe, splitCard); 
+    removeCard(shoe, splitCard); 
   }
   //If it contains an ace, remove the two. 
   else if (hand.isSoft) 
   {
-    deck[1]--; 
+    removeCard(shoe, 1); 
     otherCard = hand.value - ACE_VALUE; 
-    deck[otherCard]--;     
+    removeCard(shoe, otherCard); 
   }
   else //May be hard 5 through 19. 
   {
-    cards = chooseCardsInStartingHand (deck, hand.value, cardsInDeck); 
-    deck[cards[0]]--; 
-    deck[cards[1]]--; 
-    free(cards); 
+    stratum = chooseCardsInStartingHand (shoe, hand.value, cards, u, rs); 
+    removeCard(shoe, cards[0]); 
+    removeCard(shoe, cards[1]); 
   }
+  
+  return stratum; 
 }
 
 
 
 //------------------------------------------------------------------------------
-// Returns the two cars that comprise the player's starting hand, when the hand
-// is neither a soft hand nor a splittable one. That is, it may be between hard
-// 5 and hard 19. For some hands, there is only one possiblity. For most, 
-// though, this randomly returns one of the possible pairs of cards that make up
-// the hand, based on their respective probabilities of being drawn from the 
-// given deck. "value" is the value of the (hard) hand. 
+// Chooses the two cards that comprise the player's starting hand, when the hand
+// is neither a soft hand nor a splittable one, and writes them to cards[0] and
+// cards[1]. That is, it may be between hard 5 and hard 19. For some hands, 
+// there is only one possiblity. For most, though, this randomly chooses one of
+// the possible pairs of cards that make up the hand, based on their respective
+// probabilities of being drawn from the given shoe. "value" is the value of 
+// the (hard) hand. If u (in [0, 1)) is not negative, it is used in place of a
+// random number, for stratified sampling. Returns the index of the chosen 
+// combination in the list below. 
 //
 // Possible combos: 
 // 5: 2/3 
@@ -332,32 +1516,50 @@ void removeCardsInStartingHand (int *deck, Hand hand, int cardsInDeck)
 // 19: 9/10 
 //  
 //------------------------------------------------------------------------------
-int * chooseCardsInStartingHand (int *deck, int value, int cardsInDeck)
+int chooseCardsInStartingHand (CardSampler *shoe, int value, int *cards, 
+                       double u, RandStream *rs)
 {
-  int *cards = NULL; 
-  double *probs = NULL; 
+  //The two cards lesserCards[i] and greaterCards[i] will add up to "value", 
+  //and will be selected with probability proportional to weights[i]. 
+  int lesserCards[MAX_COMBOS]; 
+  int greaterCards[MAX_COMBOS]; 
+  int weights[MAX_COMBOS]; 
+  int i, count, sum, cum; 
   
-  //These vectors give the combinations of possible pairs of cards that can 
-  //produce the given hand. The two cards lesserCards[i] and greaterCards[i]
-  //will add up to "value", and will be selected with probability probs[i]. 
-  int *lesserCards = NULL; 
-  int *greaterCards = NULL; 
+  count = getStartingCombos(shoe, value, lesserCards, greaterCards, weights); 
+  sum = 0; 
+  for (i = 0; i < count; i++)
+    sum += weights[i]; 
   
-  const int MAX_COMBOS = 4; //maximum number of combinations of two cards that
-                  //can make a given hand 
+  if (u < 0.)
+    i = randdraw_count2_r(rs, weights, count, sum) - 1; 
+  else 
+  {
+    //Invert the cumulative distribution at u 
+    cum = weights[0]; 
+    i = 0; 
+    while (u * sum >= cum && i < count - 1)
+    {
+      i++; 
+      cum += weights[i]; 
+    }
+  }
+  
+  cards[0] = lesserCards[i]; 
+  cards[1] = greaterCards[i]; 
+  return i; 
+}
+
+
+//------------------------------------------------------------------------------
+// Lists the combinations of two cards that make up the hard total "value" (see
+// chooseCardsInStartingHand), each with its weight: the number of ways of 
+// drawing it from the shoe. Returns the number of combinations. 
+//------------------------------------------------------------------------------
+int getStartingCombos (const CardSampler *shoe, int value, int *lesserCards, 
+                 int *greaterCards, int *weights)
+{
   int i, j, count; 
-  double sum; 
-  
-  cards = (int *) malloc (2 * sizeof(int)); 
-  if (cards == NULL) throwMemErr("cards", "chooseCardsInStartingHand"); 
-  lesserCards = (int *) malloc (MAX_COMBOS * sizeof(int)); 
-  if (lesserCards == NULL) 
-    throwMemErr("lesserCards", "chooseCardsInStartingHand"); 
-  greaterCards = (int *) malloc (MAX_COMBOS * sizeof(int)); 
-  if (greaterCards == NULL) 
-    throwMemErr("greaterCards", "chooseCardsInStartingHand"); 
-  probs = allocvector(MAX_COMBOS); 
-  if (probs == NULL) throwMemErr("probs", "chooseCardsInStartingHand"); 
   
   count = 0; 
   for (i = maxi(2, value - 10); i < value / 2.; i++)
@@ -365,23 +1567,11 @@ int * chooseCardsInStartingHand (int *deck, int value, int cardsInDeck)
     j = value - i; 
     lesserCards[count] = i; 
     greaterCards[count] = j; 
-    probs[count] = 2. * ((double) deck[i]) * ((double) deck[j])
-              / (cardsInDeck * cardsInDeck); 
+    weights[count] = countOfRank(shoe, i) * countOfRank(shoe, j); 
     count++; 
   }
   
-  sum = vectorsum(probs, count); 
-  for (i = 0; i < count; i++)
-    probs[i] /= sum; 
-  
-  i = randdraw(probs, count) - 1; 
-  cards[0] = lesserCards[i]; 
-  cards[1] = greaterCards[i]; 
-  
-  free(lesserCards); 
-  free(greaterCards); 
-
-  return cards; 
+  return count; 
 }
 
 
@@ -1,68 +1,278 @@
 #include "bj_strat.h"
+#include <math.h> 
 #include <stdlib.h> 
+#include <string.h> 
 #include "boolean.h"
 #include "error.h"
 #include "linal.h"
 #include "moremath.h"
+#include "parallel.h"
 #include "hands.h" 
-
-double **dealersProbabilities; 
+#include "splits.h" 
+#if defined(__AVX__)
+#include <immintrin.h> 
+#elif defined(__SSE2__)
+#include <emmintrin.h> 
+#endif
+
+__thread double **dealersProbabilities; 
 const int STAND = 1; 
 const int HIT = 2; 
 const int SPLIT = 3; 
 const int DOUBLE_DOWN = 4; 
 
-//Number of possible outcomes - 0 through 22, with 22 signifying bust. The 
-//reason for including numbers under 12 is just so that the indices of an 
-//outcomes vector are the same as the point value. 
-const static int NUM_OUTCOMES = 23; 
+//The solver's tables are kept per thread, so that charts for different rules 
+//can be solved at once on different threads (see sweep.c). They are made the 
+//first time a thread solves a chart and filled in again for each chart after 
+//that, until freeStratTables. 
+static __thread double **hitTransitionMatrix; 
+
+//Whether to hit or stand (HIT or STAND) on each simple hand against each up 
+//card, as found by calculateSimpleChart: hitStandActions[level * 
+//NUM_HANDS_SIMPLE + i][upCard] is for hands[i] with level + 2 cards. With a 
+//Charlie this depends on the number of cards, and there is a level for each 
+//number up to one less than the Charlie; otherwise there is only one level. 
+//It points into hitStandBuffer, which holds room for hitStandCapacity levels, 
+//unless the thread has taken over another's tables (see useStratTables). 
+static __thread int (*hitStandActions)[NUM_CARDS+1]; 
+static __thread int numHitStandLevels; 
+static __thread int (*hitStandBuffer)[NUM_CARDS+1]; 
+static __thread int hitStandCapacity; 
+
+//The simple hands in the order in which they are solved (see 
+//orderHandsForHitting), which is the same for all rules 
+static __thread int *hitOrder; 
+
+//A chart of the simple hands for the solver to work in: the strategies with 
+//one more card, for a Charlie, and the chart by which the hands after a split
+//are played without doubling after a split 
+static __thread StrategyTable *scratchChart; 
+
+//The solver works on every up card at once, as the lanes of a vector (see 
+//addScaledLanes): lane u of a row is up card u, and lane 0 and those after 
+//NUM_CARDS are padding, so that a row is a whole number of vectors of two or 
+//four doubles. 
+#define UP_CARD_LANES (12)
+
+//Tables of solverLanes, each of which has a row for every simple hand 
+enum { 
+  LANES_STAND_WIN, //probabilities of winning and losing by standing 
+  LANES_STAND_LOSS, 
+  LANES_DD_WIN, //by doubling (see getDDWinProb) 
+  LANES_DD_LOSS, 
+  LANES_WIN, //by playing the hand as the simple chart does 
+  LANES_LOSS, 
+  LANES_AFTER_WIN, //same with one more card, for a Charlie 
+  LANES_AFTER_LOSS, 
+  NUM_LANE_TABLES 
+}; 
+
+#define LANE_TABLE(t) (solverLanes + (t) * NUM_HANDS_SIMPLE)
+
+//The solver's rows of lanes, in one block, made by prepareSolver: 
+//LANE_TABLE(t)[i] is table t's row for hands[i] 
+static __thread double (*solverLanes)[UP_CARD_LANES]; 
+
+//Work shared by the threads of calculateStrategyChartParallel: the chart, 
+//and the calling thread's tables, which they all read 
+typedef struct { 
+  StrategyTable *chart; 
+  int makeSimpleChart; 
+  const Rules *rules; 
+  StratTables tables; 
+  int *hitOrder; 
+  StrategyTable *scratchChart; 
+  double (*solverLanes)[UP_CARD_LANES]; 
+} ChartJob; 
+
+static void solveHitOrStand (StrategyTable *chart, const StrategyTable *after, 
+                    int i, int upCard); 
+static void orderHandsForHitting (int *order); 
+static void visitHandForHitting (int i, int *state, int *order, int *n); 
+static void fillHitTransitionMat (double **P, const Rules *rules); 
+static void fillStandTables (double *row); 
+static void copyStratColumn (StrategyTable *dest, const StrategyTable *src, 
+                    int nhands, int upCard); 
+static void solveChartColumnTask (int task, int thread, void *arg); 
+static void solveChartColumn (ChartJob *job, int upCard); 
+static void prepareSolver (const Rules *rules); 
+static void fillSolverLanes (); 
+static void addScaledLanes (double *sum, const double *x, double p); 
+static void solveSimpleChart (StrategyTable *chart, const Rules *rules); 
+static void solveHitOrStandLanes (StrategyTable *chart, 
+                        double (*win)[UP_CARD_LANES], 
+                        double (*loss)[UP_CARD_LANES], 
+                        double (*afterWin)[UP_CARD_LANES], 
+                        double (*afterLoss)[UP_CARD_LANES], int i, 
+                        int level); 
+static void solveSimpleColumn (StrategyTable *chart, const Rules *rules, 
+                      int upCard); 
+static int getDoubleIndex (Hand hand); 
+static Strategy splitOrDoubleStrat (const StrategyTable *chart, 
+                    const StrategyTable *splitChart, int handIndex, 
+                    int upCard, const Rules *rules, double *playEV); 
+static void setHitStandEVs (StrategyTable *chart, int c, double standEV, 
+                   double hitEV); 
+static void getInfiniteSplitValue (int removed, int isPair, 
+                          SplitHandValue *value, void *arg); 
+static double getFirstHandPairProb (int splitCard, const Rules *rules); 
+static double getStratBet (Strategy strat); 
+static int shouldSurrender (Strategy strat, int handIndex, int upCard, 
+                   const Rules *rules); 
 
-//Maximum number of cards after the first two that it is theoretically possible
-//to get. (After the 22nd card you are guaranteed to go bust.) The point of 
-//this is to get the long term final transition matrix, P raised to this 
-//power. 
-const static int MAX_POSSIBLE_HITS = 22; 
 
-//Probability of drawing each card (in order, A, 2-10). Note: A dummy value of 
-//zero is added to the front so that CARD_PROBABILITIES[k] is the probability 
-//of getting card with value k. 
-static double CARD_PROBABILITIES[NUM_CARDS+1] = {0., 1./13, 1./13, 1./13, 1./13, 1./13,
-                                                 1./13, 1./13, 1./13, 1./13, 4./13}; 
+//------------------------------------------------------------------------------
+// Allocates a chart of nhands hands (NUM_HANDS, or NUM_HANDS_SIMPLE for the 
+// simple hands only), with all of its arrays in one block. The expected 
+// values of the plays start out as NAN, as they stay in the unused column. 
+//------------------------------------------------------------------------------
+StrategyTable * newStrategyTable (int nhands)
+{
+  StrategyTable *chart = NULL; 
+  int ncells = nhands * (NUM_CARDS+1); 
+  char *block = NULL; 
+  int i; 
+  
+  //The doubles go first, so that every array is aligned 
+  chart = (StrategyTable *) malloc(sizeof(StrategyTable)); 
+  block = (char *) malloc(ncells * ((3 + NUM_PLAY_EVS) * sizeof(double) 
+                        + 2 * sizeof(int))); 
+  if (chart == NULL || block == NULL) 
+    throwMemErr("chart", "newStrategyTable"); 
+  
+  chart->nhands = nhands; 
+  chart->winPct = (double *) block; 
+  chart->lossPct = chart->winPct + ncells; 
+  chart->splitEV = chart->lossPct + ncells; 
+  chart->playEV = chart->splitEV + ncells; 
+  chart->action = (int *) (chart->playEV + ncells * NUM_PLAY_EVS); 
+  chart->surrender = chart->action + ncells; 
+  for (i = 0; i < ncells * NUM_PLAY_EVS; i++)
+    chart->playEV[i] = NAN; 
+  return chart; 
+}
 
-static double **hitTransitionMatrix; 
+
+//------------------------------------------------------------------------------
+// Frees a chart made by newStrategyTable. 
+//------------------------------------------------------------------------------
+void freeStrategyTable (StrategyTable *chart)
+{
+  if (chart == NULL)
+    return; 
+  free(chart->winPct); //the start of the block 
+  free(chart); 
+}
 
 
 //------------------------------------------------------------------------------
-// Creates the chart. If MAKE_SIMPLE_CHART is true, ignores splits and doubles. 
+// Returns the strategy for hands[handIndex] against upCard. 
 //------------------------------------------------------------------------------
-void calculateStrategyChart (Strategy **chart, int MAKE_SIMPLE_CHART)
+Strategy getStrat (const StrategyTable *chart, int handIndex, int upCard)
 {
-  int i, j, equivIndex; 
-  Hand doubleHand, equivHand; 
-  int status; 
+  Strategy strat; 
+  int c = STRAT_CELL(handIndex, upCard); 
+  
+  strat.action = chart->action[c]; 
+  strat.winPct = chart->winPct[c]; 
+  strat.lossPct = chart->lossPct[c]; 
+  strat.splitEV = chart->splitEV[c]; 
+  strat.surrender = chart->surrender[c]; 
+  return strat; 
+}
 
-  //First, calculate strategies ignoring non-simple hands, and ignoring 
-  //splits/doubles. 
-  status = calculateSimpleChart (chart); 
+
+//------------------------------------------------------------------------------
+// Sets the strategy for hands[handIndex] against upCard. 
+//------------------------------------------------------------------------------
+void setStrat (StrategyTable *chart, int handIndex, int upCard, Strategy strat)
+{
+  int c = STRAT_CELL(handIndex, upCard); 
   
-  //Copy strategies from simple chart on to non-simple hands 
-  for (i = THREES; i <= TENS; i++)
+  chart->action[c] = strat.action; 
+  chart->winPct[c] = strat.winPct; 
+  chart->lossPct[c] = strat.lossPct; 
+  chart->splitEV[c] = strat.splitEV; 
+  chart->surrender[c] = strat.surrender; 
+}
+
+
+//------------------------------------------------------------------------------
+// Copies the strategies for the first nhands hands against upCard from src to 
+// dest. 
+//------------------------------------------------------------------------------
+static void copyStratColumn (StrategyTable *dest, const StrategyTable *src, 
+                    int nhands, int upCard)
+{
+  int i, c; 
+  
+  for (i = 0; i < nhands; i++)
   {
-    doubleHand = hands[i]; 
-    equivHand = makeHand (doubleHand.value, FALSE, FALSE, FALSE); 
-    equivIndex = getHandIndex(equivHand); 
-    
-    for (j = 1; j <= NUM_CARDS; j++)
-      chart[i][j] = chart[equivIndex][j]; 
+    c = STRAT_CELL(i, upCard); 
+    dest->action[c] = src->action[c]; 
+    dest->surrender[c] = src->surrender[c]; 
+    dest->winPct[c] = src->winPct[c]; 
+    dest->lossPct[c] = src->lossPct[c]; 
+    dest->splitEV[c] = src->splitEV[c]; 
+    memcpy(&PLAY_EV(dest, c, 0), &PLAY_EV(src, c, 0), 
+      NUM_PLAY_EVS * sizeof(double)); 
+  }
+}
+
+
+//------------------------------------------------------------------------------
+// Creates the chart for the given rules. If MAKE_SIMPLE_CHART is true, ignores
+// splits and doubles. Allocates nothing once the calling thread has solved a 
+// chart before. 
+//------------------------------------------------------------------------------
+void calculateStrategyChart (StrategyTable *chart, int MAKE_SIMPLE_CHART, 
+                   const Rules *rules)
+{
+  calculateStrategyChartParallel(chart, MAKE_SIMPLE_CHART, rules, 1); 
+}
+
+
+//------------------------------------------------------------------------------
+// Same as calculateStrategyChart, but solves the up cards concurrently on 
+// nthreads threads, the calling thread among them. The hit/stand chart is 
+// solved first, for all up cards at once, on the calling thread (see 
+// solveSimpleChart). The play against one up card never depends on the plays 
+// against the others, so after that each up card is a task of its own 
+// (solveChartColumn), which reads the tables that the calling thread has 
+// filled in for the rules and writes only its own column of the chart and of 
+// the tables. Every cell is found by the same arithmetic on whichever thread 
+// solves it, so the chart is the same for any number of threads. With one 
+// thread, the up cards are solved in turn on the calling thread, and nothing 
+// is allocated once it has solved a chart before. 
+//------------------------------------------------------------------------------
+void calculateStrategyChartParallel (StrategyTable *chart, 
+                          int MAKE_SIMPLE_CHART, const Rules *rules, 
+                          int nthreads)
+{
+  ChartJob job; 
+  int i, upCard; 
+  
+  prepareSolver(rules); 
+  solveSimpleChart(chart, rules); 
+  job.chart = chart; 
+  job.makeSimpleChart = MAKE_SIMPLE_CHART; 
+  job.rules = rules; 
+  
+  if (nthreads <= 1)
+  {
+    for (upCard = 1; upCard <= NUM_CARDS; upCard++)
+      solveChartColumn(&job, upCard); 
   }
-  if (status == EXIT_SUCCESS && !(MAKE_SIMPLE_CHART)) //Note 2 
+  else 
   {
-    //Then, determine when to split or double 
-    for (i = 0; i < NUM_HANDS; i++)
-      for (j = 1; j <= NUM_CARDS; j++)
-        chart[i][j] = splitOrDoubleStrat (chart, i, j);   
+    job.tables = getStratTables(); 
+    job.hitOrder = hitOrder; 
+    job.scratchChart = scratchChart; 
+    job.solverLanes = solverLanes; 
+    parallel_for(NUM_CARDS, nthreads, solveChartColumnTask, &job); 
   }
-  else if (MAKE_SIMPLE_CHART)
+  
+  if (MAKE_SIMPLE_CHART)
   {
     for (i = THREES; i < NUM_HANDS; i++)
       hands[i].isObvious = TRUE; //hide splits 
@@ -70,141 +280,593 @@ void calculateStrategyChart (Strategy **chart, int MAKE_SIMPLE_CHART)
 }
 
 
+//------------------------------------------------------------------------------
+// Task for parallel_for in calculateStrategyChartParallel: solves the column 
+// of up card task + 1. The threads other than the calling one are made for 
+// the call (see parallel_for), so they take over the calling thread's tables 
+// here and have none of their own to lose. 
+//------------------------------------------------------------------------------
+static void solveChartColumnTask (int task, int thread, void *arg)
+{
+  ChartJob *job = (ChartJob *) arg; 
+  
+  useStratTables(job->tables); 
+  hitOrder = job->hitOrder; 
+  scratchChart = job->scratchChart; 
+  solverLanes = job->solverLanes; 
+  solveChartColumn(job, task + 1); 
+}
+
+
+//------------------------------------------------------------------------------
+// Solves the chart of job against upCard, once the hit/stand chart has been: 
+// the pairs copy the hit/stand column from the hard totals that they add up 
+// to, and then, unless only the simple chart is wanted, it finds when to 
+// split or double and when to surrender. 
+//------------------------------------------------------------------------------
+static void solveChartColumn (ChartJob *job, int upCard)
+{
+  StrategyTable *chart = job->chart; 
+  const Rules *rules = job->rules; 
+  const StrategyTable *splitChart; //chart by which the hands after a split 
+                          //are played 
+  Hand equivHand; 
+  int i, equiv; 
+  
+  //Copy strategies from simple chart on to non-simple hands 
+  for (i = THREES; i <= TENS; i++)
+  {
+    equivHand = makeHand (hands[i].value, FALSE, FALSE, FALSE); 
+    equiv = getHandIndex(equivHand); 
+    setStrat(chart, i, upCard, getStrat(chart, equiv, upCard)); 
+    memcpy(&PLAY_EV(chart, STRAT_CELL(i, upCard), 0), 
+      &PLAY_EV(chart, STRAT_CELL(equiv, upCard), 0), 
+      NUM_PLAY_EVS * sizeof(double)); 
+  }
+  
+  //A,10 is a blackjack, which is paid at once rather than played (see 
+  //getEVOfHand) 
+  PLAY_EV(chart, STRAT_CELL(SOFT_TWENTYONE, upCard), PLAY_EV_STAND) 
+    = rules->blackjackPays; 
+  PLAY_EV(chart, STRAT_CELL(SOFT_TWENTYONE, upCard), PLAY_EV_HIT) = NAN; 
+  if (job->makeSimpleChart)
+    return; 
+  
+  //Without doubling after a split, the hands after a split are played by 
+  //the chart as it is before doubles are added 
+  splitChart = chart; 
+  if (!(rules->doubleAfterSplit))
+  {
+    copyStratColumn(scratchChart, chart, NUM_HANDS_SIMPLE, upCard); 
+    splitChart = scratchChart; 
+  }
+  
+  //Then, determine when to split or double 
+  for (i = 0; i < NUM_HANDS; i++)
+    setStrat(chart, i, upCard, splitOrDoubleStrat (chart, splitChart, i, 
+                      upCard, rules, &PLAY_EV(chart, STRAT_CELL(i, upCard), 
+                                      0))); 
+  
+  //and finally when to surrender, once the best play otherwise is known. 
+  //Surrendering is worth half the bet (see getStratEV). 
+  for (i = 0; i < NUM_HANDS; i++)
+    PLAY_EV(chart, STRAT_CELL(i, upCard), PLAY_EV_SURRENDER) 
+      = rules->surrender == SURRENDER_NONE || i == BUST 
+      || i == SOFT_TWENTYONE ? NAN : -.5; 
+  if (rules->surrender != SURRENDER_NONE)
+    for (i = 0; i < NUM_HANDS; i++)
+      chart->surrender[STRAT_CELL(i, upCard)] 
+        = shouldSurrender(getStrat(chart, i, upCard), i, upCard, rules); 
+}
+
+
   
 //------------------------------------------------------------------------------
 // Calculates the strategy chart ignoring splits or doubles. 
 // Note: For all purposes of this function and sub-functions, the only relevant
 // probability is the probability of winning conditioned on the event that it
 // is either a win or a loss - i.e. pushes are ignored. 
+// 
+// Always returns EXIT_SUCCESS; it used to return EXIT_FAILURE when repeated 
+// sweeps over the hands failed to converge. 
 //------------------------------------------------------------------------------
-int calculateSimpleChart (Strategy **chart)
+int calculateSimpleChart (StrategyTable *chart, const Rules *rules)
 { 
-  int status; 
-  Hand hand; 
-  int i, j, upCard; 
-  double hitWinProb, standWinProb; //probabilities of winning the hand if you 
-                        //hit or stand, respectively 
-  double hitLossProb, standLossProb; //same 
+  prepareSolver(rules); 
+  solveSimpleChart(chart, rules); 
+  return EXIT_SUCCESS; 
+}
+
+
+//------------------------------------------------------------------------------
+// Same as calculateSimpleChart, but solves one up card at a time, without the 
+// solver's lanes (see solveSimpleColumn). It makes the same chart to the last 
+// bit, and is kept to check and time the solver against (see benchChart). 
+//------------------------------------------------------------------------------
+int calculateSimpleChartScalar (StrategyTable *chart, const Rules *rules)
+{ 
+  int upCard; 
   
-  int doneCount = 0; //count of number of hands that we have solved for 
-  int COUNT_END = NUM_HANDS_SIMPLE * NUM_CARDS;   //total hands to solve 
+  prepareSolver(rules); 
+  for (upCard = 1; upCard <= NUM_CARDS; upCard++)
+    solveSimpleColumn(chart, rules, upCard); 
   
-  //Flag to ensure an infinite loop isn't created. The flag will be set to true
-  //every time we restart going through all the possible hands, and is set to  
-  //false if at least one possibility is "solved" on that run-through. 
-  int infLoop; 
+  return EXIT_SUCCESS; 
+}
+
+
+//------------------------------------------------------------------------------
+// Gets the calling thread's tables ready to solve a chart for the given rules:
+// they are made the first time it gets here, and filled in again after that. 
+//------------------------------------------------------------------------------
+static void prepareSolver (const Rules *rules)
+{
+  if (hitTransitionMatrix == NULL)
+  {
+    hitTransitionMatrix = allocmatrix(NUM_HANDS_SIMPLE, NUM_HANDS_SIMPLE); 
+    if (hitTransitionMatrix == NULL) 
+      throwMemErr("hitTransitionMatrix", "prepareSolver"); 
+    hitOrder = (int *) malloc(NUM_HANDS_SIMPLE * sizeof(int)); 
+    if (hitOrder == NULL) throwMemErr("hitOrder", "prepareSolver"); 
+    orderHandsForHitting(hitOrder); 
+    scratchChart = newStrategyTable(NUM_HANDS_SIMPLE); 
+    solverLanes = calloc(NUM_LANE_TABLES * NUM_HANDS_SIMPLE, 
+                    sizeof(*solverLanes)); 
+    if (solverLanes == NULL) throwMemErr("solverLanes", "prepareSolver"); 
+  }
+  fillHitTransitionMat (hitTransitionMatrix, rules); 
+  fillSolverLanes(); 
+  
+  numHitStandLevels = rules->charlie ? rules->charlie - 2 : 1; 
+  if (numHitStandLevels > hitStandCapacity)
+  {
+    free(hitStandBuffer); 
+    hitStandBuffer = malloc(numHitStandLevels * NUM_HANDS_SIMPLE 
+                      * sizeof(*hitStandBuffer)); 
+    if (hitStandBuffer == NULL) 
+      throwMemErr("hitStandBuffer", "prepareSolver"); 
+    hitStandCapacity = numHitStandLevels; 
+  }
+  hitStandActions = hitStandBuffer; 
+}
+
+
+//------------------------------------------------------------------------------
+// Fills in the rows of lanes that depend only on the rules, for prepareSolver:
+// the probabilities of winning and losing by standing on each simple hand, 
+// and by doubling on it, which are the sums of getDDWinProb and getDDLossProb 
+// taken in the same order. The padding lanes are left at zero. 
+//------------------------------------------------------------------------------
+static void fillSolverLanes ()
+{
+  double (*standWin)[UP_CARD_LANES] = LANE_TABLE(LANES_STAND_WIN); 
+  double (*standLoss)[UP_CARD_LANES] = LANE_TABLE(LANES_STAND_LOSS); 
+  double (*ddWin)[UP_CARD_LANES] = LANE_TABLE(LANES_DD_WIN); 
+  double (*ddLoss)[UP_CARD_LANES] = LANE_TABLE(LANES_DD_LOSS); 
+  const double *P; 
+  int i, k, upCard; 
 
-  //Boolean matrix indicating which strategies have been solved for: 
-  //entry i,j corresponds to the i,j scenario in chart. 
-  int **isSolved = NULL; 
-  isSolved = (int **) malloc (NUM_HANDS_SIMPLE * sizeof(int *)); 
   for (i = 0; i < NUM_HANDS_SIMPLE; i++)
-    isSolved[i] = (int *) malloc((NUM_CARDS+1)*sizeof(int)); 
-  if (isSolved == NULL) throwMemErr("isSolved", "calculateSimpleChart");  
+    for (upCard = 1; upCard <= NUM_CARDS; upCard++)
+    {
+      standWin[i][upCard] = probOfWinGivenTotal(hands[i].value, upCard); 
+      standLoss[i][upCard] = probOfLossGivenTotal(hands[i].value, upCard); 
+    }
+
   for (i = 0; i < NUM_HANDS_SIMPLE; i++)
-    for (j = 1; j <= NUM_CARDS; j++)
-      isSolved[i][j] = FALSE; 
+  {
+    P = hitTransitionMatrix[i]; 
+    for (upCard = 0; upCard < UP_CARD_LANES; upCard++)
+      ddWin[i][upCard] = ddLoss[i][upCard] = 0.; 
+    for (k = 0; k < NUM_HANDS_SIMPLE; k++)
+      if (P[k] > 0.)
+      {
+        addScaledLanes(ddWin[i], standWin[k], P[k]); 
+        addScaledLanes(ddLoss[i], standLoss[k], P[k]); 
+      }
+  }
+}
 
-  hitTransitionMatrix = makeHitTransitionMat (); 
-    
-  //Make bust row 
-  for (j = 1; j <= NUM_CARDS; j++)
+
+//------------------------------------------------------------------------------
+// Adds p times x to sum, lane by lane, for a row of lanes: the inner loop of 
+// the solver. Each lane gets the same multiplication and addition that it 
+// would get on its own, so every path gives the same sums to the last bit: 
+// AVX when the compiler targets it (e.g. with -mavx), SSE2, which every 
+// x86-64 has, and otherwise a plain loop. 
+//------------------------------------------------------------------------------
+static void addScaledLanes (double *sum, const double *x, double p)
+{
+#if defined(__AVX__)
+  __m256d vp = _mm256_set1_pd(p); 
+  int u; 
+  
+  for (u = 0; u < UP_CARD_LANES; u += 4)
+    _mm256_storeu_pd(sum + u, _mm256_add_pd(_mm256_loadu_pd(sum + u), 
+      _mm256_mul_pd(vp, _mm256_loadu_pd(x + u)))); 
+#elif defined(__SSE2__)
+  __m128d vp = _mm_set1_pd(p); 
+  int u; 
+  
+  for (u = 0; u < UP_CARD_LANES; u += 2)
+    _mm_storeu_pd(sum + u, _mm_add_pd(_mm_loadu_pd(sum + u), 
+      _mm_mul_pd(vp, _mm_loadu_pd(x + u)))); 
+#else
+  int u; 
+  
+  for (u = 0; u < UP_CARD_LANES; u++)
+    sum[u] += p * x[u]; 
+#endif
+}
+
+
+//------------------------------------------------------------------------------
+// Solves whether to hit or stand on each simple hand against every up card at 
+// once, for calculateSimpleChart, by the same arithmetic as solveSimpleColumn 
+// does for one up card: the probabilities of winning and losing are kept in 
+// rows of lanes, so that each hand's are summed from the hands that hitting it
+// can lead to a row at a time. 
+// 
+// Each hand is solved exactly once, after every hand that hitting it can lead 
+// to (see orderHandsForHitting). With a Charlie, the hands are solved once 
+// for each number of cards, from one less than the Charlie down to two, and 
+// the rows with one more card are kept in the LANES_AFTER tables. 
+//------------------------------------------------------------------------------
+static void solveSimpleChart (StrategyTable *chart, const Rules *rules)
+{ 
+  double (*win)[UP_CARD_LANES] = LANE_TABLE(LANES_WIN); 
+  double (*loss)[UP_CARD_LANES] = LANE_TABLE(LANES_LOSS); 
+  double (*afterWin)[UP_CARD_LANES] = LANE_TABLE(LANES_AFTER_WIN); 
+  double (*afterLoss)[UP_CARD_LANES] = LANE_TABLE(LANES_AFTER_LOSS); 
+  double (*swap)[UP_CARD_LANES]; 
+  int i, k, u, n, ncards; 
+
+  if (!(rules->charlie))
   {
-    chart[BUST][j].action = STAND; 
-    chart[BUST][j].winPct = 0.; 
-    chart[BUST][j].lossPct = 1.; 
-    isSolved[BUST][j] = TRUE; 
-    doneCount++; 
+    for (n = 0; n < NUM_HANDS_SIMPLE; n++)
+      solveHitOrStandLanes(chart, win, loss, win, loss, hitOrder[n], 0); 
+    return; 
   }
   
-  do 
+  //A hand with as many cards as the Charlie has won, unless it has busted 
+  for (k = 0; k < NUM_HANDS_SIMPLE; k++)
+    for (u = 0; u < UP_CARD_LANES; u++)
+    {
+      afterWin[k][u] = k == BUST ? 0. : 1.; 
+      afterLoss[k][u] = k == BUST ? 1. : 0.; 
+    }
+  
+  for (ncards = rules->charlie - 1; ncards >= 2; ncards--)
   {
-    infLoop = TRUE; 
+    for (i = 0; i < NUM_HANDS_SIMPLE; i++)
+      solveHitOrStandLanes(chart, win, loss, afterWin, afterLoss, i, 
+        ncards - 2); 
+    swap = afterWin; 
+    afterWin = win; 
+    win = swap; 
+    swap = afterLoss; 
+    afterLoss = loss; 
+    loss = swap; 
+  }
+}
+
+
+//------------------------------------------------------------------------------
+// Finds whether to hit or stand on hands[i] against every up card, as 
+// solveHitOrStand does against one, and stores the strategies in chart, in 
+// the rows of win and loss and in level of hitStandActions. afterWin and 
+// afterLoss hold the rows of the hands that hitting can lead to, and may be 
+// win and loss themselves. 
+//------------------------------------------------------------------------------
+static void solveHitOrStandLanes (StrategyTable *chart, 
+                        double (*win)[UP_CARD_LANES], 
+                        double (*loss)[UP_CARD_LANES], 
+                        double (*afterWin)[UP_CARD_LANES], 
+                        double (*afterLoss)[UP_CARD_LANES], int i, 
+                        int level)
+{
+  const double *P = hitTransitionMatrix[i]; 
+  const double *standWin = LANE_TABLE(LANES_STAND_WIN)[i]; 
+  const double *standLoss = LANE_TABLE(LANES_STAND_LOSS)[i]; 
+  double hitWin[UP_CARD_LANES], hitLoss[UP_CARD_LANES]; 
+  int k, u, c; 
+  
+  for (u = 0; u < UP_CARD_LANES; u++)
+    hitWin[u] = hitLoss[u] = 0.; 
+  if (i != BUST)
+    for (k = 0; k < NUM_HANDS_SIMPLE; k++)
+      if (P[k] > 0.)
+      {
+        addScaledLanes(hitWin, afterWin[k], P[k]); 
+        addScaledLanes(hitLoss, afterLoss[k], P[k]); 
+      }
   
-    for (i = NUM_HANDS_SIMPLE - 1; i >= 0; i--) //NOTE 3 
+  for (u = 1; u <= NUM_CARDS; u++)
+  {
+    c = STRAT_CELL(i, u); 
+    chart->splitEV[c] = 0.; 
+    chart->surrender[c] = FALSE; 
+    if (i == BUST)
     {
-      if (i == BUST) //already solved bust above 
-        continue; 
-    
-      hand = hands[i]; 
-      
-      for (upCard = NUM_CARDS; upCard >= 1; upCard--)
+      chart->action[c] = STAND; 
+      chart->winPct[c] = 0.; 
+      chart->lossPct[c] = 1.; 
+      setHitStandEVs(chart, c, -1., NAN); 
+    }
+    else 
+    {
+      if (shouldHit(hitWin[u], hitLoss[u], standWin[u], standLoss[u])) 
       {
-        if (!(isSolved[i][upCard])) //skip strats that are already solved 
-        {
-          standWinProb = probOfWinGivenTotal (hand.value, upCard); 
-          standLossProb = probOfLossGivenTotal (hand.value, upCard); 
-          
-          //Compute probability of winning and losing if you hit 
-          hitWinProb = getHitWinProb (chart, isSolved, i, upCard);
-          hitLossProb = getHitLossProb (chart, isSolved, i, upCard); 
-          
-          //If getHitWinProb was successful, hitWinProb will not equal -1. 
-          if (hitWinProb >= 0.) 
-          {
-            //This condition should be impossible - just checking to make 
-            //sure. 
-            if (hitLossProb < 0.)
-              throwErr("getHitWinProb exited successfully, but "
-                "getHitLossProb did not.", "calculateSimpleChart"); 
-          
-            if (shouldHit(hitWinProb, hitLossProb, 
-              standWinProb, standLossProb)) 
-            {
-              chart[i][upCard].action = HIT; 
-              chart[i][upCard].winPct = hitWinProb; 
-              chart[i][upCard].lossPct = hitLossProb; 
-            }
-            else 
-            {
-              chart[i][upCard].action = STAND; 
-              chart[i][upCard].winPct = standWinProb; 
-              chart[i][upCard].lossPct = standLossProb; 
-            }
-            
-            doneCount++; 
-            infLoop = FALSE; 
-            isSolved[i][upCard] = TRUE; 
-          }
-          
-          //If it is not a success, continue iterating through the 
-          //possibilities. 
-        }
+        chart->action[c] = HIT; 
+        chart->winPct[c] = hitWin[u]; 
+        chart->lossPct[c] = hitLoss[u]; 
       }
+      else 
+      {
+        chart->action[c] = STAND; 
+        chart->winPct[c] = standWin[u]; 
+        chart->lossPct[c] = standLoss[u]; 
+      }
+      setHitStandEVs(chart, c, standWin[u] - standLoss[u], 
+        hitWin[u] - hitLoss[u]); 
     }
+    win[i][u] = chart->winPct[c]; 
+    loss[i][u] = chart->lossPct[c]; 
+    hitStandActions[level * NUM_HANDS_SIMPLE + i][u] = chart->action[c]; 
   }
-  while (doneCount < COUNT_END && !(infLoop)); 
+}
+
 
-  //If it doesn't converge, replace every non-converged scenario with "double 
-  //down", which serves as a flag for debugging. 
-  if (infLoop)
+//------------------------------------------------------------------------------
+// Solves whether to hit or stand on each simple hand against upCard, for 
+// calculateSimpleChartScalar. 
+// 
+// Each hand is solved exactly once, after every hand that hitting it can lead 
+// to (see orderHandsForHitting), so the probabilities of winning and losing by
+// hitting are always available. 
+// 
+// With a Charlie, the best play also depends on the number of cards in the 
+// hand, so the hands are solved once for each number of cards, from one less 
+// than the Charlie (where hitting without busting wins) down to two, which 
+// goes in the chart. The strategies with one more card are kept in the 
+// column of scratchChart. 
+//------------------------------------------------------------------------------
+static void solveSimpleColumn (StrategyTable *chart, const Rules *rules, 
+                      int upCard)
+{ 
+  int i, k, n, ncards; 
+  StrategyTable *after; //strategies with one more card, for a Charlie 
+
+  if (!(rules->charlie))
+  {
+    for (n = 0; n < NUM_HANDS_SIMPLE; n++)
+    {
+      i = hitOrder[n]; 
+      solveHitOrStand(chart, chart, i, upCard); 
+      hitStandActions[i][upCard] = chart->action[STRAT_CELL(i, upCard)]; 
+    }
+    return; 
+  }
+  
+  //A hand with as many cards as the Charlie has won, unless it has busted 
+  after = scratchChart; 
+  for (k = 0; k < NUM_HANDS_SIMPLE; k++)
+  {
+    after->winPct[STRAT_CELL(k, upCard)] = k == BUST ? 0. : 1.; 
+    after->lossPct[STRAT_CELL(k, upCard)] = k == BUST ? 1. : 0.; 
+  }
+  
+  for (ncards = rules->charlie - 1; ncards >= 2; ncards--)
   {
-    status = EXIT_FAILURE; 
-    warning("Infinite loop created - method failed to converge.", 
-          "calculateSimpleChart"); 
-    
     for (i = 0; i < NUM_HANDS_SIMPLE; i++)
     {
-      for (j = 1; j <= NUM_HANDS; j++)
-      {
-        if (!(isSolved[i][j]))
-        {
-          chart[i][j].action = DOUBLE_DOWN; 
-          chart[i][j].winPct = 0.; 
-          chart[i][j].lossPct = 0.; 
-        }
-      }
+      solveHitOrStand(chart, after, i, upCard); 
+      hitStandActions[(ncards - 2) * NUM_HANDS_SIMPLE + i][upCard] 
+        = chart->action[STRAT_CELL(i, upCard)]; 
     }
+    copyStratColumn(after, chart, NUM_HANDS_SIMPLE, upCard); 
   }
-  else
-    status = EXIT_SUCCESS; 
+}
+
+
+//------------------------------------------------------------------------------
+// Finds whether to hit or stand on hands[i] against upCard, and stores the 
+// strategy in chart. after holds the strategies of the hands that hitting can 
+// lead to, whose probabilities of winning and losing are read in place. 
+//------------------------------------------------------------------------------
+static void solveHitOrStand (StrategyTable *chart, const StrategyTable *after, 
+                    int i, int upCard)
+{
+  int c = STRAT_CELL(i, upCard); 
+  double hitWinProb, standWinProb; //probabilities of winning the hand if you 
+                        //hit or stand, respectively 
+  double hitLossProb, standLossProb; //same 
+  double p; 
+  int k; 
+  
+  chart->splitEV[c] = 0.; 
+  chart->surrender[c] = FALSE; 
+  if (i == BUST)
+  {
+    chart->action[c] = STAND; 
+    chart->winPct[c] = 0.; 
+    chart->lossPct[c] = 1.; 
+    setHitStandEVs(chart, c, -1., NAN); 
+    return; 
+  }
+  
+  standWinProb = probOfWinGivenTotal (hands[i].value, upCard); 
+  standLossProb = probOfLossGivenTotal (hands[i].value, upCard); 
+  
+  //Probabilities of winning and losing if you hit, from the hands that 
+  //hitting can lead to, all of which have been solved 
+  hitWinProb = 0.; 
+  hitLossProb = 0.; 
+  for (k = 0; k < NUM_HANDS_SIMPLE; k++)
+  {
+    p = hitTransitionMatrix[i][k]; 
+    if (p > 0.)
+    {
+      hitWinProb += p * after->winPct[STRAT_CELL(k, upCard)]; 
+      hitLossProb += p * after->lossPct[STRAT_CELL(k, upCard)]; 
+    }
+  }
+  
+  if (shouldHit(hitWinProb, hitLossProb, standWinProb, standLossProb)) 
+  {
+    chart->action[c] = HIT; 
+    chart->winPct[c] = hitWinProb; 
+    chart->lossPct[c] = hitLossProb; 
+  }
+  else 
+  {
+    chart->action[c] = STAND; 
+    chart->winPct[c] = standWinProb; 
+    chart->lossPct[c] = standLossProb; 
+  }
+  setHitStandEVs(chart, c, standWinProb - standLossProb, 
+    hitWinProb - hitLossProb); 
+}
 
-  for (i = 0; i < NUM_HANDS_SIMPLE; i++) {
-		free(isSolved[i]);
-	}
-	free(isSolved);
 
-  return status; 
+//------------------------------------------------------------------------------
+// Stores the expected values of standing and hitting in cell c of chart, 
+// found while solving the hit/stand chart, where the other plays are not 
+// known yet. 
+//------------------------------------------------------------------------------
+static void setHitStandEVs (StrategyTable *chart, int c, double standEV, 
+                   double hitEV)
+{
+  PLAY_EV(chart, c, PLAY_EV_STAND) = standEV; 
+  PLAY_EV(chart, c, PLAY_EV_HIT) = hitEV; 
+  PLAY_EV(chart, c, PLAY_EV_DOUBLE) = NAN; 
+  PLAY_EV(chart, c, PLAY_EV_SPLIT) = NAN; 
+  PLAY_EV(chart, c, PLAY_EV_SURRENDER) = NAN; 
+}
+
+
+//------------------------------------------------------------------------------
+// Returns whether to hit or stand (HIT or STAND) on hands[handIndex], holding 
+// ncards cards, against upCard when the player may not double, split or 
+// surrender: after hitting, or on a hand after a split that may not be 
+// doubled. Comes from the chart last made by calculateSimpleChart. A pair is 
+// played like the hard total it adds up to. 
+//------------------------------------------------------------------------------
+int getHitStandAction (int handIndex, int ncards, int upCard)
+{
+  int level = ncards - 2; 
+  
+  if (level >= numHitStandLevels) //only with a Charlie, which has won 
+    level = numHitStandLevels - 1; 
+  if (handIndex >= NUM_HANDS_SIMPLE)
+    handIndex = getHandIndex(makeHand(hands[handIndex].value, FALSE, FALSE, 
+                                  FALSE)); 
+  
+  return hitStandActions[level * NUM_HANDS_SIMPLE + handIndex][upCard]; 
+}
+
+
+//------------------------------------------------------------------------------
+// Returns the tables that the calling thread's chart was solved with, which a 
+// thread that plays by the chart, but did not solve it, must take over with 
+// useStratTables. 
+//------------------------------------------------------------------------------
+StratTables getStratTables ()
+{
+  StratTables tables; 
+  
+  tables.dealersProbabilities = dealersProbabilities; 
+  tables.hitTransitionMatrix = hitTransitionMatrix; 
+  tables.hitStandActions = hitStandActions; 
+  tables.numHitStandLevels = numHitStandLevels; 
+  return tables; 
+}
+
+
+//------------------------------------------------------------------------------
+// Makes the calling thread read the tables of a chart solved on another thread
+// (from getStratTables). They still belong to that thread, and the calling 
+// thread must not solve a chart of its own, or call freeStratTables, before it
+// stops using them. 
+//------------------------------------------------------------------------------
+void useStratTables (StratTables tables)
+{
+  dealersProbabilities = tables.dealersProbabilities; 
+  hitTransitionMatrix = tables.hitTransitionMatrix; 
+  hitStandActions = tables.hitStandActions; 
+  numHitStandLevels = tables.numHitStandLevels; 
+}
+
+
+//------------------------------------------------------------------------------
+// Frees the tables made by calculateSimpleChart on the calling thread, which 
+// would otherwise be kept for the next chart it solves. dealersProbabilities 
+// belongs to the caller and is left alone. 
+//------------------------------------------------------------------------------
+void freeStratTables ()
+{
+  if (hitTransitionMatrix != NULL)
+    freematrix(hitTransitionMatrix, NUM_HANDS_SIMPLE); 
+  hitTransitionMatrix = NULL; 
+  free(hitStandBuffer); 
+  hitStandBuffer = NULL; 
+  hitStandCapacity = 0; 
+  hitStandActions = NULL; 
+  numHitStandLevels = 0; 
+  free(hitOrder); 
+  hitOrder = NULL; 
+  freeStrategyTable(scratchChart); 
+  scratchChart = NULL; 
+  free(solverLanes); 
+  solverLanes = NULL; 
+}
+
+
+//------------------------------------------------------------------------------
+// Fills order with the indices of the simple hands, arranged so that every hand
+// comes after all of the hands that hitting it can lead to (a reverse 
+// topological order of the hit transition matrix, found by depth-first 
+// search). Hitting can never lead back to the same hand, since it either adds 
+// to the value or uses up the ace counted as 11. 
+//------------------------------------------------------------------------------
+static void orderHandsForHitting (int *order)
+{
+  int *state = NULL; //0 if not yet visited, 1 while visiting, 2 once ordered 
+  int i, n = 0; 
+  
+  state = (int *) calloc(NUM_HANDS_SIMPLE, sizeof(int)); 
+  if (state == NULL) throwMemErr("state", "orderHandsForHitting"); 
+  
+  for (i = 0; i < NUM_HANDS_SIMPLE; i++)
+    if (state[i] == 0)
+      visitHandForHitting(i, state, order, &n); 
+  
+  free(state); 
+}
+
+
+//------------------------------------------------------------------------------
+// Adds hand i to order, at position *n, after every hand that hitting it can 
+// lead to; for orderHandsForHitting. 
+//------------------------------------------------------------------------------
+static void visitHandForHitting (int i, int *state, int *order, int *n)
+{
+  int k; 
+  
+  state[i] = 1; 
+  if (i != BUST) //bust is final 
+  {
+    for (k = 1; k <= NUM_CARDS; k++)
+    {
+      if (state[handAfterCard[i][k]] == 1)
+        throwErr("Hitting can lead back to the same hand.", 
+          "orderHandsForHitting"); 
+      if (state[handAfterCard[i][k]] == 0)
+        visitHandForHitting(handAfterCard[i][k], state, order, n); 
+    }
+  }
+  state[i] = 2; 
+  order[(*n)++] = i; 
 }
 
 
@@ -256,26 +918,14 @@ double probOfWinIgnorePushes (int yourValue, int upCard)
 // Computes the probability that you will win the hand, given the total ending
 // value of your hand and the dealer's up card. Note: This gives the conditional
 // probabilities given that neither the player nor the dealer has blackjack. 
-// This does not include the probability of a push. 
+// This does not include the probability of a push. It is looked up in the 
+// row of dealersProbabilities (see fillStandTables). 
 //------------------------------------------------------------------------------
 double probOfWinGivenTotal (int yourValue, int upCard)
 {
-  double prob; 
-  const int DEALERS_MIN = 17; //dealer always ends up with at least 17 
-  int i; 
-
-  if (yourValue > 21)
-    prob = 0.; 
-  else if (yourValue <= DEALERS_MIN) 
-    prob = dealersProbabilities[upCard][BUST_VALUE]; //win iff dealer busts
-  else //win iff dealer busts or your total is higher 
-  {
-    prob = dealersProbabilities[upCard][BUST_VALUE]; 
-    for (i = DEALERS_MIN; i < yourValue; i++)
-      prob += dealersProbabilities[upCard][i]; 
-  }  
-  
-  return prob; 
+  if (yourValue > BUST_VALUE)
+    yourValue = BUST_VALUE; 
+  return dealersProbabilities[upCard][DEALER_WIN_TABLE + yourValue]; 
 }
 
 
@@ -288,32 +938,58 @@ double probOfWinGivenTotal (int yourValue, int upCard)
 //------------------------------------------------------------------------------
 double probOfLossGivenTotal (int yourValue, int upCard)
 {
-  const int DEALERS_MIN = 17; //dealer always ends up with at least 17 
-  int i; 
-  double prob = 0.; 
-  
-  if (yourValue > 21)
-    prob = 1.; 
-  else
-  { 
-    for (i = maxi(yourValue + 1, DEALERS_MIN); i <= 21; i++)
-      prob += dealersProbabilities[upCard][i]; 
-  }
+  if (yourValue > BUST_VALUE)
+    yourValue = BUST_VALUE; 
+  return dealersProbabilities[upCard][DEALER_LOSS_TABLE + yourValue]; 
+}
+
+
+
+//------------------------------------------------------------------------------
+// Probability that the hand will be a push, given the total ending value of 
+// your hand and the dealer's up card. 
+//------------------------------------------------------------------------------
+double probOfPushGivenTotal (int yourValue, int upCard)
+{
+  return 1. - probOfWinGivenTotal(yourValue, upCard) 
+        - probOfLossGivenTotal(yourValue, upCard); 
   
-  return prob; 
 }
 
 
 
 //------------------------------------------------------------------------------
-// Probability that the hand will be a push, given the total ending value of 
-// your hand and the dealer's up card. 
+// Returns the probabilities of winning by standing on each total 0-22 against 
+// upCard, as probOfWinGivenTotal gives them, indexed by total. They lie in 
+// dealersProbabilities and are good for as long as it is. 
+//------------------------------------------------------------------------------
+const double * getStandWinProbs (int upCard)
+{
+  return dealersProbabilities[upCard] + DEALER_WIN_TABLE; 
+}
+
+
+//------------------------------------------------------------------------------
+// Like getStandWinProbs but for a loss. 
+//------------------------------------------------------------------------------
+const double * getStandLossProbs (int upCard)
+{
+  return dealersProbabilities[upCard] + DEALER_LOSS_TABLE; 
+}
+
+
+//------------------------------------------------------------------------------
+// Fills ev[v] for each total v = 0-22 with the expected value of standing on 
+// v against upCard, the probability of winning less that of losing. 
 //------------------------------------------------------------------------------
-double probOfPushGivenTotal (int yourValue, int upCard)
+void getStandEVs (int upCard, double *ev)
 {
-  return 1. - probOfWinGivenTotal(yourValue, upCard) 
-        - probOfLossGivenTotal(yourValue, upCard); 
-  
+  const double *win = getStandWinProbs(upCard); 
+  const double *loss = getStandLossProbs(upCard); 
+  int v; 
+
+  for (v = 0; v < DEALER_TOTALS; v++)
+    ev[v] = win[v] - loss[v]; 
 }
 
 
@@ -323,34 +999,22 @@ double probOfPushGivenTotal (int yourValue, int upCard)
 // probability is given by the dot product of the row of the transition matrix
 // corresponding to the player's hand and the vector of probabilities of winning
 // given each hand his hand could transform to after the hit. 
-// This is the dot product of P[handIndex] and the winPct's of chart[:][upCard].
+// This is the dot product of P[handIndex] and the winPct's of the hands 
+// against upCard, which are read from the chart in place. 
 // 
 // The hit transition matrix is the transition matrix of moving from 
-// the current hand to another if the player hits on the current hand. 
-// 
-// Note: If the chart is not complete enough for this to be computed, it returns
-// an error code of -1. 
+// the current hand to another if the player hits on the current hand. Every 
+// hand that hitting can lead to must have been solved. 
 //------------------------------------------------------------------------------
-double getHitWinProb (Strategy **chart, int **isSolved, int handIndex, 
-              int upCard)
+double getHitWinProb (const StrategyTable *chart, int handIndex, int upCard)
 {
-  double *winProbsByHand = getWinProbsByHand(chart, upCard, isSolved); 
+  const double *P = hitTransitionMatrix[handIndex]; 
+  double p = 0.; 
   int i; 
-  const double ERR_CODE = -1.; 
-  double p; 
   
-  //Check to see if the problem is solvable 
   for (i = 0; i < NUM_HANDS_SIMPLE; i++)
-  {
-    if (hitTransitionMatrix[handIndex][i] > 0. && !(isSolved[i][upCard])) {
-  		free(winProbsByHand); 
-      return ERR_CODE; 
-		}
-  }
-  
-  p = dot_ignore_undef (hitTransitionMatrix[handIndex], winProbsByHand, 
-	                      NUM_HANDS_SIMPLE); 
-  free(winProbsByHand); 
+    if (P[i] > 0.)
+      p += P[i] * chart->winPct[STRAT_CELL(i, upCard)]; 
   
   return p; 
 }
@@ -359,26 +1023,15 @@ double getHitWinProb (Strategy **chart, int **isSolved, int handIndex,
 //------------------------------------------------------------------------------
 // Same as getHitWinProb, but probability of loss. 
 //------------------------------------------------------------------------------
-double getHitLossProb (Strategy **chart, int **isSolved, int handIndex, 
-                int upCard)
+double getHitLossProb (const StrategyTable *chart, int handIndex, int upCard)
 {
-  double *lossProbsByHand = getLossProbsByHand(chart, upCard, isSolved); 
+  const double *P = hitTransitionMatrix[handIndex]; 
+  double p = 0.; 
   int i; 
-  const double ERR_CODE = -1.; 
-  double p; 
   
-  //Check to see if the problem is solvable 
   for (i = 0; i < NUM_HANDS_SIMPLE; i++)
-  {
-    if (hitTransitionMatrix[handIndex][i] > 0. && !(isSolved[i][upCard])) {
-  		free(lossProbsByHand); 
-      return ERR_CODE; 
-		}
-  }
-  
-  p = dot_ignore_undef (hitTransitionMatrix[handIndex], lossProbsByHand, 
-	                      NUM_HANDS_SIMPLE); 
-  free(lossProbsByHand); 
+    if (P[i] > 0.)
+      p += P[i] * chart->lossPct[STRAT_CELL(i, upCard)]; 
   
   return p; 
 }
@@ -386,57 +1039,87 @@ double getHitLossProb (Strategy **chart, int **isSolved, int handIndex,
 
 //------------------------------------------------------------------------------
 // Returns the player's expected value of a hand if he splits his cards on the 
-// hand. 
+// hand, playing the hands after the split by chart, and resplitting as the 
+// rules allow (see evaluateSplit). Split aces are only stood on if the rules 
+// don't let them be hit. 
 //------------------------------------------------------------------------------
-double getSplitEV (Strategy **chart, int splitCard, int upCard)
+double getSplitEV (const StrategyTable *chart, int splitCard, int upCard, 
+              const Rules *rules)
 {
-  double ev, p_hand, ev_hand; 
-  int i; 
+  SplitHandValue value; 
   Strategy strat; 
-
-  //Distribution of what the "starting hand" will be - i.e. the hand consisting
-  //of one of the two original split cards and the first new card that is 
-  //dealt to it. 
-  double *startingHandDistrib = distribOfHands (splitCard, FALSE); 
-  
-  //index of the hand that you would split - the hand consisting of two 
-  //of "splitCard"
-  int splittableHandIndex = getHandIndex(getHandByCards(splitCard, splitCard,
-                                      FALSE)); 
-
-// These equations give the expected value of *each* newly split hand:   
-// ev = p_hand1 * ev_hand1 + p_hand1 * ev_hand1 + ... + p_same * 2 * ev 
-// ev = (p_hand1 * ev_hand1 + ... ) / (1 - 2 * p_same) 
-  ev = 0.; 
-  
-  for (i = 0; i < NUM_HANDS_SIMPLE; i++)
+  double p_card; 
+  int i, newCard, unsplit; 
+  int standOnly = splitCard == 1 && !(rules->hitSplitAces); 
+
+  //The new hands that are not the same pair again: the "starting hand" of 
+  //one of the two original split cards and the first new card dealt to it 
+  value.ev = value.win = value.loss = 0.; 
+  for (newCard = 1; newCard <= NUM_CARDS; newCard++)
   {
-    if (hands[i].isSplittable) //skip 2,2 and A,A 
+    p_card = rules->cardProbs[newCard]; 
+    if (newCard == splitCard || p_card == 0.)
       continue; 
-  
-    //Add the probability of getting hand i times the expected value of 
-    //hand i 
-    p_hand = startingHandDistrib[i]; 
-    
-    strat = chart[i][upCard]; 
-    ev_hand = strat.winPct - strat.lossPct; 
-    
-    //If the strategy is to double down, expected value is multiplied by two. 
-    //(This is true for splits as well of course, but that doesn't apply here
-    //because a splittable hand cannot become another splittable hand. 
-    if (strat.action == DOUBLE_DOWN)
-      ev_hand *= 2.; 
+    i = handByCards[splitCard][newCard]; 
+    strat = getStrat(chart, i, upCard); 
+    if (standOnly)
+    {
+      strat.action = STAND; 
+      strat.winPct = probOfWinGivenTotal(hands[i].value, upCard); 
+      strat.lossPct = probOfLossGivenTotal(hands[i].value, upCard); 
+    }
     
-    ev += p_hand * ev_hand; 
+    //(If the strategy is to double down, getStratEV multiplies by two. A 
+    //splittable hand cannot become another splittable hand, so the chart 
+    //never says to split here.) 
+    value.ev += p_card * getStratEV(strat); 
+    value.win += p_card * strat.winPct; 
+    value.loss += p_card * strat.lossPct; 
   }
-    
-  ev /= 1. - 2. * startingHandDistrib[splittableHandIndex]; 
-
-  //Multiply by two: what we have until now is the exp. val of *each* split hand
-  ev *= 2.; 
+  value.pairProb = rules->cardProbs[splitCard]; 
   
-	free(startingHandDistrib); 
-  return ev; 
+  //A pair that may not be split again is played like its total 
+  unsplit = getUnsplitIndex(splitCard); 
+  strat = getStrat(chart, unsplit, upCard); 
+  if (standOnly)
+  {
+    strat.action = STAND; 
+    strat.winPct = probOfWinGivenTotal(hands[unsplit].value, upCard); 
+    strat.lossPct = probOfLossGivenTotal(hands[unsplit].value, upCard); 
+  }
+  value.pairEV = getStratEV(strat); 
+  value.pairWin = strat.winPct; 
+  value.pairLoss = strat.lossPct; 
+  
+  return evaluateSplit(getMaxSplitHands(splitCard, rules), 0, 
+                 getInfiniteSplitValue, &value).ev; 
+}
+
+
+//------------------------------------------------------------------------------
+// SplitHandFn for getSplitEV: in an infinite shoe a hand after a split is 
+// worth the same however many cards of the split rank are out, so arg is the 
+// value. 
+//------------------------------------------------------------------------------
+static void getInfiniteSplitValue (int removed, int isPair, 
+                          SplitHandValue *value, void *arg)
+{
+  *value = *(const SplitHandValue *) arg; 
+}
+
+
+//------------------------------------------------------------------------------
+// Returns the index of the simple hand by which a pair of splitCard is played 
+// when it may not be split again. 
+//------------------------------------------------------------------------------
+int getUnsplitIndex (int splitCard)
+{
+  if (splitCard == 1)
+    return SOFT_TWELVE; 
+  else if (splitCard == 2)
+    return FOUR; 
+  else 
+    return getHandIndex(makeHand(2 * splitCard, FALSE, FALSE, FALSE)); 
 }
 
 
@@ -446,127 +1129,113 @@ double getSplitEV (Strategy **chart, int splitCard, int upCard)
 // hands H, then this is the probability of winning hand H. splitCard is the 
 // card that was split - i.e., the original hand was two cards both of type 
 // splitCard. 
+// 
+// H is the first of the hands. Another card of the split rank dealt to it 
+// starts a new hand, and H is dealt again, as long as the rules allow more 
+// hands; after that, it leaves a pair, played as in getSplitEV. So this is 
+// the probability that the new hand resulting from one 8, say, will win given
+// that it is not a pair, which is:
+// winpct = (p_card1 * pwin_hand1 + p_card2 * pwin_hand2 + ...) / (1 - p_same)
+// weighted with the probability of winning the pair by the probability that 
+// H ends up a pair (see getFirstHandPairProb). This is what the simulations 
+// of a split play out (see simulateHand). 
 //------------------------------------------------------------------------------
-double getSplitWinProb (Strategy **chart, int splitCard, int upCard, int **isSolved)
+double getSplitWinProb (const StrategyTable *chart, int splitCard, int upCard,
+                  const Rules *rules)
 {
-  double *winProbsByHand = getWinProbsByHand(chart, upCard, isSolved); 
-  double p; 
-  int i; 
-
-  //index of the hand consisting of two of "splitCard" 
-  int splitHandIndex = getHandIndex(getHandByCards(splitCard,splitCard,FALSE));
+  double p = 0., q, pair; 
+  int i, newCard; 
+  int standOnly = splitCard == 1 && !(rules->hitSplitAces); 
 
-  //Distribution of what the "starting hand" will be - i.e. the hand consisting
-  //of one of the two original split cards and the first new card that is 
-  //dealt to it. 
-  double *startingHandDistrib = distribOfHands (splitCard, FALSE); 
-
-  //probability that the next hand will be the same as the original hand - i.e.
-  //that a third card of type splitCard will be dealt. 
-  double sameProb = startingHandDistrib[splitHandIndex]; 
-  
-  startingHandDistrib[splitHandIndex] = 0.;   
-  for (i = 0; i < NUM_HANDS; i++)
-    startingHandDistrib[i] /= 1. - sameProb; 
-    
-  //This is technically the probability of winning each split hand given that 
-  //the split hand does not become the original hand. E.g., if splitCard = 8,
-  //it is the probability that the new hand resulting from one 8 will win 
-  //given that the next hand dealt to the new hand is *not* another 8. The 
-  //formula is: 
-  //winpct = (p_hand1 * pwin_hand1 + p_hand2 * pwin_hand2 + ...) / (1 - p_same)
-  p = dot (startingHandDistrib, winProbsByHand, NUM_HANDS_SIMPLE);
+  for (newCard = 1; newCard <= NUM_CARDS; newCard++)
+  {
+    if (newCard == splitCard || rules->cardProbs[newCard] == 0.)
+      continue; 
+    i = handByCards[splitCard][newCard]; 
     
-  free(winProbsByHand); 
-  free(startingHandDistrib); 
-  
-  return p; 
+    //Split aces that may not be hit are stood on 
+    p += rules->cardProbs[newCard] * (standOnly 
+      ? probOfWinGivenTotal(hands[i].value, upCard) 
+      : chart->winPct[STRAT_CELL(i, upCard)]); 
+  }
+  p /= 1. - rules->cardProbs[splitCard]; 
+  
+  q = getFirstHandPairProb(splitCard, rules); 
+  if (q == 0.)
+    return p; 
+  i = getUnsplitIndex(splitCard); 
+  pair = standOnly ? probOfWinGivenTotal(hands[i].value, upCard) 
+    : chart->winPct[STRAT_CELL(i, upCard)]; 
+  return (1. - q) * p + q * pair; 
 }
 
 
 //------------------------------------------------------------------------------
 // Like getSplitWinProb but for a loss. 
 //------------------------------------------------------------------------------
-double getSplitLossProb (Strategy **chart, int splitCard, int upCard, int **isSolved)
+double getSplitLossProb (const StrategyTable *chart, int splitCard, 
+                  int upCard, const Rules *rules)
 {
-  double *lossProbsByHand = getLossProbsByHand(chart, upCard, isSolved); 
-  double p; 
-  int i; 
+  double p = 0., q, pair; 
+  int i, newCard; 
+  int standOnly = splitCard == 1 && !(rules->hitSplitAces); 
+
+  for (newCard = 1; newCard <= NUM_CARDS; newCard++)
+  {
+    if (newCard == splitCard || rules->cardProbs[newCard] == 0.)
+      continue; 
+    i = handByCards[splitCard][newCard]; 
+    
+    //Split aces that may not be hit are stood on 
+    p += rules->cardProbs[newCard] * (standOnly 
+      ? probOfLossGivenTotal(hands[i].value, upCard) 
+      : chart->lossPct[STRAT_CELL(i, upCard)]); 
+  }
+  p /= 1. - rules->cardProbs[splitCard]; 
+  
+  q = getFirstHandPairProb(splitCard, rules); 
+  if (q == 0.)
+    return p; 
+  i = getUnsplitIndex(splitCard); 
+  pair = standOnly ? probOfLossGivenTotal(hands[i].value, upCard) 
+    : chart->lossPct[STRAT_CELL(i, upCard)]; 
+  return (1. - q) * p + q * pair; 
+}
 
-  //index of the hand consisting of two of "splitCard" 
-  int splitHandIndex = getHandIndex(getHandByCards(splitCard,splitCard,FALSE));
 
-  //Distribution of what the "starting hand" will be - i.e. the hand consisting
-  //of one of the two original split cards and the first new card that is 
-  //dealt to it. 
-  double *startingHandDistrib = distribOfHands (splitCard, FALSE); 
+//------------------------------------------------------------------------------
+// Returns the probability that the first of the hands after splitting a pair 
+// of splitCard ends up a pair, which is when it is dealt a card of the split 
+// rank each time until the split has made as many hands as the rules allow 
+// (see getSplitWinProb): none when they allow any number. 
+//------------------------------------------------------------------------------
+static double getFirstHandPairProb (int splitCard, const Rules *rules)
+{
+  int maxHands = getMaxSplitHands(splitCard, rules); 
 
-  //probability that the next hand will be the same as the original hand - i.e.
-  //that a third card of type splitCard will be dealt. 
-  double sameProb = startingHandDistrib[splitHandIndex]; 
-  
-  startingHandDistrib[splitHandIndex] = 0.;   
-  for (i = 0; i < NUM_HANDS; i++)
-    startingHandDistrib[i] /= 1. - sameProb; 
-    
-  //This is technically the probability of lossning each split hand given that 
-  //the split hand does not become the original hand. E.g., if splitCard = 8,
-  //it is the probability that the new hand resulting from one 8 will loss 
-  //given that the next hand dealt to the new hand is *not* another 8. The 
-  //formula is: 
-  //losspct = (p_hand1 * ploss_hand1 + p_hand2 * ploss_hand2 + ...) / (1 - p_same)
-  p = dot (startingHandDistrib, lossProbsByHand, NUM_HANDS_SIMPLE);
-    
-  free(lossProbsByHand); 
-  free(startingHandDistrib); 
-  
-  return p; 
+  if (maxHands == 0)
+    return 0.; 
+  return pow(rules->cardProbs[splitCard], maxHands - 1); 
 }
 
 
 
 
 //------------------------------------------------------------------------------
-// Probability of winning the hand if the player doubles down. 
+// Probability of winning the hand if the player doubles down. The final hand 
+// is the one that one card leads to, from the row of the hit transition 
+// matrix corresponding to "hand". 
 //------------------------------------------------------------------------------
-double getDDWinProb (Strategy **chart, Hand hand, int upCard)
+double getDDWinProb (Hand hand, int upCard)
 {
+  const double *stand = getStandWinProbs(upCard); 
   int i; 
-  int handIndex; 
-  double p; 
-  double *winProbs = NULL; //probabilities of winning a hand given your total 
-                  //and the up card 
-  double *totalProbs = NULL; //probabilities of ending up with the given 
-                    //total card value 
-  
-  //Convert a splittable hand to the equivalent non-splittable type 
-  if (hand.isSplittable && !(areHandsEqual(hand, hands[FOUR])
-                    || areHandsEqual(hand, hands[TWELVE]))) 
-  {
-    hand = makeHand (hand.value, FALSE, FALSE, FALSE); 
-  }
-  
-  handIndex = getHandIndex(hand); 
-  
-  winProbs = allocvector(NUM_OUTCOMES); 
-  if (winProbs == NULL) throwMemErr("winProbs", "getDDWinProb"); 
-  
-  for (i = 0; i < NUM_OUTCOMES; i++)
-    winProbs[i] = probOfWinGivenTotal(i, upCard); 
-  
-  //The distribution of what the final hand will be is given by the row 
-  //of the hit transition matrix corresponding to "hand". 
-  //We need to convert this distribution of hands into a distribution of 
-  //the values of those hands. 
-  totalProbs = zerosv(NUM_OUTCOMES); 
-  if (totalProbs == NULL) throwMemErr("totalProbs", "getDDWinProb"); 
+  int handIndex = getDoubleIndex(hand); 
+  double p = 0.; 
   
   for (i = 0; i < NUM_HANDS_SIMPLE; i++)
-    totalProbs[hands[i].value] += hitTransitionMatrix[handIndex][i];   
-  
-  p = dot (totalProbs, winProbs, NUM_OUTCOMES); 
-  free(totalProbs); 
-  free(winProbs); 
+    if (hitTransitionMatrix[handIndex][i] > 0.)
+      p += hitTransitionMatrix[handIndex][i] * stand[hands[i].value]; 
   
   return p; 
 }
@@ -575,108 +1244,49 @@ double getDDWinProb (Strategy **chart, Hand hand, int upCard)
 //------------------------------------------------------------------------------
 // Probability of losing the hand if the player doubles down. 
 //------------------------------------------------------------------------------
-double getDDLossProb (Strategy **chart, Hand hand, int upCard)
+double getDDLossProb (Hand hand, int upCard)
 {
+  const double *stand = getStandLossProbs(upCard); 
   int i; 
-  int handIndex; 
-  double p; 
-  double *lossProbs = NULL; //probabilities of losing a hand given your total 
-                  //and the up card 
-  double *totalProbs = NULL; //probabilities of ending up with the given 
-                    //total card value 
-  
-  //Convert a splittable hand to the equivalent non-splittable type 
-  if (hand.isSplittable && !(areHandsEqual(hand, hands[FOUR])
-                    || areHandsEqual(hand, hands[TWELVE]))) 
-  {
-    hand = makeHand (hand.value, FALSE, FALSE, FALSE); 
-  }
-  
-  handIndex = getHandIndex(hand); 
-  
-  lossProbs = allocvector(NUM_OUTCOMES); 
-  if (lossProbs == NULL) throwMemErr("lossProbs", "getDDLossProb"); 
-  
-  for (i = 0; i < NUM_OUTCOMES; i++)
-    lossProbs[i] = probOfLossGivenTotal(i, upCard); 
-  
-  //The distribution of what the final hand will be is given by the row 
-  //of the hit transition matrix corresponding to "hand". 
-  //We need to convert this distribution of hands into a distribution of 
-  //the values of those hands. 
-  totalProbs = zerosv(NUM_OUTCOMES); 
-  if (totalProbs == NULL) throwMemErr("totalProbs", "getDDLossProb"); 
+  int handIndex = getDoubleIndex(hand); 
+  double p = 0.; 
   
   for (i = 0; i < NUM_HANDS_SIMPLE; i++)
-    totalProbs[hands[i].value] += hitTransitionMatrix[handIndex][i];   
-  
-  p = dot (totalProbs, lossProbs, NUM_OUTCOMES); 
-  free(totalProbs); 
-  free(lossProbs); 
+    if (hitTransitionMatrix[handIndex][i] > 0.)
+      p += hitTransitionMatrix[handIndex][i] * stand[hands[i].value]; 
   
   return p; 
 }
 
 
 //------------------------------------------------------------------------------
-// Returns the probability of winning each hand given the dealer's up card. 
-//------------------------------------------------------------------------------
-double * getWinProbsByHand (Strategy **chart, int upCard, int **isSolved)
-{
-  int i; 
-  double *winProbsByHand = allocvector(NUM_HANDS_SIMPLE); 
-  if(winProbsByHand == NULL) throwMemErr("winProbsByHand", "getWinProbsByHand");
-  
-  for (i = 0; i < NUM_HANDS_SIMPLE; i++) {
-		if (isSolved[i][upCard]) {
-	    winProbsByHand[i] = chart[i][upCard].winPct; 
-		}
-		else {
-			// signals that it is not yet defined, since probabilities can't be neg.
-			winProbsByHand[i] = -1.; 
-		}
-	}
-  
-  return winProbsByHand; 
-}  
-
-
-//------------------------------------------------------------------------------
-// Returns the probability of losing each hand given the dealer's up card. 
+// Returns the index of the simple hand whose row of the hit transition matrix 
+// doubling down on hand follows: a pair is doubled like the hard total it 
+// adds up to, except for 2-2, which is the only hand of four. 
 //------------------------------------------------------------------------------
-double * getLossProbsByHand (Strategy **chart, int upCard, int **isSolved)
+static int getDoubleIndex (Hand hand)
 {
-  int i; 
-  double *lossProbsByHand = allocvector(NUM_HANDS_SIMPLE); 
-  if (lossProbsByHand == NULL) 
-    throwMemErr("lossProbsByHand", "getLossProbsByHand");
-  
-  for (i = 0; i < NUM_HANDS_SIMPLE; i++) {
-		if (isSolved[i][upCard]) {
-	    lossProbsByHand[i] = chart[i][upCard].lossPct; 
-		}
-		else {
-			// signals that it is not yet defined, since probabilities can't be neg.
-			lossProbsByHand[i] = -1.; 
-		}
-	}
+  //Convert a splittable hand to the equivalent non-splittable type 
+  if (hand.isSplittable && !(areHandsEqual(hand, hands[FOUR])
+                    || areHandsEqual(hand, hands[TWELVE]))) 
+  {
+    hand = makeHand (hand.value, FALSE, FALSE, FALSE); 
+  }
   
-  return lossProbsByHand; 
-}  
+  return getHandIndex(hand); 
+}
 
 
 //------------------------------------------------------------------------------
 // Indicates whether the dealer stands on a given hand.  If it returns false, 
-// the dealer hits. 
+// the dealer hits. He stands on 18 or more and hits 16 or fewer; on 17 he 
+// stands unless it is soft and the rules have him hit soft 17. 
 //------------------------------------------------------------------------------
-int doesDealerStand (Hand hand)
+int doesDealerStand (Hand hand, const Rules *rules)
 {
-  if (hand.value >= 18) //always stands with 18 or more 
-    return TRUE; 
-  else if (hand.value <= 16) //always hits with 16 or fewer 
-    return FALSE; 
-  else 
-    return !(hand.isSoft); //hits on soft 17, stands on hard 17
+  //Branch-free, since the dealer cache calls this for every holding 
+  return (hand.value > 17) 
+    | ((hand.value == 17) & !(hand.isSoft & rules->hitSoft17)); 
 }
 
 
@@ -685,21 +1295,26 @@ int doesDealerStand (Hand hand)
 // given total given his up card.  Each row corresponds to an up card 1 - 10 
 // (with the first row blank in order for the index to correspond with the card
 // number), and each column is a value 0-22, with 22 corresponding to bust. 
+// The rows are DEALER_ROW_SIZE long, and go on with the stand tables of 
+// fillStandTables. 
 //------------------------------------------------------------------------------
-double ** makeDealersProbabilities ()
+double ** makeDealersProbabilities (const Rules *rules)
 {
   int upCard; 
   int j; 
   double *pi = NULL; 
   double *v = NULL; 
-  double **P, **PP; 
+  double **P, **B; 
   double **dealerProbabilities = NULL; 
   
-  dealerProbabilities = zerosm(NUM_CARDS+1, NUM_OUTCOMES); 
+  dealerProbabilities = zerosm(NUM_CARDS+1, DEALER_ROW_SIZE); 
   if (dealerProbabilities == NULL) 
     throwMemErr("dealerProbabilities", "makeDealerProbabilities"); 
   
-  P = makeDealersTransitionMat(hands); 
+  //B[i][j] is the probability that the dealer, holding hand i, ends up 
+  //with hand j. Hand values only go up, so the chain is solved in one pass. 
+  P = makeDealersTransitionMat(rules); 
+  B = absorbing_chain(P, NUM_HANDS_SIMPLE); 
   
   //For each possible dealer's up card, compute probability that dealer will
   //end up with a given total 
@@ -707,37 +1322,68 @@ double ** makeDealersProbabilities ()
   {
     //Compute pi, the distribution vector of the dealer's possible hands 
     //given his up card 
-    pi = distribOfHands(upCard, TRUE); 
+    pi = distribOfHands(upCard, TRUE, rules); 
     
-    //v = pi*P^22. v is the distribution vector of the hands the dealer 
-    //could end up with. 
-    PP = matrixpow(P, NUM_HANDS_SIMPLE, MAX_POSSIBLE_HITS); 
-    v = vtimesm(pi, PP, NUM_HANDS_SIMPLE, NUM_HANDS_SIMPLE); 
+    //v = pi*B. v is the distribution vector of the hands the dealer could 
+    //end up with. 
+    v = vtimesm(pi, B, NUM_HANDS_SIMPLE, NUM_HANDS_SIMPLE); 
     
     //Convert the probabilities of ending up with each hand into the 
     //probabilities of ending up with each value 
     for (j = 0; j < NUM_HANDS_SIMPLE; j++)
       dealerProbabilities[upCard][hands[j].value] += v[j]; 
+    fillStandTables(dealerProbabilities[upCard]); 
 
 	  free(pi); 
 	  free(v); 
-  	freematrix(PP, NUM_HANDS_SIMPLE); 
   }
 
   freematrix(P, NUM_HANDS_SIMPLE); 
+  freematrix(B, NUM_HANDS_SIMPLE); 
   
   return dealerProbabilities; 
 }
 
 
+//------------------------------------------------------------------------------
+// Fills in the stand tables of a row of dealersProbabilities from its 
+// distribution of the dealer's totals: the probability of winning by standing 
+// on each total v, the bust probability plus the running sum of the totals 
+// from 17 (the dealer's least) up to v-1, and of losing, the sum of those 
+// above v. Each is summed in the same order as it always has been, so the 
+// chart is the same to the last bit as when they were summed for every 
+// lookup. 
+//------------------------------------------------------------------------------
+static void fillStandTables (double *row)
+{
+  const int DEALERS_MIN = 17; //dealer always ends up with at least 17 
+  double *win = row + DEALER_WIN_TABLE; 
+  double *loss = row + DEALER_LOSS_TABLE; 
+  int v, i; 
+
+  for (v = 0; v <= DEALERS_MIN; v++)
+    win[v] = row[BUST_VALUE]; //win iff dealer busts 
+  for (v = DEALERS_MIN + 1; v <= 21; v++)
+    win[v] = win[v - 1] + row[v - 1]; 
+  win[BUST_VALUE] = 0.; 
+
+  for (v = 0; v <= 21; v++)
+  {
+    loss[v] = 0.; 
+    for (i = maxi(v + 1, DEALERS_MIN); i <= 21; i++)
+      loss[v] += row[i]; 
+  }
+  loss[BUST_VALUE] = 1.; 
+}
+
+
 //------------------------------------------------------------------------------
 // Makes the Markov transition matrix showing the probability of the dealer's 
 // next hand being a given hand given his current hand. 
 //------------------------------------------------------------------------------
-double ** makeDealersTransitionMat ()
+double ** makeDealersTransitionMat (const Rules *rules)
 {
   double **P = NULL; 
-  Hand newHand; 
   int i, j, k; 
 
   P = zerosm(NUM_HANDS_SIMPLE, NUM_HANDS_SIMPLE); 
@@ -745,18 +1391,16 @@ double ** makeDealersTransitionMat ()
   
   for (i = 0; i < NUM_HANDS_SIMPLE; i++)
   {
-    if (doesDealerStand(hands[i]))
+    if (doesDealerStand(hands[i], rules))
       P[i][i] = 1.; //dealer never moves away from this hand 
     else //if dealer draws a card 
     {
       for (k = 1; k <= NUM_CARDS; k++)
       {
-        //new hand that will be obtained from hand i by drawing card k 
-        newHand = calculateNewHand (hands[i], k); 
-    
-        //probability of moving to hand j is the probability of drawing card k
-        j = getHandIndex(newHand); 
-        P[i][j] += CARD_PROBABILITIES[k]; 
+        //probability of moving to hand j, the hand obtained from hand i by 
+        //drawing card k, is the probability of drawing card k
+        j = handAfterCard[i][k]; 
+        P[i][j] += rules->cardProbs[k]; 
       }
     }
   }
@@ -771,34 +1415,42 @@ double ** makeDealersTransitionMat ()
 // next hand being a given hand given his current hand and given that he hits
 // on the current hand. Only includes simple hands. 
 //------------------------------------------------------------------------------
-double ** makeHitTransitionMat ()
+double ** makeHitTransitionMat (const Rules *rules)
 {
-  double **P = NULL; 
-  Hand newHand; 
-  int i, j, k; 
-
-  P = zerosm(NUM_HANDS_SIMPLE, NUM_HANDS_SIMPLE); 
+  double **P = allocmatrix(NUM_HANDS_SIMPLE, NUM_HANDS_SIMPLE); 
   if (P == NULL) throwMemErr("P", "makeHitTransitionMat"); 
   
+  fillHitTransitionMat(P, rules); 
+  return P; 
+}
+
+
+//------------------------------------------------------------------------------
+// Fills in P, a NUM_HANDS_SIMPLE x NUM_HANDS_SIMPLE matrix, as the hit 
+// transition matrix for the given rules (see makeHitTransitionMat). 
+//------------------------------------------------------------------------------
+static void fillHitTransitionMat (double **P, const Rules *rules)
+{
+  int i, j, k; 
+
   for (i = 0; i < NUM_HANDS_SIMPLE; i++)
   {
+    for (j = 0; j < NUM_HANDS_SIMPLE; j++)
+      P[i][j] = 0.; 
+    
     if (i == BUST)
       P[i][i] = 1.; //player never moves away from a bust 
     else 
     {
       for (k = 1; k <= NUM_CARDS; k++)
       {
-        //new hand that will be obtained from hand i by drawing card k 
-        newHand = calculateNewHand (hands[i], k); 
-    
-        //probability of moving to hand j is the probability of drawing card k
-        j = getHandIndex(newHand); 
-        P[i][j] += CARD_PROBABILITIES[k]; 
+        //probability of moving to hand j, the hand obtained from hand i by 
+        //drawing card k, is the probability of drawing card k
+        j = handAfterCard[i][k]; 
+        P[i][j] += rules->cardProbs[k]; 
       }
     }
   }
-  
-  return P; 
 }
 
 
@@ -808,31 +1460,7 @@ double ** makeHitTransitionMat ()
 //------------------------------------------------------------------------------
 Hand calculateNewHand (Hand oldHand, int card)
 {
-  Hand newHand = {oldHand.value + card, oldHand.isSoft, FALSE, FALSE}; 
-  
-  //If the new card is an ace, count it as 11 initially 
-  if (card == 1)
-  {
-    newHand.value += 10; 
-    newHand.isSoft = TRUE; 
-  }
-  
-  //If there is either an ace being used as 11 in the original hand, and/or the
-  //new card is an ace, count it as 1 if necessary 
-  if (newHand.isSoft && newHand.value > 21)
-  {
-    newHand.value -= 10; 
-    
-    //The new hand is not soft, unless the previous hand was soft and the new
-    //card is an ace. 
-    newHand.isSoft = oldHand.isSoft && card == 1; 
-  }
-  
-  if (newHand.value > 21)
-    newHand = hands[BUST]; 
-  
-  //Return the hand in the hands array that is equal to the newly created hand
-  return getHand(newHand); 
+  return hands[handAfterCard[getHandIndex(oldHand)][card]]; 
 }
 
 
@@ -846,11 +1474,10 @@ Hand calculateNewHand (Hand oldHand, int card)
 // The resulting vector has length NUM_HANDS if isDealer = false and 
 // NUM_HANDS_SIMPLE if isDealer is true. 
 //------------------------------------------------------------------------------
-double * distribOfHands (int knownCard, int isDealer)
+double * distribOfHands (int knownCard, int isDealer, const Rules *rules)
 {
   double *pi = NULL; //vector of possible hands 
   int downCard, newCard; 
-  Hand hand; 
   int index; 
   
   if (isDealer)
@@ -861,15 +1488,14 @@ double * distribOfHands (int knownCard, int isDealer)
     for (downCard = 1; downCard <= NUM_CARDS; downCard++)
     {
       //Get the hand that the dealer has, comprised of his up and down cards
-      hand = getHandByCards(knownCard, downCard, TRUE); 
-      index = getHandIndex(hand); 
+      index = dealerHandByCards[knownCard][downCard]; 
       
       if (knownCard == 1)
-        pi[index] += cardProbsAceUpAssumingNoBJ(downCard); 
+        pi[index] += cardProbsAceUpAssumingNoBJ(downCard, rules); 
       else if (knownCard == 10)
-        pi[index] += cardProbsTenUpAssumingNoBJ(downCard); 
+        pi[index] += cardProbsTenUpAssumingNoBJ(downCard, rules); 
       else
-        pi[index] += CARD_PROBABILITIES[downCard]; 
+        pi[index] += rules->cardProbs[downCard]; 
     }
   }
   else
@@ -879,9 +1505,8 @@ double * distribOfHands (int knownCard, int isDealer)
     
     for (newCard = 1; newCard <= NUM_CARDS; newCard++)
     {
-      hand = getHandByCards(knownCard, newCard, FALSE); 
-      index = getHandIndex(hand); 
-      pi[index] += CARD_PROBABILITIES[newCard]; 
+      index = handByCards[knownCard][newCard]; 
+      pi[index] += rules->cardProbs[newCard]; 
     }
   }
   
@@ -893,12 +1518,12 @@ double * distribOfHands (int knownCard, int isDealer)
 // Gives the probability that the dealer has the given down card, given that his
 // up card is an Ace and given that the down card is not a ten. 
 //------------------------------------------------------------------------------
-double cardProbsAceUpAssumingNoBJ (int downCard)
+double cardProbsAceUpAssumingNoBJ (int downCard, const Rules *rules)
 {
   if (downCard == 10)
     return 0.; 
   else
-    return 1./9.; //There are 9 equally likely possibilities. 
+    return rules->cardProbs[downCard] / (1. - rules->cardProbs[10]); 
 }
 
 
@@ -906,14 +1531,12 @@ double cardProbsAceUpAssumingNoBJ (int downCard)
 // Gives the probability that the dealer has the given down card, given that his
 // up card is a ten and given that the down card is not an ace. 
 //------------------------------------------------------------------------------
-double cardProbsTenUpAssumingNoBJ (int downCard)
+double cardProbsTenUpAssumingNoBJ (int downCard, const Rules *rules)
 {
   if (downCard == 1)
     return 0.; 
-  else if (downCard == 10)
-    return 4./12; //four tens/face cards 
   else 
-    return 1./12; //each non-face card equally likely 
+    return rules->cardProbs[downCard] / (1. - rules->cardProbs[1]); 
 }
 
 
@@ -921,97 +1544,224 @@ double cardProbsTenUpAssumingNoBJ (int downCard)
 //------------------------------------------------------------------------------
 // Returns the strategy one should use when splitting and doubling are allowed.
 // handIndex is the index of the hand the player has, and upCard is the dealer's 
-// up card. 
+// up card. The hands after a split are played by splitChart. 
+// 
+// Plays are compared by their expected value before the dealer checks for 
+// blackjack, which only differs from the expected value given that he doesn't
+// have it when he takes no hole card, since then a doubled or split bet is 
+// lost to his blackjack too. 
+// 
+// The probabilities of doubling are those of getDDWinProb and getDDLossProb, 
+// read from the rows of lanes that the solver has summed them in for every up 
+// card at once, so this may only be called by the solver, from the thread 
+// solving the chart. 
+// 
+// Unless playEV is NULL, the expected values of doubling and splitting are 
+// stored in it, at PLAY_EV_DOUBLE and PLAY_EV_SPLIT, whether or not they are 
+// the best play, or NAN where the play may not be made (see PLAY_EV). 
 //------------------------------------------------------------------------------
-Strategy splitOrDoubleStrat (Strategy **chart, int handIndex, int upCard) 
+static Strategy splitOrDoubleStrat (const StrategyTable *chart, 
+                    const StrategyTable *splitChart, int handIndex, 
+                    int upCard, const Rules *rules, double *playEV) 
 {
-  double splitEV; 
+  double splitEV, q; 
   double ddWinProb, ddLossProb; 
   int splitCard; 
-  Strategy strat = chart[handIndex][upCard]; 
+  Strategy strat = getStrat(chart, handIndex, upCard); 
+  Strategy candidate; 
   Hand hand = hands[handIndex]; 
-	int **isSolved = iones(NUM_HANDS_SIMPLE, NUM_CARDS + 1); // needed by getSplitWinProb
   
-  //First, determine whether to double. 
-  ddWinProb = getDDWinProb (chart, hand, upCard); 
-  ddLossProb = getDDLossProb (chart, hand, upCard); 
+  //probability that the dealer's blackjack is only found after the player 
+  //has played 
+  q = rules->holeCard ? 0. : probOfDealerBJ(upCard, rules); 
+  if (playEV != NULL)
+    playEV[PLAY_EV_DOUBLE] = playEV[PLAY_EV_SPLIT] = NAN; 
+  
+  //A bust is not played on, and a blackjack is paid at once 
+  if (handIndex == BUST || handIndex == SOFT_TWENTYONE)
+    return strat; 
   
-  //note: tie goes to not doubling to decrease variance 
-  if (2. * (ddWinProb - ddLossProb) > strat.winPct - strat.lossPct) 
+  //First, determine whether to double. 
+  if (isDoubleAllowed(hand, rules))
   {
-    strat.action = DOUBLE_DOWN; 
-    strat.winPct = ddWinProb; 
-    strat.lossPct = ddLossProb; 
+    ddWinProb = LANE_TABLE(LANES_DD_WIN)[getDoubleIndex(hand)][upCard]; 
+    ddLossProb = LANE_TABLE(LANES_DD_LOSS)[getDoubleIndex(hand)][upCard]; 
+    
+    candidate = strat; 
+    candidate.action = DOUBLE_DOWN; 
+    candidate.winPct = ddWinProb; 
+    candidate.lossPct = ddLossProb; 
+    if (playEV != NULL)
+      playEV[PLAY_EV_DOUBLE] = getStratEV(candidate); 
+    
+    //note: tie goes to not doubling to decrease variance 
+    if (getEVBeforePeek(candidate, handIndex, q, rules) 
+        > getEVBeforePeek(strat, handIndex, q, rules)) 
+      strat = candidate; 
   }
   
   // Next, determine whether to split 
   if (hand.isSplittable)
   {
     splitCard = hand.isSoft ? 1 : hand.value / 2; 
-    splitEV = getSplitEV (chart, splitCard, upCard); 
+    splitEV = getSplitEV (splitChart, splitCard, upCard, rules); 
+    
+    candidate = strat; 
+    candidate.action = SPLIT; 
+    candidate.splitEV = splitEV; 
+    if (playEV != NULL)
+      playEV[PLAY_EV_SPLIT] = getStratEV(candidate); 
     
     //as with doubles, tie goes to not splitting 
-    if (strat.action != DOUBLE_DOWN)
-    {
-      if (splitEV > strat.winPct - strat.lossPct)
-      {
-        strat.action = SPLIT; 
-        strat.winPct = getSplitWinProb(chart, splitCard, upCard, isSolved); 
-        strat.lossPct = getSplitLossProb(chart, splitCard, upCard, isSolved); 
-        strat.splitEV = splitEV; 
-      }
-    }
-    else //If current strat is to double down, multiply by 2 
+    if (getEVBeforePeek(candidate, handIndex, q, rules) 
+        > getEVBeforePeek(strat, handIndex, q, rules)) 
     {
-      if (splitEV > 2. * (strat.winPct - strat.lossPct)) 
-      {
-        strat.action = SPLIT; 
-        strat.winPct = getSplitWinProb(chart, splitCard, upCard, isSolved); 
-        strat.lossPct = getSplitLossProb(chart, splitCard, upCard, isSolved); 
-        strat.splitEV = splitEV; 
-      }
+      strat = candidate; 
+      strat.winPct = getSplitWinProb(splitChart, splitCard, upCard, rules); 
+      strat.lossPct = getSplitLossProb(splitChart, splitCard, upCard, rules); 
     }
   }
-
-	freeimatrix (isSolved, NUM_HANDS_SIMPLE); 
   
   return strat; 
 }
 
 
-
 //------------------------------------------------------------------------------
-// Computes the player's expected value and prints it to the terminal. E.g., if 
-// the expected value is x, it means that the player will on average lose x 
-// dollars on each hand when betting one dollar. 
+// Returns whether the player should surrender hands[handIndex] against upCard,
+// when strat is how he would play it otherwise. 
 //------------------------------------------------------------------------------
-void computeExpectedValue (Strategy **chart, double BLACKJACK_PAYS)
+static int shouldSurrender (Strategy strat, int handIndex, int upCard, 
+                   const Rules *rules)
 {
-  //expected value = probability of starting with each hand times expected 
-  //value of each hand. 
-  double *startingHandProbs = getStartingHandProbs(); 
-  double *handExpVals = getHandExpVals (chart, BLACKJACK_PAYS); 
+  double q; 
+  Strategy surrender = strat; 
+
+  if (handIndex == BUST || handIndex == SOFT_TWENTYONE)
+    return FALSE; 
   
-  //expected val
-  double ev = dot (startingHandProbs, handExpVals, NUM_HANDS); 
+  //With late surrender and a hole card, the player only gets to choose once 
+  //the dealer is known not to have blackjack 
+  q = (rules->surrender == SURRENDER_EARLY || !(rules->holeCard)) 
+    ? probOfDealerBJ(upCard, rules) : 0.; 
+  surrender.surrender = TRUE; 
+  
+  //tie goes to playing the hand 
+  return getEVBeforePeek(surrender, handIndex, q, rules) 
+    > getEVBeforePeek(strat, handIndex, q, rules); 
+}
+
+
+//------------------------------------------------------------------------------
+// Returns the expected value of playing hands[handIndex] by strat, where q is 
+// the probability that the dealer has blackjack, and the value given that he 
+// does not comes from strat. 
+//------------------------------------------------------------------------------
+double getEVBeforePeek (Strategy strat, int handIndex, double q, 
+                const Rules *rules)
+{
+  if (q == 0.) //keeps the comparison exact when there is nothing to weigh 
+    return getStratEV(strat); 
+  return (1. - q) * getStratEV(strat) + q * getEVDealerBJ(strat, handIndex, 
+                                              rules); 
+}
+
+
+//------------------------------------------------------------------------------
+// Returns the player's expected value of playing hands[handIndex] by strat 
+// when the dealer turns out to have blackjack. 
+//------------------------------------------------------------------------------
+double getEVDealerBJ (Strategy strat, int handIndex, const Rules *rules)
+{
+  if (handIndex == SOFT_TWENTYONE) //push 
+    return 0.; 
+  else if (strat.surrender) //only keeps half his bet if he surrendered first 
+    return rules->surrender == SURRENDER_EARLY ? -.5 : -1.; 
+  else if (rules->holeCard) //the dealer checks before any more is bet 
+    return -1.; 
+  else 
+    return -getStratBet(strat); 
+}
+
+
+//------------------------------------------------------------------------------
+// Returns the amount the player has bet at the end of a hand played by strat, 
+// in units of his original bet. A split counts the bets on the first two 
+// hands only, leaving out any resplits. 
+//------------------------------------------------------------------------------
+static double getStratBet (Strategy strat)
+{
+  if (strat.action == DOUBLE_DOWN || strat.action == SPLIT)
+    return 2.; 
+  else 
+    return 1.; 
+}
+
+
+//------------------------------------------------------------------------------
+// Returns the player's expected value of a hand played by strat, given that 
+// the dealer does not have blackjack. 
+//------------------------------------------------------------------------------
+double getStratEV (Strategy strat)
+{
+  if (strat.surrender)
+    return -.5; 
+  else if (strat.action == DOUBLE_DOWN) 
+    return 2. * (strat.winPct - strat.lossPct); 
+  else if (strat.action == SPLIT) 
+    return strat.splitEV; 
+  else 
+    return strat.winPct - strat.lossPct; 
+}
+
+
+//------------------------------------------------------------------------------
+// Computes the player's expected value, prints it to the terminal and returns 
+// it. E.g., if the expected value is x, it means that the player will on 
+// average lose x dollars on each hand when betting one dollar. 
+//------------------------------------------------------------------------------
+double computeExpectedValue (const StrategyTable *chart, const Rules *rules)
+{
+  double ev = getExpectedValue (chart, rules); 
 
   printf ("The player's expected value is %.3f%%. That is, a player betting "
       "$100 per hand will lose an average of $%.2f per hand.\n", 
       100. * ev, -100. * ev); 
+  return ev; 
+}
+
+//------------------------------------------------------------------------------
+// Returns the player's expected value per hand, betting one unit, when playing
+// by the chart: the probability of starting with each hand times the expected
+// value of each hand. Allocates nothing. 
+//------------------------------------------------------------------------------
+double getExpectedValue (const StrategyTable *chart, const Rules *rules)
+{
+  double ev = 0.; 
+  double p; 
+  int i, j; 
+  
+  //i and j run over all combinations of hands a player can be dealt 
+  for (i = 1; i <= NUM_CARDS; i++)
+  {
+    for (j = 1; j <= NUM_CARDS; j++) 
+    {
+      p = rules->cardProbs[i] * rules->cardProbs[j]; 
+      if (p > 0.)
+        ev += p * getHandEV(chart, handByCards[i][j], rules); 
+    }
+  }
   
-  free (startingHandProbs); 
-  free (handExpVals); 
+  return ev; 
 }
 
 //------------------------------------------------------------------------------
 // Returns a vector of length NUM_HANDS whose ith entry is the probability that 
 // the player will initially be dealt hand i. 
 //------------------------------------------------------------------------------
-double * getStartingHandProbs ()
+double * getStartingHandProbs (const Rules *rules)
 {
   double *probs = NULL; 
   int i, j; 
-  Hand hand; 
   int index; 
   double p; 
   
@@ -1023,9 +1773,8 @@ double * getStartingHandProbs ()
   {
     for (j = 1; j <= NUM_CARDS; j++) 
     {
-      hand = getHandByCards(i, j, FALSE); 
-      index = getHandIndex(hand); 
-      p = CARD_PROBABILITIES[i] * CARD_PROBABILITIES[j]; 
+      index = handByCards[i][j]; 
+      p = rules->cardProbs[i] * rules->cardProbs[j]; 
       probs[index] += p; 
     }
   }
@@ -1037,60 +1786,67 @@ double * getStartingHandProbs ()
 // Returns a vector of length NUM_HANDS whose ith entry is the expected value 
 // to the player of a hand in which his initial cards are given by hand i. 
 //------------------------------------------------------------------------------
-double * getHandExpVals (Strategy **chart, double BLACKJACK_PAYS)
+double * getHandExpVals (const StrategyTable *chart, const Rules *rules)
 {
   double *EVs = NULL; 
   int i; 
   
-  //Probability that the dealer has blackjack 
-  double probDealerBJ = 2. * CARD_PROBABILITIES[1] * CARD_PROBABILITIES[10]; 
-  double EVDealerBJ, EVNoDealerBJ;  
-  
   EVs = allocvector(NUM_HANDS); 
   if (EVs == NULL) throwMemErr("EVs", "getHandExpVals"); 
   
   for (i = 0; i < NUM_HANDS; i++)
+    EVs[i] = getHandEV(chart, i, rules); 
+  
+  return EVs; 
+}
+
+//------------------------------------------------------------------------------
+// Returns the expected value to the player of a hand in which his initial 
+// cards are given by hands[handIndex], over all of the dealer's up cards. 
+//------------------------------------------------------------------------------
+double getHandEV (const StrategyTable *chart, int handIndex, 
+            const Rules *rules)
+{
+  double ev = 0.; 
+  double q, EVNoDealerBJ; 
+  Strategy strat; 
+  int upCard; 
+  
+  //The expected value of each hand against each up card is the probability
+  //that dealer has blackjack times expected value given that dealer has 
+  //blackjack, plus probabilitity that dealer does not have blackjack times 
+  //expected value given that dealer does not have blackjack. 
+  for (upCard = 1; upCard <= NUM_CARDS; upCard++)
   {
-    //The expected value of each hand is the probability that dealer has 
-    //blackjack times expected value given that dealer has blackjack, plus
-    //probabilitity that dealer does not have blackjack times expected value
-    //given that dealer does not have blackjack. 
-    
-    //If the player has blackjack it's a push, otherwise player loses his bet
-    EVDealerBJ = (i == SOFT_TWENTYONE ? 0. : -1.); 
-    EVNoDealerBJ = getEVOfHand (chart, i, BLACKJACK_PAYS); 
-    
-    EVs[i] = probDealerBJ * EVDealerBJ + (1. - probDealerBJ) * EVNoDealerBJ; 
+    q = probOfDealerBJ(upCard, rules); 
+    strat = getStrat(chart, handIndex, upCard); 
+    EVNoDealerBJ = handIndex == SOFT_TWENTYONE ? rules->blackjackPays 
+                                    : getStratEV(strat); 
+    ev += rules->cardProbs[upCard] 
+      * (q * getEVDealerBJ(strat, handIndex, rules) + (1. - q) * EVNoDealerBJ);
   }
   
-  return EVs; 
+  return ev; 
 }
 
 //------------------------------------------------------------------------------
 // Returns the player's expected value when starting on the given hand, given
 // that the dealer does not have blackjack. 
 //------------------------------------------------------------------------------
-double getEVOfHand (Strategy **chart, int handIndex, double BLACKJACK_PAYS)
+double getEVOfHand (const StrategyTable *chart, int handIndex, 
+             const Rules *rules)
 {
   double EV = 0.; 
   double p; 
   int upCard; 
-  Strategy strat; 
   
   if (handIndex == SOFT_TWENTYONE)
-    return BLACKJACK_PAYS; 
+    return rules->blackjackPays; 
   
   for (upCard = 1; upCard <= NUM_CARDS; upCard++)
   {
-    strat = chart[handIndex][upCard]; 
-    p = probOfUpCardGivenNoBJ(upCard); 
-
-    if (strat.action == HIT || strat.action == STAND) 
-      EV += p * (strat.winPct - strat.lossPct); 
-    else if (strat.action == DOUBLE_DOWN) 
-      EV += 2. * p * (strat.winPct - strat.lossPct); 
-    else //if it's a split 
-      EV += p * strat.splitEV; 
+    p = probOfUpCardGivenNoBJ(upCard, rules); 
+    EV += p * getStratEV(getStrat(chart, handIndex, upCard)); 
   }
 
   return EV; 
@@ -1101,50 +1857,21 @@ double getEVOfHand (Strategy **chart, int handIndex, double BLACKJACK_PAYS)
 // Returns the probability that the dealer has the following up card, 
 // conditioned on the event that the dealer does not have blackjack. 
 //------------------------------------------------------------------------------
-double probOfUpCardGivenNoBJ (int upCard)
+double probOfUpCardGivenNoBJ (int upCard, const Rules *rules)
 {
   //By Bayes' rule, this equals P(up card & no BJ) / P(no BJ). 
-  double probBoth; 
-  double probNoBJ = 1. - 2. * CARD_PROBABILITIES[1] * CARD_PROBABILITIES[10]; 
-  
-  if (upCard == 1)
-    probBoth = CARD_PROBABILITIES[1] * (1. - CARD_PROBABILITIES[10]); 
-  else if (upCard == 10)
-    probBoth = CARD_PROBABILITIES[10] * (1. - CARD_PROBABILITIES[1]); 
-  else 
-    probBoth = CARD_PROBABILITIES[upCard]; 
+  const double *p = rules->cardProbs; 
+  double probNoBJ = 1. - 2. * p[1] * p[10]; 
+  double probBoth = p[upCard] * (1. - probOfDealerBJ(upCard, rules)); 
   
   return probBoth / probNoBJ; 
 }
 
 
-// Returns the dot product of x and y, while ignoring values of y that are 
-// undefined (signaled by negative values). Used by getHitWinProb among others.
-double dot_ignore_undef (double *x, double *y, int N) { 
-	int i; 
-	double d = 0.; 
-
-	for (i = 0; i < N; i++) { 
-		if (y[i] >= 0.) {
-			d += x[i] * y[i]; 
-		}
-		else if (x[i] > 0.) { 
-			throwErr("attempt to multiply positive probability by undefined probability", "dot_ignore_undef"); 
-		}
-	}
-
-	return d; 
-}
-
-
 /* Notes: 
 
 1. Probability of winning and losing add up to less than 100% because a push may
   be possible. 
-2. If calculateSimpleChart doesn't converge, don't calculate splits and doubles, 
-  because DD is used as the code for strategies that were not solved. 
-3. The reason both of these loops go "backwards" is because it is more likely 
-  that a solution can be found first for "higher" hands and higher cards drawn.
 */
 
 
@@ -0,0 +1,738 @@
+#include "cd_strat.h" 
+#include <stdlib.h> 
+#include <string.h> 
+#include "boolean.h" 
+#include "error.h" 
+#include "hands.h" 
+#include "parallel.h" 
+#include "splits.h" 
+
+//The key of a holding packs the number of cards of each rank held into 
+//RANK_BITS bits each, aces lowest, and above them the rank of the cards of a 
+//split pair that are in the player's other hands, and their number, or 0. A 
+//holding can have at most 21 cards of a rank, and the other hands at most 
+//2 * MAX_CD_SPLIT_HANDS - 1 cards of the split rank, which fit. 
+#define RANK_BITS (5)
+#define EXTRA_SHIFT (RANK_BITS * NUM_CARDS)
+#define RANK_UNIT(rank) ((uint64_t) 1 << (RANK_BITS * ((rank) - 1)))
+#define EXTRA_KEY(rank, n) ((n) == 0 ? 0 \
+  : ((uint64_t) (n) << (EXTRA_SHIFT + 4)) + ((uint64_t) (rank) << EXTRA_SHIFT))
+
+//Most hands that a pair is split into when the rules set no limit, as in the 
+//simulations 
+#define MAX_CD_SPLIT_HANDS (16)
+
+//Number of entries a CDHoldingTable starts out with; a power of two 
+static const int INITIAL_TABLE_SIZE = 1 << 12; 
+
+//State of the solver while it works through one up card. left is the 
+//composition of the shoe with the up card and the current holding removed. 
+typedef struct { 
+  CDChart *chart; 
+  CDHoldingTable *table; 
+  DealerCache *cache; 
+  int upCard; 
+  int left[NUM_CARDS+1]; 
+  int nleft; 
+} CDSolver; 
+
+//A pair being split by getCDSplitEV, for getCDSplitValue 
+typedef struct { 
+  CDSolver *s; 
+  int card; 
+} CDSplit; 
+
+static void solveUpCardTask (int task, int thread, void *arg); 
+static void initSolver (CDSolver *s, CDChart *chart, int upCard, 
+               DealerCache *cache); 
+static void takeCard (CDSolver *s, int rank); 
+static void returnCard (CDSolver *s, int rank); 
+static Strategy solvePair (CDSolver *s, int card1, int card2); 
+static CDHolding solveHolding (CDSolver *s, int hand, uint64_t key, 
+                      int ncards); 
+static void getStandProbs (CDSolver *s, int hand, double *win, double *loss); 
+static void getDoubleProbs (CDSolver *s, int hand, uint64_t key, 
+                   double *win, double *loss); 
+static double getCDSplitEV (CDSolver *s, int card, double *win, 
+                   double *loss); 
+static void getCDSplitValue (int removed, int isPair, SplitHandValue *value, 
+                    void *arg); 
+static double getCDSplitHandProbs (CDSolver *s, int hand, uint64_t key, 
+                          int standOnly, double *win, double *loss); 
+static double getProbOfDealerBJ (CDSolver *s); 
+static double getCDExpectedValue (CDChart *chart); 
+static CDHolding * findHolding (CDHoldingTable *table, uint64_t key); 
+static void growHoldingTable (CDHoldingTable *table); 
+
+
+//------------------------------------------------------------------------------
+// Makes an unsolved chart for the shoe and rules given by rules, which must 
+// outlive the chart; calculateCDChart solves it. 
+//------------------------------------------------------------------------------
+CDChart * newCDChart (const Rules *rules)
+{
+  CDChart *chart = NULL; 
+  int k; 
+
+  checkRules(rules); 
+
+  chart = (CDChart *) malloc(sizeof(CDChart)); 
+  if (chart == NULL) throwMemErr("chart", "newCDChart"); 
+
+  chart->rules = rules; 
+  chart->numDecks = rules->numDecks; 
+  getShoeCounts(rules, chart->counts); 
+  chart->ev = 0.; 
+
+  for (k = 1; k <= NUM_CARDS; k++)
+  {
+    chart->holdings[k].entry = (CDHolding *) calloc(INITIAL_TABLE_SIZE, 
+                                 sizeof(CDHolding)); 
+    if (chart->holdings[k].entry == NULL)
+      throwMemErr("chart->holdings[k].entry", "newCDChart"); 
+    chart->holdings[k].size = INITIAL_TABLE_SIZE; 
+    chart->holdings[k].nused = 0; 
+  }
+  chart->cache = NULL; 
+
+  return chart; 
+}
+
+
+//------------------------------------------------------------------------------
+// Frees a chart made by newCDChart. 
+//------------------------------------------------------------------------------
+void freeCDChart (CDChart *chart)
+{
+  int k; 
+
+  if (chart == NULL)
+    return; 
+  for (k = 1; k <= NUM_CARDS; k++)
+    free(chart->holdings[k].entry); 
+  freeDealerCache(chart->cache); 
+  free(chart); 
+}
+
+
+//------------------------------------------------------------------------------
+// Computes the best strategy for every pair of cards the player can be dealt 
+// against every up card, and the player's expected value, for the chart's 
+// shoe and rules. Pairs are split and resplit as the rules allow (see 
+// getCDSplitEV). 
+// 
+// Every holding the player can reach by hitting is solved once per up card, 
+// with the dealer's final total computed exactly from the cards left in the 
+// shoe (dealerOutcomeProbs), and memoized so that it is shared by every 
+// starting hand that can lead to it. The up cards are solved in parallel on 
+// nthreads threads. The chance of drawing each card while hitting ignores the 
+// small effect of knowing that the dealer's hole card doesn't give him 
+// blackjack. When the dealer takes no hole card, or the player may surrender 
+// early, the plays are compared allowing for the exact chance of the dealer's 
+// blackjack given the cards that have been dealt. 
+//------------------------------------------------------------------------------
+void calculateCDChart (CDChart *chart, int nthreads)
+{
+  int k; 
+
+  if (hands == NULL)
+    throwErr("makeHands has not been called.", "calculateCDChart"); 
+
+  for (k = 1; k <= NUM_CARDS; k++)
+  {
+    memset(chart->holdings[k].entry, 0, 
+      chart->holdings[k].size * sizeof(CDHolding)); 
+    chart->holdings[k].nused = 0; 
+  }
+
+  parallel_for(NUM_CARDS, nthreads, solveUpCardTask, chart); 
+  chart->ev = getCDExpectedValue(chart); 
+}
+
+
+//------------------------------------------------------------------------------
+// Returns the best play of a holding of ncards cards (given by rank in cards)
+// against upCard, when the only choices are to hit or stand, as in a hand that 
+// has already been hit. The chart must have been solved by calculateCDChart. 
+// Holdings that were not reached while solving it are solved now. Not 
+// thread-safe. 
+//------------------------------------------------------------------------------
+Strategy getCDHoldingStrat (CDChart *chart, const int *cards, int ncards, 
+                   int upCard)
+{
+  CDSolver s; 
+  CDHolding holding; 
+  Strategy strat; 
+  uint64_t key; 
+  int hand, i; 
+
+  if (ncards < 2)
+    throwErr("A holding must have at least two cards.", "getCDHoldingStrat"); 
+  if (upCard < 1 || upCard > NUM_CARDS)
+    throwErr("Invalid up card.", "getCDHoldingStrat"); 
+  if (chart->cache == NULL)
+    chart->cache = newDealerCache(chart->rules); 
+
+  initSolver(&s, chart, upCard, chart->cache); 
+  hand = handByCards[cards[0]][cards[1]]; 
+  key = 0; 
+  for (i = 0; i < ncards; i++)
+  {
+    if (cards[i] < 1 || cards[i] > NUM_CARDS || s.left[cards[i]] <= 0)
+      throwErr("Holding is not possible with this shoe.", 
+        "getCDHoldingStrat"); 
+    takeCard(&s, cards[i]); 
+    key += RANK_UNIT(cards[i]); 
+    if (i >= 2)
+      hand = handAfterCard[hand][cards[i]]; 
+  }
+
+  strat.splitEV = 0.; 
+  strat.surrender = FALSE; 
+  if (hand == BUST)
+  {
+    strat.action = STAND; 
+    strat.winPct = 0.; 
+    strat.lossPct = 1.; 
+    return strat; 
+  }
+
+  holding = solveHolding(&s, hand, key, ncards); 
+  strat.action = holding.action; 
+  strat.winPct = holding.winPct; 
+  strat.lossPct = holding.lossPct; 
+  return strat; 
+}
+
+
+//------------------------------------------------------------------------------
+// Returns the expected value of splitting a pair of card against upCard, 
+// given that the dealer doesn't have blackjack, as calculateCDChart finds it. 
+// The chart need not have been solved; the holdings the split leads to that 
+// have not been solved are solved now. Not thread-safe. 
+//------------------------------------------------------------------------------
+double getCDPairSplitEV (CDChart *chart, int card, int upCard)
+{
+  CDSolver s; 
+  double win, loss, ev; 
+
+  if (card < 1 || card > NUM_CARDS || upCard < 1 || upCard > NUM_CARDS)
+    throwErr("Invalid card.", "getCDPairSplitEV"); 
+  if (chart->cache == NULL)
+    chart->cache = newDealerCache(chart->rules); 
+
+  initSolver(&s, chart, upCard, chart->cache); 
+  if (s.left[card] < 2)
+    throwErr("Pair is not possible with this shoe.", "getCDPairSplitEV"); 
+  takeCard(&s, card); 
+  takeCard(&s, card); 
+  ev = getCDSplitEV(&s, card, &win, &loss); 
+  returnCard(&s, card); 
+  returnCard(&s, card); 
+  return ev; 
+}
+
+
+//------------------------------------------------------------------------------
+// Task for parallel_for in calculateCDChart: solves every pair of cards 
+// against up card task + 1, with a dealer cache of its own. 
+//------------------------------------------------------------------------------
+static void solveUpCardTask (int task, int thread, void *arg)
+{
+  CDChart *chart = (CDChart *) arg; 
+  CDSolver s; 
+  Strategy strat; 
+  int upCard = task + 1; 
+  int card1, card2; 
+
+  initSolver(&s, chart, upCard, newDealerCache(chart->rules)); 
+  for (card1 = 1; card1 <= NUM_CARDS; card1++)
+  {
+    for (card2 = card1; card2 <= NUM_CARDS; card2++)
+    {
+      strat = solvePair(&s, card1, card2); 
+      chart->strat[card1][card2][upCard] = strat; 
+      chart->strat[card2][card1][upCard] = strat; 
+    }
+  }
+  freeDealerCache(s.cache); 
+}
+
+
+//------------------------------------------------------------------------------
+// Sets up a solver for upCard, with the up card removed from the chart's shoe. 
+//------------------------------------------------------------------------------
+static void initSolver (CDSolver *s, CDChart *chart, int upCard, 
+               DealerCache *cache)
+{
+  int k; 
+
+  s->chart = chart; 
+  s->table = &chart->holdings[upCard]; 
+  s->cache = cache; 
+  s->upCard = upCard; 
+  s->nleft = 0; 
+  for (k = 0; k <= NUM_CARDS; k++)
+  {
+    s->left[k] = chart->counts[k]; 
+    s->nleft += s->left[k]; 
+  }
+  takeCard(s, upCard); 
+}
+
+
+//------------------------------------------------------------------------------
+// Removes a card of the given rank from the solver's shoe, or puts it back. 
+//------------------------------------------------------------------------------
+static void takeCard (CDSolver *s, int rank)
+{
+  s->left[rank]--; 
+  s->nleft--; 
+}
+
+static void returnCard (CDSolver *s, int rank)
+{
+  s->left[rank]++; 
+  s->nleft++; 
+}
+
+
+//------------------------------------------------------------------------------
+// Returns the best strategy for a player dealt card1 and card2 against the 
+// solver's up card, choosing among hitting, standing, doubling, (for a pair) 
+// splitting and surrendering, as the rules allow. As in splitOrDoubleStrat, 
+// ties go to not doubling, not splitting and not surrendering. 
+//------------------------------------------------------------------------------
+static Strategy solvePair (CDSolver *s, int card1, int card2)
+{
+  const Rules *rules = s->chart->rules; 
+  Strategy strat, candidate; 
+  CDHolding holding; 
+  double ddWin, ddLoss, splitWin, splitLoss, pBJ, q; 
+  uint64_t key = RANK_UNIT(card1) + RANK_UNIT(card2); 
+  int hand = handByCards[card1][card2]; 
+
+  takeCard(s, card1); 
+  takeCard(s, card2); 
+
+  //Plays are compared before the dealer's blackjack is known only if he has
+  //no hole card 
+  pBJ = getProbOfDealerBJ(s); 
+  q = rules->holeCard ? 0. : pBJ; 
+
+  holding = solveHolding(s, hand, key, 2); 
+  strat.action = holding.action; 
+  strat.winPct = holding.winPct; 
+  strat.lossPct = holding.lossPct; 
+  strat.splitEV = 0.; 
+  strat.surrender = FALSE; 
+
+  if (isDoubleAllowed(hands[hand], rules))
+  {
+    getDoubleProbs(s, hand, key, &ddWin, &ddLoss); 
+    candidate = strat; 
+    candidate.action = DOUBLE_DOWN; 
+    candidate.winPct = ddWin; 
+    candidate.lossPct = ddLoss; 
+    if (getEVBeforePeek(candidate, hand, q, rules) 
+        > getEVBeforePeek(strat, hand, q, rules))
+      strat = candidate; 
+  }
+
+  if (card1 == card2)
+  {
+    candidate = strat; 
+    candidate.action = SPLIT; 
+    candidate.splitEV = getCDSplitEV(s, card1, &splitWin, &splitLoss); 
+    candidate.winPct = splitWin; 
+    candidate.lossPct = splitLoss; 
+    if (getEVBeforePeek(candidate, hand, q, rules) 
+        > getEVBeforePeek(strat, hand, q, rules))
+      strat = candidate; 
+  }
+
+  if (rules->surrender != SURRENDER_NONE && hand != SOFT_TWENTYONE)
+  {
+    if (rules->surrender == SURRENDER_EARLY)
+      q = pBJ; 
+    candidate = strat; 
+    candidate.surrender = TRUE; 
+    strat.surrender = getEVBeforePeek(candidate, hand, q, rules) 
+      > getEVBeforePeek(strat, hand, q, rules); 
+  }
+
+  returnCard(s, card2); 
+  returnCard(s, card1); 
+  return strat; 
+}
+
+
+//------------------------------------------------------------------------------
+// Returns the probability that the dealer's hole card, drawn from the solver's
+// shoe, gives him blackjack. 
+//------------------------------------------------------------------------------
+static double getProbOfDealerBJ (CDSolver *s)
+{
+  if (s->upCard == 1)
+    return (double) s->left[10] / s->nleft; 
+  else if (s->upCard == 10)
+    return (double) s->left[1] / s->nleft; 
+  else 
+    return 0.; 
+}
+
+
+//------------------------------------------------------------------------------
+// Returns the best play of the holding identified by key, whose hand is 
+// hands[hand], when the choices are to hit or stand. The solver's shoe must 
+// have the holding (and the up card) removed; it has ncards cards. Results 
+// are memoized in the solver's table. 
+//------------------------------------------------------------------------------
+static CDHolding solveHolding (CDSolver *s, int hand, uint64_t key, 
+                      int ncards)
+{
+  CDHolding holding, child; 
+  CDHolding *e; 
+  double hitWin, hitLoss, p; 
+  int rank, next, charlie = s->chart->rules->charlie; 
+
+  if (charlie && ncards >= charlie) //wins outright, so isn't worth storing 
+  {
+    holding.key = key; 
+    holding.standWin = holding.winPct = 1.; 
+    holding.standLoss = holding.lossPct = 0.; 
+    holding.action = STAND; 
+    return holding; 
+  }
+
+  e = findHolding(s->table, key); 
+  if (e->key == key)
+    return *e; 
+
+  holding.key = key; 
+  getStandProbs(s, hand, &holding.standWin, &holding.standLoss); 
+  holding.action = STAND; 
+  holding.winPct = holding.standWin; 
+  holding.lossPct = holding.standLoss; 
+
+  if (hands[hand].value < 21)
+  {
+    hitWin = 0.; 
+    hitLoss = 0.; 
+    for (rank = 1; rank <= NUM_CARDS; rank++)
+    {
+      if (s->left[rank] <= 0)
+        continue; 
+      p = (double) s->left[rank] / s->nleft; 
+      next = handAfterCard[hand][rank]; 
+      if (next == BUST)
+      {
+        hitLoss += p; 
+        continue; 
+      }
+
+      takeCard(s, rank); 
+      child = solveHolding(s, next, key + RANK_UNIT(rank), ncards + 1); 
+      returnCard(s, rank); 
+      hitWin += p * child.winPct; 
+      hitLoss += p * child.lossPct; 
+    }
+
+    if (shouldHit(hitWin, hitLoss, holding.standWin, holding.standLoss))
+    {
+      holding.action = HIT; 
+      holding.winPct = hitWin; 
+      holding.lossPct = hitLoss; 
+    }
+  }
+
+  //The table may have grown while the children were solved, so the slot is 
+  //found again 
+  e = findHolding(s->table, key); 
+  *e = holding; 
+  s->table->nused++; 
+  if (2 * s->table->nused > s->table->size)
+    growHoldingTable(s->table); 
+
+  return holding; 
+}
+
+
+//------------------------------------------------------------------------------
+// Computes the probabilities of winning and losing by standing on hands[hand], 
+// with the dealer drawing from the solver's shoe. 
+//------------------------------------------------------------------------------
+static void getStandProbs (CDSolver *s, int hand, double *win, double *loss)
+{
+  double probs[BUST_VALUE+1]; 
+  int value = hands[hand].value; 
+  int total; 
+
+  if (hand == BUST)
+  {
+    *win = 0.; 
+    *loss = 1.; 
+    return; 
+  }
+
+  dealerOutcomeProbs(s->cache, s->left, s->upCard, TRUE, probs); 
+  *win = probs[BUST_VALUE]; 
+  *loss = 0.; 
+  for (total = 17; total <= 21; total++)
+  {
+    if (total < value)
+      *win += probs[total]; 
+    else if (total > value)
+      *loss += probs[total]; 
+  }
+}
+
+
+//------------------------------------------------------------------------------
+// Computes the probabilities of winning and losing after doubling down on the 
+// two-card holding identified by key, whose hand is hands[hand]. 
+//------------------------------------------------------------------------------
+static void getDoubleProbs (CDSolver *s, int hand, uint64_t key, 
+                   double *win, double *loss)
+{
+  CDHolding child; 
+  double p; 
+  int rank, next; 
+
+  *win = 0.; 
+  *loss = 0.; 
+  for (rank = 1; rank <= NUM_CARDS; rank++)
+  {
+    if (s->left[rank] <= 0)
+      continue; 
+    p = (double) s->left[rank] / s->nleft; 
+    next = handAfterCard[hand][rank]; 
+    if (next == BUST)
+    {
+      *loss += p; 
+      continue; 
+    }
+
+    takeCard(s, rank); 
+    child = solveHolding(s, next, key + RANK_UNIT(rank), 3); 
+    returnCard(s, rank); 
+    *win += p * child.standWin; 
+    *loss += p * child.standLoss; 
+  }
+}
+
+
+//------------------------------------------------------------------------------
+// Returns the expected value of splitting a pair of card, whose two cards must 
+// already have been removed from the solver's shoe, resplitting as the rules 
+// allow (up to MAX_CD_SPLIT_HANDS hands), and sets win and loss to the 
+// average probabilities of winning and losing each of the hands. 
+// 
+// evaluateSplit works through the hands, memoizing the value of the hands 
+// still to be played by the number of hands in play and the number of cards 
+// of the split rank out of the shoe. Each hand is played on the shoe with all 
+// of those cards removed, but not the others that the other hands draw: it 
+// may be hit, stood or (if the rules allow doubling after a split) doubled, 
+// or only stood on if it is a split ace that the rules don't let be hit. 
+//------------------------------------------------------------------------------
+static double getCDSplitEV (CDSolver *s, int card, double *win, double *loss)
+{
+  CDSplit split; 
+  SplitResult result; 
+  int maxHands = getMaxSplitHands(card, s->chart->rules); 
+
+  if (maxHands == 0 || maxHands > MAX_CD_SPLIT_HANDS)
+    maxHands = MAX_CD_SPLIT_HANDS; 
+  split.s = s; 
+  split.card = card; 
+  result = evaluateSplit(maxHands, s->left[card] + 2, getCDSplitValue, 
+                 &split); 
+
+  *win = result.win / result.nhands; 
+  *loss = result.loss / result.nhands; 
+  return result.ev; 
+}
+
+
+//------------------------------------------------------------------------------
+// SplitHandFn for getCDSplitEV: finds the value of a hand after splitting a 
+// pair of split->card, or of a pair of them if isPair is true, with removed 
+// cards of that rank (the pair's two among them) out of the solver's shoe. 
+//------------------------------------------------------------------------------
+static void getCDSplitValue (int removed, int isPair, SplitHandValue *value, 
+                    void *arg)
+{
+  CDSplit *split = (CDSplit *) arg; 
+  CDSolver *s = split->s; 
+  int card = split->card; 
+  int standOnly = card == 1 && !(s->chart->rules->hitSplitAces); 
+  double ev, win, loss, p; 
+  uint64_t key; 
+  int rank, k; 
+
+  for (k = 2; k < removed; k++)
+    takeCard(s, card); 
+
+  //A pair that may not be split again holds two 
+  if (isPair)
+  {
+    key = EXTRA_KEY(card, removed - 2) + 2 * RANK_UNIT(card); 
+    value->pairEV = getCDSplitHandProbs(s, handByCards[card][card], key, 
+                               standOnly, &value->pairWin, 
+                               &value->pairLoss); 
+  }
+  
+  //A new hand holds one card of the split rank, and the other hands the rest
+  else 
+  {
+    value->ev = value->win = value->loss = 0.; 
+    for (rank = 1; rank <= NUM_CARDS; rank++)
+    {
+      if (rank == card || s->left[rank] <= 0)
+        continue; 
+      p = (double) s->left[rank] / s->nleft; 
+      key = EXTRA_KEY(card, removed - 1) + RANK_UNIT(card) + RANK_UNIT(rank);
+      
+      takeCard(s, rank); 
+      ev = getCDSplitHandProbs(s, handByCards[card][rank], key, standOnly, 
+                       &win, &loss); 
+      returnCard(s, rank); 
+      
+      value->ev += p * ev; 
+      value->win += p * win; 
+      value->loss += p * loss; 
+    }
+    value->pairProb = (double) s->left[card] / s->nleft; 
+  }
+
+  for (k = 2; k < removed; k++)
+    returnCard(s, card); 
+}
+
+
+//------------------------------------------------------------------------------
+// Returns the expected value of the best play of one of the hands after a 
+// split, the two-card holding identified by key whose hand is hands[hand], 
+// and sets win and loss to its probabilities of winning and losing. The 
+// solver's shoe must have the holding removed. If standOnly is true, the hand 
+// may only be stood on. 
+//------------------------------------------------------------------------------
+static double getCDSplitHandProbs (CDSolver *s, int hand, uint64_t key, 
+                          int standOnly, double *win, double *loss)
+{
+  const Rules *rules = s->chart->rules; 
+  CDHolding holding; 
+  double ddWin, ddLoss; 
+
+  holding = solveHolding(s, hand, key, 2); 
+  if (standOnly)
+  {
+    *win = holding.standWin; 
+    *loss = holding.standLoss; 
+    return *win - *loss; 
+  }
+
+  *win = holding.winPct; 
+  *loss = holding.lossPct; 
+  if (rules->doubleAfterSplit && isDoubleAllowed(hands[hand], rules))
+  {
+    getDoubleProbs(s, hand, key, &ddWin, &ddLoss); 
+    if (2. * (ddWin - ddLoss) > *win - *loss)
+    {
+      *win = ddWin; 
+      *loss = ddLoss; 
+      return 2. * (ddWin - ddLoss); 
+    }
+  }
+  return *win - *loss; 
+}
+
+
+//------------------------------------------------------------------------------
+// Returns the player's expected value per hand with the solved chart, taking 
+// the probability of each deal (two cards and an up card) from the shoe and 
+// allowing for blackjacks. 
+//------------------------------------------------------------------------------
+static double getCDExpectedValue (CDChart *chart)
+{
+  const int *counts = chart->counts; 
+  const Rules *rules = chart->rules; 
+  double ev, p, probDealerBJ, evNoDealerBJ, evDealerBJ; 
+  int n, card1, card2, upCard, hand, left; 
+  Strategy strat; 
+
+  n = 0; 
+  for (card1 = 1; card1 <= NUM_CARDS; card1++)
+    n += counts[card1]; 
+
+  ev = 0.; 
+  for (card1 = 1; card1 <= NUM_CARDS; card1++)
+  {
+    for (card2 = 1; card2 <= NUM_CARDS; card2++)
+    {
+      for (upCard = 1; upCard <= NUM_CARDS; upCard++)
+      {
+        p = (double) counts[card1] / n 
+          * (counts[card2] - (card2 == card1)) / (n - 1)
+          * (counts[upCard] - (upCard == card1) - (upCard == card2)) / (n - 2); 
+
+        //Probability that the hole card gives the dealer blackjack 
+        probDealerBJ = 0.; 
+        if (upCard == 1 || upCard == 10)
+        {
+          left = upCard == 1 ? 10 : 1; 
+          probDealerBJ = (double) (counts[left] - (card1 == left)
+            - (card2 == left)) / (n - 3); 
+        }
+
+        hand = handByCards[card1][card2]; 
+        strat = chart->strat[card1][card2][upCard]; 
+        evDealerBJ = getEVDealerBJ(strat, hand, rules); 
+        evNoDealerBJ = hand == SOFT_TWENTYONE ? rules->blackjackPays 
+          : getStratEV(strat); 
+
+        ev += p * (probDealerBJ * evDealerBJ 
+          + (1. - probDealerBJ) * evNoDealerBJ); 
+      }
+    }
+  }
+
+  return ev; 
+}
+
+
+//------------------------------------------------------------------------------
+// Returns the entry of the table that holds key, or the empty entry where it 
+// should be stored. The table is open-addressed with linear probing, and is 
+// never more than half full. 
+//------------------------------------------------------------------------------
+static CDHolding * findHolding (CDHoldingTable *table, uint64_t key)
+{
+  const uint64_t GOLDEN = 0x9e3779b97f4a7c15ULL; //multiplier for hashing 
+  unsigned i, mask = (unsigned) table->size - 1; 
+
+  i = (unsigned) ((key * GOLDEN) >> 32) & mask; 
+  while (table->entry[i].key != 0 && table->entry[i].key != key)
+    i = (i + 1) & mask; 
+  return table->entry + i; 
+}
+
+
+//------------------------------------------------------------------------------
+// Doubles the size of a table, rehashing its entries. 
+//------------------------------------------------------------------------------
+static void growHoldingTable (CDHoldingTable *table)
+{
+  CDHolding *old = table->entry; 
+  int oldSize = table->size; 
+  int i; 
+
+  table->size *= 2; 
+  table->entry = (CDHolding *) calloc(table->size, sizeof(CDHolding)); 
+  if (table->entry == NULL) throwMemErr("table->entry", "growHoldingTable"); 
+
+  for (i = 0; i < oldSize; i++)
+    if (old[i].key != 0)
+      *findHolding(table, old[i].key) = old[i]; 
+  free(old); 
+}
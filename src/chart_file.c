@@ -0,0 +1,345 @@
+#include "chart_file.h" 
+#include <stdio.h> 
+#include <stdlib.h> 
+#include <string.h> 
+#include <fcntl.h> 
+#include <unistd.h> 
+#include <sys/mman.h> 
+#include <sys/stat.h> 
+#include "boolean.h" 
+#include "error.h" 
+#include "hands.h" 
+
+static const char CHART_FILE_MAGIC[8] = "BJCHART"; 
+static const uint32_t BYTE_ORDER_MARK = 0x01020304; 
+
+static void getSectionSizes (const ChartFileHeader *header, size_t *size); 
+static void writeSection (FILE *file, const void *data, size_t size, 
+                 uint64_t offset); 
+static void checkHeader (const ChartFileHeader *header, size_t fileSize); 
+static double ** getRows (const double *data, int M, int N); 
+
+
+//------------------------------------------------------------------------------
+// Saves the chart, solved for the given rules on the calling thread (whose 
+// dealer's table and hit/stand tables are saved with it; see getStratTables), 
+// to a chart file that loadChartFile can map. 
+//------------------------------------------------------------------------------
+void saveChartFile (const char *filename, const StrategyTable *chart, 
+              const Rules *rules)
+{
+  ChartFileHeader header; 
+  StratTables tables = getStratTables(); 
+  size_t size[NUM_CHART_SECTIONS]; 
+  size_t ncells = NUM_HANDS * (NUM_CARDS+1); 
+  uint64_t offset; 
+  double *ev = NULL; 
+  double *dealer = NULL, *transition = NULL; 
+  FILE *file = NULL; 
+  int i, j, s; 
+
+  if (hands == NULL || tables.dealersProbabilities == NULL 
+      || tables.hitTransitionMatrix == NULL || tables.hitStandActions == NULL)
+    throwErr("The chart has not been solved on this thread.", 
+      "saveChartFile"); 
+  if (chart->nhands != NUM_HANDS)
+    throwErr("Only a full chart can be saved.", "saveChartFile"); 
+
+  memset(&header, 0, sizeof(header)); 
+  memcpy(header.magic, CHART_FILE_MAGIC, sizeof(header.magic)); 
+  header.version = CHART_FILE_VERSION; 
+  header.byteOrder = BYTE_ORDER_MARK; 
+  header.headerSize = sizeof(ChartFileHeader); 
+  header.intSize = sizeof(int); 
+  header.handSize = sizeof(Hand); 
+  header.rulesSize = sizeof(Rules); 
+  header.numHands = NUM_HANDS; 
+  header.numHandsSimple = NUM_HANDS_SIMPLE; 
+  header.numCards = NUM_CARDS; 
+  header.numOutcomes = DEALER_ROW_SIZE; 
+  header.numHitStandLevels = tables.numHitStandLevels; 
+  header.numPlayEVs = NUM_PLAY_EVS; 
+  header.ev = getExpectedValue(chart, rules); 
+
+  //Lay out the sections one after another, each aligned 
+  getSectionSizes(&header, size); 
+  offset = sizeof(ChartFileHeader); 
+  for (s = 0; s < NUM_CHART_SECTIONS; s++)
+  {
+    offset = (offset + CHART_FILE_ALIGN - 1) / CHART_FILE_ALIGN 
+      * CHART_FILE_ALIGN; 
+    header.offset[s] = offset; 
+    offset += size[s]; 
+  }
+  header.fileSize = offset; 
+
+  //The matrices are written by rows, which need not be next to each other 
+  dealer = (double *) malloc(size[CHART_SECTION_DEALER]); 
+  transition = (double *) malloc(size[CHART_SECTION_HIT_TRANSITION]); 
+  ev = (double *) malloc(size[CHART_SECTION_EV]); 
+  if (dealer == NULL || transition == NULL || ev == NULL)
+    throwMemErr("dealer", "saveChartFile"); 
+  for (i = 0; i <= NUM_CARDS; i++)
+    memcpy(dealer + i * DEALER_ROW_SIZE, tables.dealersProbabilities[i], 
+      DEALER_ROW_SIZE * sizeof(double)); 
+  for (i = 0; i < NUM_HANDS_SIMPLE; i++)
+    memcpy(transition + i * NUM_HANDS_SIMPLE, tables.hitTransitionMatrix[i], 
+      NUM_HANDS_SIMPLE * sizeof(double)); 
+  for (i = 0; i < NUM_HANDS; i++)
+  {
+    ev[STRAT_CELL(i, 0)] = 0.; 
+    for (j = 1; j <= NUM_CARDS; j++)
+      ev[STRAT_CELL(i, j)] = getStratEV(getStrat(chart, i, j)); 
+  }
+
+  file = fopen(filename, "wb"); 
+  if (file == NULL) throwErr("File could not be opened.", "saveChartFile"); 
+  if (fwrite(&header, sizeof(header), 1, file) != 1)
+    throwErr("Could not write the file.", "saveChartFile"); 
+  writeSection(file, rules, size[CHART_SECTION_RULES], 
+    header.offset[CHART_SECTION_RULES]); 
+  writeSection(file, hands, size[CHART_SECTION_HANDS], 
+    header.offset[CHART_SECTION_HANDS]); 
+  writeSection(file, dealer, size[CHART_SECTION_DEALER], 
+    header.offset[CHART_SECTION_DEALER]); 
+  writeSection(file, transition, size[CHART_SECTION_HIT_TRANSITION], 
+    header.offset[CHART_SECTION_HIT_TRANSITION]); 
+  writeSection(file, tables.hitStandActions, size[CHART_SECTION_HIT_STAND], 
+    header.offset[CHART_SECTION_HIT_STAND]); 
+  writeSection(file, chart->winPct, ncells * sizeof(double), 
+    header.offset[CHART_SECTION_WIN]); 
+  writeSection(file, chart->lossPct, ncells * sizeof(double), 
+    header.offset[CHART_SECTION_LOSS]); 
+  writeSection(file, chart->splitEV, ncells * sizeof(double), 
+    header.offset[CHART_SECTION_SPLIT_EV]); 
+  writeSection(file, ev, ncells * sizeof(double), 
+    header.offset[CHART_SECTION_EV]); 
+  writeSection(file, chart->action, ncells * sizeof(int), 
+    header.offset[CHART_SECTION_ACTION]); 
+  writeSection(file, chart->surrender, ncells * sizeof(int), 
+    header.offset[CHART_SECTION_SURRENDER]); 
+  writeSection(file, chart->playEV, size[CHART_SECTION_PLAY_EV], 
+    header.offset[CHART_SECTION_PLAY_EV]); 
+  if (fclose(file) != 0)
+    throwErr("Could not write the file.", "saveChartFile"); 
+
+  free(dealer); 
+  free(transition); 
+  free(ev); 
+}
+
+
+//------------------------------------------------------------------------------
+// Maps a file written by saveChartFile into memory, read-only and shared with 
+// every other process that maps it, and returns the chart and tables in it, 
+// which are not copied. makeHands must have been called; the hands in the 
+// file must be the same. The chart is played by on a thread once it has 
+// called useStratTables(file->tables), with file->rules. 
+//------------------------------------------------------------------------------
+ChartFile * loadChartFile (const char *filename)
+{
+  ChartFile *file = NULL; 
+  const ChartFileHeader *header; 
+  const char *base; 
+  struct stat st; 
+  void *map; 
+  int fd; 
+
+  if (hands == NULL)
+    throwErr("makeHands has not been called.", "loadChartFile"); 
+
+  fd = open(filename, O_RDONLY); 
+  if (fd < 0) throwErr("File could not be opened.", "loadChartFile"); 
+  if (fstat(fd, &st) != 0 || st.st_size < (off_t) sizeof(ChartFileHeader))
+    throwErr("Not a chart file.", "loadChartFile"); 
+  map = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0); 
+  if (map == MAP_FAILED) 
+    throwErr("File could not be mapped.", "loadChartFile"); 
+  close(fd); //the mapping stays 
+
+  header = (const ChartFileHeader *) map; 
+  checkHeader(header, st.st_size); 
+  base = (const char *) map; 
+  if (memcmp(base + header->offset[CHART_SECTION_HANDS], hands, 
+        NUM_HANDS * sizeof(Hand)))
+    throwErr("The file's hands differ from the program's.", "loadChartFile"); 
+
+  file = (ChartFile *) malloc(sizeof(ChartFile)); 
+  if (file == NULL) throwMemErr("file", "loadChartFile"); 
+  file->header = header; 
+  file->map = map; 
+  file->size = st.st_size; 
+  memcpy(&file->rules, base + header->offset[CHART_SECTION_RULES], 
+    sizeof(Rules)); 
+
+  file->chart.nhands = NUM_HANDS; 
+  file->chart.winPct = (double *) (base + header->offset[CHART_SECTION_WIN]); 
+  file->chart.lossPct = (double *) (base + header->offset[CHART_SECTION_LOSS]); 
+  file->chart.splitEV = (double *) (base 
+    + header->offset[CHART_SECTION_SPLIT_EV]); 
+  file->chart.action = (int *) (base + header->offset[CHART_SECTION_ACTION]); 
+  file->chart.surrender = (int *) (base 
+    + header->offset[CHART_SECTION_SURRENDER]); 
+  file->chart.playEV = (double *) (base 
+    + header->offset[CHART_SECTION_PLAY_EV]); 
+  file->ev = (const double *) (base + header->offset[CHART_SECTION_EV]); 
+
+  file->tables.dealersProbabilities = getRows((const double *) (base 
+    + header->offset[CHART_SECTION_DEALER]), NUM_CARDS+1, DEALER_ROW_SIZE); 
+  file->tables.hitTransitionMatrix = getRows((const double *) (base 
+    + header->offset[CHART_SECTION_HIT_TRANSITION]), NUM_HANDS_SIMPLE, 
+    NUM_HANDS_SIMPLE); 
+  file->tables.hitStandActions = (int (*)[NUM_CARDS+1]) (base 
+    + header->offset[CHART_SECTION_HIT_STAND]); 
+  file->tables.numHitStandLevels = header->numHitStandLevels; 
+
+  return file; 
+}
+
+
+//------------------------------------------------------------------------------
+// Unmaps a file mapped by loadChartFile. No thread may still be using its 
+// tables. 
+//------------------------------------------------------------------------------
+void closeChartFile (ChartFile *file)
+{
+  if (file == NULL)
+    return; 
+  free(file->tables.dealersProbabilities); 
+  free(file->tables.hitTransitionMatrix); 
+  munmap(file->map, file->size); 
+  free(file); 
+}
+
+
+//------------------------------------------------------------------------------
+// Takes the options 
+//   --save FILE      save the chart to FILE once it is solved 
+//   --load FILE      load the chart from FILE instead of solving it, with the 
+//                    rules it was solved for 
+// out of the command-line arguments into args, leaving the rest (including 
+// the rules options, for parseRulesArgs) in argv. Returns the number of 
+// arguments left. 
+//------------------------------------------------------------------------------
+int parseChartFileArgs (ChartFileArgs *args, int argc, char **argv)
+{
+  int i, n; 
+
+  args->save = NULL; 
+  args->load = NULL; 
+  n = 1; 
+  for (i = 1; i < argc; i++)
+  {
+    if (strcmp(argv[i], "--save") && strcmp(argv[i], "--load"))
+    {
+      argv[n++] = argv[i]; 
+      continue; 
+    }
+    if (i + 1 >= argc)
+      throwErr("Missing value for an option.", "parseChartFileArgs"); 
+    if (!strcmp(argv[i], "--save"))
+      args->save = argv[++i]; 
+    else 
+      args->load = argv[++i]; 
+  }
+
+  argv[n] = NULL; 
+  return n; 
+}
+
+
+//------------------------------------------------------------------------------
+// Fills size with the number of bytes in each section of a file with the 
+// given header. 
+//------------------------------------------------------------------------------
+static void getSectionSizes (const ChartFileHeader *header, size_t *size)
+{
+  size_t ncells = (size_t) header->numHands * (header->numCards + 1); 
+  int s; 
+
+  size[CHART_SECTION_RULES] = sizeof(Rules); 
+  size[CHART_SECTION_HANDS] = header->numHands * sizeof(Hand); 
+  size[CHART_SECTION_DEALER] = (size_t) (header->numCards + 1)
+    * header->numOutcomes * sizeof(double); 
+  size[CHART_SECTION_HIT_TRANSITION] = (size_t) header->numHandsSimple 
+    * header->numHandsSimple * sizeof(double); 
+  size[CHART_SECTION_HIT_STAND] = (size_t) header->numHitStandLevels 
+    * header->numHandsSimple * (header->numCards + 1) * sizeof(int); 
+  for (s = CHART_SECTION_WIN; s <= CHART_SECTION_EV; s++)
+    size[s] = ncells * sizeof(double); 
+  size[CHART_SECTION_ACTION] = ncells * sizeof(int); 
+  size[CHART_SECTION_SURRENDER] = ncells * sizeof(int); 
+  size[CHART_SECTION_PLAY_EV] = ncells * header->numPlayEVs * sizeof(double); 
+}
+
+
+//------------------------------------------------------------------------------
+// Writes size bytes of data to file at offset, padding with zeros from where 
+// the file has got to. 
+//------------------------------------------------------------------------------
+static void writeSection (FILE *file, const void *data, size_t size, 
+                 uint64_t offset)
+{
+  long at = ftell(file); 
+
+  for (; at >= 0 && (uint64_t) at < offset; at++)
+    fputc(0, file); 
+  if (at < 0 || fwrite(data, 1, size, file) != size)
+    throwErr("Could not write the file.", "writeSection"); 
+}
+
+
+//------------------------------------------------------------------------------
+// Checks that a mapped file of fileSize bytes is a chart file that this 
+// program can read in place, and exits with an error if not. 
+//------------------------------------------------------------------------------
+static void checkHeader (const ChartFileHeader *header, size_t fileSize)
+{
+  size_t size[NUM_CHART_SECTIONS]; 
+  int s; 
+
+  if (memcmp(header->magic, CHART_FILE_MAGIC, sizeof(header->magic)))
+    throwErr("Not a chart file.", "checkHeader"); 
+  if (header->version != CHART_FILE_VERSION)
+    throwErr("Unsupported version of the chart file.", "checkHeader"); 
+  if (header->byteOrder != BYTE_ORDER_MARK 
+      || header->headerSize != sizeof(ChartFileHeader)
+      || header->intSize != sizeof(int) || header->handSize != sizeof(Hand)
+      || header->rulesSize != sizeof(Rules))
+    throwErr("The chart file was written on a different platform.", 
+      "checkHeader"); 
+  if (header->numHands != NUM_HANDS 
+      || header->numHandsSimple != NUM_HANDS_SIMPLE 
+      || header->numCards != NUM_CARDS 
+      || header->numOutcomes != DEALER_ROW_SIZE 
+      || header->numHitStandLevels < 1 
+      || header->numPlayEVs != NUM_PLAY_EVS)
+    throwErr("The chart file's hands differ from the program's.", 
+      "checkHeader"); 
+  if (header->fileSize != fileSize)
+    throwErr("The chart file is truncated.", "checkHeader"); 
+
+  getSectionSizes(header, size); 
+  for (s = 0; s < NUM_CHART_SECTIONS; s++)
+    if (header->offset[s] % CHART_FILE_ALIGN != 0 
+        || header->offset[s] < sizeof(ChartFileHeader)
+        || header->offset[s] > fileSize 
+        || size[s] > fileSize - header->offset[s])
+      throwErr("The chart file is corrupt.", "checkHeader"); 
+}
+
+
+//------------------------------------------------------------------------------
+// Returns row pointers to the M x N matrix stored by rows at data, which is 
+// not copied. 
+//------------------------------------------------------------------------------
+static double ** getRows (const double *data, int M, int N)
+{
+  double **A = (double **) malloc(M * sizeof(double *)); 
+  int i; 
+
+  if (A == NULL) throwMemErr("A", "getRows"); 
+  for (i = 0; i < M; i++)
+    A[i] = (double *) (data + (size_t) i * N); 
+  return A; 
+}
@@ -0,0 +1,256 @@
+#include "dealer.h" 
+#include <stdlib.h> 
+#include <string.h> 
+#include "boolean.h" 
+#include "error.h" 
+#include "hands.h" 
+
+//A partial dealer hand is identified by its up card and the number of cards 
+//of each rank that have been drawn to it, packed into a key. The drawn counts 
+//take RANK_BITS bits each, aces lowest, and the up card the bits above them. 
+//No rank can be drawn more than 31 times before the dealer stands. 
+#define RANK_BITS (5)
+#define RANK_MASK ((1 << RANK_BITS) - 1)
+#define UP_CARD_SHIFT (RANK_BITS * NUM_CARDS)
+
+//Largest fraction of the cache that is filled before further results are no 
+//longer memoized, so that probe sequences stay short 
+static const double MAX_LOAD = 0.75; 
+
+static void dealerFrom (DealerCache *cache, int hand, uint64_t key, 
+               int ndrawn, double *prob); 
+static DealerCacheEntry * findEntry (DealerCache *cache, uint64_t key); 
+static void setComposition (DealerCache *cache, const int *counts); 
+static int finalTotalIndex (int value); 
+
+
+//------------------------------------------------------------------------------
+// Makes an empty cache for dealerOutcomeProbs, for a dealer who plays by rules,
+// which must outlive the cache. 
+//------------------------------------------------------------------------------
+DealerCache * newDealerCache (const Rules *rules)
+{
+  DealerCache *cache = NULL; 
+
+  cache = (DealerCache *) malloc(sizeof(DealerCache)); 
+  if (cache == NULL) throwMemErr("cache", "newDealerCache"); 
+  cache->entry = (DealerCacheEntry *) calloc(DEALER_CACHE_SIZE, 
+                         sizeof(DealerCacheEntry)); 
+  if (cache->entry == NULL) throwMemErr("cache->entry", "newDealerCache"); 
+
+  //Generation 0 marks the empty entries made by calloc, so the first 
+  //composition is given generation 1 
+  cache->gen = 0; 
+  cache->ncards = -1; //matches no composition 
+  cache->rules = rules; 
+  return cache; 
+}
+
+
+//------------------------------------------------------------------------------
+// Frees a cache made by newDealerCache. 
+//------------------------------------------------------------------------------
+void freeDealerCache (DealerCache *cache)
+{
+  if (cache == NULL)
+    return; 
+  free(cache->entry); 
+  free(cache); 
+}
+
+
+//------------------------------------------------------------------------------
+// Computes the exact probability that the dealer ends up with each total, given 
+// his up card and the cards he draws from: counts[k] is the number of cards of 
+// rank k (1-10) left in the shoe, with the up card (and any other cards that 
+// have been seen) already removed. The dealer plays by the rules the cache 
+// was made with, as in doesDealerStand. If noBlackjack is true, the 
+// distribution is conditioned on the dealer not having blackjack, as when he 
+// has already checked his hole card; otherwise a blackjack counts as 21. 
+// 
+// probs is filled like a row of dealersProbabilities: probs[v] for v = 0-22 is 
+// the probability of a final total of v, with 22 meaning bust. 
+// 
+// Every partial dealer hand is evaluated once per composition by recursing 
+// over the cards it could draw; the results are memoized in cache, which must 
+// be made with newDealerCache. Calls with the same composition for different 
+// up cards share the cache. Requires makeHands to have been called. 
+//------------------------------------------------------------------------------
+void dealerOutcomeProbs (DealerCache *cache, const int *counts, int upCard, 
+               int noBlackjack, double *probs)
+{
+  double sub[NUM_DEALER_TOTALS]; 
+  double prob[NUM_DEALER_TOTALS]; 
+  double p, total; 
+  int hole, k; 
+
+  if (upCard < 1 || upCard > NUM_CARDS)
+    throwErr("Invalid up card.", "dealerOutcomeProbs"); 
+  setComposition(cache, counts); 
+
+  //Number of cards the hole card may be, which excludes the card that would 
+  //give the dealer blackjack if he has checked for it 
+  total = cache->ncards; 
+  if (noBlackjack && (upCard == 1 || upCard == 10))
+    total -= counts[upCard == 1 ? 10 : 1]; 
+  if (total <= 0.)
+    throwErr("No cards left for the dealer to draw.", "dealerOutcomeProbs"); 
+
+  for (k = 0; k < NUM_DEALER_TOTALS; k++)
+    prob[k] = 0.; 
+
+  for (hole = 1; hole <= NUM_CARDS; hole++)
+  {
+    if (counts[hole] <= 0)
+      continue; 
+    if (noBlackjack && upCard + hole == 11 && (upCard == 1 || hole == 1))
+      continue; 
+
+    p = counts[hole] / total; 
+    dealerFrom(cache, dealerHandByCards[upCard][hole], 
+      ((uint64_t) upCard << UP_CARD_SHIFT)
+        + ((uint64_t) 1 << (RANK_BITS * (hole - 1))), 1, sub); 
+    for (k = 0; k < NUM_DEALER_TOTALS; k++)
+      prob[k] += p * sub[k]; 
+  }
+
+  for (k = 0; k <= BUST_VALUE; k++)
+    probs[k] = 0.; 
+  for (k = 0; k < NUM_DEALER_TOTALS; k++)
+    probs[17 + k] = prob[k]; 
+}
+
+
+//------------------------------------------------------------------------------
+// Computes the distribution of the dealer's final total (17-21, bust) from 
+// hands[hand], which is identified by key and was made by drawing ndrawn cards 
+// from the cache's composition, and stores it in prob. 
+//------------------------------------------------------------------------------
+static void dealerFrom (DealerCache *cache, int hand, uint64_t key, 
+               int ndrawn, double *prob)
+{
+  DealerCacheEntry *e; 
+  double sub[NUM_DEALER_TOTALS]; 
+  double p; 
+  int rank, left, next, k; 
+
+  for (k = 0; k < NUM_DEALER_TOTALS; k++)
+    prob[k] = 0.; 
+  if (doesDealerStand(hands[hand], cache->rules))
+  {
+    prob[finalTotalIndex(hands[hand].value)] = 1.; 
+    return; 
+  }
+
+  e = findEntry(cache, key); 
+  if (e != NULL && e->gen == cache->gen)
+  {
+    memcpy(prob, e->prob, sizeof(e->prob)); 
+    return; 
+  }
+
+  for (rank = 1; rank <= NUM_CARDS; rank++)
+  {
+    left = cache->counts[rank] 
+      - (int) ((key >> (RANK_BITS * (rank - 1))) & RANK_MASK); 
+    if (left <= 0)
+      continue; 
+
+    p = (double) left / (cache->ncards - ndrawn); 
+    next = handAfterCard[hand][rank]; 
+    //saves a call for the most common case 
+    if (doesDealerStand(hands[next], cache->rules))
+    {
+      prob[finalTotalIndex(hands[next].value)] += p; 
+      continue; 
+    }
+    dealerFrom(cache, next, key + ((uint64_t) 1 << (RANK_BITS * (rank - 1))), 
+      ndrawn + 1, sub); 
+    for (k = 0; k < NUM_DEALER_TOTALS; k++)
+      prob[k] += p * sub[k]; 
+  }
+
+  //If the shoe ran out, the hand is left as it is (prob is all zeros); this 
+  //can only happen with a nearly empty shoe 
+
+  //The hands drawn to above may have taken the slot found before, so it is 
+  //found again 
+  e = findEntry(cache, key); 
+  if (e != NULL)
+  {
+    e->key = key; 
+    e->gen = cache->gen; 
+    memcpy(e->prob, prob, sizeof(e->prob)); 
+    cache->nused++; 
+  }
+}
+
+
+//------------------------------------------------------------------------------
+// Returns the cache entry that holds key, or the empty entry where it should 
+// be stored, or NULL if it is not in the cache and the cache is too full to 
+// store it. The table is open-addressed with linear probing. 
+//------------------------------------------------------------------------------
+static DealerCacheEntry * findEntry (DealerCache *cache, uint64_t key)
+{
+  const uint64_t GOLDEN = 0x9e3779b97f4a7c15ULL; //multiplier for hashing 
+  DealerCacheEntry *e; 
+  unsigned i; 
+
+  i = (unsigned) ((key * GOLDEN) >> 32) & (DEALER_CACHE_SIZE - 1); 
+  for (;;)
+  {
+    e = cache->entry + i; 
+    if (e->gen != cache->gen)
+      return cache->nused < MAX_LOAD * DEALER_CACHE_SIZE ? e : NULL; 
+    if (e->key == key)
+      return e; 
+    i = (i + 1) & (DEALER_CACHE_SIZE - 1); 
+  }
+}
+
+
+//------------------------------------------------------------------------------
+// Makes the cache hold results for the given composition, discarding its 
+// entries if they were computed for a different one. 
+//------------------------------------------------------------------------------
+static void setComposition (DealerCache *cache, const int *counts)
+{
+  int k, ncards, same; 
+
+  same = TRUE; 
+  ncards = 0; 
+  for (k = 1; k <= NUM_CARDS; k++)
+  {
+    if (counts[k] < 0)
+      throwErr("Negative number of cards.", "dealerOutcomeProbs"); 
+    same = same && counts[k] == cache->counts[k]; 
+    ncards += counts[k]; 
+  }
+  if (same && ncards == cache->ncards)
+    return; 
+
+  for (k = 1; k <= NUM_CARDS; k++)
+    cache->counts[k] = counts[k]; 
+  cache->ncards = ncards; 
+  cache->nused = 0; 
+
+  //Start a new generation, which empties every entry at once. When the 
+  //counter wraps around, the entries must be cleared for real. 
+  cache->gen++; 
+  if (cache->gen == 0)
+  {
+    memset(cache->entry, 0, DEALER_CACHE_SIZE * sizeof(DealerCacheEntry)); 
+    cache->gen = 1; 
+  }
+}
+
+
+//------------------------------------------------------------------------------
+// Returns the index of a final dealer total (17-21, or BUST_VALUE) in the 
+// probability vectors used here. 
+//------------------------------------------------------------------------------
+static int finalTotalIndex (int value)
+{
+  return value - 17; 
+}
@@ -0,0 +1,199 @@
+#include "eor.h" 
+#include <stdlib.h> 
+#include "boolean.h" 
+#include "error.h" 
+#include "linal.h" 
+#include "parallel.h" 
+#include "hands.h" 
+
+//Decisions whose effects of removal are found: the ones that card counters 
+//most often vary 
+const KeyPlay KEY_PLAYS[] = { 
+  {16, 10, 0}, {15, 10, 0}, {16, 9, 0}, {13, 2, 0}, 
+  {13, 3, 0}, {12, 2, 0}, {12, 3, 0}, {12, 4, 0}, 
+  {12, 5, 0}, {12, 6, 0}, {11, 1, 1}, {10, 10, 1}, 
+  {10, 1, 1}, {9, 2, 1}, {9, 7, 1}, 
+}; 
+#define NKEY (sizeof(KEY_PLAYS) / sizeof(KeyPlay))
+const int NUM_KEY_PLAYS = NKEY; 
+
+//Fraction of a card that is removed to find each effect, as a derivative. 
+//Taking out a whole card would let the chart change its plays, which makes 
+//the effects add up to more than the change from removing several cards at 
+//once; for a small enough fraction no play changes, and the effects are 
+//those of the full shoe's strategy, as card-counting systems need. 
+static const double REMOVED_FRACTION = 1. / 64.; 
+
+//Results for one composition of the shoe: the full shoe (number 0) or the 
+//shoe less REMOVED_FRACTION of a card of rank 1-10 
+typedef struct { 
+  int skipped; //true if the shoe has no card of the rank to remove 
+  double ev; 
+  double keyGain[NKEY]; 
+  double insurance; 
+} EoRComposition; 
+
+//Work shared by all threads in computeEoR 
+typedef struct { 
+  const Rules *rules; 
+  EoRComposition comp[NUM_CARDS+1]; 
+  StrategyTable **charts; //two charts for each thread: the full chart, and the 
+                 //hit/stand chart that the key plays are valued from 
+} EoRJob; 
+
+static void solveCompositionTask (int task, int thread, void *arg); 
+static double getPlayEV (const StrategyTable *simple, int handIndex, 
+                 int upCard, int action); 
+
+
+//------------------------------------------------------------------------------
+// Finds the effects of removal for the given rules, solving the full shoe and 
+// the ten shoes with a card removed in parallel on nthreads threads. 
+// 
+// Each shoe is solved as an infinite shoe with its proportions of the cards, 
+// like the chart, and each effect is found from a small fraction of a card 
+// (REMOVED_FRACTION) and scaled up to a whole card. The dealer's table for 
+// each shoe is made once and used both for the chart, from which the expected 
+// value comes, and for valuing the key plays, which are compared as the chart 
+// compares hitting and standing (getHitWinProb, probOfWinGivenTotal) and 
+// doubling (getDDWinProb). 
+//------------------------------------------------------------------------------
+EoRSet * computeEoR (const Rules *rules, int nthreads)
+{
+  EoRSet *set = NULL; 
+  EoRJob job; 
+  int k, n, t; 
+
+  if (hands == NULL)
+    throwErr("makeHands has not been called.", "computeEoR"); 
+  if (nthreads < 1)
+    nthreads = 1; 
+
+  job.rules = rules; 
+  job.charts = (StrategyTable **) malloc(2 * nthreads 
+                                 * sizeof(StrategyTable *)); 
+  if (job.charts == NULL) throwMemErr("job.charts", "computeEoR"); 
+  for (t = 0; t < 2 * nthreads; t++)
+    job.charts[t] = newStrategyTable(NUM_HANDS); 
+
+  parallel_for(NUM_CARDS + 1, nthreads, solveCompositionTask, &job); 
+
+  set = (EoRSet *) malloc(sizeof(EoRSet)); 
+  if (set == NULL) throwMemErr("set", "computeEoR"); 
+  set->keyGain = (double *) malloc(NUM_KEY_PLAYS * sizeof(double)); 
+  if (set->keyGain == NULL) throwMemErr("set->keyGain", "computeEoR"); 
+  set->keyEoR = malloc(NUM_KEY_PLAYS * sizeof(*set->keyEoR)); 
+  if (set->keyEoR == NULL) throwMemErr("set->keyEoR", "computeEoR"); 
+
+  set->ev = job.comp[0].ev; 
+  set->insurance = job.comp[0].insurance; 
+  for (n = 0; n < NUM_KEY_PLAYS; n++)
+    set->keyGain[n] = job.comp[0].keyGain[n]; 
+  for (k = 0; k <= NUM_CARDS; k++)
+  {
+    set->eor[k] = set->insuranceEoR[k] = 0.; 
+    for (n = 0; n < NUM_KEY_PLAYS; n++)
+      set->keyEoR[n][k] = 0.; 
+    if (k == 0 || job.comp[k].skipped)
+      continue; 
+    set->eor[k] = (job.comp[k].ev - set->ev) / REMOVED_FRACTION; 
+    set->insuranceEoR[k] = (job.comp[k].insurance - set->insurance) 
+      / REMOVED_FRACTION; 
+    for (n = 0; n < NUM_KEY_PLAYS; n++)
+      set->keyEoR[n][k] = (job.comp[k].keyGain[n] - set->keyGain[n]) 
+        / REMOVED_FRACTION; 
+  }
+
+  for (t = 0; t < 2 * nthreads; t++)
+    freeStrategyTable(job.charts[t]); 
+  free(job.charts); 
+
+  return set; 
+}
+
+
+//------------------------------------------------------------------------------
+// Frees a set made by computeEoR. 
+//------------------------------------------------------------------------------
+void freeEoRSet (EoRSet *set)
+{
+  if (set == NULL)
+    return; 
+  free(set->keyGain); 
+  free(set->keyEoR); 
+  free(set); 
+}
+
+
+//------------------------------------------------------------------------------
+// Task for parallel_for in computeEoR: solves the full shoe (task 0) or the 
+// shoe less REMOVED_FRACTION of a card of rank task. 
+//------------------------------------------------------------------------------
+static void solveCompositionTask (int task, int thread, void *arg)
+{
+  EoRJob *job = (EoRJob *) arg; 
+  EoRComposition *comp = &job->comp[task]; 
+  StrategyTable *chart = job->charts[2 * thread]; 
+  StrategyTable *simple = job->charts[2 * thread + 1]; 
+  Rules rules = *job->rules; 
+  int counts[NUM_CARDS+1]; 
+  double left[NUM_CARDS+1]; //cards of each rank left in the shoe 
+  double ncards; 
+  int n, k; 
+
+  getShoeCounts(&rules, counts); 
+  comp->skipped = task > 0 && counts[task] == 0; 
+  if (comp->skipped)
+    return; 
+  ncards = 0.; 
+  for (k = 1; k <= NUM_CARDS; k++)
+  {
+    left[k] = counts[k] - (k == task ? REMOVED_FRACTION : 0.); 
+    ncards += left[k]; 
+  }
+  for (k = 1; k <= NUM_CARDS; k++)
+    rules.cardProbs[k] = left[k] / ncards; 
+
+  dealersProbabilities = makeDealersProbabilities(&rules); 
+
+  calculateSimpleChart(simple, &rules); 
+  for (n = 0; n < NUM_KEY_PLAYS; n++)
+  {
+    k = getHandIndex(makeHand(KEY_PLAYS[n].total, FALSE, FALSE, FALSE)); 
+    comp->keyGain[n] = getPlayEV(simple, k, KEY_PLAYS[n].upCard, 
+                            KEY_PLAYS[n].isDouble ? DOUBLE_DOWN : STAND)
+      - getPlayEV(simple, k, KEY_PLAYS[n].upCard, HIT); 
+  }
+
+  calculateStrategyChart(chart, FALSE, &rules); 
+  comp->ev = getExpectedValue(chart, &rules); 
+
+  //Insurance pays 2 to 1 if the card under the dealer's ace is a ten; the 
+  //ace has come out of the shoe 
+  comp->insurance = 3. * left[10] / (ncards - 1.) - 1.; 
+
+  freematrix(dealersProbabilities, NUM_CARDS+1); 
+  dealersProbabilities = NULL; 
+  freeStratTables(); 
+}
+
+
+//------------------------------------------------------------------------------
+// Returns the expected value of playing hands[handIndex], a hard total, 
+// against upCard by the given action, given that the dealer doesn't have 
+// blackjack. simple is the hit/stand chart, solved for the same shoe. 
+//------------------------------------------------------------------------------
+static double getPlayEV (const StrategyTable *simple, int handIndex, 
+                 int upCard, int action)
+{
+  Hand hand = hands[handIndex]; 
+
+  if (action == STAND)
+    return probOfWinGivenTotal(hand.value, upCard)
+      - probOfLossGivenTotal(hand.value, upCard); 
+  else if (action == DOUBLE_DOWN)
+    return 2. * (getDDWinProb(hand, upCard) - getDDLossProb(hand, upCard)); 
+
+  return getHitWinProb(simple, handIndex, upCard)
+    - getHitLossProb(simple, handIndex, upCard); 
+}
@@ -0,0 +1,530 @@
+#include "export.h" 
+#include <math.h> 
+#include <stdlib.h> 
+#include <string.h> 
+#include "boolean.h" 
+#include "error.h" 
+#include "hands.h" 
+#include "print_chart.h" 
+
+//Size of the buffer through which a table is written to its file 
+#define EXPORT_BUFFER_SIZE (1 << 20)
+
+static const char COLUMNAR_MAGIC[8] = "BJCOLS"; 
+
+//Columns of the tables written by exportChart, exportSims and exportSweep 
+static const ExportColumn CHART_COLUMNS[] = { 
+  {"hand", EXPORT_STRING}, {"hand_index", EXPORT_INT}, 
+  {"up_card", EXPORT_INT}, {"action", EXPORT_STRING}, 
+  {"surrender", EXPORT_INT}, {"win", EXPORT_DOUBLE}, 
+  {"loss", EXPORT_DOUBLE}, {"split_ev", EXPORT_DOUBLE}, 
+  {"ev", EXPORT_DOUBLE}, {"ev_stand", EXPORT_DOUBLE}, 
+  {"ev_hit", EXPORT_DOUBLE}, {"ev_double", EXPORT_DOUBLE}, 
+  {"ev_split", EXPORT_DOUBLE}, {"ev_surrender", EXPORT_DOUBLE}, 
+}; 
+static const ExportColumn SIMS_COLUMNS[] = { 
+  {"hand", EXPORT_STRING}, {"hand_index", EXPORT_INT}, 
+  {"up_card", EXPORT_INT}, {"nsims", EXPORT_INT}, {"nwins", EXPORT_INT}, 
+  {"nlosses", EXPORT_INT}, {"win", EXPORT_DOUBLE}, {"loss", EXPORT_DOUBLE}, 
+  {"win_var", EXPORT_DOUBLE}, {"loss_var", EXPORT_DOUBLE}, 
+  {"chart_win", EXPORT_DOUBLE}, {"chart_loss", EXPORT_DOUBLE}, 
+}; 
+
+static void beginValue (Exporter *e, int type); 
+static void writeCSVString (FILE *file, const char *s); 
+static void writeJSONString (FILE *file, const char *s); 
+static void appendToBlock (ExportBlockColumn *b, const void *data, 
+                  size_t size); 
+static void flushBlock (Exporter *e); 
+static void writeOrDie (const void *data, size_t size, FILE *file); 
+
+
+//------------------------------------------------------------------------------
+// Returns the format in which to export to filename, from its extension: 
+// .csv, .ndjson or .jsonl, or .cols for the columnar format. 
+//------------------------------------------------------------------------------
+int getExportFormat (const char *filename)
+{
+  const char *ext = strrchr(filename, '.'); 
+
+  if (ext != NULL && !strcmp(ext, ".csv"))
+    return EXPORT_CSV; 
+  else if (ext != NULL 
+      && (!strcmp(ext, ".ndjson") || !strcmp(ext, ".jsonl")))
+    return EXPORT_NDJSON; 
+  else if (ext != NULL && !strcmp(ext, ".cols"))
+    return EXPORT_COLUMNAR; 
+
+  throwErr("The file to export to must end in .csv, .ndjson, .jsonl or " 
+    ".cols.", "getExportFormat"); 
+  return 0; 
+}
+
+
+//------------------------------------------------------------------------------
+// Opens filename to write a table with the given columns in format, which 
+// columns must outlast. Each row is written one value at a time, in the order 
+// of the columns, by exportInt, exportDouble and exportString, and ended by 
+// endExportRow; closeExporter finishes the file. Only the current block of 
+// the columnar format is held in memory. 
+//------------------------------------------------------------------------------
+Exporter * openExporter (const char *filename, int format, 
+                 const ExportColumn *columns, int ncolumns)
+{
+  Exporter *e = NULL; 
+  uint32_t header[3]; 
+  uint32_t col[2]; 
+  int c; 
+
+  if (format != EXPORT_CSV && format != EXPORT_NDJSON 
+      && format != EXPORT_COLUMNAR)
+    throwErr("Unknown format.", "openExporter"); 
+  if (ncolumns < 1)
+    throwErr("A table needs columns.", "openExporter"); 
+
+  e = (Exporter *) malloc(sizeof(Exporter)); 
+  if (e == NULL) throwMemErr("e", "openExporter"); 
+  e->file = fopen(filename, "wb"); 
+  if (e->file == NULL) throwErr("File could not be opened.", "openExporter"); 
+  e->buffer = (char *) malloc(EXPORT_BUFFER_SIZE); 
+  if (e->buffer == NULL) throwMemErr("e->buffer", "openExporter"); 
+  setvbuf(e->file, e->buffer, _IOFBF, EXPORT_BUFFER_SIZE); 
+  e->format = format; 
+  e->columns = columns; 
+  e->ncolumns = ncolumns; 
+  e->column = 0; 
+  e->nrows = 0; 
+  e->blockRows = 0; 
+  e->block = NULL; 
+
+  if (format == EXPORT_CSV)
+  {
+    for (c = 0; c < ncolumns; c++)
+    {
+      if (c > 0)
+        fputc(',', e->file); 
+      writeCSVString(e->file, columns[c].name); 
+    }
+    fputc('\n', e->file); 
+  }
+  else if (format == EXPORT_COLUMNAR)
+  {
+    writeOrDie(COLUMNAR_MAGIC, sizeof(COLUMNAR_MAGIC), e->file); 
+    header[0] = 0x01020304; 
+    header[1] = 1; 
+    header[2] = ncolumns; 
+    writeOrDie(header, sizeof(header), e->file); 
+    for (c = 0; c < ncolumns; c++)
+    {
+      col[0] = columns[c].type; 
+      col[1] = strlen(columns[c].name); 
+      writeOrDie(col, sizeof(col), e->file); 
+      writeOrDie(columns[c].name, col[1], e->file); 
+    }
+
+    e->block = (ExportBlockColumn *) calloc(ncolumns, 
+                                  sizeof(ExportBlockColumn)); 
+    if (e->block == NULL) throwMemErr("e->block", "openExporter"); 
+    for (c = 0; c < ncolumns; c++)
+    {
+      if (columns[c].type != EXPORT_STRING)
+        continue; 
+      e->block[c].lengths = (uint32_t *) malloc(EXPORT_BLOCK_ROWS 
+                                     * sizeof(uint32_t)); 
+      if (e->block[c].lengths == NULL)
+        throwMemErr("e->block[c].lengths", "openExporter"); 
+    }
+  }
+
+  return e; 
+}
+
+
+//------------------------------------------------------------------------------
+// Writes the next value of the current row, which must be in an EXPORT_INT 
+// column. 
+//------------------------------------------------------------------------------
+void exportInt (Exporter *e, int64_t value)
+{
+  beginValue(e, EXPORT_INT); 
+  if (e->format == EXPORT_COLUMNAR)
+    appendToBlock(&e->block[e->column], &value, sizeof(value)); 
+  else 
+    fprintf(e->file, "%lld", (long long) value); 
+  e->column++; 
+}
+
+
+//------------------------------------------------------------------------------
+// Writes the next value of the current row, which must be in an EXPORT_DOUBLE 
+// column. Values are written in full precision; JSON, which has no infinity 
+// or NaN, gets null for them. 
+//------------------------------------------------------------------------------
+void exportDouble (Exporter *e, double value)
+{
+  beginValue(e, EXPORT_DOUBLE); 
+  if (e->format == EXPORT_COLUMNAR)
+    appendToBlock(&e->block[e->column], &value, sizeof(value)); 
+  else if (e->format == EXPORT_NDJSON && !isfinite(value))
+    fputs("null", e->file); 
+  else 
+    fprintf(e->file, "%.17g", value); 
+  e->column++; 
+}
+
+
+//------------------------------------------------------------------------------
+// Writes the next value of the current row, which must be in an EXPORT_STRING 
+// column. 
+//------------------------------------------------------------------------------
+void exportString (Exporter *e, const char *value)
+{
+  ExportBlockColumn *b; 
+
+  beginValue(e, EXPORT_STRING); 
+  if (e->format == EXPORT_CSV)
+    writeCSVString(e->file, value); 
+  else if (e->format == EXPORT_NDJSON)
+    writeJSONString(e->file, value); 
+  else 
+  {
+    b = &e->block[e->column]; 
+    b->lengths[e->blockRows] = strlen(value); 
+    appendToBlock(b, value, b->lengths[e->blockRows]); 
+  }
+  e->column++; 
+}
+
+
+//------------------------------------------------------------------------------
+// Ends the current row, which must have a value in every column. 
+//------------------------------------------------------------------------------
+void endExportRow (Exporter *e)
+{
+  if (e->column != e->ncolumns)
+    throwErr("The row is missing values.", "endExportRow"); 
+
+  if (e->format == EXPORT_CSV)
+    fputc('\n', e->file); 
+  else if (e->format == EXPORT_NDJSON)
+    fputs("}\n", e->file); 
+  else if (++e->blockRows == EXPORT_BLOCK_ROWS)
+    flushBlock(e); 
+  e->column = 0; 
+  e->nrows++; 
+}
+
+
+//------------------------------------------------------------------------------
+// Finishes the table and closes its file. 
+//------------------------------------------------------------------------------
+void closeExporter (Exporter *e)
+{
+  int c; 
+
+  if (e->column != 0)
+    throwErr("The last row was not ended.", "closeExporter"); 
+  if (e->format == EXPORT_COLUMNAR)
+  {
+    if (e->blockRows > 0)
+      flushBlock(e); 
+    flushBlock(e); //a block of no rows ends the file 
+    for (c = 0; c < e->ncolumns; c++)
+    {
+      free(e->block[c].data); 
+      free(e->block[c].lengths); 
+    }
+    free(e->block); 
+  }
+
+  if (fclose(e->file) != 0)
+    throwErr("Could not write the file.", "closeExporter"); 
+  free(e->buffer); 
+  free(e); 
+}
+
+
+//------------------------------------------------------------------------------
+// Writes every cell of the chart to filename, in the format given by its 
+// extension (see getExportFormat): the hand, up card, play, probabilities of 
+// winning and losing, the expected value of splitting and the expected value 
+// of the play (see getStratEV; for a blackjack, what it pays by rules, as in 
+// getEVOfHand), and then that of each play, the best or not (see PLAY_EV), 
+// which is nan (null in JSON) where the play may not be made. 
+//------------------------------------------------------------------------------
+void exportChart (const char *filename, const StrategyTable *chart, 
+              const Rules *rules)
+{
+  Exporter *e = openExporter(filename, getExportFormat(filename), 
+                    CHART_COLUMNS, 
+                    sizeof(CHART_COLUMNS) / sizeof(ExportColumn)); 
+  Strategy strat; 
+  int i, j, play; 
+
+  for (i = 0; i < chart->nhands; i++)
+  {
+    for (j = 1; j <= NUM_CARDS; j++)
+    {
+      strat = getStrat(chart, i, j); 
+      exportString(e, getHandName(hands[i])); 
+      exportInt(e, i); 
+      exportInt(e, j); 
+      exportString(e, actionSymbol(strat.action)); 
+      exportInt(e, strat.surrender); 
+      exportDouble(e, strat.winPct); 
+      exportDouble(e, strat.lossPct); 
+      exportDouble(e, strat.splitEV); 
+      exportDouble(e, i == SOFT_TWENTYONE ? rules->blackjackPays 
+        : getStratEV(strat)); 
+      for (play = 0; play < NUM_PLAY_EVS; play++)
+        exportDouble(e, PLAY_EV(chart, STRAT_CELL(i, j), play)); 
+      endExportRow(e); 
+    }
+  }
+
+  closeExporter(e); 
+}
+
+
+//------------------------------------------------------------------------------
+// Writes the results of the simulations of every cell that has been simulated 
+// to filename, in the format given by its extension: the numbers of hands 
+// simulated, won and lost, the estimates of the probabilities of winning and 
+// losing with the variance-reduction methods vr (see getSimEstimate) and 
+// their variances, and the chart's probabilities. 
+//------------------------------------------------------------------------------
+void exportSims (const char *filename, HandSim **simsChart, 
+             const StrategyTable *chart, const Rules *rules, int vr)
+{
+  Exporter *e = openExporter(filename, getExportFormat(filename), 
+                    SIMS_COLUMNS, 
+                    sizeof(SIMS_COLUMNS) / sizeof(ExportColumn)); 
+  SimEstimate est; 
+  HandSim *hs; 
+  int i, j; 
+
+  for (i = 0; i < NUM_HANDS; i++)
+  {
+    for (j = 1; j <= NUM_CARDS; j++)
+    {
+      hs = &simsChart[i][j]; 
+      if (hs->nsims == 0)
+        continue; 
+      est = getSimEstimate(*hs, rules, i, j, vr); 
+      exportString(e, getHandName(hands[i])); 
+      exportInt(e, i); 
+      exportInt(e, j); 
+      exportInt(e, hs->nsims); 
+      exportInt(e, hs->nwins); 
+      exportInt(e, hs->nlosses); 
+      exportDouble(e, est.winPct); 
+      exportDouble(e, est.lossPct); 
+      exportDouble(e, est.winVar); 
+      exportDouble(e, est.lossVar); 
+      exportDouble(e, chart->winPct[STRAT_CELL(i, j)]); 
+      exportDouble(e, chart->lossPct[STRAT_CELL(i, j)]); 
+      endExportRow(e); 
+    }
+  }
+
+  closeExporter(e); 
+}
+
+
+//------------------------------------------------------------------------------
+// Writes each variant of a sweep that has been run to filename, in the format 
+// given by its extension: the value of each axis, the expected value, the 
+// composition-dependent expected value if the sweep found it, and the number 
+// of plays that differ from the first variant's. 
+//------------------------------------------------------------------------------
+void exportSweep (const char *filename, const Sweep *sweep)
+{
+  const SweepSpec *spec = &sweep->spec; 
+  ExportColumn columns[MAX_SWEEP_AXES + 4]; 
+  Exporter *e = NULL; 
+  const SweepVariant *v; 
+  int a, k, n; 
+
+  n = 0; 
+  columns[n].name = "variant"; 
+  columns[n++].type = EXPORT_INT; 
+  for (a = 0; a < spec->naxes; a++)
+  {
+    columns[n].name = spec->axis[a].name; 
+    columns[n++].type = EXPORT_STRING; 
+  }
+  columns[n].name = "ev"; 
+  columns[n++].type = EXPORT_DOUBLE; 
+  if (spec->cd)
+  {
+    columns[n].name = "cd_ev"; 
+    columns[n++].type = EXPORT_DOUBLE; 
+  }
+  columns[n].name = "nchanges"; 
+  columns[n++].type = EXPORT_INT; 
+
+  e = openExporter(filename, getExportFormat(filename), columns, n); 
+  for (k = 0; k < sweep->nvariants; k++)
+  {
+    v = &sweep->variant[k]; 
+    exportInt(e, k); 
+    for (a = 0; a < spec->naxes; a++)
+      exportString(e, spec->axis[a].values[v->value[a]]); 
+    exportDouble(e, v->ev); 
+    if (spec->cd)
+      exportDouble(e, v->cdEV); 
+    exportInt(e, v->nchanges); 
+    endExportRow(e); 
+  }
+  closeExporter(e); 
+}
+
+
+//------------------------------------------------------------------------------
+// Takes the option 
+//   --export FILE    write the results as a table to FILE, in the format 
+//                    given by its extension (see getExportFormat)
+// out of the command-line arguments, leaving the rest in argv, and sets 
+// filename to FILE, or NULL if it is not given. Returns the number of 
+// arguments left. 
+//------------------------------------------------------------------------------
+int parseExportArgs (const char **filename, int argc, char **argv)
+{
+  int i, n; 
+
+  *filename = NULL; 
+  n = 1; 
+  for (i = 1; i < argc; i++)
+  {
+    if (strcmp(argv[i], "--export"))
+    {
+      argv[n++] = argv[i]; 
+      continue; 
+    }
+    if (i + 1 >= argc)
+      throwErr("Missing value for an option.", "parseExportArgs"); 
+    *filename = argv[++i]; 
+    getExportFormat(*filename); //check it now, before any work is done 
+  }
+
+  argv[n] = NULL; 
+  return n; 
+}
+
+
+//------------------------------------------------------------------------------
+// Starts the next value of the current row, checking that its column has the 
+// given type, and writes what goes before it. 
+//------------------------------------------------------------------------------
+static void beginValue (Exporter *e, int type)
+{
+  if (e->column >= e->ncolumns)
+    throwErr("Too many values in the row.", "beginValue"); 
+  if (e->columns[e->column].type != type)
+    throwErr("Value of the wrong type for its column.", "beginValue"); 
+
+  if (e->format == EXPORT_CSV && e->column > 0)
+    fputc(',', e->file); 
+  else if (e->format == EXPORT_NDJSON)
+  {
+    fputs(e->column == 0 ? "{" : ",", e->file); 
+    writeJSONString(e->file, e->columns[e->column].name); 
+    fputc(':', e->file); 
+  }
+}
+
+
+//------------------------------------------------------------------------------
+// Writes a string as a field of a CSV file, quoted if it has a comma, quote or 
+// line break in it (as the names of the pairs do), with its quotes doubled. 
+//------------------------------------------------------------------------------
+static void writeCSVString (FILE *file, const char *s)
+{
+  if (strpbrk(s, ",\"\r\n") == NULL)
+  {
+    fputs(s, file); 
+    return; 
+  }
+
+  fputc('"', file); 
+  for (; *s != '\0'; s++)
+  {
+    if (*s == '"')
+      fputc('"', file); 
+    fputc(*s, file); 
+  }
+  fputc('"', file); 
+}
+
+
+//------------------------------------------------------------------------------
+// Writes a string in JSON, quoted and escaped. 
+//------------------------------------------------------------------------------
+static void writeJSONString (FILE *file, const char *s)
+{
+  fputc('"', file); 
+  for (; *s != '\0'; s++)
+  {
+    if (*s == '"' || *s == '\\')
+      fprintf(file, "\\%c", *s); 
+    else if ((unsigned char) *s < 0x20)
+      fprintf(file, "\\u%04x", (unsigned char) *s); 
+    else 
+      fputc(*s, file); 
+  }
+  fputc('"', file); 
+}
+
+
+//------------------------------------------------------------------------------
+// Appends size bytes of data to the buffer of a column of the current block, 
+// enlarging it as needed. 
+//------------------------------------------------------------------------------
+static void appendToBlock (ExportBlockColumn *b, const void *data, 
+                  size_t size)
+{
+  size_t capacity = b->capacity > 0 ? b->capacity : 1024; 
+
+  while (b->size + size > capacity)
+    capacity *= 2; 
+  if (capacity != b->capacity)
+  {
+    b->data = (char *) realloc(b->data, capacity); 
+    if (b->data == NULL) throwMemErr("b->data", "appendToBlock"); 
+    b->capacity = capacity; 
+  }
+  memcpy(b->data + b->size, data, size); 
+  b->size += size; 
+}
+
+
+//------------------------------------------------------------------------------
+// Writes the current block of the columnar format to the file and empties it. 
+//------------------------------------------------------------------------------
+static void flushBlock (Exporter *e)
+{
+  uint32_t nrows = e->blockRows; 
+  ExportBlockColumn *b; 
+  int c; 
+
+  writeOrDie(&nrows, sizeof(nrows), e->file); 
+  for (c = 0; c < e->ncolumns; c++)
+  {
+    b = &e->block[c]; 
+    if (e->columns[c].type == EXPORT_STRING)
+      writeOrDie(b->lengths, nrows * sizeof(uint32_t), e->file); 
+    writeOrDie(b->data, b->size, e->file); 
+    b->size = 0; 
+  }
+  e->blockRows = 0; 
+}
+
+
+//------------------------------------------------------------------------------
+// Writes size bytes of data to file, and exits with an error if it cannot. 
+//------------------------------------------------------------------------------
+static void writeOrDie (const void *data, size_t size, FILE *file)
+{
+  if (size > 0 && fwrite(data, 1, size, file) != size)
+    throwErr("Could not write the file.", "writeOrDie"); 
+}
@@ -6,6 +6,26 @@
 #include "bj_strat.h"
 
 Hand *hands; 
+int **handAfterCard; 
+int **handByCards; 
+int **dealerHandByCards; 
+
+//Index of the hand with each value, softness and splittability, or -1 if 
+//there is no such hand; entry [value][isSoft][isSplittable]. Built by 
+//makeHands so that getHandIndex does not need to search the hands array. 
+static int (*handLookup)[2][2]; 
+
+//Longest name of a hand: "10,10" plus the null termination character 
+#define HAND_NAME_LENGTH (6) 
+
+//Name of each hand, as given by getHandName; built by makeHands 
+static char (*handNames)[HAND_NAME_LENGTH]; 
+
+static int ** allocIndexTable (int nrows, int ncols); 
+static void freeIndexTable (int **table); 
+static Hand addCard (Hand oldHand, int card); 
+static Hand makeHandByCards (int card1, int card2, int isDealer); 
+static void formatHandName (Hand hand, char *name); 
 
 const int NUM_HANDS = 37;
 const int NUM_HANDS_SIMPLE = 29; 
@@ -54,13 +74,16 @@ const int TENS = 36;
 // Makes a vector containing every possible hand. Each hand is indexed by its 
 // name as the constants listed above. Note that doubles are listed last, so 
 // that the beginning of the vector can be used as a vector of "simple" hands. 
+// Also builds the tables handAfterCard, handByCards and dealerHandByCards, 
+// which give the index of the hand resulting from drawing a card or from a 
+// pair of cards. 
 //------------------------------------------------------------------------------
 void makeHands ()
 {
-  int i; 
+  int i, j, v, s, t; 
   int offset; 
 
-  hands = NULL; 
+  freeHands(); 
   hands = (Hand *) malloc(NUM_HANDS * sizeof(Hand)); 
   if (hands == NULL) throwMemErr("hands", "makeHands"); 
   
@@ -92,6 +115,97 @@ void makeHands ()
   offset = -26; 
   for (i = THREES; i <= TENS; i++)
     hands[i] = makeHand(2 * (i + offset), FALSE, FALSE, TRUE); 
+  
+  //Index of each hand by value, softness and splittability 
+  handLookup = malloc((BUST_VALUE+1) * sizeof(*handLookup)); 
+  if (handLookup == NULL) throwMemErr("handLookup", "makeHands"); 
+  for (v = 0; v <= BUST_VALUE; v++)
+    for (s = 0; s < 2; s++)
+      for (t = 0; t < 2; t++)
+        handLookup[v][s][t] = -1; 
+  for (i = 0; i < NUM_HANDS; i++)
+    handLookup[hands[i].value][hands[i].isSoft][hands[i].isSplittable] = i; 
+  
+  //Names of the hands 
+  handNames = malloc(NUM_HANDS * sizeof(*handNames)); 
+  if (handNames == NULL) throwMemErr("handNames", "makeHands"); 
+  for (i = 0; i < NUM_HANDS; i++)
+    formatHandName(hands[i], handNames[i]); 
+  
+  //Transitions from each hand by drawing each card 
+  handAfterCard = allocIndexTable(NUM_HANDS, NUM_CARDS+1); 
+  for (i = 0; i < NUM_HANDS; i++)
+    for (j = 1; j <= NUM_CARDS; j++)
+      handAfterCard[i][j] = getHandIndex(addCard(hands[i], j)); 
+  
+  //Hands made up of two given cards 
+  handByCards = allocIndexTable(NUM_CARDS+1, NUM_CARDS+1); 
+  dealerHandByCards = allocIndexTable(NUM_CARDS+1, NUM_CARDS+1); 
+  for (i = 1; i <= NUM_CARDS; i++)
+  {
+    for (j = 1; j <= NUM_CARDS; j++)
+    {
+      handByCards[i][j] = getHandIndex(makeHandByCards(i, j, FALSE)); 
+      dealerHandByCards[i][j] = getHandIndex(makeHandByCards(i, j, TRUE)); 
+    }
+  }
+}
+
+
+//------------------------------------------------------------------------------
+// Frees the hands array and the tables built by makeHands, if they have been 
+// made. 
+//------------------------------------------------------------------------------
+void freeHands ()
+{
+  free(hands); 
+  free(handLookup); 
+  free(handNames); 
+  freeIndexTable(handAfterCard); 
+  freeIndexTable(handByCards); 
+  freeIndexTable(dealerHandByCards); 
+  
+  hands = NULL; 
+  handLookup = NULL; 
+  handNames = NULL; 
+  handAfterCard = NULL; 
+  handByCards = NULL; 
+  dealerHandByCards = NULL; 
+}
+
+
+//------------------------------------------------------------------------------
+// Allocates an nrows by ncols table of hand indices, as a single block so that
+// lookups stay within a few cache lines. 
+//------------------------------------------------------------------------------
+static int ** allocIndexTable (int nrows, int ncols)
+{
+  int **table = NULL; 
+  int i; 
+  
+  table = (int **) malloc(nrows * sizeof(int *)); 
+  if (table == NULL) throwMemErr("table", "allocIndexTable"); 
+  table[0] = (int *) malloc(nrows * ncols * sizeof(int)); 
+  if (table[0] == NULL) throwMemErr("table[0]", "allocIndexTable"); 
+  
+  for (i = 1; i < nrows; i++)
+    table[i] = table[0] + i * ncols; 
+  for (i = 0; i < nrows * ncols; i++)
+    table[0][i] = -1; 
+  
+  return table; 
+}
+
+
+//------------------------------------------------------------------------------
+// Frees a table made by allocIndexTable. 
+//------------------------------------------------------------------------------
+static void freeIndexTable (int **table)
+{
+  if (table == NULL)
+    return; 
+  free(table[0]); 
+  free(table); 
 }
 
 
@@ -110,16 +224,14 @@ Hand makeHand (int value, int isSoft, int isObvious, int isSplittable)
 //------------------------------------------------------------------------------
 int getHandIndex (Hand hand)
 {
-  int i = 0; 
-  while (i < NUM_HANDS)
-  {
-    if (areHandsEqual(hand, hands[i]))
-      return i; 
-    i++;
-  }
+  int i = -1; 
   
-  throwErr("Hand is not equal to any existing hand.", "getHandIndex"); 
-  return -1; 
+  if (hand.value >= 0 && hand.value <= BUST_VALUE)
+    i = handLookup[hand.value][hand.isSoft != 0][hand.isSplittable != 0]; 
+  if (i < 0)
+    throwErr("Hand is not equal to any existing hand.", "getHandIndex"); 
+  
+  return i; 
 }
 
 
@@ -128,16 +240,7 @@ int getHandIndex (Hand hand)
 //------------------------------------------------------------------------------
 Hand getHand (Hand hand)
 {
-  int i = 0; 
-  while (i < NUM_HANDS)
-  {
-    if (areHandsEqual(hand, hands[i]))
-      return hands[i]; 
-    i++;
-  }
-  
-  throwErr("Hand is not equal to any existing hand.", "getHand"); 
-  return hands[0]; 
+  return hands[getHandIndex(hand)]; 
 }
 
 
@@ -156,16 +259,22 @@ int areHandsEqual (Hand hand1, Hand hand2)
 
 
 //------------------------------------------------------------------------------
-// Returns the symbolic "name" of the hand: e.g. 14, A,7, 8,8. 
+// Returns the symbolic "name" of the hand: e.g. 14, A,7, 8,8. The string is 
+// owned by the hands table and must not be freed. 
+//------------------------------------------------------------------------------
+const char * getHandName (Hand hand)
+{
+  return handNames[getHandIndex(hand)]; 
+}
+
+
+//------------------------------------------------------------------------------
+// Writes the name of the hand, for getHandName, into name, which must have 
+// room for HAND_NAME_LENGTH characters. 
 //------------------------------------------------------------------------------
-char * getHandName (Hand hand)
+static void formatHandName (Hand hand, char *name)
 {
-  char *name = NULL; 
   const int ACE_VALUE = 11; 
-  const int MAX_LENGTH = 6; //"10,10" + null termination character
-  
-  name = (char *) malloc(MAX_LENGTH*sizeof(char)); 
-  if (name == NULL) throwMemErr("name", "getHandName"); 
   
   if (hand.isSplittable)
   {
@@ -180,8 +289,6 @@ char * getHandName (Hand hand)
     sprintf(name, "XXX"); 
   else 
     sprintf(name, "%d", hand.value); 
-  
-  return name;   
 }
 
 
@@ -192,6 +299,17 @@ char * getHandName (Hand hand)
 // possbility of splits for other reasons.
 //------------------------------------------------------------------------------
 Hand getHandByCards (int card1, int card2, int isDealer)
+{
+  return hands[isDealer ? dealerHandByCards[card1][card2] 
+                  : handByCards[card1][card2]]; 
+}
+
+
+//------------------------------------------------------------------------------
+// Works out the hand made up of the given two cards, for building the 
+// handByCards and dealerHandByCards tables; see getHandByCards. 
+//------------------------------------------------------------------------------
+static Hand makeHandByCards (int card1, int card2, int isDealer)
 {
   int isEitherAce = card1 == 1 || card2 == 1; 
   Hand hand = {card1 + card2 + 10*isEitherAce,
@@ -202,7 +320,40 @@ Hand getHandByCards (int card1, int card2, int isDealer)
   if (card1 == card2 && !(isDealer))
     hand.isSplittable = TRUE; 
   
-  return getHand(hand); 
+  return hand; 
+}
+
+
+//------------------------------------------------------------------------------
+// Works out the hand that results from oldHand by drawing a given card, for 
+// building the handAfterCard table. 
+//------------------------------------------------------------------------------
+static Hand addCard (Hand oldHand, int card)
+{
+  Hand newHand = {oldHand.value + card, oldHand.isSoft, FALSE, FALSE}; 
+  
+  //If the new card is an ace, count it as 11 initially 
+  if (card == 1)
+  {
+    newHand.value += 10; 
+    newHand.isSoft = TRUE; 
+  }
+  
+  //If there is either an ace being used as 11 in the original hand, and/or the
+  //new card is an ace, count it as 1 if necessary 
+  if (newHand.isSoft && newHand.value > 21)
+  {
+    newHand.value -= 10; 
+    
+    //The new hand is not soft, unless the previous hand was soft and the new
+    //card is an ace. 
+    newHand.isSoft = oldHand.isSoft && card == 1; 
+  }
+  
+  if (newHand.value > 21)
+    newHand = hands[BUST]; 
+  
+  return newHand; 
 }
 
 
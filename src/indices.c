@@ -0,0 +1,437 @@
+#include "indices.h" 
+#include <math.h> 
+#include <stdlib.h> 
+#include <string.h> 
+#include "boolean.h" 
+#include "error.h" 
+#include "linal.h" 
+#include "parallel.h" 
+#include "stp.h" 
+#include "hands.h" 
+#include "shoe.h" 
+
+//Number of plays a cell of the chart can have: an action (1-4) and whether 
+//to surrender, coded as 2 * action + surrender 
+#define NUM_PLAYS (10)
+#define PLAY_CODE(chart, hand, upCard) \
+  (2 * (chart)->action[STRAT_CELL(hand, upCard)] \
+    + (chart)->surrender[STRAT_CELL(hand, upCard)])
+
+//Fraction of perBin shoes that a true count must have for its plays to be 
+//used; the most extreme counts come up too rarely to fill 
+static const double MIN_BIN_FRACTION = 0.1; 
+
+//Most shoes dealt, per shoe wanted, while looking for shoes at each count 
+static const int MAX_DEALS_PER_SHOE = 20; 
+
+//Stream of the counter-based generator used to deal the shoes; the substream 
+//is the number of the deal 
+static const uint32_t INDEX_STREAM = 0x494e4458; 
+
+const CountSystem COUNT_SYSTEMS[] = { 
+  //            A   2  3  4  5  6  7  8   9  10 
+  {"hilo",   {0, -1, 1, 1, 1, 1, 1, 0, 0,  0, -1}}, 
+  {"hiopt1", {0,  0, 0, 1, 1, 1, 1, 0, 0,  0, -1}}, 
+  {"hiopt2", {0,  0, 1, 1, 2, 2, 1, 1, 0,  0, -2}}, 
+  {"omega2", {0,  0, 1, 1, 2, 2, 2, 1, 0, -1, -2}}, 
+  {"zen",    {0, -1, 1, 1, 2, 2, 2, 1, 0,  0, -2}}, 
+}; 
+const int NUM_COUNT_SYSTEMS = sizeof(COUNT_SYSTEMS) / sizeof(CountSystem); 
+
+//Work shared by all threads in computeIndexSet 
+typedef struct { 
+  const IndexSpec *spec; 
+  int nshoes; 
+  int (*counts)[NUM_CARDS+1]; //cards left in each shoe 
+  int *bin; //true count of each shoe, less minTC 
+  StrategyTable **charts; //one chart for each thread to solve in 
+  int **tally; //for each thread, the number of shoes at each true count in 
+            //which each play is best in each cell: see tallyIndex 
+  int **insure; //for each thread, the number of shoes at each true count in 
+             //which insurance is worth taking 
+} IndexJob; 
+
+static void dealShoes (IndexJob *job, IndexSet *set); 
+static void solveShoeTask (int task, int thread, void *arg); 
+static int tallyIndex (int bin, int hand, int upCard, int play); 
+static void findIndexPlays (IndexSet *set, const int *tally, 
+                   const int *insure, const StrategyTable *basic); 
+static int findEnd (const int *usable, int nbins, int above); 
+static int findCrossing (const double *d, const int *usable, int nbins, 
+                 int above, double *crossing); 
+
+
+//------------------------------------------------------------------------------
+// Returns the counting system with the given name (e.g. "hilo"), or NULL if 
+// there is none. 
+//------------------------------------------------------------------------------
+const CountSystem * findCountSystem (const char *name)
+{
+  int k; 
+
+  for (k = 0; k < NUM_COUNT_SYSTEMS; k++)
+    if (!strcmp(name, COUNT_SYSTEMS[k].name))
+      return &COUNT_SYSTEMS[k]; 
+  return NULL; 
+}
+
+
+//------------------------------------------------------------------------------
+// Finds the index plays of the spec's counting system, solving the shoes on 
+// nthreads threads. 
+// 
+// Shoes are dealt down at random until every true count has perBin of them 
+// (or enough have been dealt that the rarest counts are given up on). For 
+// each one the chart is solved, against its own dealer table, as though the 
+// shoe's proportions of each card held for the rest of the hand, and every 
+// cell votes for the play that is best. The index of a play is the true count 
+// at which it starts to outvote basic strategy (the chart for the full shoe), 
+// interpolated between the neighbouring whole counts. The plays are tallied 
+// by thread and added up at the end, so the results depend only on the seed. 
+//------------------------------------------------------------------------------
+IndexSet * computeIndexSet (const IndexSpec *spec, int nthreads)
+{
+  const int NTALLY = tallyIndex(spec->maxTC - spec->minTC + 1, 0, 0, 0); 
+  IndexSet *set = NULL; 
+  IndexJob job; 
+  StrategyTable *basic; 
+  int *tally = NULL, *insure = NULL; 
+  int k, t; 
+
+  if (hands == NULL)
+    throwErr("makeHands has not been called.", "computeIndexSet"); 
+  if (spec->minTC > spec->maxTC || spec->perBin < 1)
+    throwErr("Invalid true counts.", "computeIndexSet"); 
+  if (spec->penetration <= 0. || spec->penetration >= 1.)
+    throwErr("Penetration must be between 0 and 1.", "computeIndexSet"); 
+  if (nthreads < 1)
+    nthreads = 1; 
+
+  set = (IndexSet *) malloc(sizeof(IndexSet)); 
+  if (set == NULL) throwMemErr("set", "computeIndexSet"); 
+  set->spec = *spec; 
+  set->nbins = spec->maxTC - spec->minTC + 1; 
+  set->nshoes = (int *) calloc(set->nbins, sizeof(int)); 
+  if (set->nshoes == NULL) throwMemErr("set->nshoes", "computeIndexSet"); 
+  set->nplays = 0; 
+  set->play = NULL; 
+
+  job.spec = spec; 
+  dealShoes(&job, set); 
+
+  job.charts = (StrategyTable **) malloc(nthreads 
+                                 * sizeof(StrategyTable *)); 
+  if (job.charts == NULL) throwMemErr("job.charts", "computeIndexSet"); 
+  job.tally = (int **) malloc(nthreads * sizeof(int *)); 
+  if (job.tally == NULL) throwMemErr("job.tally", "computeIndexSet"); 
+  job.insure = (int **) malloc(nthreads * sizeof(int *)); 
+  if (job.insure == NULL) throwMemErr("job.insure", "computeIndexSet"); 
+  for (t = 0; t < nthreads; t++)
+  {
+    job.charts[t] = newStrategyTable(NUM_HANDS); 
+    job.tally[t] = (int *) calloc(NTALLY, sizeof(int)); 
+    if (job.tally[t] == NULL) throwMemErr("job.tally[t]", "computeIndexSet"); 
+    job.insure[t] = (int *) calloc(set->nbins, sizeof(int)); 
+    if (job.insure[t] == NULL)
+      throwMemErr("job.insure[t]", "computeIndexSet"); 
+  }
+
+  parallel_for(job.nshoes, nthreads, solveShoeTask, &job); 
+
+  //Add up the threads' tallies into the first thread's 
+  tally = job.tally[0]; 
+  insure = job.insure[0]; 
+  for (t = 1; t < nthreads; t++)
+  {
+    for (k = 0; k < NTALLY; k++)
+      tally[k] += job.tally[t][k]; 
+    for (k = 0; k < set->nbins; k++)
+      insure[k] += job.insure[t][k]; 
+  }
+
+  //Basic strategy, for the full shoe 
+  basic = job.charts[0]; 
+  dealersProbabilities = makeDealersProbabilities(spec->rules); 
+  calculateStrategyChart(basic, FALSE, spec->rules); 
+  freematrix(dealersProbabilities, NUM_CARDS+1); 
+  dealersProbabilities = NULL; 
+  freeStratTables(); 
+
+  findIndexPlays(set, tally, insure, basic); 
+
+  for (t = 0; t < nthreads; t++)
+  {
+    freeStrategyTable(job.charts[t]); 
+    free(job.tally[t]); 
+    free(job.insure[t]); 
+  }
+  free(job.charts); 
+  free(job.tally); 
+  free(job.insure); 
+  free(job.counts); 
+  free(job.bin); 
+
+  return set; 
+}
+
+
+//------------------------------------------------------------------------------
+// Frees an index set made by computeIndexSet. 
+//------------------------------------------------------------------------------
+void freeIndexSet (IndexSet *set)
+{
+  if (set == NULL)
+    return; 
+  free(set->nshoes); 
+  free(set->play); 
+  free(set); 
+}
+
+
+//------------------------------------------------------------------------------
+// Deals shoes for computeIndexSet into job, and counts those at each true 
+// count in set->nshoes. Each deal takes a random number of cards from the 
+// full shoe, from one up to the fraction "penetration" of it, and is kept if 
+// its true count is one that still needs shoes. A shoe that has run out of 
+// aces, or of every other card, cannot be solved and is passed over. 
+//------------------------------------------------------------------------------
+static void dealShoes (IndexJob *job, IndexSet *set)
+{
+  const IndexSpec *spec = job->spec; 
+  const int MAX_SHOES = spec->perBin * set->nbins; 
+  CardSampler sampler; 
+  RandStream rs; 
+  int full[NUM_CARDS+1]; 
+  int ntotal, maxDealt, ndealt, rc, b, k, deal; 
+  double tc; 
+
+  getShoeCounts(spec->rules, full); 
+  ntotal = 0; 
+  for (k = 1; k <= NUM_CARDS; k++)
+    ntotal += full[k]; 
+  if (ntotal > MAX_SHOE_CARDS)
+    throwErr("Shoe is too large.", "dealShoes"); 
+  maxDealt = (int) (spec->penetration * ntotal); 
+  if (maxDealt < 1)
+    maxDealt = 1; 
+
+  job->counts = malloc(MAX_SHOES * sizeof(*job->counts)); 
+  if (job->counts == NULL) throwMemErr("job->counts", "dealShoes"); 
+  job->bin = (int *) malloc(MAX_SHOES * sizeof(int)); 
+  if (job->bin == NULL) throwMemErr("job->bin", "dealShoes"); 
+  job->nshoes = 0; 
+
+  rng_seed(&rs, spec->seed); 
+  for (deal = 0; deal < MAX_DEALS_PER_SHOE * MAX_SHOES 
+    && job->nshoes < MAX_SHOES; deal++)
+  {
+    rng_set_stream(&rs, INDEX_STREAM, (uint32_t) deal); 
+    initCardSamplerFromCounts(&sampler, full); 
+    ndealt = rdiscunif_r(&rs, 1, maxDealt); 
+    rc = 0; 
+    for (k = 0; k < ndealt; k++)
+      rc += spec->count->tag[drawCard(&sampler, &rs)]; 
+
+    tc = (double) rc * CARDS_PER_DECK / cardsLeft(&sampler); 
+    b = (int) floor(tc + .5) - spec->minTC; 
+    if (b < 0 || b >= set->nbins || set->nshoes[b] >= spec->perBin)
+      continue; 
+    if (countOfRank(&sampler, 1) == 0 
+      || countOfRank(&sampler, 1) == cardsLeft(&sampler))
+      continue; 
+
+    for (k = 1; k <= NUM_CARDS; k++)
+      job->counts[job->nshoes][k] = countOfRank(&sampler, k); 
+    job->counts[job->nshoes][0] = 0; 
+    job->bin[job->nshoes] = b; 
+    job->nshoes++; 
+    set->nshoes[b]++; 
+  }
+}
+
+
+//------------------------------------------------------------------------------
+// Task for parallel_for in computeIndexSet: solves the chart for shoe number 
+// task, and tallies the best play in each cell and whether to take insurance. 
+//------------------------------------------------------------------------------
+static void solveShoeTask (int task, int thread, void *arg)
+{
+  IndexJob *job = (IndexJob *) arg; 
+  const int *counts = job->counts[task]; 
+  int b = job->bin[task]; 
+  StrategyTable *chart = job->charts[thread]; 
+  Rules rules = *job->spec->rules; 
+  int i, upCard, ncards, k; 
+
+  setRankCounts(&rules, counts); 
+  dealersProbabilities = makeDealersProbabilities(&rules); 
+  calculateStrategyChart(chart, FALSE, &rules); 
+
+  for (i = 0; i < NUM_HANDS; i++)
+    for (upCard = 1; upCard <= NUM_CARDS; upCard++)
+      job->tally[thread][tallyIndex(b, i, upCard, 
+                                PLAY_CODE(chart, i, upCard))]++; 
+
+  //Insurance pays 2 to 1, so it is worth taking when more than a third of the 
+  //cards that could be under the dealer's ace are tens 
+  ncards = 0; 
+  for (k = 1; k <= NUM_CARDS; k++)
+    ncards += counts[k]; 
+  if (3 * counts[10] > ncards - 1)
+    job->insure[thread][b]++; 
+
+  freematrix(dealersProbabilities, NUM_CARDS+1); 
+  dealersProbabilities = NULL; 
+  freeStratTables(); 
+}
+
+
+//------------------------------------------------------------------------------
+// Returns the position in a tally of the number of shoes at true count 
+// minTC + bin in which play (a PLAY_CODE) is best for hands[hand] against 
+// upCard. 
+//------------------------------------------------------------------------------
+static int tallyIndex (int bin, int hand, int upCard, int play)
+{
+  return ((bin * NUM_HANDS + hand) * (NUM_CARDS+1) + upCard) * NUM_PLAYS 
+    + play; 
+}
+
+
+//------------------------------------------------------------------------------
+// Fills set->play with the index plays of every starting hand against every 
+// up card, from the tallies of the plays at each true count, and finds the 
+// insurance index. For each cell, the play that departs from basic strategy 
+// is the one that does best at the highest (or lowest) true count, if it 
+// outvotes basic strategy there; its index is where the difference in their 
+// shares of the votes crosses zero, coming in from that end. 
+//------------------------------------------------------------------------------
+static void findIndexPlays (IndexSet *set, const int *tally, 
+                   const int *insure, const StrategyTable *basic)
+{
+  const int MAX_PLAYS = 2 * NUM_HANDS * NUM_CARDS; 
+  int *usable = NULL; //whether each true count has enough shoes to be used 
+  double *d = NULL; //share of votes for the play, less that of basic strategy 
+  int isStarting[NUM_HANDS]; 
+  IndexPlay *p; 
+  int i, j, upCard, b, c, best, basicCode, side, above, end; 
+  double crossing; 
+
+  usable = (int *) malloc(set->nbins * sizeof(int)); 
+  if (usable == NULL) throwMemErr("usable", "findIndexPlays"); 
+  d = (double *) malloc(set->nbins * sizeof(double)); 
+  if (d == NULL) throwMemErr("d", "findIndexPlays"); 
+  set->play = (IndexPlay *) malloc(MAX_PLAYS * sizeof(IndexPlay)); 
+  if (set->play == NULL) throwMemErr("set->play", "findIndexPlays"); 
+
+  for (b = 0; b < set->nbins; b++)
+    usable[b] = set->nshoes[b] > 0 
+      && set->nshoes[b] >= MIN_BIN_FRACTION * set->spec.perBin; 
+
+  //Hands the player can be dealt, apart from blackjack 
+  for (i = 0; i < NUM_HANDS; i++)
+    isStarting[i] = FALSE; 
+  for (i = 1; i <= NUM_CARDS; i++)
+    for (j = 1; j <= NUM_CARDS; j++)
+      isStarting[handByCards[i][j]] = TRUE; 
+  isStarting[SOFT_TWENTYONE] = FALSE; 
+
+  for (i = 0; i < NUM_HANDS; i++)
+  {
+    if (!(isStarting[i]))
+      continue; 
+    //Up cards in the order of the chart: 2-10, then ace 
+    for (j = 2; j <= NUM_CARDS + 1; j++)
+    {
+      upCard = j <= NUM_CARDS ? j : 1; 
+      basicCode = PLAY_CODE(basic, i, upCard); 
+      for (side = 0; side < 2; side++)
+      {
+        above = side == 0; 
+        end = findEnd(usable, set->nbins, above); 
+        if (end < 0)
+          continue; 
+
+        best = -1; 
+        for (c = 0; c < NUM_PLAYS; c++)
+          if (c != basicCode && (best < 0 
+            || tally[tallyIndex(end, i, upCard, c)] 
+              > tally[tallyIndex(end, i, upCard, best)]))
+            best = c; 
+        for (b = 0; b < set->nbins; b++)
+          if (usable[b])
+            d[b] = (double) (tally[tallyIndex(b, i, upCard, best)] 
+              - tally[tallyIndex(b, i, upCard, basicCode)]) / set->nshoes[b]; 
+        if (d[end] <= 0. 
+          || !(findCrossing(d, usable, set->nbins, above, &crossing)))
+          continue; 
+
+        p = &set->play[set->nplays++]; 
+        p->hand = i; 
+        p->upCard = upCard; 
+        p->basicAction = basicCode / 2; 
+        p->basicSurrender = basicCode % 2; 
+        p->action = best / 2; 
+        p->surrender = best % 2; 
+        p->index = set->spec.minTC + crossing; 
+        p->above = above; 
+      }
+    }
+  }
+
+  //Insurance, which is taken when it is right in more than half of the shoes 
+  for (b = 0; b < set->nbins; b++)
+    if (usable[b])
+      d[b] = (double) insure[b] / set->nshoes[b] - .5; 
+  set->insurance = HUGE_VAL; 
+  end = findEnd(usable, set->nbins, TRUE); 
+  if (end >= 0 && d[end] > 0. 
+    && findCrossing(d, usable, set->nbins, TRUE, &crossing))
+    set->insurance = set->spec.minTC + crossing; 
+
+  free(usable); 
+  free(d); 
+}
+
+
+//------------------------------------------------------------------------------
+// Returns the highest usable bin (if above is true) or the lowest (if not), or 
+// -1 if there is none. 
+//------------------------------------------------------------------------------
+static int findEnd (const int *usable, int nbins, int above)
+{
+  int b; 
+
+  for (b = above ? nbins - 1 : 0; b >= 0 && b < nbins; b += above ? -1 : 1)
+    if (usable[b])
+      return b; 
+  return -1; 
+}
+
+
+//------------------------------------------------------------------------------
+// Finds where d, which is positive at the highest usable bin (if above is 
+// true) or the lowest (if not), first falls to zero or below coming in from 
+// that end, interpolating linearly between the usable bins on either side. 
+// Returns false if it never does. 
+//------------------------------------------------------------------------------
+static int findCrossing (const double *d, const int *usable, int nbins, 
+                 int above, double *crossing)
+{
+  int step = above ? -1 : 1; 
+  int b, prev = -1; 
+
+  for (b = above ? nbins - 1 : 0; b >= 0 && b < nbins; b += step)
+  {
+    if (!(usable[b]))
+      continue; 
+    if (prev >= 0 && d[b] <= 0.)
+    {
+      *crossing = b + (prev - b) * (-d[b]) / (d[prev] - d[b]); 
+      return TRUE; 
+    }
+    prev = b; 
+  }
+
+  return FALSE; 
+}
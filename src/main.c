@@ -11,42 +11,273 @@
  *  ./blackjack_strategy
  * 
  *  To run Monte Carlo simulations to numerically verify the optimal strategy:
- *  ./blackjack_strategy sims
+ *  ./blackjack_strategy sims [threads] [seed]
+ *  where "threads" is the number of threads to run the simulations on (by 
+ *  default, one per processor) and "seed" seeds the random number generator 
+ *  (by default, the time). Runs with the same seed give identical results, 
+ *  whatever the number of threads. 
+ *
+ *  To run simulations without supervision until every cell's results are 
+ *  known to a given precision: 
+ *  ./blackjack_strategy adaptive [halfwidth] [confidence] [alpha] [threads] 
+ *    [seed] [methods] 
+ *  which keeps simulating, concentrating on the cells with the widest 
+ *  intervals, until the "confidence" (by default .95) confidence interval for 
+ *  each cell's probabilities of winning and losing is within "halfwidth" (by 
+ *  default .005) on either side. If "alpha" is positive (by default it is 0), 
+ *  a cell also stops as soon as it disagrees with the computed chart at that 
+ *  significance level. "methods" selects variance-reduction methods: any of 
+ *  the letters c (the dealer's final total as control variates), a 
+ *  (antithetic pairs of hands) and s (stratified starting cards), or "none" 
+ *  (the default). With any of them, the gain in effective sample size of 
+ *  each cell is reported; cells whose outcome the controls determine, such 
+ *  as standing, keep the plain proportion (a gain of 1). 
+ *
+ *  To measure the player's expected value by playing whole shoes: 
+ *  ./blackjack_strategy shoe [decks] [penetration] [shoes] [threads] [seed]
+ *  where each shoe of "decks" decks (6 by default) is shuffled and dealt from 
+ *  until the cut card, placed after the fraction "penetration" of the cards 
+ *  (0.75 by default), comes out, and then reshuffled. "shoes" is the number of
+ *  shoes to play (by default 20000); "threads" and "seed" are as above. 
+ *
+ *  To compute composition-dependent strategy, which depends on the cards in 
+ *  the player's hand and not only their total: 
+ *  ./blackjack_strategy cd [decks] [threads] 
+ *  for a shoe of "decks" decks (6 by default). Plays that differ from the 
+ *  chart are marked with a *. 
+ *
+ *  To solve the chart and expected value for every combination of a grid of 
+ *  rule variations: 
+ *  ./blackjack_strategy sweep [axis=value,value,...]... [threads] [cd] 
+ *  e.g. 
+ *  ./blackjack_strategy sweep h17=yes,no das=yes,no surrender=none,late 
+ *    bj-pays=3:2,6:5 
+ *  Each axis is an option that takes a value (decks, double, splits, 
+ *  surrender, charlie, bj-pays) or one of h17, enhc, das, rsa and hsa, which 
+ *  take yes or no; the rules not swept are those of the other options. The 
+ *  chart assumes an infinite shoe, so the number of decks only matters with 
+ *  "cd", which also solves composition-dependent strategy for each variant's 
+ *  shoe (much more slowly), and a decks axis may only be given with it. 
+ *  Prints one line per variant, with the number of plays in its chart that 
+ *  differ from the first variant's. 
+ * 
+ *  To find the index plays of a card-counting system - the true counts beyond 
+ *  which the best play departs from basic strategy: 
+ *  ./blackjack_strategy index [count] [shoes] [threads] [seed] 
+ *  where "count" is hilo (the default), hiopt1, hiopt2, omega2, zen or all, 
+ *  and "shoes" (by default 1000) is the number of depleted shoes whose chart 
+ *  is solved at each true count from -6 to +6. 
+ * 
+ *  To find the effects of removal - the change in the player's expected value, 
+ *  and in some key decisions, from taking one card of each rank out of the 
+ *  shoe: 
+ *  ./blackjack_strategy eor [threads] 
+ * 
+ *  To time the program's inner loops: 
+ *  ./blackjack_strategy bench [name]
+ * 
+ *  Rules: 
+ *  By default, the shoe has six decks, the dealer hits soft 17 and checks for 
+ *  blackjack, the player may double on any two cards, including after a 
+ *  split, and split to four hands (but not resplit aces, though split aces 
+ *  may be hit), there is no surrender, and blackjack pays 3:2. Any of these 
+ *  may be changed with the options of parseRulesArgs (rules.c), given 
+ *  anywhere on the command line, e.g. 
+ *  ./blackjack_strategy --s17 --surrender late --bj-pays 6:5 
+ *  A number of decks given for "shoe" or "cd" overrides --decks. 
+ * 
+ *  Chart files: 
+ *  The chart, sims and adaptive modes take --save FILE, which saves the 
+ *  solved chart, with the rules and the tables it is played by, to a binary 
+ *  file, and --load FILE, which maps such a file into memory instead of 
+ *  solving the chart, and plays by the rules it was solved for (see 
+ *  chart_file.h), so it may not be given with any rules options, e.g. 
+ *  ./blackjack_strategy --s17 --save s17.chart 
+ *  ./blackjack_strategy sims --load s17.chart 
+ * 
+ *  Exporting: 
+ *  The chart, sims, adaptive and sweep modes take --export FILE, which writes 
+ *  their results - the chart, the simulations of each cell or the variants - 
+ *  as a table to FILE, as CSV if it ends in .csv, newline-delimited JSON if 
+ *  it ends in .ndjson or .jsonl, or in the columnar format of export.h if it 
+ *  ends in .cols. The chart's table gives the expected value of every play 
+ *  of each cell (ev_stand, ev_hit, ev_double, ev_split and ev_surrender), 
+ *  not just of the best one, so the cost of any mistake can be read off it. 
  * 
  *  Assumptions: 
- *  Doubling down and splitting are allowed. 
- *  Dealer hits soft 17. 
- *   There are several decks, so the probability of drawing any particular card 
- *    (ignoring suits) may always be taken to be 1/13. 
+ *  The strategy chart assumes that there are enough decks that the 
+ *    probability of drawing each card may always be taken to be that of a 
+ *    full deck (e.g. 1/13 for a 2). The simulations, "shoe" and "cd" deal 
+ *    from the actual number of decks. 
  */
 
 #include <stdio.h> 
 #include <stdlib.h> 
 #include <string.h>
+#include <stdint.h>
+#include "bench.h"
+#include "chart_file.h" 
+#include "export.h" 
+#include "eor.h" 
 #include "error.h"
 #include "boolean.h"
 #include "linal.h"
+#include "parallel.h"
 #include "bj_strat.h"
+#include "cd_strat.h"
 #include "hands.h" 
+#include "indices.h" 
 #include "print_chart.h" 
+#include "rules.h" 
+#include "stp.h"
+#include "sweep.h" 
 
-void compute_strategy (); 
-void run_sims ();
+void compute_strategy (const Rules *rules, const ChartFileArgs *files, 
+                 const char *exportFile); 
+const Rules * make_chart (const Rules *rules, const ChartFileArgs *files, 
+                 int MAKE_SIMPLE_CHART, int nthreads, StrategyTable **chart,
+                 ChartFile **loaded); 
+void free_chart (StrategyTable *chart, ChartFile *loaded); 
+void run_sims (const Rules *rules, const ChartFileArgs *files, 
+          const char *exportFile, int nthreads, uint64_t seed);
+void run_adaptive (const Rules *rules, const ChartFileArgs *files, 
+            const char *exportFile, AdaptiveSpec spec, int nthreads, 
+            uint64_t seed); 
+int parse_vr (const char *methods); 
+void run_shoe (const Rules *rules, double penetration, int nshoes, 
+          int nthreads, uint64_t seed); 
+void run_cd (const Rules *rules, int nthreads); 
+void run_sweep (const SweepSpec *spec, const char *exportFile, int nthreads); 
+void run_index (const Rules *rules, const char *count, int perBin, 
+          int nthreads, uint64_t seed); 
+void run_eor (const Rules *rules, int nthreads); 
 
 int main (int argc, char **argv)
 {
+  int nthreads; 
+  uint64_t seed; 
+  int nshoes; 
+  double penetration; 
+  AdaptiveSpec spec; 
+  SweepSpec sweepSpec; 
+  ChartFileArgs files; 
+  const char *exportFile; 
+  Rules rules; 
+  int nargs; 
+  int i; 
+  
+  //Take out the options for chart files, exporting and the rules, leaving the
+  //arguments below 
+  argc = parseChartFileArgs(&files, argc, argv); 
+  argc = parseExportArgs(&exportFile, argc, argv); 
+  defaultRules(&rules); 
+  nargs = argc; 
+  argc = parseRulesArgs(&rules, argc, argv); 
+  if ((files.save != NULL || files.load != NULL) && argc >= 2 
+      && strcmp(argv[1], "sims") && strcmp(argv[1], "adaptive"))
+    throwErr("--save and --load only go with no mode (the chart), sims and "
+      "adaptive.", "main"); 
+  //A loaded chart was solved for the rules in its file 
+  if (files.load != NULL && argc != nargs)
+    throwErr("Rules options may not be given with --load, which uses the "
+      "rules the chart was saved with.", "main"); 
+  if (exportFile != NULL && argc >= 2 && strcmp(argv[1], "sims") 
+      && strcmp(argv[1], "adaptive") && strcmp(argv[1], "sweep"))
+    throwErr("--export only goes with no mode (the chart), sims, adaptive "
+      "and sweep.", "main"); 
+  
   if (argc >= 2 && !strcmp(argv[1], "sims"))  
-    run_sims ();  
+  {
+    nthreads = argc >= 3 ? atoi(argv[2]) : num_cpus(); 
+    if (nthreads < 1) throwErr("Number of threads must be positive.", "main"); 
+    seed = argc >= 4 ? strtoull(argv[3], NULL, 10) : time_seed(); 
+    run_sims (&rules, &files, exportFile, nthreads, seed);  
+  }
+  else if (argc >= 2 && !strcmp(argv[1], "adaptive"))
+  {
+    spec.halfWidth = argc >= 3 ? atof(argv[2]) : .005; 
+    spec.confidence = argc >= 4 ? atof(argv[3]) : .95; 
+    spec.alpha = argc >= 5 ? atof(argv[4]) : 0.; 
+    spec.pilot = 1000; 
+    spec.maxPerCell = 100000000; 
+    if (spec.halfWidth <= 0.) 
+      throwErr("Half-width must be positive.", "main"); 
+    if (spec.confidence <= 0. || spec.confidence >= 1.)
+      throwErr("Confidence must be between 0 and 1.", "main"); 
+    nthreads = argc >= 6 ? atoi(argv[5]) : num_cpus(); 
+    if (nthreads < 1) throwErr("Number of threads must be positive.", "main"); 
+    seed = argc >= 7 ? strtoull(argv[6], NULL, 10) : time_seed(); 
+    spec.vr = argc >= 8 ? parse_vr(argv[7]) : 0; 
+    run_adaptive (&rules, &files, exportFile, spec, nthreads, seed); 
+  }
+  else if (argc >= 2 && !strcmp(argv[1], "shoe"))
+  {
+    if (argc >= 3)
+      rules.numDecks = atoi(argv[2]); 
+    checkRules(&rules); 
+    penetration = argc >= 4 ? atof(argv[3]) : 0.75; 
+    nshoes = argc >= 5 ? atoi(argv[4]) : 20000; 
+    if (nshoes < 1) throwErr("Number of shoes must be positive.", "main"); 
+    nthreads = argc >= 6 ? atoi(argv[5]) : num_cpus(); 
+    if (nthreads < 1) throwErr("Number of threads must be positive.", "main"); 
+    seed = argc >= 7 ? strtoull(argv[6], NULL, 10) : time_seed(); 
+    run_shoe (&rules, penetration, nshoes, nthreads, seed); 
+  }
+  else if (argc >= 2 && !strcmp(argv[1], "cd"))
+  {
+    if (argc >= 3)
+      rules.numDecks = atoi(argv[2]); 
+    checkRules(&rules); 
+    nthreads = argc >= 4 ? atoi(argv[3]) : num_cpus(); 
+    if (nthreads < 1) throwErr("Number of threads must be positive.", "main"); 
+    run_cd (&rules, nthreads); 
+  }
+  else if (argc >= 2 && !strcmp(argv[1], "sweep"))
+  {
+    initSweepSpec(&sweepSpec, &rules); 
+    nthreads = num_cpus(); 
+    //cd first, since whether it is given decides which axes may be 
+    for (i = 2; i < argc; i++)
+      if (!strcmp(argv[i], "cd"))
+        sweepSpec.cd = TRUE; 
+    for (i = 2; i < argc; i++)
+    {
+      if (strchr(argv[i], '=') != NULL)
+        addSweepAxis(&sweepSpec, argv[i]); 
+      else if (strcmp(argv[i], "cd"))
+        nthreads = atoi(argv[i]); 
+    }
+    if (nthreads < 1) throwErr("Number of threads must be positive.", "main"); 
+    run_sweep (&sweepSpec, exportFile, nthreads); 
+  }
+  else if (argc >= 2 && !strcmp(argv[1], "index"))
+  {
+    nshoes = argc >= 4 ? atoi(argv[3]) : 1000; 
+    if (nshoes < 1) throwErr("Number of shoes must be positive.", "main"); 
+    nthreads = argc >= 5 ? atoi(argv[4]) : num_cpus(); 
+    if (nthreads < 1) throwErr("Number of threads must be positive.", "main"); 
+    seed = argc >= 6 ? strtoull(argv[5], NULL, 10) : time_seed(); 
+    run_index (&rules, argc >= 3 ? argv[2] : "hilo", nshoes, nthreads, seed); 
+  }
+  else if (argc >= 2 && !strcmp(argv[1], "eor"))
+  {
+    nthreads = argc >= 3 ? atoi(argv[2]) : num_cpus(); 
+    if (nthreads < 1) throwErr("Number of threads must be positive.", "main"); 
+    run_eor (&rules, nthreads); 
+  }
+  else if (argc >= 2 && !strcmp(argv[1], "bench"))
+    runBenchmarks (argc >= 3 ? argv[2] : NULL); 
   else 
-    compute_strategy ();
+    compute_strategy (&rules, &files, exportFile);
 
   return 0; 
 }
 
 
 
-// Main body of the program, for computing strategy
-void compute_strategy ()
+// Main body of the program, for computing strategy under the given rules 
+void compute_strategy (const Rules *rules, const ChartFileArgs *files, 
+                 const char *exportFile)
 {
   //File name to print chart to 
   const char *filename = "../output/Blackjack strategy chart.tex"; 
@@ -54,46 +285,88 @@ void compute_strategy ()
   const int SHOW_WIN_PCT = TRUE;
   //Indicates whether to exclude doubles and splits 
   const int MAKE_SIMPLE_CHART = FALSE;
-  //Ratio of the player's bet that he wins by getting blackjack 
-  const double BLACKJACK_PAYS = 3./2.; 
-  
-  Strategy **chart = NULL; 
-  int i; 
-  
-  //chart is a NUM_HANDS by NUM_CARDS+1 matrix, with entry i,j being hands[i] 
-  //and the card with face value j. 
-  chart = (Strategy **) malloc(NUM_HANDS * sizeof(Strategy *)); 
-  for (i = 0; i < NUM_HANDS; i++)
-    chart[i] = (Strategy *) malloc((NUM_CARDS+1) * sizeof(Strategy)); 
-  if (chart == NULL) throwMemErr("chart", "main"); 
   
-  //Make vector of possible hands 
-  makeHands(); 
-  //Make matrix of dealer's probabilities of ending up with a given total given
-  //each given up card 
-  dealersProbabilities = makeDealersProbabilities(); 
+  StrategyTable *chart = NULL; 
+  ChartFile *loaded = NULL; 
   
   //Compute optimal strategy for each combination of player's hand and 
-  //dealer's up card 
-  calculateStrategyChart (chart, MAKE_SIMPLE_CHART); 
+  //dealer's up card, solving the up cards on all the processors, unless it 
+  //is loaded from a file 
+  rules = make_chart (rules, files, MAKE_SIMPLE_CHART, num_cpus(), &chart, 
+                &loaded); 
   
   //Print chart to Latex   
-  printChart (chart, filename, SHOW_WIN_PCT, MAKE_SIMPLE_CHART); 
+  printChart (chart, filename, SHOW_WIN_PCT, MAKE_SIMPLE_CHART, rules); 
+  if (exportFile != NULL)
+    exportChart (exportFile, chart, rules); 
   printf("Program complete.\n"); 
   
   //Compute player's expected value 
   if (!(MAKE_SIMPLE_CHART))
-    computeExpectedValue (chart, BLACKJACK_PAYS); 
+    computeExpectedValue (chart, rules); 
+  
+  free_chart (chart, loaded); 
+}
+
+
+//Makes the chart that compute_strategy and the simulations play by, along 
+//with the hands and the calling thread's tables: solves it for rules on 
+//nthreads threads, or maps it from the file given by --load, whose rules it 
+//was solved for are returned in place of rules. Saves it to the file given by
+//--save. free_chart frees it. 
+const Rules * make_chart (const Rules *rules, const ChartFileArgs *files, 
+                 int MAKE_SIMPLE_CHART, int nthreads, StrategyTable **chart,
+                 ChartFile **loaded)
+{
+  //Make vector of possible hands 
+  makeHands(); 
+  
+  *loaded = NULL; 
+  if (files->load != NULL)
+  {
+    *loaded = loadChartFile(files->load); 
+    useStratTables((*loaded)->tables); 
+    *chart = &(*loaded)->chart; 
+    rules = &(*loaded)->rules; 
+  }
+  else 
+  {
+    //chart is a NUM_HANDS by NUM_CARDS+1 table, with entry i,j being 
+    //hands[i] and the card with face value j. 
+    *chart = newStrategyTable(NUM_HANDS); 
+    
+    //Make matrix of dealer's probabilities of ending up with a given total 
+    //given each given up card 
+    dealersProbabilities = makeDealersProbabilities(rules); 
+    calculateStrategyChartParallel (*chart, MAKE_SIMPLE_CHART, rules, 
+                           nthreads); 
+  }
+  
+  if (files->save != NULL)
+    saveChartFile(files->save, *chart, rules); 
+  return rules; 
+}
+
+
+//Frees a chart made by make_chart, and its tables 
+void free_chart (StrategyTable *chart, ChartFile *loaded)
+{
+  StratTables none = {NULL, NULL, NULL, 0}; 
   
+  if (loaded != NULL)
+  {
+    useStratTables(none); 
+    closeChartFile(loaded); 
+    return; 
+  }
   freematrix(dealersProbabilities, NUM_CARDS+1); 
-  for (i = 0; i < NUM_HANDS; i++)
-    free(chart[i]); 
-  free(chart); 
+  freeStrategyTable(chart); 
 }
 
 
-//Runs Monte Carlo simulations to test the strategy
-void run_sims ()
+//Runs Monte Carlo simulations to test the strategy, on nthreads threads 
+void run_sims (const Rules *rules, const ChartFileArgs *files, 
+          const char *exportFile, int nthreads, uint64_t seed)
 {
   //File name to print chart to 
   const char *filename = "Simulations chart.tex"; 
@@ -102,53 +375,46 @@ void run_sims ()
   //program) 
   const int N_SIMS = 1000; 
 
-  Strategy **chart = NULL; 
+  StrategyTable *chart = NULL; 
+  ChartFile *loaded = NULL; 
   HandSim **simsChart; 
   int i, j; 
   int N; //number of simulations to run 
   int n; //number that have been completed 
   int m; //number of additional sims to run 
   int info; 
+  int ncells; //number of combinations of hand and up card that are simulated
+  int pass; //number of times the user has been asked for more sims 
+  double start, elapsed; 
   
-  //First, compute the strategy chart in the same way as bj_strat.c. 
+  //First, compute the strategy chart in the same way as bj_strat.c, or load
+  //it 
+  rules = make_chart (rules, files, FALSE, nthreads, &chart, &loaded); 
+
+  simsChart = initializeSimsChart(); 
   
-  //chart is a NUM_HANDS by NUM_CARDS+1 matrix, with entry i,j being hands[i] 
-  //and the card with face value j. 
-  chart = (Strategy **) malloc(NUM_HANDS * sizeof(Strategy *)); 
+  ncells = 0; 
   for (i = 0; i < NUM_HANDS; i++)
-    chart[i] = (Strategy *) malloc((NUM_CARDS+1) * sizeof(Strategy)); 
-  if (chart == NULL) throwMemErr("chart", "main"); 
-  
-  //Make vector of possible hands 
-  makeHands(); 
-  //Make matrix of dealer's probabilities of ending up with a given total given
-  //each given up card 
-  dealersProbabilities = makeDealersProbabilities(); 
+    if (!(hands[i].isObvious))
+      for (j = 1; j <= NUM_CARDS; j++)
+        ncells++; 
   
-  //Compute optimal strategy for each combination of player's hand and 
-  //dealer's up card 
-  calculateStrategyChart (chart, FALSE); 
-
-  simsChart = initializeSimsChart(); 
+  printf("Random seed: %llu\n", (unsigned long long) seed); 
   
   n = 0; 
   N = N_SIMS; 
+  pass = 0; 
   
   while (n < N)
   {
-    for (i = 0; i < NUM_HANDS; i++) //i = player's hand 
-    {
-      if (!(hands[i].isObvious))
-      {
-        for (j = 1; j <= NUM_CARDS; j++) //j = up card 
-        {
-          runSims (simsChart, chart, i, j, N - n); 
-        }
-      }
-      
-      printf("Finished running simulations for hand %d of %d.\n", 
-          i + 1, NUM_HANDS); 
-    }
+    start = wall_time(); 
+    runSimsParallel (simsChart, chart, rules, N - n, 0, nthreads, seed, 
+                pass++); 
+    elapsed = wall_time() - start; 
+    
+    printf("Ran %d simulations of each of %d combinations of hand and up "
+      "card in %.2f seconds on %d threads (%.0f hands/sec).\n", N - n, 
+      ncells, elapsed, nthreads, (double) (N - n) * ncells / elapsed); 
     
     n = N; 
     
@@ -166,20 +432,405 @@ void run_sims ()
     N += m; 
   }
   
-  freematrix(dealersProbabilities, NUM_CARDS+1); 
+  if (exportFile != NULL)
+    exportSims (exportFile, simsChart, chart, rules, 0); 
+  free_chart (chart, loaded); 
   for (i = 0; i < NUM_HANDS; i++)
-    free(chart[i]); 
-  free(chart); 
+    free(simsChart[i]); 
+  free(simsChart); 
+}
+
+
+//Runs simulations until every cell is known to the precision in spec, and 
+//reports any cells that disagree with the computed chart 
+void run_adaptive (const Rules *rules, const ChartFileArgs *files, 
+            const char *exportFile, AdaptiveSpec spec, int nthreads, 
+            uint64_t seed)
+{
+  StrategyTable *chart = NULL; 
+  ChartFile *loaded = NULL; 
+  HandSim **simsChart; 
+  AdaptiveResult result; 
+  SimEstimate est; 
+  double alpha; 
+  int i, j; 
+  double start, elapsed; 
+  
+  rules = make_chart (rules, files, FALSE, nthreads, &chart, &loaded); 
+  simsChart = initializeSimsChart(); 
+  
+  printf("Random seed: %llu\n", (unsigned long long) seed); 
+  
+  start = wall_time(); 
+  result = runAdaptiveSims (simsChart, chart, rules, spec, nthreads, seed); 
+  elapsed = wall_time() - start; 
+  
+  printf("Ran %ld simulations in %d rounds in %.2f seconds on %d threads "
+    "(%.0f hands/sec).\n", result.nhands, result.nrounds, elapsed, nthreads, 
+    result.nhands / elapsed); 
+  printf("%d of %d combinations of hand and up card reached the target "
+    "half-width of %.2f%% (widest: %.2f%%).\n", result.nmet, result.ncells, 
+    100. * spec.halfWidth, 100. * result.maxHalfWidth); 
+  printf("Running the same number of simulations of every combination would "
+    "have taken %ld simulations (%.1f times as many).\n", 
+    result.uniformHands, (double) result.uniformHands / result.nhands); 
+  
+  alpha = spec.alpha > 0. ? spec.alpha : 1. - spec.confidence; 
+  printf("%d combinations disagree with the computed chart at the %g level "
+    "(Bonferroni-corrected):\n", result.ndisagree, alpha); 
+  for (i = 0; i < NUM_HANDS; i++)
+  {
+    if (hands[i].isObvious)
+      continue; 
+    for (j = 1; j <= NUM_CARDS; j++)
+    {
+      est = getSimEstimate(simsChart[i][j], rules, i, j, spec.vr); 
+      if (!(doesSimDisagree(est, getStrat(chart, i, j), alpha, 
+                      result.ncells)))
+        continue; 
+      printf("  %-5s vs %2d: won %.2f%%, lost %.2f%% in %d simulations; "
+        "chart says %.2f%%, %.2f%% (p = %.2g)\n", getHandName(hands[i]), j, 
+        100. * est.winPct, 100. * est.lossPct, simsChart[i][j].nsims, 
+        100. * chart->winPct[STRAT_CELL(i, j)], 
+        100. * chart->lossPct[STRAT_CELL(i, j)], 
+        getSimPValue(est, getStrat(chart, i, j))); 
+    }
+  }
+  
+  //Gain in effective sample size from variance reduction, for the 
+  //probabilities of winning/losing 
+  if (spec.vr)
+  {
+    printf("Gain in effective sample size (win/loss) by up card:\n      "); 
+    for (j = 2; j <= NUM_CARDS + 1; j++)
+      printf(" %9d", j <= NUM_CARDS ? j : 1); 
+    printf("\n"); 
+    for (i = 0; i < NUM_HANDS; i++)
+    {
+      if (hands[i].isObvious)
+        continue; 
+      printf("%-6s", getHandName(hands[i])); 
+      for (j = 2; j <= NUM_CARDS + 1; j++)
+      {
+        est = getSimEstimate(simsChart[i][j <= NUM_CARDS ? j : 1], rules, i, 
+                      j <= NUM_CARDS ? j : 1, spec.vr); 
+        printf(" %4.1f/%4.1f", est.winGain, est.lossGain); 
+      }
+      printf("\n"); 
+    }
+  }
+  
+  if (exportFile != NULL)
+    exportSims (exportFile, simsChart, chart, rules, spec.vr); 
+  free_chart (chart, loaded); 
   for (i = 0; i < NUM_HANDS; i++)
     free(simsChart[i]); 
   free(simsChart); 
 }
 
 
+//Returns the variance-reduction flags (VR_ in bj_sims.h) named by the letters
+//in methods: c, a and s; "none" gives none 
+int parse_vr (const char *methods)
+{
+  int vr = 0; 
+  
+  if (!strcmp(methods, "none"))
+    return 0; 
+  for (; *methods != '\0'; methods++)
+  {
+    if (*methods == 'c')
+      vr |= VR_CONTROL; 
+    else if (*methods == 'a')
+      vr |= VR_ANTITHETIC; 
+    else if (*methods == 's')
+      vr |= VR_STRATIFY; 
+    else 
+      throwErr("Unknown variance-reduction method.", "parse_vr"); 
+  }
+  
+  return vr; 
+}
+
 
+//Plays nshoes whole shoes on nthreads threads under the given rules, following
+//the optimal strategy, and reports the player's expected value 
+void run_shoe (const Rules *rules, double penetration, int nshoes, 
+          int nthreads, uint64_t seed)
+{
+  StrategyTable *chart = NULL; 
+  ShoeSim sim; 
+  double start, elapsed; 
+  
+  //chart is a NUM_HANDS by NUM_CARDS+1 table, with entry i,j being hands[i] 
+  //and the card with face value j. 
+  chart = newStrategyTable(NUM_HANDS); 
+  
+  makeHands(); 
+  dealersProbabilities = makeDealersProbabilities(rules); 
+  calculateStrategyChart (chart, FALSE, rules); 
+  
+  printf("Random seed: %llu\n", (unsigned long long) seed); 
+  
+  start = wall_time(); 
+  sim = runShoeSims (chart, rules, penetration, nshoes, nthreads, seed); 
+  elapsed = wall_time() - start; 
+  
+  printf("Played %ld rounds from %ld shoes of %d decks (penetration %.2f) in "
+    "%.2f seconds on %d threads (%.0f rounds/sec).\n", sim.nrounds, 
+    sim.nshoes, rules->numDecks, penetration, elapsed, nthreads, 
+    sim.nrounds / elapsed); 
+  printf("The player's expected value is %.3f%% +/- %.3f%% (95%% confidence)."
+    "\n", 100. * getShoeSimEV(sim), 196. * getShoeSimStdErr(sim)); 
+  
+  freematrix(dealersProbabilities, NUM_CARDS+1); 
+  freeStrategyTable(chart); 
+}
+
+
+//Computes composition-dependent strategy under the given rules on nthreads 
+//threads, and prints it with the plays that differ from the chart marked 
+void run_cd (const Rules *rules, int nthreads)
+{
+  StrategyTable *chart = NULL; 
+  CDChart *cdChart = NULL; 
+  Strategy strat, basic; 
+  char label[8]; //name of a pair of cards, e.g. "10,10" 
+  const char *symbol; 
+  int card1, card2, upCard, ndiffer; 
+  double start, elapsed; 
+  
+  //chart is a NUM_HANDS by NUM_CARDS+1 table, with entry i,j being hands[i] 
+  //and the card with face value j. 
+  chart = newStrategyTable(NUM_HANDS); 
+  
+  makeHands(); 
+  dealersProbabilities = makeDealersProbabilities(rules); 
+  calculateStrategyChart (chart, FALSE, rules); 
+  
+  cdChart = newCDChart(rules); 
+  start = wall_time(); 
+  calculateCDChart(cdChart, nthreads); 
+  elapsed = wall_time() - start; 
+  
+  printf("Composition-dependent strategy for %d decks, solved in %.2f seconds "
+    "on %d threads:\n      ", rules->numDecks, elapsed, nthreads); 
+  for (upCard = 2; upCard <= NUM_CARDS + 1; upCard++)
+    printf(" %5d", upCard <= NUM_CARDS ? upCard : 1); 
+  printf("\n"); 
+  
+  ndiffer = 0; 
+  for (card1 = 1; card1 <= NUM_CARDS; card1++)
+  {
+    for (card2 = card1; card2 <= NUM_CARDS; card2++)
+    {
+      if (card1 == 1 && card2 == 10) //blackjack 
+        continue; 
+      if (card1 == 1)
+        sprintf(label, card2 == 1 ? "A,A" : "A,%d", card2); 
+      else 
+        sprintf(label, "%d,%d", card1, card2); 
+      printf("%-6s", label); 
+      for (upCard = 2; upCard <= NUM_CARDS + 1; upCard++)
+      {
+        strat = cdChart->strat[card1][card2][upCard <= NUM_CARDS ? upCard : 1]; 
+        basic = getStrat(chart, handByCards[card1][card2], 
+                    upCard <= NUM_CARDS ? upCard : 1); 
+        symbol = strat.surrender ? "SUR" : actionSymbol(strat.action); 
+        if (strat.action != basic.action || strat.surrender != basic.surrender)
+        {
+          printf(" %4s*", symbol); 
+          ndiffer++; 
+        }
+        else 
+          printf(" %4s ", symbol); 
+      }
+      printf("\n"); 
+    }
+  }
+  
+  printf("%d plays differ from the chart.\n", ndiffer); 
+  printf("The player's expected value is %.3f%%.\n", 100. * cdChart->ev); 
+  
+  freeCDChart(cdChart); 
+  freematrix(dealersProbabilities, NUM_CARDS+1); 
+  freeStrategyTable(chart); 
+}
 
 
+//Solves every variant of the sweep on nthreads threads, and prints a table of
+//their results 
+void run_sweep (const SweepSpec *spec, const char *exportFile, int nthreads)
+{
+  Sweep *sweep = NULL; 
+  SweepVariant *v; 
+  char desc[256]; 
+  int width[MAX_SWEEP_AXES]; //width of each axis's column 
+  int a, k; 
+  double start, elapsed; 
+  
+  makeHands(); 
+  sweep = newSweep(spec); 
+  
+  start = wall_time(); 
+  runSweep(sweep, nthreads); 
+  elapsed = wall_time() - start; 
+  
+  describeRules(&spec->base, desc, sizeof(desc)); 
+  printf("Base rules: %s\n", desc); 
+  for (a = 0; a < spec->naxes; a++)
+  {
+    width[a] = strlen(spec->axis[a].name); 
+    for (k = 0; k < spec->axis[a].nvalues; k++)
+      if ((int) strlen(spec->axis[a].values[k]) > width[a])
+        width[a] = strlen(spec->axis[a].values[k]); 
+    printf("%-*s  ", width[a], spec->axis[a].name); 
+  }
+  printf("%9s%s  Changes\n", "EV", spec->cd ? "      CD EV" : ""); 
+  
+  for (k = 0; k < sweep->nvariants; k++)
+  {
+    v = &sweep->variant[k]; 
+    for (a = 0; a < spec->naxes; a++)
+      printf("%-*s  ", width[a], spec->axis[a].values[v->value[a]]); 
+    printf("%8.3f%%", 100. * v->ev); 
+    if (spec->cd)
+      printf("  %8.3f%%", 100. * v->cdEV); 
+    printf("  %7d\n", v->nchanges); 
+  }
+  
+  printf("Solved %d variants (sharing %d dealer tables) in %.2f seconds on %d "
+    "threads (%.1f variants/sec).\n", sweep->nvariants, sweep->ndealers, 
+    elapsed, nthreads, sweep->nvariants / elapsed); 
+  
+  if (exportFile != NULL)
+    exportSweep(exportFile, sweep); 
+  freeSweep(sweep); 
+}
 
 
+//Finds and prints the index plays of the named counting system (or of all of 
+//them), solving perBin shoes at each true count on nthreads threads 
+void run_index (const Rules *rules, const char *count, int perBin, 
+          int nthreads, uint64_t seed)
+{
+  const int MIN_TC = -6, MAX_TC = 6; //true counts solved 
+  const double PENETRATION = 0.75; //deepest that shoes are dealt 
+  IndexSpec spec; 
+  IndexSet *set = NULL; 
+  IndexPlay *p; 
+  char desc[256]; 
+  int k, b, nsolved; 
+  double start, elapsed; 
+  
+  if (strcmp(count, "all") && findCountSystem(count) == NULL)
+    throwErr("Unknown counting system.", "run_index"); 
+  
+  makeHands(); 
+  describeRules(rules, desc, sizeof(desc)); 
+  printf("Random seed: %llu\n", (unsigned long long) seed); 
+  
+  spec.rules = rules; 
+  spec.minTC = MIN_TC; 
+  spec.maxTC = MAX_TC; 
+  spec.perBin = perBin; 
+  spec.penetration = PENETRATION; 
+  spec.seed = seed; 
+  
+  for (k = 0; k < NUM_COUNT_SYSTEMS; k++)
+  {
+    if (strcmp(count, "all") && strcmp(count, COUNT_SYSTEMS[k].name))
+      continue; 
+    spec.count = &COUNT_SYSTEMS[k]; 
+    
+    start = wall_time(); 
+    set = computeIndexSet(&spec, nthreads); 
+    elapsed = wall_time() - start; 
+    
+    printf("\nIndex plays for %s (%s):\n", spec.count->name, desc); 
+    printf("Hand   Up  Basic  Play  True count\n"); 
+    for (b = 0; b < set->nplays; b++)
+    {
+      p = &set->play[b]; 
+      printf("%-6s %2d  %-5s  %-4s  %s %+.1f\n", getHandName(hands[p->hand]), 
+        p->upCard, p->basicSurrender ? "SUR" : actionSymbol(p->basicAction), 
+        p->surrender ? "SUR" : actionSymbol(p->action), 
+        p->above ? ">=" : "<=", p->index); 
+    }
+    if (set->insurance < HUGE_VAL)
+      printf("Insurance: take at true counts >= %+.1f\n", set->insurance); 
+    else 
+      printf("Insurance: never take\n"); 
+    
+    nsolved = 0; 
+    printf("Shoes solved at each true count from %+d:", MIN_TC); 
+    for (b = 0; b < set->nbins; b++)
+    {
+      printf(" %d", set->nshoes[b]); 
+      nsolved += set->nshoes[b]; 
+    }
+    printf("\nSolved the index set for %d shoes in %.2f seconds on %d threads "
+      "(%.0f shoes/sec).\n", nsolved, elapsed, nthreads, nsolved / elapsed); 
+    
+    freeIndexSet(set); 
+  }
+}
 
 
+//Finds and prints the effects of removal under the given rules, on nthreads 
+//threads 
+void run_eor (const Rules *rules, int nthreads)
+{
+  EoRSet *set = NULL; 
+  char desc[256]; 
+  char label[4]; //name of a rank 
+  int k, n; 
+  double sum, start, elapsed; 
+  
+  makeHands(); 
+  start = wall_time(); 
+  set = computeEoR(rules, nthreads); 
+  elapsed = wall_time() - start; 
+  
+  describeRules(rules, desc, sizeof(desc)); 
+  printf("Effects of removal for %s.\n", desc); 
+  printf("The player's expected value with the full shoe is %.3f%%.\n", 
+    100. * set->ev); 
+  printf("Effect on it of removing one card of each rank (%%):\n"); 
+  sum = 0.; 
+  for (k = 2; k <= NUM_CARDS + 1; k++)
+  {
+    sprintf(label, k <= NUM_CARDS ? "%d" : "A", k); 
+    printf("  %-2s %+.4f\n", label, 100. * set->eor[k <= NUM_CARDS ? k : 1]); 
+    sum += rules->rankCounts[k <= NUM_CARDS ? k : 1] 
+      * set->eor[k <= NUM_CARDS ? k : 1]; 
+  }
+  printf("Sum over a deck: %+.4f%%\n", 100. * sum); 
+  
+  printf("\nKey plays (%% of the bet, given no dealer blackjack):\n"); 
+  printf("Play             Full shoe"); 
+  for (k = 2; k <= NUM_CARDS + 1; k++)
+  {
+    sprintf(label, k <= NUM_CARDS ? "%d" : "A", k); 
+    printf(" %7s", label); 
+  }
+  printf("\n"); 
+  for (n = 0; n < NUM_KEY_PLAYS; n++)
+  {
+    printf("%2d vs %2d: %-6s  %+8.3f", KEY_PLAYS[n].total, 
+      KEY_PLAYS[n].upCard, KEY_PLAYS[n].isDouble ? "DD - H" : "S - H", 
+      100. * set->keyGain[n]); 
+    for (k = 2; k <= NUM_CARDS + 1; k++)
+      printf(" %+7.3f", 100. * set->keyEoR[n][k <= NUM_CARDS ? k : 1]); 
+    printf("\n"); 
+  }
+  printf("%-16s %+8.3f", "Insurance", 100. * set->insurance); 
+  for (k = 2; k <= NUM_CARDS + 1; k++)
+    printf(" %+7.3f", 100. * set->insuranceEoR[k <= NUM_CARDS ? k : 1]); 
+  printf("\n"); 
+  
+  printf("Solved %d shoes in %.1f milliseconds on %d threads.\n", 
+    NUM_CARDS + 1, 1000. * elapsed, nthreads); 
+  
+  freeEoRSet(set); 
+}
@@ -7,14 +7,17 @@
 #include "bj_strat.h" 
 #include "hands.h" 
 
+static void printCell (Strategy strat, FILE *file); 
+
 
 //------------------------------------------------------------------------------
-// Prints a chart of strategies to a .tex file. 
+// Prints a chart of strategies, found for the given rules, to a .tex file. 
 //------------------------------------------------------------------------------
-void printChart (Strategy **chart, const char *filename, int showWinPct, 
-            int MAKE_SIMPLE_CHART)
+void printChart (const StrategyTable *chart, const char *filename, 
+            int showWinPct, int MAKE_SIMPLE_CHART, const Rules *rules)
 {
   FILE *file = NULL; 
+  char description[256]; 
   int i, j; 
   
   file = fopen(filename, "w"); 
@@ -32,6 +35,9 @@ void printChart (Strategy **chart, const char *filename, int showWinPct,
   fprintf(file, "\\begin{document}\n\n\\begin{center}\n\\begin{large}\n"); 
   fprintf(file, "Blackjack Strategy\n\\end{large}\n\\end{center}\n\n"); 
   
+  describeRules(rules, description, sizeof(description)); 
+  fprintf(file, "\\begin{center}\n%s\n\\end{center}\n\n", description); 
+  
   fprintf(file, "\\begin{small}\n"); 
   fprintf(file, "\\begin{center}\n\\emph{Dealer's up card}\n\\end{center}\n\n");
   
@@ -62,7 +68,10 @@ void printChart (Strategy **chart, const char *filename, int showWinPct,
   fprintf(file, "\\end{small}\n\n"); 
   fprintf(file, "\\vspace{.1in}\n"); 
   fprintf(file, "\\noindent KEY:\\\\\nH: Hit\\quad S: Stand\\quad DD: "); 
-  fprintf(file, "Double down\\quad SPL: Split\\\\\n"); 
+  fprintf(file, "Double down\\quad SPL: Split"); 
+  if (rules->surrender != SURRENDER_NONE)
+    fprintf(file, "\\quad SUR/X: Surrender, or X if you may not"); 
+  fprintf(file, "\\\\\n"); 
   fprintf(file, "X/Y: X\\%% chance of winning, Y\\%% chance of losing. "
           "(May not add up to 100 due to pushes. For splits, this is the");
   fprintf(file, " probability of winning each of the two split hands.)\n\n");
@@ -75,10 +84,11 @@ void printChart (Strategy **chart, const char *filename, int showWinPct,
 //------------------------------------------------------------------------------
 // Prints the line of information for a single given hand, hands[i]. 
 //------------------------------------------------------------------------------
-void printHand (int i, Strategy **chart, int showWinPct, FILE *file)
+void printHand (int i, const StrategyTable *chart, int showWinPct, 
+            FILE *file)
 {
   int j; 
-	char *handName;
+	const char *handName;
 
   if (hands[i].isObvious) //don't print "obvious" hands 
     return; 
@@ -88,19 +98,29 @@ void printHand (int i, Strategy **chart, int showWinPct, FILE *file)
   fprintf(file, "%s ", handName); 
   
   for (j = 2; j <= NUM_CARDS; j++)
-    fprintf(file, " & %s ", actionSymbol(chart[i][j].action)); 
-  fprintf(file, " & %s \\\\\n", actionSymbol(chart[i][1].action)); //ace 
+    printCell(getStrat(chart, i, j), file); 
+  printCell(getStrat(chart, i, 1), file); //ace 
+  fprintf(file, "\\\\\n"); 
   
   if (showWinPct)
   {
     for (j = 2; j <= NUM_CARDS; j++)
-      fprintf(file, " & %.0f/%.0f ", 100.*chart[i][j].winPct, 
-            100.*chart[i][j].lossPct);
-    fprintf(file, " & %.0f/%.0f \\\\\n", 100.*chart[i][1].winPct, 
-          100.*chart[i][1].lossPct); //ace 
+      fprintf(file, " & %.0f/%.0f ", 100.*chart->winPct[STRAT_CELL(i, j)], 
+            100.*chart->lossPct[STRAT_CELL(i, j)]);
+    fprintf(file, " & %.0f/%.0f \\\\\n", 
+          100.*chart->winPct[STRAT_CELL(i, 1)], 
+          100.*chart->lossPct[STRAT_CELL(i, 1)]); //ace 
   }
+}
+
 
-	free(handName);
+//------------------------------------------------------------------------------
+// Prints the entry of the chart for a single hand and up card. 
+//------------------------------------------------------------------------------
+static void printCell (Strategy strat, FILE *file)
+{
+  fprintf(file, " & %s%s ", strat.surrender ? "SUR/" : "", 
+        actionSymbol(strat.action)); 
 }
 
 
@@ -129,7 +149,7 @@ char * actionSymbol (int action)
 // Prints a Latex chart of the results of running simulations of each possible 
 // hand. 
 //------------------------------------------------------------------------------
-void printSimsChart (HandSim **simsChart, Strategy **chart,  
+void printSimsChart (HandSim **simsChart, const StrategyTable *chart, 
               const char *filename, int nsims)
 {
   FILE *file = NULL; 
@@ -184,8 +204,8 @@ void printSimsChart (HandSim **simsChart, Strategy **chart,
 //------------------------------------------------------------------------------
 // Prints the line of results from simulations for a single hand. 
 //------------------------------------------------------------------------------
-void printHandSims (int i, HandSim **simsChart, Strategy **chart, FILE *file,
-              int nsims)
+void printHandSims (int i, HandSim **simsChart, const StrategyTable *chart, 
+              FILE *file, int nsims)
 {
   const double THRESHHOLD = .01; //amount above which to print "errors" in red 
   int j; 
@@ -198,15 +218,16 @@ void printHandSims (int i, HandSim **simsChart, Strategy **chart, FILE *file,
   fprintf(file, "%s ", getHandName(hands[i])); 
   
   for (j = 2; j <= NUM_CARDS; j++)
-    fprintf(file, " & %s ", actionSymbol(chart[i][j].action)); 
-  fprintf(file, " & %s \\\\\n", actionSymbol(chart[i][1].action)); //ace 
+    fprintf(file, " & %s ", actionSymbol(chart->action[STRAT_CELL(i, j)])); 
+  fprintf(file, " & %s \\\\\n", 
+        actionSymbol(chart->action[STRAT_CELL(i, 1)])); //ace 
   
   for (j = 2; j <= NUM_CARDS; j++)
   {
     winpct = ((double) simsChart[i][j].nwins) / nsims; 
     losspct = ((double) simsChart[i][j].nlosses) / nsims; 
-    windiff = winpct - chart[i][j].winPct; 
-    lossdiff = losspct - chart[i][j].lossPct; 
+    windiff = winpct - chart->winPct[STRAT_CELL(i, j)]; 
+    lossdiff = losspct - chart->lossPct[STRAT_CELL(i, j)]; 
     
     fprintf(file, " & "); 
     if (fabs(windiff) > THRESHHOLD) 
@@ -231,8 +252,8 @@ void printHandSims (int i, HandSim **simsChart, Strategy **chart, FILE *file,
   }
   winpct = ((double) simsChart[i][1].nwins) / nsims; 
   losspct = ((double) simsChart[i][1].nlosses) / nsims; 
-  windiff = winpct - chart[i][1].winPct; 
-  lossdiff = losspct - chart[i][1].lossPct; 
+  windiff = winpct - chart->winPct[STRAT_CELL(i, 1)]; 
+  lossdiff = losspct - chart->lossPct[STRAT_CELL(i, 1)]; 
 
   fprintf(file, " & "); 
   if (fabs(windiff) > THRESHHOLD) 
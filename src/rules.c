@@ -0,0 +1,314 @@
+#include "rules.h" 
+#include <stdio.h> 
+#include <stdlib.h> 
+#include <string.h> 
+#include "boolean.h" 
+#include "error.h" 
+
+const int DOUBLE_ANY_TWO = 1; 
+const int DOUBLE_NINE_TO_ELEVEN = 2; 
+const int DOUBLE_TEN_ELEVEN = 3; 
+
+const int SURRENDER_NONE = 0; 
+const int SURRENDER_LATE = 1; 
+const int SURRENDER_EARLY = 2; 
+
+static double parsePayout (const char *s); 
+
+
+//------------------------------------------------------------------------------
+// Sets rules to those of a common six-deck game: the dealer hits soft 17 and 
+// checks for blackjack, the player may double on any two cards, including 
+// after a split, and split to four hands (but not resplit aces, though split 
+// aces may be hit), there is no surrender, and blackjack pays 3:2. 
+//------------------------------------------------------------------------------
+void defaultRules (Rules *rules)
+{
+  const int NUM_EACH_CARD = 4; //number of each card in a deck 
+  int counts[NUM_CARDS+1]; 
+  int k; 
+
+  counts[0] = 0; 
+  for (k = 1; k <= NUM_CARDS; k++) //10 plus three face cards 
+    counts[k] = NUM_EACH_CARD * (k == 10 ? 4 : 1); 
+  setRankCounts(rules, counts); 
+
+  rules->numDecks = 6; 
+  rules->hitSoft17 = TRUE; 
+  rules->holeCard = TRUE; 
+  rules->doubleRule = DOUBLE_ANY_TWO; 
+  rules->doubleAfterSplit = TRUE; 
+  rules->maxSplitHands = 4; 
+  rules->resplitAces = FALSE; 
+  rules->hitSplitAces = TRUE; 
+  rules->surrender = SURRENDER_NONE; 
+  rules->charlie = 0; 
+  rules->blackjackPays = 3./2.; 
+}
+
+
+//------------------------------------------------------------------------------
+// Sets the number of cards of each rank in a deck, rankCounts[k] for k = 1-10, 
+// and the probability of drawing each. The strategy calculator draws cards 
+// with these probabilities, as from an infinite number of such decks. 
+//------------------------------------------------------------------------------
+void setRankCounts (Rules *rules, const int *rankCounts)
+{
+  int k, total; 
+
+  total = 0; 
+  for (k = 1; k <= NUM_CARDS; k++)
+  {
+    if (rankCounts[k] < 0)
+      throwErr("Negative number of cards.", "setRankCounts"); 
+    total += rankCounts[k]; 
+  }
+  if (rankCounts[1] <= 0 || total <= rankCounts[1])
+    throwErr("A deck needs aces and other cards.", "setRankCounts"); 
+
+  rules->rankCounts[0] = 0; 
+  rules->cardProbs[0] = 0.; 
+  for (k = 1; k <= NUM_CARDS; k++)
+  {
+    rules->rankCounts[k] = rankCounts[k]; 
+    rules->cardProbs[k] = (double) rankCounts[k] / total; 
+  }
+}
+
+
+//------------------------------------------------------------------------------
+// Checks that the rules are consistent, and exits with an error if not. 
+//------------------------------------------------------------------------------
+void checkRules (const Rules *rules)
+{
+  if (rules->numDecks < 1)
+    throwErr("Number of decks must be positive.", "checkRules"); 
+  if (rules->doubleRule != DOUBLE_ANY_TWO 
+    && rules->doubleRule != DOUBLE_NINE_TO_ELEVEN 
+    && rules->doubleRule != DOUBLE_TEN_ELEVEN)
+    throwErr("Unknown doubling rule.", "checkRules"); 
+  if (rules->maxSplitHands != 0 && rules->maxSplitHands < 2)
+    throwErr("A pair must be split into at least two hands.", "checkRules"); 
+  if (rules->surrender != SURRENDER_NONE && rules->surrender != SURRENDER_LATE 
+    && rules->surrender != SURRENDER_EARLY)
+    throwErr("Unknown surrender rule.", "checkRules"); 
+  //A doubled hand has three cards, so it is never a Charlie 
+  if (rules->charlie != 0 && rules->charlie < 4)
+    throwErr("A Charlie must have at least four cards.", "checkRules"); 
+  if (rules->blackjackPays < 0.)
+    throwErr("Blackjack cannot pay less than nothing.", "checkRules"); 
+}
+
+
+//------------------------------------------------------------------------------
+// Fills counts with the number of cards of each rank 1-10 in the full shoe. 
+//------------------------------------------------------------------------------
+void getShoeCounts (const Rules *rules, int *counts)
+{
+  int k; 
+
+  counts[0] = 0; 
+  for (k = 1; k <= NUM_CARDS; k++)
+    counts[k] = rules->numDecks * rules->rankCounts[k]; 
+}
+
+
+//------------------------------------------------------------------------------
+// Indicates whether the rules let the player double down on his first two 
+// cards when they make the given hand. 
+//------------------------------------------------------------------------------
+int isDoubleAllowed (Hand hand, const Rules *rules)
+{
+  if (rules->doubleRule == DOUBLE_ANY_TWO)
+    return TRUE; 
+  else if (rules->doubleRule == DOUBLE_NINE_TO_ELEVEN)
+    return !(hand.isSoft) && hand.value >= 9 && hand.value <= 11; 
+  else 
+    return !(hand.isSoft) && hand.value >= 10 && hand.value <= 11; 
+}
+
+
+//------------------------------------------------------------------------------
+// Returns the most hands that a pair of splitCard may be split into, or 0 if 
+// there is no limit. 
+//------------------------------------------------------------------------------
+int getMaxSplitHands (int splitCard, const Rules *rules)
+{
+  if (splitCard == 1 && !(rules->resplitAces))
+    return 2; 
+  return rules->maxSplitHands; 
+}
+
+
+//------------------------------------------------------------------------------
+// Returns the probability that the dealer has blackjack given his up card. 
+//------------------------------------------------------------------------------
+double probOfDealerBJ (int upCard, const Rules *rules)
+{
+  if (upCard == 1)
+    return rules->cardProbs[10]; 
+  else if (upCard == 10)
+    return rules->cardProbs[1]; 
+  else 
+    return 0.; 
+}
+
+
+//------------------------------------------------------------------------------
+// Writes a one-line description of the rules to buf, e.g. "6 decks, H17, 
+// double any two cards, DAS, split to 4 hands, blackjack pays 1.5 to 1", 
+// truncated to size characters. 
+//------------------------------------------------------------------------------
+void describeRules (const Rules *rules, char *buf, size_t size)
+{
+  char split[32], charlie[32]; 
+
+  if (rules->maxSplitHands == 0)
+    sprintf(split, "resplit to any number of hands"); 
+  else if (rules->maxSplitHands == 2)
+    sprintf(split, "no resplits"); 
+  else 
+    sprintf(split, "split to %d hands", rules->maxSplitHands); 
+  charlie[0] = '\0'; 
+  if (rules->charlie)
+    sprintf(charlie, ", %d-card Charlie", rules->charlie); 
+
+  snprintf(buf, size, "%d deck%s, %s%s, double %s, %s, %s%s%s%s%s, blackjack "
+    "pays %g to 1", rules->numDecks, rules->numDecks == 1 ? "" : "s", 
+    rules->hitSoft17 ? "H17" : "S17", rules->holeCard ? "" : ", no hole card", 
+    rules->doubleRule == DOUBLE_ANY_TWO ? "any two cards" 
+      : rules->doubleRule == DOUBLE_NINE_TO_ELEVEN ? "9-11" : "10-11", 
+    rules->doubleAfterSplit ? "DAS" : "no DAS", split, 
+    rules->maxSplitHands != 2 && rules->resplitAces ? ", resplit aces" : "", 
+    rules->hitSplitAces ? "" : ", one card to split aces", 
+    rules->surrender == SURRENDER_LATE ? ", late surrender" 
+      : rules->surrender == SURRENDER_EARLY ? ", early surrender" : "", 
+    charlie, rules->blackjackPays); 
+}
+
+
+//------------------------------------------------------------------------------
+// Sets rules from the options among the command-line arguments, starting from 
+// whatever rules already holds, and removes the options from argv. Returns the 
+// number of arguments left. The options are: 
+//   --decks N        number of decks 
+//   --s17, --h17     the dealer stands on or hits soft 17 
+//   --enhc           the dealer takes no hole card 
+//   --hole-card      the dealer takes a hole card and checks for blackjack 
+//   --double D       the hands that may be doubled: any, 9-11 or 10-11 
+//   --das, --no-das  doubling after a split is or is not allowed 
+//   --splits N       most hands a pair may be split into (0 for no limit)
+//   --rsa, --no-rsa  aces may or may not be resplit 
+//   --hsa, --no-hsa  split aces may be hit, or get one card each 
+//   --surrender S    none, late or early 
+//   --charlie N      N-card Charlie (0 for none)
+//   --bj-pays P      what blackjack pays, as a ratio (1.2) or as odds (6:5)
+//   --spanish        Spanish decks, which have no 10s (but do have face cards)
+//------------------------------------------------------------------------------
+int parseRulesArgs (Rules *rules, int argc, char **argv)
+{
+  int counts[NUM_CARDS+1]; 
+  const char *opt, *val; 
+  int i, k, n; 
+
+  n = 1; 
+  for (i = 1; i < argc; i++)
+  {
+    opt = argv[i]; 
+    if (strncmp(opt, "--", 2)) //not an option 
+    {
+      argv[n++] = argv[i]; 
+      continue; 
+    }
+
+    //Options without a value 
+    if (!strcmp(opt, "--s17"))
+      rules->hitSoft17 = FALSE; 
+    else if (!strcmp(opt, "--h17"))
+      rules->hitSoft17 = TRUE; 
+    else if (!strcmp(opt, "--enhc"))
+      rules->holeCard = FALSE; 
+    else if (!strcmp(opt, "--hole-card"))
+      rules->holeCard = TRUE; 
+    else if (!strcmp(opt, "--das"))
+      rules->doubleAfterSplit = TRUE; 
+    else if (!strcmp(opt, "--no-das"))
+      rules->doubleAfterSplit = FALSE; 
+    else if (!strcmp(opt, "--rsa"))
+      rules->resplitAces = TRUE; 
+    else if (!strcmp(opt, "--no-rsa"))
+      rules->resplitAces = FALSE; 
+    else if (!strcmp(opt, "--hsa"))
+      rules->hitSplitAces = TRUE; 
+    else if (!strcmp(opt, "--no-hsa"))
+      rules->hitSplitAces = FALSE; 
+    else if (!strcmp(opt, "--spanish"))
+    {
+      for (k = 0; k <= NUM_CARDS; k++)
+        counts[k] = rules->rankCounts[k]; 
+      counts[10] -= counts[10] / 4; //the 10s, leaving the face cards 
+      setRankCounts(rules, counts); 
+    }
+    else 
+    {
+      //Options with a value 
+      if (i + 1 >= argc)
+        throwErr("Missing value for an option.", "parseRulesArgs"); 
+      val = argv[++i]; 
+
+      if (!strcmp(opt, "--decks"))
+        rules->numDecks = atoi(val); 
+      else if (!strcmp(opt, "--double"))
+      {
+        if (!strcmp(val, "any"))
+          rules->doubleRule = DOUBLE_ANY_TWO; 
+        else if (!strcmp(val, "9-11"))
+          rules->doubleRule = DOUBLE_NINE_TO_ELEVEN; 
+        else if (!strcmp(val, "10-11"))
+          rules->doubleRule = DOUBLE_TEN_ELEVEN; 
+        else 
+          throwErr("Unknown doubling rule.", "parseRulesArgs"); 
+      }
+      else if (!strcmp(opt, "--splits"))
+        rules->maxSplitHands = atoi(val); 
+      else if (!strcmp(opt, "--surrender"))
+      {
+        if (!strcmp(val, "none"))
+          rules->surrender = SURRENDER_NONE; 
+        else if (!strcmp(val, "late"))
+          rules->surrender = SURRENDER_LATE; 
+        else if (!strcmp(val, "early"))
+          rules->surrender = SURRENDER_EARLY; 
+        else 
+          throwErr("Unknown surrender rule.", "parseRulesArgs"); 
+      }
+      else if (!strcmp(opt, "--charlie"))
+        rules->charlie = atoi(val); 
+      else if (!strcmp(opt, "--bj-pays"))
+        rules->blackjackPays = parsePayout(val); 
+      else 
+        throwErr("Unknown option.", "parseRulesArgs"); 
+    }
+  }
+
+  argv[n] = NULL; 
+  checkRules(rules); 
+  return n; 
+}
+
+
+//------------------------------------------------------------------------------
+// Returns the payout given by s, either as a ratio ("1.5") or as odds ("3:2"). 
+//------------------------------------------------------------------------------
+static double parsePayout (const char *s)
+{
+  double win, bet; 
+
+  if (sscanf(s, "%lf:%lf", &win, &bet) == 2)
+  {
+    if (bet <= 0.)
+      throwErr("Invalid payout.", "parsePayout"); 
+    return win / bet; 
+  }
+  return atof(s); 
+}
@@ -0,0 +1,221 @@
+#include "shoe.h" 
+#include "error.h" 
+#include "stp.h" 
+
+//Fewest cards that must be left behind the cut card, so that the last round 
+//before a reshuffle practically never runs out of cards 
+static const int MIN_CARDS_BEHIND_CUT = 26; 
+
+
+//------------------------------------------------------------------------------
+// Fills a shoe with numDecks decks, with the cut card placed so that the given
+// fraction of the cards is dealt before each reshuffle. The shoe must be 
+// shuffled before it is dealt from. 
+//------------------------------------------------------------------------------
+void initShoe (Shoe *shoe, int numDecks, double penetration)
+{
+  const int NUM_EACH_CARD = 4; //number of each card in a deck 
+  int counts[NUM_CARDS+1]; 
+  int rank; 
+  
+  if (numDecks < 1 || numDecks > MAX_DECKS)
+    throwErr("Unsupported number of decks.", "initShoe"); 
+  
+  for (rank = 1; rank <= NUM_CARDS - 1; rank++)
+    counts[rank] = NUM_EACH_CARD * numDecks; 
+  counts[10] = 4 * NUM_EACH_CARD * numDecks; //10 plus three face cards 
+  
+  initShoeFromCounts(shoe, counts, penetration); 
+}
+
+
+//------------------------------------------------------------------------------
+// Fills a shoe with the given number of cards of each rank, counts[rank] for 
+// rank 1-10, with the cut card placed as in initShoe. 
+//------------------------------------------------------------------------------
+void initShoeFromCounts (Shoe *shoe, const int *counts, double penetration)
+{
+  int rank, k, n; 
+  
+  if (penetration <= 0. || penetration > 1.)
+    throwErr("Penetration must be in (0, 1].", "initShoeFromCounts"); 
+  
+  n = 0; 
+  for (rank = 1; rank <= NUM_CARDS; rank++)
+  {
+    if (counts[rank] < 0 || n + counts[rank] > MAX_SHOE_CARDS)
+      throwErr("Invalid shoe composition.", "initShoeFromCounts"); 
+    
+    for (k = 0; k < counts[rank]; k++)
+      shoe->card[n++] = (unsigned char) rank; 
+  }
+  if (n <= MIN_CARDS_BEHIND_CUT)
+    throwErr("Too few cards in the shoe.", "initShoeFromCounts"); 
+  
+  shoe->ncards = n; 
+  shoe->cutCard = (int) (penetration * n); 
+  if (shoe->cutCard > n - MIN_CARDS_BEHIND_CUT)
+    shoe->cutCard = n - MIN_CARDS_BEHIND_CUT; 
+  shoe->next = n; //nothing left to deal until it is shuffled 
+}
+
+
+//------------------------------------------------------------------------------
+// Shuffles all of the cards back into the shoe (Fisher-Yates). 
+//------------------------------------------------------------------------------
+void shuffleShoe (Shoe *shoe, RandStream *rs)
+{
+  int i, j; 
+  unsigned char tmp; 
+  
+  for (i = shoe->ncards - 1; i > 0; i--)
+  {
+    j = (int) rng_bounded(rs, (uint32_t) (i + 1)); 
+    tmp = shoe->card[i]; 
+    shoe->card[i] = shoe->card[j]; 
+    shoe->card[j] = tmp; 
+  }
+  shoe->next = 0; 
+}
+
+
+//------------------------------------------------------------------------------
+// Deals the next card from the shoe and returns its rank. If the shoe has run 
+// out in the middle of a round (possible only with extreme penetration and a 
+// long round), it is reshuffled first. 
+//------------------------------------------------------------------------------
+int dealCard (Shoe *shoe, RandStream *rs)
+{
+  if (shoe->next >= shoe->ncards)
+    shuffleShoe(shoe, rs); 
+  
+  return shoe->card[shoe->next++]; 
+}
+
+
+//------------------------------------------------------------------------------
+// Indicates whether the cut card has come out, i.e. whether the shoe should be
+// reshuffled before the next round. 
+//------------------------------------------------------------------------------
+int isCutCardReached (const Shoe *shoe)
+{
+  return shoe->next >= shoe->cutCard; 
+}
+
+
+//------------------------------------------------------------------------------
+// Fills a sampler with numDecks full decks. 
+//------------------------------------------------------------------------------
+void initCardSampler (CardSampler *shoe, int numDecks)
+{
+  const int NUM_EACH_CARD = 4; //number of each card in a deck 
+  int counts[NUM_CARDS+1]; 
+  int rank; 
+  
+  for (rank = 1; rank <= NUM_CARDS - 1; rank++)
+    counts[rank] = NUM_EACH_CARD * numDecks; 
+  counts[10] = 4 * NUM_EACH_CARD * numDecks; //10 plus three face cards 
+  
+  initCardSamplerFromCounts(shoe, counts); 
+}
+
+
+//------------------------------------------------------------------------------
+// Fills a sampler with the given number of cards of each rank: counts[rank] 
+// for rank 1-10. 
+//------------------------------------------------------------------------------
+void initCardSamplerFromCounts (CardSampler *shoe, const int *counts)
+{
+  int rank, k, n; 
+  
+  n = 0; 
+  for (rank = 1; rank <= NUM_CARDS; rank++)
+  {
+    if (counts[rank] < 0 || n + counts[rank] > MAX_SHOE_CARDS)
+      throwErr("Invalid shoe composition.", "initCardSamplerFromCounts"); 
+    
+    shoe->start[rank] = n; 
+    for (k = 0; k < counts[rank]; k++)
+      shoe->slot[n++] = (unsigned char) rank; 
+  }
+  shoe->start[NUM_CARDS+1] = n; 
+}
+
+
+//------------------------------------------------------------------------------
+// Number of cards remaining in the shoe. 
+//------------------------------------------------------------------------------
+int cardsLeft (const CardSampler *shoe)
+{
+  return shoe->start[NUM_CARDS+1]; 
+}
+
+
+//------------------------------------------------------------------------------
+// Number of cards of the given rank remaining in the shoe. 
+//------------------------------------------------------------------------------
+int countOfRank (const CardSampler *shoe, int rank)
+{
+  return shoe->start[rank+1] - shoe->start[rank]; 
+}
+
+
+//------------------------------------------------------------------------------
+// Removes one card of the given rank from the shoe. The run of each higher 
+// rank moves down by one slot, which takes one write per rank, so the cost is 
+// bounded by NUM_CARDS whatever the size of the shoe (and is zero for ten-
+// valued cards, the most common). 
+//------------------------------------------------------------------------------
+void removeCard (CardSampler *shoe, int rank)
+{
+  int r; 
+  
+  if (countOfRank(shoe, rank) <= 0)
+    throwErr("No card of this rank is left in the shoe.", "removeCard"); 
+  
+  for (r = rank + 1; r <= NUM_CARDS; r++)
+  {
+    shoe->start[r]--; 
+    shoe->slot[shoe->start[r]] = (unsigned char) r; 
+  }
+  shoe->start[NUM_CARDS+1]--; 
+}
+
+
+//------------------------------------------------------------------------------
+// Draws a card at random from the shoe, removes it, and returns its rank. 
+//------------------------------------------------------------------------------
+int drawCard (CardSampler *shoe, RandStream *rs)
+{
+  int rank = shoe->slot[rng_bounded(rs, (uint32_t) cardsLeft(shoe))]; 
+  
+  removeCard(shoe, rank); 
+  return rank; 
+}
+
+
+//------------------------------------------------------------------------------
+// Draws a card at random from those in the shoe that are not of rank 
+// excludedRank, removes it, and returns its rank. This is the same as drawing 
+// repeatedly until the card is not excludedRank, but takes a single draw: a 
+// slot is chosen among the slots outside excludedRank's run, and then shifted 
+// past the run if it falls after its start. 
+//------------------------------------------------------------------------------
+int drawCardExcluding (CardSampler *shoe, int excludedRank, RandStream *rs)
+{
+  int excluded = countOfRank(shoe, excludedRank); 
+  int n = cardsLeft(shoe) - excluded; 
+  int k, rank; 
+  
+  if (n <= 0)
+    throwErr("No card of another rank is left in the shoe.", 
+          "drawCardExcluding"); 
+  
+  k = (int) rng_bounded(rs, (uint32_t) n); 
+  if (k >= shoe->start[excludedRank])
+    k += excluded; 
+  
+  rank = shoe->slot[k]; 
+  removeCard(shoe, rank); 
+  return rank; 
+}
@@ -0,0 +1,206 @@
+#include "splits.h" 
+#include <stdlib.h> 
+#include "boolean.h" 
+#include "error.h" 
+
+//Number of states of V whose memo evaluateSplit keeps on the stack, which is 
+//enough for any split in an infinite shoe, and for a finite one with a few 
+//cards of the split rank; larger memos are allocated 
+#define STACK_STATES (256)
+
+//State of evaluateSplit. V(h, n, r) is the total over h hands that are still 
+//to be dealt their second card, when there are n hands in all and r cards of 
+//the split rank are out of the shoe; it is memoized in memo, at 
+//(r * (maxHands+1) + n) * (maxHands+1) + h. In an infinite shoe nothing 
+//depends on r, and only r = 2 is stored. 
+typedef struct { 
+  int maxHands; 
+  int maxRemoved; //0 for an infinite shoe 
+  SplitHandFn fn; 
+  void *arg; 
+  SplitResult *memo; 
+  char *isSolved; //whether each entry of memo has been found 
+  SplitHandValue *value; //value of a hand for each r, from fn 
+  char *hasValue; //for each r, whether value has the hand's values (bit 1) and 
+              //the pair's (bit 2) 
+} SplitEvaluator; 
+
+static SplitResult getHandsValue (SplitEvaluator *e, int h, int n, int r); 
+static const SplitHandValue * getHandValue (SplitEvaluator *e, int r, 
+                              int isPair); 
+static void addScaled (SplitResult *sum, SplitResult x, double p); 
+
+
+//------------------------------------------------------------------------------
+// Returns the totals over the hands that result from splitting a pair into at 
+// most maxHands hands (0 for no limit), when the shoe holds maxRemoved cards 
+// of the split rank in all, counting the pair, or 0 if it is infinite. fn 
+// gives the value of a hand after the split for each number of cards of the 
+// split rank that are out of the shoe; it is called at most once for each, 
+// and for the pair only if a pair may be left. 
+// 
+// Each hand in turn is dealt its second card. Another card of the split rank 
+// starts a new hand, if there may be more hands, or else leaves a pair that 
+// is played as it is. With d = fn(r) and p = d.pairProb, 
+// V(h, n, r) = d.ev + (1-p) V(h-1, n, r) + p V(h+1, n+1, r+1) if n < maxHands,
+// V(h, n, r) = d.ev + (1-p) V(h-1, n, r) + p (fn(r+1).pairEV + V(h-1, n, r+1))
+// for n = maxHands, and V(0, n, r) = 0; the split is worth V(2, 2, 2). Every 
+// state that the split can reach is solved once. The cards that the hands 
+// draw other than those of the split rank are not taken out of the shoe for 
+// the hands after them, as is usual in combinatorial analysis. 
+// 
+// In an infinite shoe with no limit on the hands, each hand after the split 
+// is worth X = d + 2 p X, and the split 2 d / (1 - 2 p). 
+// 
+// The memo is kept on the stack when it is small enough (STACK_STATES), as it 
+// is for every split in the chart, so that solving the chart allocates 
+// nothing. 
+//------------------------------------------------------------------------------
+SplitResult evaluateSplit (int maxHands, int maxRemoved, SplitHandFn fn, 
+                  void *arg)
+{
+  SplitEvaluator e; 
+  SplitResult result; 
+  SplitHandValue d; 
+  SplitResult memo[STACK_STATES]; 
+  char isSolved[STACK_STATES]; 
+  SplitHandValue value[STACK_STATES]; 
+  char hasValue[STACK_STATES]; 
+  double p; 
+  int size, nr, i; 
+
+  if (maxRemoved != 0 && maxRemoved < 2)
+    throwErr("The shoe must hold the pair.", "evaluateSplit"); 
+
+  if (maxHands == 0 && maxRemoved == 0)
+  {
+    fn(2, FALSE, &d, arg); 
+    p = d.pairProb; 
+    result.ev = 2. * d.ev / (1. - 2. * p); 
+    result.win = 2. * d.win / (1. - 2. * p); 
+    result.loss = 2. * d.loss / (1. - 2. * p); 
+    result.nhands = 2. * (1. - p) / (1. - 2. * p); 
+    return result; 
+  }
+
+  //There can be no more hands than cards of the split rank 
+  if (maxHands == 0 || (maxRemoved != 0 && maxHands > maxRemoved))
+    maxHands = maxRemoved; 
+  if (maxHands < 2)
+    maxHands = 2; 
+
+  nr = maxRemoved == 0 ? 3 : maxRemoved + 1; 
+  size = nr * (maxHands + 1) * (maxHands + 1); 
+  e.maxHands = maxHands; 
+  e.maxRemoved = maxRemoved; 
+  e.fn = fn; 
+  e.arg = arg; 
+  if (size <= STACK_STATES && nr + 1 <= STACK_STATES)
+  {
+    e.memo = memo; 
+    e.isSolved = isSolved; 
+    e.value = value; 
+    e.hasValue = hasValue; 
+    for (i = 0; i < size; i++)
+      isSolved[i] = 0; 
+    for (i = 0; i <= nr; i++)
+      hasValue[i] = 0; 
+    return getHandsValue(&e, 2, 2, 2); 
+  }
+  
+  e.memo = (SplitResult *) malloc(size * sizeof(SplitResult)); 
+  e.isSolved = (char *) calloc(size, sizeof(char)); 
+  e.value = (SplitHandValue *) malloc((nr + 1) * sizeof(SplitHandValue)); 
+  e.hasValue = (char *) calloc(nr + 1, sizeof(char)); 
+  if (e.memo == NULL || e.isSolved == NULL || e.value == NULL 
+      || e.hasValue == NULL)
+    throwMemErr("e", "evaluateSplit"); 
+
+  result = getHandsValue(&e, 2, 2, 2); 
+
+  free(e.memo); 
+  free(e.isSolved); 
+  free(e.value); 
+  free(e.hasValue); 
+  return result; 
+}
+
+
+//------------------------------------------------------------------------------
+// Returns V(h, n, r) (see evaluateSplit), solving it if it has not been. 
+//------------------------------------------------------------------------------
+static SplitResult getHandsValue (SplitEvaluator *e, int h, int n, int r)
+{
+  SplitResult v, zero = {0., 0., 0., 0.}; 
+  SplitHandValue d, pair; 
+  int i, next; 
+
+  if (h == 0)
+    return zero; 
+  if (e->maxRemoved == 0) //nothing depends on r 
+    r = 2; 
+  i = (r * (e->maxHands + 1) + n) * (e->maxHands + 1) + h; 
+  if (e->isSolved[i])
+    return e->memo[i]; 
+
+  d = *getHandValue(e, r, FALSE); 
+  v.ev = d.ev; 
+  v.win = d.win; 
+  v.loss = d.loss; 
+  v.nhands = 1. - d.pairProb; 
+  addScaled(&v, getHandsValue(e, h - 1, n, r), 1. - d.pairProb); 
+
+  if (d.pairProb > 0.)
+  {
+    if (e->maxRemoved != 0 && r >= e->maxRemoved)
+      throwErr("More cards of the split rank than the shoe holds.", 
+        "getHandsValue"); 
+    next = e->maxRemoved == 0 ? r : r + 1; 
+    if (n < e->maxHands)
+      addScaled(&v, getHandsValue(e, h + 1, n + 1, next), d.pairProb); 
+    else 
+    {
+      pair = *getHandValue(e, next, TRUE); 
+      v.ev += d.pairProb * pair.pairEV; 
+      v.win += d.pairProb * pair.pairWin; 
+      v.loss += d.pairProb * pair.pairLoss; 
+      v.nhands += d.pairProb; 
+      addScaled(&v, getHandsValue(e, h - 1, n, next), d.pairProb); 
+    }
+  }
+
+  e->memo[i] = v; 
+  e->isSolved[i] = 1; 
+  return v; 
+}
+
+
+//------------------------------------------------------------------------------
+// Returns the value of a hand after the split with r cards of the split rank 
+// out of the shoe, having the values of the pair in it if isPair is true and 
+// of the other hands if not, which are got from fn the first time. 
+//------------------------------------------------------------------------------
+static const SplitHandValue * getHandValue (SplitEvaluator *e, int r, 
+                              int isPair)
+{
+  int bit = isPair ? 2 : 1; 
+  
+  if (!(e->hasValue[r] & bit))
+  {
+    e->fn(r, isPair, &e->value[r], e->arg); 
+    e->hasValue[r] |= bit; 
+  }
+  return &e->value[r]; 
+}
+
+
+//------------------------------------------------------------------------------
+// Adds p times x to sum. 
+//------------------------------------------------------------------------------
+static void addScaled (SplitResult *sum, SplitResult x, double p)
+{
+  sum->ev += p * x.ev; 
+  sum->win += p * x.win; 
+  sum->loss += p * x.loss; 
+  sum->nhands += p * x.nhands; 
+}
@@ -0,0 +1,357 @@
+#include "sweep.h" 
+#include <stdio.h> 
+#include <stdlib.h> 
+#include <string.h> 
+#include "boolean.h" 
+#include "error.h" 
+#include "linal.h" 
+#include "parallel.h" 
+#include "cd_strat.h" 
+#include "hands.h" 
+
+//Largest number of variants a sweep may have 
+static const int MAX_SWEEP_VARIANTS = 1 << 20; 
+
+//An axis that turns a rule on or off, and the options of parseRulesArgs that 
+//do so; it takes the values yes and no. Any other axis is named after an 
+//option that takes a value, e.g. "decks" for --decks. 
+typedef struct { 
+  const char *name; 
+  const char *yes; 
+  const char *no; 
+} SweepFlag; 
+
+static const SweepFlag SWEEP_FLAGS[] = { 
+  {"h17", "--h17", "--s17"}, 
+  {"enhc", "--enhc", "--hole-card"}, 
+  {"das", "--das", "--no-das"}, 
+  {"rsa", "--rsa", "--no-rsa"}, 
+  {"hsa", "--hsa", "--no-hsa"}, 
+}; 
+static const int NUM_SWEEP_FLAGS = sizeof(SWEEP_FLAGS) / sizeof(SweepFlag); 
+
+//Work shared by all threads in runSweep 
+typedef struct { 
+  Sweep *sweep; 
+  double ***dealerTables; //dealersProbabilities for each dealer 
+  int *firstOfDealer; //first variant that plays against each dealer 
+  StrategyTable **charts; //one chart for each thread to solve in 
+  int *actions; //plays of each variant's chart, NUM_HANDS * (NUM_CARDS+1) per 
+             //variant, for counting the changes 
+} SweepJob; 
+
+static void applySweepValue (Rules *rules, const SweepAxis *axis, int k); 
+static int isSameDealer (const Rules *a, const Rules *b); 
+static void sweepDealerTask (int task, int thread, void *arg); 
+static void sweepVariantTask (int task, int thread, void *arg); 
+
+
+//------------------------------------------------------------------------------
+// Starts a spec with no axes, whose variants are all the given rules. 
+//------------------------------------------------------------------------------
+void initSweepSpec (SweepSpec *spec, const Rules *base)
+{
+  spec->base = *base; 
+  spec->naxes = 0; 
+  spec->cd = FALSE; 
+}
+
+
+//------------------------------------------------------------------------------
+// Adds an axis given as "name=value,value,...", e.g. "charlie=0,5,6", 
+// "surrender=none,late" or "das=yes,no". The names are those of the options 
+// of parseRulesArgs that take a value (decks, double, splits, surrender, 
+// charlie and bj-pays), with the same values, and h17, enhc, das, rsa and 
+// hsa, which take yes or no. Exits with an error if any value is not valid. 
+// 
+// The chart and its expected value assume an infinite shoe, so only the 
+// composition-dependent results depend on the number of decks; a decks axis 
+// is an error unless spec->cd has been set. 
+//------------------------------------------------------------------------------
+void addSweepAxis (SweepSpec *spec, const char *arg)
+{
+  SweepAxis *axis; 
+  Rules check; 
+  const char *eq, *val, *end; 
+  size_t len; 
+  int k; 
+
+  if (spec->naxes >= MAX_SWEEP_AXES)
+    throwErr("Too many sweep axes.", "addSweepAxis"); 
+  eq = strchr(arg, '='); 
+  if (eq == NULL || eq == arg || eq[1] == '\0')
+    throwErr("A sweep axis must be given as name=value,value,...", 
+      "addSweepAxis"); 
+  len = eq - arg; 
+  if (len >= SWEEP_NAME_LENGTH)
+    throwErr("Sweep axis name is too long.", "addSweepAxis"); 
+
+  axis = &spec->axis[spec->naxes]; 
+  memcpy(axis->name, arg, len); 
+  axis->name[len] = '\0'; 
+  for (k = 0; k < spec->naxes; k++)
+    if (!strcmp(spec->axis[k].name, axis->name))
+      throwErr("Sweep axis is given twice.", "addSweepAxis"); 
+  if (!strcmp(axis->name, "decks") && !(spec->cd))
+    throwErr("A decks axis changes nothing without cd, since the chart "
+      "assumes an infinite shoe.", "addSweepAxis"); 
+
+  axis->nvalues = 0; 
+  for (val = eq + 1; ; val = end + 1)
+  {
+    end = strchr(val, ','); 
+    len = end == NULL ? strlen(val) : (size_t) (end - val); 
+    if (len == 0 || len >= SWEEP_NAME_LENGTH)
+      throwErr("Invalid sweep value.", "addSweepAxis"); 
+    if (axis->nvalues >= MAX_SWEEP_VALUES)
+      throwErr("Too many values on a sweep axis.", "addSweepAxis"); 
+    memcpy(axis->values[axis->nvalues], val, len); 
+    axis->values[axis->nvalues][len] = '\0'; 
+    axis->nvalues++; 
+    if (end == NULL)
+      break; 
+  }
+
+  //Try each value, so that a bad one is caught before anything is solved 
+  for (k = 0; k < axis->nvalues; k++)
+  {
+    check = spec->base; 
+    applySweepValue(&check, axis, k); 
+  }
+
+  spec->naxes++; 
+}
+
+
+//------------------------------------------------------------------------------
+// Makes an unsolved sweep of every combination of the spec's axes, and finds 
+// which variants can share a dealer table; runSweep solves it. 
+//------------------------------------------------------------------------------
+Sweep * newSweep (const SweepSpec *spec)
+{
+  Sweep *sweep = NULL; 
+  SweepVariant *v; 
+  int *firstOfDealer = NULL; 
+  int n, a, k, d, rem; 
+
+  n = 1; 
+  for (a = 0; a < spec->naxes; a++)
+  {
+    if (n > MAX_SWEEP_VARIANTS / spec->axis[a].nvalues)
+      throwErr("Too many variants in the sweep.", "newSweep"); 
+    n *= spec->axis[a].nvalues; 
+  }
+
+  sweep = (Sweep *) malloc(sizeof(Sweep)); 
+  if (sweep == NULL) throwMemErr("sweep", "newSweep"); 
+  sweep->variant = (SweepVariant *) malloc(n * sizeof(SweepVariant)); 
+  if (sweep->variant == NULL) throwMemErr("sweep->variant", "newSweep"); 
+  firstOfDealer = (int *) malloc(n * sizeof(int)); 
+  if (firstOfDealer == NULL) throwMemErr("firstOfDealer", "newSweep"); 
+  sweep->spec = *spec; 
+  sweep->nvariants = n; 
+  sweep->ndealers = 0; 
+
+  for (k = 0; k < n; k++)
+  {
+    v = &sweep->variant[k]; 
+    v->rules = spec->base; 
+    rem = k; 
+    for (a = spec->naxes - 1; a >= 0; a--)
+    {
+      v->value[a] = rem % spec->axis[a].nvalues; 
+      rem /= spec->axis[a].nvalues; 
+    }
+    for (a = 0; a < spec->naxes; a++)
+      applySweepValue(&v->rules, &spec->axis[a], v->value[a]); 
+    v->ev = v->cdEV = 0.; 
+    v->nchanges = 0; 
+
+    for (d = 0; d < sweep->ndealers; d++)
+      if (isSameDealer(&v->rules, &sweep->variant[firstOfDealer[d]].rules))
+        break; 
+    if (d == sweep->ndealers)
+      firstOfDealer[sweep->ndealers++] = k; 
+    v->dealer = d; 
+  }
+
+  free(firstOfDealer); 
+  return sweep; 
+}
+
+
+//------------------------------------------------------------------------------
+// Frees a sweep made by newSweep. 
+//------------------------------------------------------------------------------
+void freeSweep (Sweep *sweep)
+{
+  if (sweep == NULL)
+    return; 
+  free(sweep->variant); 
+  free(sweep); 
+}
+
+
+//------------------------------------------------------------------------------
+// Solves every variant of the sweep on nthreads threads: its chart, its 
+// expected value, how many of its plays differ from the first variant's and, 
+// if the spec asks for it, its composition-dependent expected value. 
+// 
+// The dealer's table (dealersProbabilities) depends only on how he plays and 
+// on the proportions of the cards, not on what the player may do or (for an 
+// infinite shoe) on the number of decks, so the distinct tables are solved 
+// first, in parallel, and each is then shared by all of its variants. The 
+// variants are handed out to the threads one at a time, each thread solving 
+// in a chart of its own; this relies on the chart solver keeping its tables 
+// per thread. 
+//------------------------------------------------------------------------------
+void runSweep (Sweep *sweep, int nthreads)
+{
+  const int NCELLS = NUM_HANDS * (NUM_CARDS+1); //cells of a chart 
+  SweepJob job; 
+  int k, d, t, i; 
+
+  if (hands == NULL)
+    throwErr("makeHands has not been called.", "runSweep"); 
+  if (nthreads < 1)
+    nthreads = 1; 
+
+  job.sweep = sweep; 
+  job.dealerTables = (double ***) malloc(sweep->ndealers 
+                                * sizeof(double **)); 
+  if (job.dealerTables == NULL) throwMemErr("job.dealerTables", "runSweep"); 
+  job.firstOfDealer = (int *) malloc(sweep->ndealers * sizeof(int)); 
+  if (job.firstOfDealer == NULL) throwMemErr("job.firstOfDealer", "runSweep"); 
+  job.actions = (int *) malloc((size_t) sweep->nvariants * NCELLS 
+                        * sizeof(int)); 
+  if (job.actions == NULL) throwMemErr("job.actions", "runSweep"); 
+  job.charts = (StrategyTable **) malloc(nthreads * sizeof(StrategyTable *)); 
+  if (job.charts == NULL) throwMemErr("job.charts", "runSweep"); 
+  for (t = 0; t < nthreads; t++)
+    job.charts[t] = newStrategyTable(NUM_HANDS); 
+
+  d = 0; 
+  for (k = 0; k < sweep->nvariants && d < sweep->ndealers; k++)
+    if (sweep->variant[k].dealer == d)
+      job.firstOfDealer[d++] = k; 
+
+  parallel_for(sweep->ndealers, nthreads, sweepDealerTask, &job); 
+  parallel_for(sweep->nvariants, nthreads, sweepVariantTask, &job); 
+
+  for (k = 0; k < sweep->nvariants; k++)
+  {
+    sweep->variant[k].nchanges = 0; 
+    for (i = 0; i < NCELLS; i++)
+      if (job.actions[k * NCELLS + i] != job.actions[i])
+        sweep->variant[k].nchanges++; 
+  }
+
+  for (d = 0; d < sweep->ndealers; d++)
+    freematrix(job.dealerTables[d], NUM_CARDS+1); 
+  for (t = 0; t < nthreads; t++)
+    freeStrategyTable(job.charts[t]); 
+  free(job.charts); 
+  free(job.actions); 
+  free(job.firstOfDealer); 
+  free(job.dealerTables); 
+}
+
+
+//------------------------------------------------------------------------------
+// Sets the rule of the given axis in rules to the axis's kth value, using 
+// parseRulesArgs. Exits with an error if the axis or the value is not valid. 
+//------------------------------------------------------------------------------
+static void applySweepValue (Rules *rules, const SweepAxis *axis, int k)
+{
+  char opt[SWEEP_NAME_LENGTH + 2]; 
+  char *argv[4]; 
+  const char *val = axis->values[k]; 
+  int f, argc; 
+
+  argv[0] = "sweep"; 
+  for (f = 0; f < NUM_SWEEP_FLAGS; f++)
+    if (!strcmp(axis->name, SWEEP_FLAGS[f].name))
+      break; 
+
+  if (f < NUM_SWEEP_FLAGS)
+  {
+    if (!strcmp(val, "yes"))
+      argv[1] = (char *) SWEEP_FLAGS[f].yes; 
+    else if (!strcmp(val, "no"))
+      argv[1] = (char *) SWEEP_FLAGS[f].no; 
+    else 
+      throwErr("A yes/no sweep axis takes yes or no.", "applySweepValue"); 
+    argc = 2; 
+  }
+  else 
+  {
+    sprintf(opt, "--%s", axis->name); 
+    argv[1] = opt; 
+    argv[2] = (char *) val; 
+    argc = 3; 
+  }
+
+  //An option that takes no value leaves the value behind as an argument 
+  if (parseRulesArgs(rules, argc, argv) != 1)
+    throwErr("Unknown sweep axis.", "applySweepValue"); 
+}
+
+
+//------------------------------------------------------------------------------
+// Indicates whether two sets of rules give the dealer the same table of 
+// dealersProbabilities: whether he hits soft 17 and the proportions of the 
+// cards are all that it depends on. 
+//------------------------------------------------------------------------------
+static int isSameDealer (const Rules *a, const Rules *b)
+{
+  return a->hitSoft17 == b->hitSoft17 
+    && !memcmp(a->cardProbs, b->cardProbs, sizeof(a->cardProbs)); 
+}
+
+
+//------------------------------------------------------------------------------
+// Task for parallel_for in runSweep: solves dealer table number task. 
+//------------------------------------------------------------------------------
+static void sweepDealerTask (int task, int thread, void *arg)
+{
+  SweepJob *job = (SweepJob *) arg; 
+  SweepVariant *v = &job->sweep->variant[job->firstOfDealer[task]]; 
+
+  job->dealerTables[task] = makeDealersProbabilities(&v->rules); 
+}
+
+
+//------------------------------------------------------------------------------
+// Task for parallel_for in runSweep: solves variant number task in the 
+// thread's chart, against its shared dealer table. 
+//------------------------------------------------------------------------------
+static void sweepVariantTask (int task, int thread, void *arg)
+{
+  const int NCELLS = NUM_HANDS * (NUM_CARDS+1); 
+  SweepJob *job = (SweepJob *) arg; 
+  SweepVariant *v = &job->sweep->variant[task]; 
+  StrategyTable *chart = job->charts[thread]; 
+  int *actions = job->actions + (size_t) task * NCELLS; 
+  CDChart *cdChart = NULL; 
+  int i, c; 
+
+  dealersProbabilities = job->dealerTables[v->dealer]; 
+  calculateStrategyChart(chart, FALSE, &v->rules); 
+  v->ev = getExpectedValue(chart, &v->rules); 
+
+  //A play is the action, and whether to surrender first; the cells are laid 
+  //out as in the chart 
+  for (c = 0; c < NCELLS; c++)
+    actions[c] = 2 * chart->action[c] + chart->surrender[c]; 
+  for (i = 0; i < NUM_HANDS; i++)
+    actions[STRAT_CELL(i, 0)] = 0; 
+  freeStratTables(); 
+
+  if (job->sweep->spec.cd)
+  {
+    cdChart = newCDChart(&v->rules); 
+    calculateCDChart(cdChart, 1); 
+    v->cdEV = cdChart->ev; 
+    freeCDChart(cdChart); 
+  }
+}
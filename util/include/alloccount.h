@@ -0,0 +1,16 @@
+/*
+ * alloccount.h
+ * Kevin Coltin 
+ *
+ * Counts heap allocations, for checking that inner loops do not allocate. The
+ * counting only happens when the library is built with COUNT_ALLOCS defined
+ * (cmake -DCOUNT_ALLOCS=ON), in which case malloc, calloc, realloc and 
+ * posix_memalign are replaced by versions that count each call. 
+ */
+
+#ifndef ALLOCCOUNT_H
+#define ALLOCCOUNT_H 
+
+long alloc_count (); 
+
+#endif 
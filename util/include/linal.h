@@ -15,14 +15,37 @@ file "linal_orig.h".
 #include <gsl/gsl_math.h> 
 #include <gsl/gsl_eigen.h> 
 
+//A real matrix stored by rows in one block: entry i,j is 
+//data[i * stride + j]. The stride is at least ncols, so that a matrix can be 
+//a block of a larger one. A matrix made by allocmatrix is stored the same 
+//way, and dmat_rows gives a view of it. 
+typedef struct {
+	double *data; 
+	int nrows, ncols; 
+	int stride; //distance between the starts of successive rows 
+} dmatrix; 
+
+#define DMAT(A, i, j) ((A).data[(size_t) (i) * (A).stride + (j)])
+
+dmatrix dmat_alloc (int M, int N); 
+void dmat_free (dmatrix A); 
+dmatrix dmat_rows (double **A, int M, int N); 
+dmatrix dmat_block (dmatrix A, int i, int j, int M, int N); 
+void dmat_vtimesm (const double *x, dmatrix A, double *y); 
+void dmat_mtimesm (dmatrix A, dmatrix B, dmatrix C); 
+
 double dot(double *x, double *y, int N);
 void c_rowswap(double complex **A, int i1, int i2);
 double * vtimesm(double *x, double **A, int M, int N);
+double * vtimesm_naive(double *x, double **A, int M, int N);
 double ** mtimesm(double **A, double **B, int M, int K, int N);
+double ** mtimesm_naive(double **A, double **B, int M, int K, int N);
 int is_csingular (double complex **A, int N); 
 double ccondit_num (double complex **A, int N); 
 double complex * c_solve(double complex **A, double complex *b, int N);
 double complex ** c_msolve (double complex **A, double complex **B, int N, int M); 
+double complex ** c_msolve_naive (double complex **A, double complex **B, 
+                         int N, int M); 
 double ** transpose(double **A, int M, int N);
 double complex ** c_transpose(double complex **A, int M, int N);
 int c_pivot_row(double complex **A, int M, int N, int start_row, int column);
@@ -41,6 +64,7 @@ void freeimatrix(int **, int);
 void eigendecomp (double **A, double complex **X, double complex *d, int n);
 double ** matrixpow (double **, int, double); 
 double ** matrixpow_basic (double **, int, int); 
+double ** absorbing_chain (double **P, int n); 
 double * copyv (double *, int); 
 double ** copym (double **, int, int); 
 void copycv_inplace (double complex *copy, double complex *orig, int n); 
@@ -0,0 +1,19 @@
+/*
+ * parallel.h
+ * Kevin Coltin 
+ *
+ * Contains a minimal pool of POSIX threads for running a batch of independent
+ * tasks concurrently. 
+ */
+
+#ifndef PARALLEL_H
+#define PARALLEL_H 
+
+//Signature of a task: the task number, the number (0 to nthreads-1) of the 
+//thread that is running it, and a user-supplied argument. 
+typedef void (*ParallelTask) (int task, int thread, void *arg); 
+
+int num_cpus (); 
+void parallel_for (int ntasks, int nthreads, ParallelTask fn, void *arg); 
+
+#endif 
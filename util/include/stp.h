@@ -12,14 +12,53 @@
 #ifndef STP_H 
 #define STP_H 
 
+#include <stddef.h>
+#include <stdint.h>
 #include <gsl/gsl_rng.h>
 
+//A counter-based random number stream (Philox4x32-10, from Salmon et al., 
+//"Parallel random numbers: as easy as 1, 2, 3", SC11). Every output is a pure
+//function of (seed, stream, substream, position), so any stream can be 
+//started, or moved to any position, in constant time, and a computation that
+//gives each piece of work its own (stream, substream) produces the same 
+//numbers however the pieces are divided among threads or processes. 
+typedef struct {
+	uint32_t key[2]; //the seed 
+	uint32_t stream; 
+	uint32_t substream; 
+	uint64_t pos; //number of 32-bit words already drawn from the substream 
+	uint32_t out[4]; //the block of output containing word pos 
+	uint32_t flip; //XORed into every word drawn: 0 normally, or all ones to
+	               //give the antithetic stream (see rng_set_antithetic) 
+} RandStream; 
+
 gsl_rng * init_runif (); 
+unsigned long int time_seed (); 
+void rng_seed (RandStream *rs, uint64_t seed); 
+void rng_set_stream (RandStream *rs, uint32_t stream, uint32_t substream); 
+void rng_skip (RandStream *rs, uint64_t n); 
+void rng_set_antithetic (RandStream *rs, int antithetic); 
+uint32_t rng_u32 (RandStream *rs); 
+uint32_t rng_bounded (RandStream *rs, uint32_t n); 
+void rng_fill_u32 (RandStream *rs, uint32_t *x, size_t n); 
+void rng_fill_bounded (RandStream *rs, uint32_t *x, size_t n, uint32_t bound); 
+
 double runif (); 
 int rdiscunif (int a, int b); 
 int randdraw (double *v, int N); 
 int randdraw_count (int *v, int N); 
 int randdraw_count2 (int *v, int N, int sum); 
 
+//Reentrant versions of the above, which draw from the given stream rather 
+//than the global generator used by runif. These are safe to call from several
+//threads at once as long as each thread has its own stream. 
+double runif_r (RandStream *rs); 
+int rdiscunif_r (RandStream *rs, int a, int b); 
+int randdraw_r (RandStream *rs, double *v, int N); 
+int randdraw_count2_r (RandStream *rs, int *v, int N, int sum); 
+
+double pnorm (double x); 
+double qnorm (double p); 
+
 
 #endif 
@@ -0,0 +1,73 @@
+#include "alloccount.h" 
+#include <stdlib.h> 
+#include <errno.h> 
+
+#ifdef COUNT_ALLOCS 
+
+//The allocator functions behind the standard ones in glibc 
+extern void * __libc_malloc (size_t); 
+extern void * __libc_calloc (size_t, size_t); 
+extern void * __libc_realloc (void *, size_t); 
+extern void * __libc_memalign (size_t, size_t); 
+
+//Number of allocations so far, over all threads; incremented atomically 
+static long nallocs = 0; 
+
+
+//------------------------------------------------------------------------------
+// Returns the number of heap allocations made so far by all threads. 
+//------------------------------------------------------------------------------
+long alloc_count ()
+{
+	return __sync_add_and_fetch(&nallocs, 0); 
+}
+
+
+//------------------------------------------------------------------------------
+// Replacements for the standard allocators, which count each call and then 
+// hand it on to glibc. 
+//------------------------------------------------------------------------------
+void * malloc (size_t size)
+{
+	__sync_fetch_and_add(&nallocs, 1); 
+	return __libc_malloc(size); 
+}
+
+
+void * calloc (size_t n, size_t size)
+{
+	__sync_fetch_and_add(&nallocs, 1); 
+	return __libc_calloc(n, size); 
+}
+
+
+void * realloc (void *ptr, size_t size)
+{
+	__sync_fetch_and_add(&nallocs, 1); 
+	return __libc_realloc(ptr, size); 
+}
+
+
+int posix_memalign (void **ptr, size_t alignment, size_t size)
+{
+	void *p; 
+	
+	__sync_fetch_and_add(&nallocs, 1); 
+	p = __libc_memalign(alignment, size); 
+	if (p == NULL)
+		return ENOMEM; 
+	*ptr = p; 
+	return 0; 
+}
+
+#else 
+
+//------------------------------------------------------------------------------
+// Allocations are not counted in this build, so this returns -1. 
+//------------------------------------------------------------------------------
+long alloc_count ()
+{
+	return -1; 
+}
+
+#endif 
@@ -9,6 +9,173 @@
 #include <gsl/gsl_math.h> 
 #include <gsl/gsl_eigen.h> 
 
+//BLAS and LAPACK routines, which take every argument by reference and store 
+//matrices by columns. A matrix stored by rows is its transpose stored by 
+//columns, which the functions below use instead of copying. 
+extern void dgemm_ (const char *transa, const char *transb, const int *m, 
+		const int *n, const int *k, const double *alpha, const double *a, 
+		const int *lda, const double *b, const int *ldb, const double *beta, 
+		double *c, const int *ldc); 
+extern void dgemv_ (const char *trans, const int *m, const int *n, 
+		const double *alpha, const double *a, const int *lda, const double *x, 
+		const int *incx, const double *beta, double *y, const int *incy); 
+extern void zgesv_ (const int *n, const int *nrhs, double complex *a, 
+		const int *lda, int *ipiv, double complex *b, const int *ldb, int *info); 
+extern double zlange_ (const char *norm, const int *m, const int *n, 
+		const double complex *a, const int *lda, double *work); 
+extern void zgecon_ (const char *norm, const int *n, const double complex *a, 
+		const int *lda, const double *anorm, double *rcond, double complex *work, 
+		double *rwork, int *info); 
+
+static void absorb_state (double **P, int n, int i, int *state, double **B); 
+static dmatrix dmat_rows_or_copy (double **A, int M, int N, int *copied); 
+
+
+//------------------------------------------------------------------------------
+// Allocates an M x N matrix, without initializing its entries, stored by rows
+// with no gap between them. 
+//------------------------------------------------------------------------------
+dmatrix dmat_alloc (int M, int N)
+{
+	dmatrix A; 
+	
+	A.data = (double *) malloc((size_t) M * N * sizeof(double)); 
+	if (A.data == NULL && M > 0 && N > 0) throwMemErr("A.data", "dmat_alloc"); 
+	A.nrows = M; 
+	A.ncols = N; 
+	A.stride = N; 
+	return A; 
+}
+
+
+//------------------------------------------------------------------------------
+// Frees a matrix made by dmat_alloc (not a view or a block of one). 
+//------------------------------------------------------------------------------
+void dmat_free (dmatrix A)
+{
+	free(A.data); 
+}
+
+
+//------------------------------------------------------------------------------
+// Returns a view of an M x N matrix made by allocmatrix, whose rows are stored
+// one after another. It shares the entries of A. 
+//------------------------------------------------------------------------------
+dmatrix dmat_rows (double **A, int M, int N)
+{
+	dmatrix view; 
+	int i; 
+	
+	for (i = 1; i < M; i++)
+		if (A[i] != A[0] + (size_t) i * N)
+			throwErr("The rows of the matrix are not stored together.", 
+				"dmat_rows"); 
+	
+	view.data = M > 0 ? A[0] : NULL; 
+	view.nrows = M; 
+	view.ncols = N; 
+	view.stride = N; 
+	return view; 
+}
+
+
+//------------------------------------------------------------------------------
+// Returns a view of the M x N block of A whose first entry is A(i, j). It 
+// shares the entries of A. 
+//------------------------------------------------------------------------------
+dmatrix dmat_block (dmatrix A, int i, int j, int M, int N)
+{
+	dmatrix block; 
+	
+	if (i < 0 || j < 0 || i + M > A.nrows || j + N > A.ncols)
+		throwErr("The block is outside of the matrix.", "dmat_block"); 
+	
+	block.data = A.data + (size_t) i * A.stride + j; 
+	block.nrows = M; 
+	block.ncols = N; 
+	block.stride = A.stride; 
+	return block; 
+}
+
+
+//------------------------------------------------------------------------------
+// Sets y to the product xA of the row vector x, of length A.nrows, and A; y 
+// has length A.ncols. Uses dgemv. 
+//------------------------------------------------------------------------------
+void dmat_vtimesm (const double *x, dmatrix A, double *y)
+{
+	const double ONE = 1., ZERO = 0.; 
+	const int INC = 1; 
+	int j; 
+	
+	if (A.ncols == 0)
+		return; 
+	if (A.nrows == 0)
+	{
+		for (j = 0; j < A.ncols; j++)
+			y[j] = 0.; 
+		return; 
+	}
+	
+	//A stored by columns is its transpose, and xA = A'x 
+	dgemv_("N", &A.ncols, &A.nrows, &ONE, A.data, &A.stride, x, &INC, &ZERO, 
+		y, &INC); 
+}
+
+
+//------------------------------------------------------------------------------
+// Sets C to the product AB, where A is M x K, B is K x N and C is M x N. C 
+// must not share any entries with A or B. Uses dgemm. 
+//------------------------------------------------------------------------------
+void dmat_mtimesm (dmatrix A, dmatrix B, dmatrix C)
+{
+	const double ONE = 1., ZERO = 0.; 
+	int i, j; 
+	
+	if (A.ncols != B.nrows || C.nrows != A.nrows || C.ncols != B.ncols)
+		throwErr("The dimensions of the matrices do not agree.", 
+			"dmat_mtimesm"); 
+	if (C.nrows == 0 || C.ncols == 0)
+		return; 
+	if (A.ncols == 0)
+	{
+		for (i = 0; i < C.nrows; i++)
+			for (j = 0; j < C.ncols; j++)
+				DMAT(C, i, j) = 0.; 
+		return; 
+	}
+	
+	//Stored by columns, the matrices are their transposes, and C' = B'A' 
+	dgemm_("N", "N", &C.ncols, &C.nrows, &A.ncols, &ONE, B.data, &B.stride, 
+		A.data, &A.stride, &ZERO, C.data, &C.stride); 
+}
+
+
+//------------------------------------------------------------------------------
+// Returns a view of A if its rows are stored together, as they are if it was 
+// made by allocmatrix, or else a copy of it, setting *copied to whether the 
+// caller must free it with dmat_free. 
+//------------------------------------------------------------------------------
+static dmatrix dmat_rows_or_copy (double **A, int M, int N, int *copied)
+{
+	dmatrix B; 
+	int i, j; 
+	
+	*copied = FALSE; 
+	for (i = 1; i < M; i++)
+		if (A[i] != A[0] + (size_t) i * N)
+			*copied = TRUE; 
+	if (!(*copied))
+		return dmat_rows(A, M, N); 
+	
+	B = dmat_alloc(M, N); 
+	for (i = 0; i < M; i++)
+		for (j = 0; j < N; j++)
+			DMAT(B, i, j) = A[i][j]; 
+	return B; 
+}
+
+
 double dot (double *x, double *y, int N)
 {
 	int i;
@@ -30,8 +197,31 @@ void c_rowswap(double complex **A, int i1, int i2)
 
 
 
-// Product xA of a M x N matrix A and a row vector x of length M
+//------------------------------------------------------------------------------
+// Product xA of a M x N matrix A and a row vector x of length M. Uses dgemv 
+// (see dmat_vtimesm). 
+//------------------------------------------------------------------------------
 double * vtimesm(double *x, double **A, int M, int N)
+{
+	double *b = NULL; 
+	dmatrix a; 
+	int copied; 
+	
+	b = allocvector(N); 
+	if (b == NULL && N > 0) throwMemErr("b", "vtimesm"); 
+	
+	a = dmat_rows_or_copy(A, M, N, &copied); 
+	dmat_vtimesm(x, a, b); 
+	if (copied)
+		dmat_free(a); 
+	return b; 
+}
+
+
+//------------------------------------------------------------------------------
+// Same as vtimesm, computed without BLAS, as it used to be. 
+//------------------------------------------------------------------------------
+double * vtimesm_naive(double *x, double **A, int M, int N)
 {
 	int j;
 	double *b = NULL; 
@@ -48,9 +238,35 @@ double * vtimesm(double *x, double **A, int M, int N)
 
 
 //------------------------------------------------------------------------------
-// Product of an M x K matrix A and a K x N matrix B. 
+// Product of an M x K matrix A and a K x N matrix B. Uses dgemm (see 
+// dmat_mtimesm). 
 //------------------------------------------------------------------------------
 double ** mtimesm(double **A, double **B, int M, int K, int N)
+{
+	double **C; 
+	dmatrix a, b; 
+	int copiedA, copiedB; 
+	
+	C = allocmatrix(M, N); 
+	if (C == NULL)
+		throwMemErr("C", "mtimesm"); 
+	
+	a = dmat_rows_or_copy(A, M, K, &copiedA); 
+	b = dmat_rows_or_copy(B, K, N, &copiedB); 
+	dmat_mtimesm(a, b, dmat_rows(C, M, N)); 
+	if (copiedA)
+		dmat_free(a); 
+	if (copiedB)
+		dmat_free(b); 
+	
+	return C; 
+}
+
+
+//------------------------------------------------------------------------------
+// Same as mtimesm, computed by the naive triple loop, as it used to be. 
+//------------------------------------------------------------------------------
+double ** mtimesm_naive(double **A, double **B, int M, int K, int N)
 {
 	double sum = 0.;
 	int i, j, k;
@@ -58,7 +274,7 @@ double ** mtimesm(double **A, double **B, int M, int K, int N)
 	
 	C = allocmatrix(M, N); 
 	if (C == NULL)
-		throwMemErr("C", "mtimesm"); 
+		throwMemErr("C", "mtimesm_naive"); 
 	
 	for(i = 0; i < M; i++)
 	{
@@ -197,15 +413,55 @@ double complex * c_solve(double complex **A, double complex *b, int N)
 
 //------------------------------------------------------------------------------
 // Solves the system AX = B, where A is N x N, B is N x M, and so X is N x M, 
-// where A and B are complex. 
+// where A and B are complex. Uses zgesv, which factors A once, with partial 
+// pivoting, for all M columns. 
 //------------------------------------------------------------------------------
 double complex ** c_msolve (double complex **A, double complex **B, int N, int M)
+{
+	double complex **X, *a, *b; 
+	int *ipiv = NULL; 
+	int i, j, info; 
+	
+	X = c_allocmatrix (N, M); 
+	if (X == NULL) throwMemErr ("X", "c_msolve"); 
+	if (N == 0 || M == 0)
+		return X; 
+	
+	// zgesv overwrites both, stored by columns 
+	a = cmat_to_fortran (A, N, N); 
+	b = cmat_to_fortran (B, N, M); 
+	ipiv = (int *) malloc (N * sizeof(int)); 
+	if (ipiv == NULL) throwMemErr ("ipiv", "c_msolve"); 
+	
+	zgesv_ (&N, &M, a, &N, ipiv, b, &N, &info); 
+	if (info < 0) 
+		throwErr ("Illegal argument to zgesv", "c_msolve"); 
+	if (info > 0) 
+		throwErr ("Singular Matrix", "c_msolve"); 
+	
+	for (i = 0; i < N; i++)
+		for (j = 0; j < M; j++)
+			X[i][j] = b[j*N+i]; 
+	
+	free (a); 
+	free (b); 
+	free (ipiv); 
+	return X; 
+}
+
+
+//------------------------------------------------------------------------------
+// Same as c_msolve, solving for each column of X in turn with c_solve, as it 
+// used to. 
+//------------------------------------------------------------------------------
+double complex ** c_msolve_naive (double complex **A, double complex **B, 
+                         int N, int M)
 {
 	double complex **X, **x = NULL, **b = NULL; 
 	int j; 
 	
-	x = c_allocmatrix (M, N); 
-	if (x == NULL) throwMemErr ("x", "c_msolve"); 
+	x = (double complex **) malloc (M * sizeof(double complex *)); 
+	if (x == NULL) throwMemErr ("x", "c_msolve_naive"); 
 	b = c_transpose (B, N, M); 
 
 	// Solve each row of X, then transpose X. 
@@ -213,7 +469,7 @@ double complex ** c_msolve (double complex **A, double complex **B, int N, int M
 	for (j = 0; j < M; j++)
 		x[j] = c_solve (A, b[j], N); 
 
-	X = c_transpose (x, N, M); 
+	X = c_transpose (x, M, N); 
 	freecmatrix (x, M); 
 	freecmatrix (b, M); 
 	return X; 
@@ -374,16 +630,24 @@ double * allocvector (int N)
 }
 
 //------------------------------------------------------------------------------
-// Allocates an empty matrix without initializing values to zero 
+// Allocates an empty matrix without initializing values to zero. The row 
+// pointers and the rows, one after another, are in one block, so that the 
+// matrix can be used as a dmatrix (see dmat_rows). 
 //------------------------------------------------------------------------------
 double ** allocmatrix(int M, int N)
 {
 	int i;
 	double **A = NULL; 
+	double *data; 
+	
+	A = (double **) malloc(M * sizeof(double *) 
+		+ (size_t) M * N * sizeof(double)); 
+	if (A == NULL)
+		return NULL; 
 	
-	A = (double **) malloc(M * sizeof(double *)); 
+	data = (double *) (A + M); 
 	for (i = 0; i < M; i++)
-		A[i] = (double *) malloc(N * sizeof(double)); 
+		A[i] = data + (size_t) i * N; 
 
 	return A; 
 }
@@ -417,14 +681,10 @@ complex ** c_allocmatrix(int M, int N)
 
 
 //------------------------------------------------------------------------------
-// Frees the memory of a matrix with leading dimension m. 
+// Frees the memory of a matrix made by allocmatrix, with leading dimension m. 
 //------------------------------------------------------------------------------
 void freematrix(double **A, int m)
 {
-	int i; 
-	
-	for (i = 0; i < m; i++)
-		free(A[i]); 
 	free(A); 
 }
 
@@ -495,6 +755,72 @@ void eigendecomp (double **A, double complex **X, double complex *d, int n)
 }
 
 
+//------------------------------------------------------------------------------
+// Returns the absorption probabilities of an absorbing Markov chain with 
+// transition matrix P (n by n): entry i,j is the probability that the chain, 
+// started in state i, is eventually absorbed in state j. A state is absorbing 
+// if P[i][i] = 1. Apart from self-loops, the transitions must never lead back 
+// to a state already visited, so that the states can be ordered such that P is
+// triangular; this holds for chains of blackjack hands, whose values only go 
+// up. The states are solved in one pass in that order by back-substitution, 
+// B[i] = sum over k != i of P[i][k] * B[k] / (1 - P[i][i]), each after every 
+// state it leads to; the order is found by a depth-first search of P. This is 
+// the limit of P^p as p grows, which matrixpow can only approximate. 
+//------------------------------------------------------------------------------
+double ** absorbing_chain (double **P, int n)
+{
+	double **B; 
+	int *state; //0 if not yet visited, 1 while being solved, 2 once solved 
+	int i; 
+	
+	B = zerosm(n, n); 
+	if (B == NULL) throwMemErr("B", "absorbing_chain"); 
+	state = (int *) calloc(n, sizeof(int)); 
+	if (state == NULL) throwMemErr("state", "absorbing_chain"); 
+	
+	for (i = 0; i < n; i++)
+		if (state[i] == 0)
+			absorb_state(P, n, i, state, B); 
+	
+	free(state); 
+	return B; 
+}
+
+
+//------------------------------------------------------------------------------
+// Fills in row i of the absorption probabilities B for absorbing_chain, 
+// solving first every state that i leads to. 
+//------------------------------------------------------------------------------
+static void absorb_state (double **P, int n, int i, int *state, double **B)
+{
+	int j, k; 
+	
+	state[i] = 1; 
+	if (P[i][i] == 1.)
+	{
+		B[i][i] = 1.; 
+		state[i] = 2; 
+		return; 
+	}
+	
+	for (k = 0; k < n; k++)
+	{
+		if (k == i || P[i][k] == 0.)
+			continue; 
+		if (state[k] == 1)
+			throwErr("Transitions form a cycle.", "absorbing_chain"); 
+		if (state[k] == 0)
+			absorb_state(P, n, k, state, B); 
+		for (j = 0; j < n; j++)
+			B[i][j] += P[i][k] * B[k][j]; 
+	}
+	for (j = 0; j < n; j++)
+		B[i][j] /= 1. - P[i][i]; 
+	
+	state[i] = 2; 
+}
+
+
 //------------------------------------------------------------------------------
 // Returns A^p where p is a nonnegative integer. n is the dimension of A. 
 // Uses an eigendecomposition algorithm: if A = XDX^-1, then A^p = XD^pX^-1. 
@@ -0,0 +1,97 @@
+#include "parallel.h" 
+#include <stdlib.h> 
+#include <pthread.h> 
+#include <unistd.h> 
+#include "error.h"
+
+//State shared by all threads working through one call to parallel_for. 
+typedef struct {
+	ParallelTask fn; 
+	void *arg; 
+	int ntasks; 
+	int next; //next task to be handed out; incremented atomically 
+} TaskQueue; 
+
+//Argument passed to each thread: the shared queue plus the thread's number. 
+typedef struct {
+	TaskQueue *queue; 
+	int thread; 
+} Worker; 
+
+
+static void * runWorker (void *); 
+
+
+//------------------------------------------------------------------------------
+// Returns the number of processors currently online, or 1 if it cannot be 
+// determined. 
+//------------------------------------------------------------------------------
+int num_cpus ()
+{
+	long n = sysconf(_SC_NPROCESSORS_ONLN); 
+	return n >= 1 ? (int) n : 1; 
+}
+
+
+//------------------------------------------------------------------------------
+// Runs fn(task, thread, arg) for every task in [0, ntasks), spread over 
+// nthreads threads (the calling thread is one of them). Tasks are handed out 
+// dynamically one at a time, so they need not take equal time, and the order
+// in which they are run is unspecified. Returns once every task has finished. 
+//------------------------------------------------------------------------------
+void parallel_for (int ntasks, int nthreads, ParallelTask fn, void *arg)
+{
+	TaskQueue queue; 
+	Worker *workers = NULL; 
+	pthread_t *threads = NULL; 
+	int t; 
+
+	if (nthreads > ntasks)
+		nthreads = ntasks; 
+	if (nthreads < 1)
+		nthreads = 1; 
+
+	queue.fn = fn; 
+	queue.arg = arg; 
+	queue.ntasks = ntasks; 
+	queue.next = 0; 
+
+	workers = (Worker *) malloc(nthreads * sizeof(Worker)); 
+	if (workers == NULL) throwMemErr("workers", "parallel_for"); 
+	threads = (pthread_t *) malloc(nthreads * sizeof(pthread_t)); 
+	if (threads == NULL) throwMemErr("threads", "parallel_for"); 
+
+	for (t = 0; t < nthreads; t++)
+	{
+		workers[t].queue = &queue; 
+		workers[t].thread = t; 
+	}
+
+	//Thread 0 is the calling thread 
+	for (t = 1; t < nthreads; t++)
+		if (pthread_create(&threads[t], NULL, runWorker, &workers[t]) != 0)
+			throwErr("Could not create thread.", "parallel_for"); 
+	runWorker(&workers[0]); 
+	for (t = 1; t < nthreads; t++)
+		pthread_join(threads[t], NULL); 
+
+	free(workers); 
+	free(threads); 
+}
+
+
+//------------------------------------------------------------------------------
+// Body of each thread: keeps taking the next task off the queue until there are
+// none left. 
+//------------------------------------------------------------------------------
+static void * runWorker (void *arg)
+{
+	Worker *worker = (Worker *) arg; 
+	TaskQueue *queue = worker->queue; 
+	int task; 
+
+	while ((task = __sync_fetch_and_add(&queue->next, 1)) < queue->ntasks)
+		queue->fn(task, worker->thread, queue->arg); 
+
+	return NULL; 
+}
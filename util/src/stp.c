@@ -7,7 +7,15 @@
 #include "linal.h"
 #include "moremath.h"
 
+//Constants of the Philox4x32 bijection: round multipliers and the Weyl 
+//sequence added to the key between rounds. 
+#define PHILOX_M0 (0xD2511F53U)
+#define PHILOX_M1 (0xCD9E8D57U)
+#define PHILOX_W0 (0x9E3779B9U)
+#define PHILOX_W1 (0xBB67AE85U)
+#define PHILOX_ROUNDS (10)
 
+static void philox_block (RandStream *rs, uint64_t block, uint32_t *out); 
 
 
 
@@ -21,16 +29,12 @@ gsl_rng * init_runif ()
 {
 	const gsl_rng_type *type; 
 	gsl_rng *rng; 
-	struct timeval time; 
 
 	gsl_rng_env_setup (); 
 	type = gsl_rng_default; 
 	rng = gsl_rng_alloc (type); 
 
-	// Set seed: uses the "timeval" structure from sys/time.h to seed time based on microseconds 
-	// rather than just seconds, as the traditional way of seeding srand() does. 
-	gettimeofday (&time, NULL); 
-	gsl_rng_set (rng, (unsigned long int) time.tv_usec * time.tv_sec); // seed the rng 
+	gsl_rng_set (rng, time_seed ()); // seed the rng 
 
 	// Note: rng is alloc-ed but never freed in either this function or in runif - it stays in
 	// memory throughout the duration of the program. This isn't really a memory leak problem 
@@ -41,6 +45,175 @@ gsl_rng * init_runif ()
 }
 
 
+//--------------------------------------------------------------------------------------------------
+// Returns a seed based on the current time. Uses the "timeval" structure from sys/time.h to seed
+// time based on microseconds rather than just seconds, as the traditional way of seeding srand()
+// does. 
+//--------------------------------------------------------------------------------------------------
+unsigned long int time_seed ()
+{
+	struct timeval time; 
+
+	gettimeofday (&time, NULL); 
+	return (unsigned long int) time.tv_usec * time.tv_sec; 
+}
+
+
+//--------------------------------------------------------------------------------------------------
+// Initializes a counter-based stream with the given seed, positioned at the start of stream 0, 
+// substream 0. 
+//--------------------------------------------------------------------------------------------------
+void rng_seed (RandStream *rs, uint64_t seed)
+{
+	rs->key[0] = (uint32_t) seed; 
+	rs->key[1] = (uint32_t) (seed >> 32); 
+	rs->flip = 0; 
+	rng_set_stream (rs, 0, 0); 
+}
+
+
+//--------------------------------------------------------------------------------------------------
+// Moves a stream to the start of the given stream and substream, keeping its seed. Each 
+// (stream, substream) pair has 2^66 words of its own before it could overlap another. 
+//--------------------------------------------------------------------------------------------------
+void rng_set_stream (RandStream *rs, uint32_t stream, uint32_t substream)
+{
+	rs->stream = stream; 
+	rs->substream = substream; 
+	rs->pos = 0; 
+}
+
+
+//--------------------------------------------------------------------------------------------------
+// Makes the stream antithetic, or normal again. The antithetic stream gives the complement 
+// 2^32-1-x of every word x of the normal one at the same position, so uniform draws u become 
+// (very nearly) 1-u and bounded draws k on [0, n) become n-1-k. Replaying a stretch of the stream
+// both ways gives pairs of negatively correlated draws for antithetic variates. 
+//--------------------------------------------------------------------------------------------------
+void rng_set_antithetic (RandStream *rs, int antithetic)
+{
+	rs->flip = antithetic ? 0xFFFFFFFFU : 0; 
+}
+
+
+//--------------------------------------------------------------------------------------------------
+// Skips over the next n words of a stream in constant time, as if rng_u32 had been called n 
+// times. 
+//--------------------------------------------------------------------------------------------------
+void rng_skip (RandStream *rs, uint64_t n)
+{
+	rs->pos += n; 
+	if (rs->pos & 3)
+		philox_block (rs, rs->pos >> 2, rs->out); 
+}
+
+
+//--------------------------------------------------------------------------------------------------
+// Returns the next uniformly distributed 32-bit word from a stream. 
+//--------------------------------------------------------------------------------------------------
+uint32_t rng_u32 (RandStream *rs)
+{
+	if ((rs->pos & 3) == 0)
+		philox_block (rs, rs->pos >> 2, rs->out); 
+
+	return rs->out[rs->pos++ & 3] ^ rs->flip; 
+}
+
+
+//--------------------------------------------------------------------------------------------------
+// Returns an integer uniformly distributed on [0, n), for n > 0, using only integer arithmetic. 
+// Uses Lemire's multiply-and-shift method ("Fast random integer generation in an interval", 
+// 2019), which needs a division only in the rare case that a draw must be rejected to keep the
+// result exactly uniform. 
+//--------------------------------------------------------------------------------------------------
+uint32_t rng_bounded (RandStream *rs, uint32_t n)
+{
+	uint64_t m = (uint64_t) rng_u32 (rs) * n; 
+	uint32_t low = (uint32_t) m; 
+	uint32_t threshold; 
+
+	if (low < n) 
+	{
+		threshold = -n % n; 
+		while (low < threshold) 
+		{
+			m = (uint64_t) rng_u32 (rs) * n; 
+			low = (uint32_t) m; 
+		}
+	}
+
+	return (uint32_t) (m >> 32); 
+}
+
+
+//--------------------------------------------------------------------------------------------------
+// Fills x with the next n words of a stream. Equivalent to calling rng_u32 n times, but whole 
+// blocks are written straight into x. 
+//--------------------------------------------------------------------------------------------------
+void rng_fill_u32 (RandStream *rs, uint32_t *x, size_t n)
+{
+	size_t i = 0; 
+
+	//Use up what is left of the current block, then generate whole blocks in place 
+	while (i < n && (rs->pos & 3) != 0)
+		x[i++] = rng_u32 (rs); 
+	for (; i + 4 <= n; i += 4, rs->pos += 4) 
+	{
+		philox_block (rs, rs->pos >> 2, x + i); 
+		x[i] ^= rs->flip; 
+		x[i+1] ^= rs->flip; 
+		x[i+2] ^= rs->flip; 
+		x[i+3] ^= rs->flip; 
+	}
+	while (i < n)
+		x[i++] = rng_u32 (rs); 
+}
+
+
+//--------------------------------------------------------------------------------------------------
+// Fills x with n integers uniformly distributed on [0, bound). Equivalent to calling 
+// rng_bounded n times. 
+//--------------------------------------------------------------------------------------------------
+void rng_fill_bounded (RandStream *rs, uint32_t *x, size_t n, uint32_t bound)
+{
+	size_t i; 
+
+	for (i = 0; i < n; i++)
+		x[i] = rng_bounded (rs, bound); 
+}
+
+
+//--------------------------------------------------------------------------------------------------
+// Computes block number "block" (four words) of a stream's current substream. The 128-bit 
+// counter is (block, substream, stream), and the 64-bit key is the seed. 
+//--------------------------------------------------------------------------------------------------
+static void philox_block (RandStream *rs, uint64_t block, uint32_t *out)
+{
+	uint32_t c0 = (uint32_t) block, c1 = (uint32_t) (block >> 32); 
+	uint32_t c2 = rs->substream, c3 = rs->stream; 
+	uint32_t k0 = rs->key[0], k1 = rs->key[1]; 
+	uint64_t p0, p1; 
+	int r; 
+
+	for (r = 0; r < PHILOX_ROUNDS; r++) 
+	{
+		p0 = (uint64_t) PHILOX_M0 * c0; 
+		p1 = (uint64_t) PHILOX_M1 * c2; 
+		c0 = (uint32_t) (p1 >> 32) ^ c1 ^ k0; 
+		c1 = (uint32_t) p1; 
+		c2 = (uint32_t) (p0 >> 32) ^ c3 ^ k1; 
+		c3 = (uint32_t) p0; 
+		k0 += PHILOX_W0; 
+		k1 += PHILOX_W1; 
+	}
+
+	out[0] = c0; 
+	out[1] = c1; 
+	out[2] = c2; 
+	out[3] = c3; 
+}
+
+
 //--------------------------------------------------------------------------------------------------
 // Uniform random number generator. Returns a random number uniformly distributed on [0, 1). 
 //--------------------------------------------------------------------------------------------------
@@ -58,6 +231,15 @@ double runif ()
 }
 
 
+//--------------------------------------------------------------------------------------------------
+// Same as runif, but draws from the given stream. 
+//--------------------------------------------------------------------------------------------------
+double runif_r (RandStream *rs)
+{
+	return rng_u32 (rs) * (1. / 4294967296.); 
+}
+
+
 //------------------------------------------------------------------------------
 // Returns a random integer with the discrete uniform distribution, between a
 // and b inclusive. 
@@ -74,6 +256,16 @@ int rdiscunif (int a, int b)
 }
 
 
+//------------------------------------------------------------------------------
+// Same as rdiscunif, but draws from the given stream. Uses integer arithmetic
+// only, so the result is exactly uniform. 
+//------------------------------------------------------------------------------
+int rdiscunif_r (RandStream *rs, int a, int b)
+{
+	return a + (int) rng_bounded (rs, (uint32_t) (b - a + 1)); 
+}
+
+
 //------------------------------------------------------------------------------
 // Returns a random draw from a vector of probabilities. The draw takes values
 // in [1, N]. Returns a value of i with probability equal to the entry v[i-1]. 
@@ -96,6 +288,27 @@ int randdraw (double *v, int N)
 }
 
 
+//------------------------------------------------------------------------------
+// Same as randdraw, but draws from the given stream. 
+//------------------------------------------------------------------------------
+int randdraw_r (RandStream *rs, double *v, int N)
+{
+	double sum, x;  
+	int i; 
+	
+	x = runif_r(rs); 
+	sum = v[0];  
+	i = 0; 
+	while (x > sum && i < N-1) 
+	{
+		i++; 
+		sum += v[i]; 
+	}
+	
+	return i + 1; 
+}
+
+
 
 //------------------------------------------------------------------------------
 // Returns a random draw from a vector. The ith entry of the vector is the 
@@ -157,11 +370,81 @@ int randdraw_count2 (int *v, int N, int sum)
 }
 
 
+//------------------------------------------------------------------------------
+// Same as randdraw_count2, but draws from the given stream. 
+//------------------------------------------------------------------------------
+int randdraw_count2_r (RandStream *rs, int *v, int N, int sum)
+{
+	int x, count, i; 
+	
+	x = rdiscunif_r(rs, 1, sum); 
+	
+	count = v[0]; 
+	i = 0; 
+	while (x > count && i < N - 1)
+	{
+		i++; 
+		count += v[i]; 
+	}
+	
+	return i + 1; 
+}
 
 
+//------------------------------------------------------------------------------
+// Standard normal cumulative distribution function. 
+//------------------------------------------------------------------------------
+double pnorm (double x)
+{
+	return 0.5 * erfc(-x / sqrt(2.)); 
+}
 
 
-
-
-
+//------------------------------------------------------------------------------
+// Standard normal quantile function, i.e. the inverse of pnorm, for p in 
+// (0, 1). Uses Acklam's rational approximation (relative error about 1e-9), 
+// polished by one step of Halley's method. 
+//------------------------------------------------------------------------------
+double qnorm (double p)
+{
+	static const double a[6] = {-3.969683028665376e+01, 2.209460984245205e+02,
+		-2.759285104469687e+02, 1.383577518672690e+02, -3.066479806614716e+01,
+		2.506628277459239e+00}; 
+	static const double b[5] = {-5.447609879822406e+01, 1.615858368580409e+02,
+		-1.556989798598866e+02, 6.680131188771972e+01, -1.328068155288572e+01}; 
+	static const double c[6] = {-7.784894002430293e-03, -3.223964580411365e-01,
+		-2.400758277161838e+00, -2.549732539343734e+00, 4.374664141464968e+00,
+		2.938163982698783e+00}; 
+	static const double d[4] = {7.784695709041462e-03, 3.224671290700398e-01,
+		2.445134137142996e+00, 3.754408661907416e+00}; 
+	const double P_LOW = 0.02425; 
+	double q, r, x, e, u; 
+	
+	if (p <= 0. || p >= 1.)
+		throwErr("p must be in (0, 1).", "qnorm"); 
+	
+	if (p < P_LOW)
+	{
+		q = sqrt(-2. * log(p)); 
+		x = (((((c[0]*q + c[1])*q + c[2])*q + c[3])*q + c[4])*q + c[5]) 
+			/ ((((d[0]*q + d[1])*q + d[2])*q + d[3])*q + 1.); 
+	}
+	else if (p <= 1. - P_LOW)
+	{
+		q = p - 0.5; 
+		r = q * q; 
+		x = (((((a[0]*r + a[1])*r + a[2])*r + a[3])*r + a[4])*r + a[5]) * q 
+			/ (((((b[0]*r + b[1])*r + b[2])*r + b[3])*r + b[4])*r + 1.); 
+	}
+	else 
+	{
+		q = sqrt(-2. * log(1. - p)); 
+		x = -(((((c[0]*q + c[1])*q + c[2])*q + c[3])*q + c[4])*q + c[5]) 
+			/ ((((d[0]*q + d[1])*q + d[2])*q + d[3])*q + 1.); 
+	}
+	
+	e = pnorm(x) - p; 
+	u = e * sqrt(2. * M_PI) * exp(x * x / 2.); 
+	return x - u / (1. + x * u / 2.); 
+}
 